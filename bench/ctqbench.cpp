@@ -0,0 +1,457 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Times the data model on synthetic trees and samples, printing one line per
+// measurement. Built with CTQTOOL_BUILD_BENCHMARKS; run as
+//   ctqbench [--scale f] [benchmark...]
+// where a scale of 1 gives the sizes the requirements name.
+
+#include "datamodel/csvimport.h"
+#include "datamodel/ctq.h"
+#include "datamodel/ctqmodel.h"
+#include "datamodel/item.h"
+#include "datamodel/journal.h"
+#include "datamodel/parallel.h"
+#include "datamodel/spc.h"
+#include "datamodel/sqlstore.h"
+#include "datamodel/xmlstream.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using namespace CtqTool;
+
+    struct Benchmark
+    {
+        const char* name;
+        const char* description;
+        std::function<bool(double scale)> run;
+    };
+
+    size_t scaled(double scale, size_t count)
+    {
+        return std::max<size_t>(1, static_cast<size_t>(scale * count));
+    }
+
+    void report(const char* what, const QElapsedTimer& timer, double bytes = 0.0, double items = 0.0)
+    {
+        const auto seconds = std::max<qint64>(timer.nsecsElapsed(), 1) / 1e9;
+        std::printf("  %-32s %9.3f s", what, seconds);
+        if (bytes > 0.0)
+        {
+            std::printf("  %9.1f MB/s", bytes / seconds / 1e6);
+        }
+        if (items > 0.0)
+        {
+            std::printf("  %9.2f M/s", items / seconds / 1e6);
+        }
+        std::printf("\n");
+    }
+
+    // needs x drivers x ctqs, with limits on every CTQ
+    std::unique_ptr<TreeItem> makeTree(size_t needs, size_t drivers, size_t ctqs)
+    {
+        auto root = CtqModel::Parse(QString());
+        for (size_t n = 0; n < needs; ++n)
+        {
+            auto need = std::make_shared<TreeItem>(MakeItemData(1, QString("Need %1").arg(n), "what the customer asks for"), root.get());
+            for (size_t d = 0; d < drivers; ++d)
+            {
+                auto driver = std::make_shared<TreeItem>(MakeItemData(2, QString("Driver %1.%2").arg(n).arg(d),
+                    "what delivers it"), need.get());
+                for (size_t c = 0; c < ctqs; ++c)
+                {
+                    auto data = MakeItemData(3, QString("CTQ %1.%2.%3").arg(n).arg(d).arg(c), "how it is measured");
+                    auto& target = static_cast<Ctq&>(*data).GetMeasurement().GetTarget();
+                    target.SetLowerLimit(-3.0);
+                    target.SetNominal(0.0);
+                    target.SetUpperLimit(3.0);
+                    target.SetUnits("mm");
+                    auto ctq = std::make_shared<TreeItem>(data, driver.get());
+                    ctq->SetRank(static_cast<unsigned short>(c % 10));
+                    driver->Append(std::move(ctq));
+                }
+                need->Append(std::move(driver));
+            }
+            root->Append(std::move(need));
+        }
+        return root;
+    }
+
+    // about 500 MB of XML at scale 1
+    bool benchmarkXml(double scale)
+    {
+        const auto root = makeTree(100, 100, scaled(scale, 170));
+
+        QTemporaryFile file;
+        if (!file.open())
+        {
+            return false;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        if (!WriteXml(*root, file) || !file.flush())
+        {
+            return false;
+        }
+        const auto bytes = static_cast<double>(file.size());
+        report("write", timer, bytes);
+
+        file.seek(0);
+        timer.start();
+        QString error;
+        const auto read = ReadXml(file, &error);
+        report("read", timer, bytes);
+        if (!read)
+        {
+            std::printf("  %s\n", qUtf8Printable(error));
+        }
+        return read != nullptr;
+    }
+
+    // normally distributed values, a second apart, in lots of 1000
+    struct Samples
+    {
+        std::vector<double> values;
+        std::vector<qint64> timestamps;
+        std::vector<quint32> lots;
+    };
+
+    Samples makeSamples(size_t count)
+    {
+        Samples s;
+        std::mt19937_64 random(count);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            s.values.push_back(normal(random));
+            s.timestamps.push_back(static_cast<qint64>(i) * 1000);
+            s.lots.push_back(static_cast<quint32>(i / 1000));
+        }
+        return s;
+    }
+
+    // 10k CTQs of 100k samples each at scale 1, which takes 20 GB of memory
+    bool benchmarkStatistics(double scale)
+    {
+        CtqModel model;
+        model.Reset(makeTree(10, 10, scaled(scale, 100)));
+        const auto samples = makeSamples(100000);
+        const auto ctqs = model.GetCtqs();
+        const auto count = static_cast<double>(ctqs.size() * samples.values.size());
+
+        QElapsedTimer timer;
+        timer.start();
+        for (auto* ctq : ctqs)
+        {
+            ctq->GetMeasurement().Append(samples.values.data(), samples.timestamps.data(), samples.lots.data(),
+                                         samples.values.size());
+        }
+        report("append", timer, 0.0, count);
+
+        timer.start();
+        const auto& measurement = ctqs.front()->GetMeasurement();
+        const auto one = ComputeStatistics(measurement.GetSamples(), measurement.GetTarget());
+        report("one CTQ, one thread", timer, 0.0, static_cast<double>(one.count));
+
+        QEventLoop loop;
+        QObject::connect(&model, &CtqModel::StatisticsUpdated, &loop, &QEventLoop::quit);
+        timer.start();
+        model.UpdateStatistics();
+        loop.exec();
+        report("all CTQs", timer, 0.0, count);
+        return ctqs.back()->GetStatistics().count == samples.values.size();
+    }
+
+    // about 1 GB of CSV at scale 1, grouped by CTQ in runs of 1000 lines
+    bool benchmarkCsv(double scale)
+    {
+        CtqModel model;
+        model.Reset(makeTree(10, 10, 10));
+        const auto ctqs = model.GetCtqs();
+        const auto lines = scaled(scale, 25000000);
+
+        QTemporaryFile file;
+        if (!file.open())
+        {
+            return false;
+        }
+        std::mt19937_64 random(lines);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        QByteArray buffer("ctq,value,timestamp,lot\n");
+        for (size_t i = 0; i < lines; ++i)
+        {
+            buffer.append(ctqs[(i / 1000) % ctqs.size()]->GetText().toUtf8()).append(',');
+            buffer.append(QByteArray::number(normal(random), 'g', 9)).append(',');
+            buffer.append(QByteArray::number(1600000000000 + qint64(i) * 1000)).append(',');
+            buffer.append(QByteArray::number(qulonglong(i / 100000))).append('\n');
+            if (buffer.size() > (1 << 24) || i + 1 == lines)
+            {
+                if (file.write(buffer) != buffer.size())
+                {
+                    return false;
+                }
+                buffer.clear();
+            }
+        }
+        if (!file.flush())
+        {
+            return false;
+        }
+
+        CsvColumns columns;
+        columns.timestamp = 2;
+        columns.lot = 3;
+        QElapsedTimer timer;
+        timer.start();
+        const auto result = ImportCsv(file.fileName(), columns, model);
+        report("import", timer, static_cast<double>(result.bytes), static_cast<double>(result.samples));
+        if (!result.error.isEmpty())
+        {
+            std::printf("  %s\n", qUtf8Printable(result.error));
+        }
+        return result.error.isEmpty() && result.samples == lines;
+    }
+
+    // 100M samples at scale 1 into a measurement that keeps none of them
+    bool benchmarkSketch(double scale)
+    {
+        Measurement measurement;
+        measurement.GetTarget().SetLowerLimit(-3.0);
+        measurement.GetTarget().SetUpperLimit(3.0);
+        measurement.SetSampleLimit(0);
+        const auto samples = makeSamples(SampleStore::chunkCapacity);
+        const auto blocks = scaled(scale, 1500);
+
+        QElapsedTimer timer;
+        timer.start();
+        for (size_t b = 0; b < blocks; ++b)
+        {
+            measurement.Append(samples.values.data(), samples.timestamps.data(), samples.lots.data(), samples.values.size());
+        }
+        report("append", timer, 0.0, static_cast<double>(blocks * samples.values.size()));
+
+        // the samples repeat, so their ranks are known exactly
+        auto sorted = samples.values;
+        std::sort(sorted.begin(), sorted.end());
+        const auto& sketch = measurement.GetDistribution().GetSketch();
+        auto worst = 0.0;
+        for (const auto q : {0.01, 0.5, 0.99})
+        {
+            const auto exact = static_cast<double>(std::upper_bound(sorted.begin(), sorted.end(), *sketch.Quantile(q)) - sorted.begin());
+            worst = std::max(worst, std::abs(exact / sorted.size() - q));
+        }
+        std::printf("  %-32s %9.4f\n", "worst rank error", worst);
+        return !measurement.KeepsSamples() && measurement.GetSamples().Size() == 0 && worst < 0.017;
+    }
+
+    // 1000 CTQs fed 100k samples each at scale 1, in blocks as a CSV append
+    // would deliver them, first on one thread and then one CTQ per task
+    bool benchmarkSpc(double scale)
+    {
+        const size_t ctqs = 1000;
+        const size_t block = 1000;
+        const auto samples = makeSamples(scaled(scale, 100000));
+        const auto count = samples.values.size();
+
+        std::vector<SpcChart> charts(ctqs);
+        QElapsedTimer timer;
+        timer.start();
+        for (size_t offset = 0; offset < count; offset += block)
+        {
+            for (auto& chart : charts)
+            {
+                chart.Append(samples.values.data() + offset, std::min(block, count - offset));
+            }
+        }
+        report("append", timer, 0.0, static_cast<double>(ctqs * count));
+
+        std::vector<SpcChart> parallel(ctqs);
+        timer.restart();
+        ParallelFor(ctqs, [&](size_t i)
+        {
+            for (size_t offset = 0; offset < count; offset += block)
+            {
+                parallel[i].Append(samples.values.data() + offset, std::min(block, count - offset));
+            }
+        });
+        report("append in parallel", timer, 0.0, static_cast<double>(ctqs * count));
+
+        // every chart saw the same samples, so they agree on the subgroups
+        size_t violations = 0;
+        for (size_t i = 0; i < ctqs; ++i)
+        {
+            if (charts[i].GetSubgroupCount() != parallel[i].GetSubgroupCount() ||
+                charts[i].GetActiveRules() != parallel[i].GetActiveRules())
+            {
+                return false;
+            }
+            violations += charts[i].TakeViolations().violations.size();
+        }
+        std::printf("  %-32s %9zu\n", "violations", violations);
+        return charts.front().IsCalibrated() == (count >= 5 * 25);
+    }
+
+    size_t countItems(const TreeItem& item)
+    {
+        size_t count = 1;
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            count += countItems(*item.GetChild(r));
+        }
+        return count;
+    }
+
+    // 1M nodes at scale 1: written at once, browsed a page of children at a
+    // time as the lazy model fetches them, read whole and edited
+    bool benchmarkSql(double scale)
+    {
+        constexpr auto page = 1000;
+        const auto root = makeTree(100, 100, scaled(scale, 100));
+        const auto nodes = countItems(*root);
+
+        QTemporaryFile file;
+        if (!file.open())
+        {
+            return false;
+        }
+        const auto store = SqlStore::Open(file.fileName());
+        if (!store)
+        {
+            return false;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!store->Write(*root))
+        {
+            return false;
+        }
+        report("write", timer, 0.0, static_cast<double>(nodes));
+
+        timer.start();
+        size_t browsed = 1;
+        std::vector<NodeStore::Id> parents{store->GetRoot()};
+        while (!parents.empty())
+        {
+            const auto parent = parents.back();
+            parents.pop_back();
+            const auto count = store->ChildCount(parent);
+            for (auto first = 0; first < count; first += page)
+            {
+                for (const auto& node : store->GetChildren(parent, first, page))
+                {
+                    ++browsed;
+                    if (node.childCount > 0)
+                    {
+                        parents.push_back(node.id);
+                    }
+                }
+            }
+        }
+        report("browse", timer, 0.0, static_cast<double>(browsed));
+
+        timer.start();
+        const auto read = store->Read();
+        report("read", timer, 0.0, static_cast<double>(nodes));
+
+        // renames spread over the tree, then a need with its subtree removed
+        std::vector<JournalRecord> journal;
+        const auto needs = root->ChildCount();
+        const auto drivers = root->GetChild(0)->ChildCount();
+        const auto ctqs = root->GetChild(0)->GetChild(0)->ChildCount();
+        const auto edits = scaled(scale, 10000);
+        std::mt19937_64 random(edits);
+        for (size_t i = 0; i < edits; ++i)
+        {
+            const auto path = std::vector<int>{static_cast<int>(random() % needs), static_cast<int>(random() % drivers),
+                static_cast<int>(random() % ctqs)};
+            journal.push_back({JournalRecord::Operation::SetData, path, 0, 0, QString("Renamed %1").arg(i), {}});
+        }
+        journal.push_back({JournalRecord::Operation::Remove, {}, 0, 1, {}, {}});
+        timer.start();
+        if (!store->Apply(journal))
+        {
+            return false;
+        }
+        report("apply", timer, 0.0, static_cast<double>(journal.size()));
+
+        const auto removed = countItems(*root->GetChild(0));
+        return browsed == nodes && read && countItems(*read) == nodes && store->ChildCount(store->GetRoot()) == needs - 1 &&
+            countItems(*store->Read()) == nodes - removed;
+    }
+
+    const std::vector<Benchmark> benchmarks
+    {
+        {"xml", "write and read a tree of 1.7M CTQs as XML", benchmarkXml},
+        {"statistics", "compute the statistics of 10k CTQs of 100k samples", benchmarkStatistics},
+        {"csv", "import 25M samples of 1000 CTQs from CSV", benchmarkCsv},
+        {"sketch", "stream 100M samples into a sketch without keeping them", benchmarkSketch},
+        {"spc", "evaluate the SPC run rules on 100M samples of 1000 CTQs", benchmarkSpc},
+        {"sql", "write, browse, read and edit a database of 1M nodes", benchmarkSql},
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("benchmark", "The benchmarks to run, all by default.");
+    const QCommandLineOption scaleOption("scale", "Scales the size of the inputs.", "scale", "1");
+    parser.addOption(scaleOption);
+    parser.process(application);
+
+    const auto scale = parser.value(scaleOption).toDouble();
+    const auto selected = parser.positionalArguments();
+    if (!(scale > 0.0))
+    {
+        parser.showHelp(1);
+    }
+
+    auto failed = 0;
+    for (const auto& benchmark : benchmarks)
+    {
+        if (!selected.isEmpty() && !selected.contains(benchmark.name))
+        {
+            continue;
+        }
+        std::printf("%s: %s\n", benchmark.name, benchmark.description);
+        if (!benchmark.run(scale))
+        {
+            std::printf("  failed\n");
+            ++failed;
+        }
+    }
+    return failed;
+}
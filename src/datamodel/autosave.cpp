@@ -0,0 +1,332 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "autosave.h"
+#include "ctqmodel.h"
+#include "document.h"
+#include "item.h"
+#include "textformat.h"
+
+#include <QDir>
+#include <QFile>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto defaultInterval = 30 * 1000;
+    constexpr auto maximumSlots = 1000;
+
+    const auto recoveryPattern = QStringLiteral("recovery-*.ctq");
+
+    QString recoveryDirectory()
+    {
+        const auto dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        QDir().mkpath(dir);
+        return dir;
+    }
+
+    // next to recovery-<n>.ctq, whose instance holds the lock while it runs
+    QString sourceFilename(const QString& recovery)
+    {
+        return recovery + ".source";
+    }
+
+    QString lockFilename(const QString& recovery)
+    {
+        return QString(recovery).replace(recovery.size() - 4, 4, ".lock");
+    }
+
+    QString baselineFilename(const QString& recovery)
+    {
+        return QString(recovery).replace(recovery.size() - 4, 4, ".baseline");
+    }
+
+    std::unique_ptr<QLockFile> tryLock(const QString& recovery)
+    {
+        auto lock = std::make_unique<QLockFile>(lockFilename(recovery));
+        // held as long as the instance runs, and stale only once it is gone
+        lock->setStaleLockTime(0);
+        return lock->tryLock(0) ? std::move(lock) : nullptr;
+    }
+
+    void removeRecovery(const QString& recovery)
+    {
+        QFile::remove(recovery);
+        QFile::remove(sourceFilename(recovery));
+    }
+
+    std::unique_ptr<TreeItem> replay(std::unique_ptr<TreeItem> root, const std::vector<JournalRecord>& records)
+    {
+        for (auto it = records.cbegin(); root && it != records.cend(); ++it)
+        {
+            if (!Apply(*it, *root))
+            {
+                return nullptr;
+            }
+        }
+        return root;
+    }
+}
+
+namespace CtqTool
+{
+    AutosaveService::AutosaveService(const CtqModel& m, const Document& d, QObject* parent) :
+        QObject(parent),
+        model(m),
+        document(d)
+    {
+        pool.setMaxThreadCount(1);
+
+        // the files of instances still running are locked
+        const auto dir = recoveryDirectory();
+        for (const auto& name : QDir(dir).entryList({recoveryPattern}, QDir::Files, QDir::Time))
+        {
+            const auto orphan = dir + '/' + name;
+            if (auto orphanLock = tryLock(orphan))
+            {
+                orphans.push_back(orphan);
+                orphanLocks.push_back(std::move(orphanLock));
+            }
+        }
+        for (auto n = 0; n < maximumSlots && !lock; ++n)
+        {
+            const auto recovery = dir + QString("/recovery-%1.ctq").arg(n);
+            if (!orphans.contains(recovery) && !QFile::exists(recovery))
+            {
+                lock = tryLock(recovery);
+                recoveryFilename = lock ? recovery : QString();
+            }
+        }
+
+        const auto markDirty = [this]() { dirty = true; };
+        connect(&model, &QAbstractItemModel::dataChanged, this, markDirty);
+        connect(&model, &QAbstractItemModel::rowsInserted, this, markDirty);
+        connect(&model, &QAbstractItemModel::rowsRemoved, this, markDirty);
+        connect(&model, &QAbstractItemModel::modelReset, this, markDirty);
+
+        connect(&timer, &QTimer::timeout, this, &AutosaveService::Autosave);
+        timer.start(defaultInterval);
+    }
+
+    AutosaveService::~AutosaveService()
+    {
+        pool.waitForDone();
+        if (discarded && !recoveryFilename.isEmpty())
+        {
+            // written after the discard
+            removeRecovery(recoveryFilename);
+            QFile::remove(baselineFilename(recoveryFilename));
+        }
+    }
+
+    void AutosaveService::SetInterval(int milliseconds)
+    {
+        timer.start(milliseconds);
+    }
+
+    void AutosaveService::SetEnabled(bool on)
+    {
+        enabled = on;
+        if (enabled)
+        {
+            timer.start();
+        }
+        else
+        {
+            timer.stop();
+            dirty = false;
+        }
+    }
+
+    TreeSnapshot AutosaveService::Capture() const
+    {
+        if (!enabled)
+        {
+            return nullptr;
+        }
+
+        // everything captured here is either owned by the snapshot or
+        // immutable, so the model can be edited while a worker builds it
+        auto records = model.GetJournal();
+        if (!model.IsJournalComplete())
+        {
+            if (!baseline)
+            {
+                return nullptr;
+            }
+            return [base = baseline, records = std::move(records)]()
+            {
+                return replay(base(), records);
+            };
+        }
+        if (document.GetFilename().isEmpty())
+        {
+            return [records = std::move(records)]()
+            {
+                return replay(CtqModel::Parse(QString()), records);
+            };
+        }
+
+        // opened here so that a compaction replacing the file cannot race the worker
+        auto file = std::make_shared<QFile>(document.GetFilename());
+        const auto size = document.GetCommittedSize();
+        if (size < 0 || !file->open(QIODevice::ReadOnly))
+        {
+            return nullptr;
+        }
+        return [file, size, records = std::move(records)]() -> std::unique_ptr<TreeItem>
+        {
+            auto contents = file->seek(0) ? Document::Read(*file, size) : Document::Contents();
+            if (contents.committedSize != size)
+            {
+                return nullptr;
+            }
+            return replay(std::move(contents.root), records);
+        };
+    }
+
+    void AutosaveService::SetBaseline(TreeSnapshot snapshot)
+    {
+        baseline = std::move(snapshot);
+    }
+
+    void AutosaveService::ClearBaseline()
+    {
+        baseline = nullptr;
+        if (!recoveryFilename.isEmpty())
+        {
+            QFile::remove(baselineFilename(recoveryFilename));
+        }
+    }
+
+    void AutosaveService::Discard()
+    {
+        ++generation;
+        dirty = false;
+        discarded = true;
+        if (!recoveryFilename.isEmpty())
+        {
+            removeRecovery(recoveryFilename);
+        }
+    }
+
+    QStringList AutosaveService::GetOrphans() const
+    {
+        return orphans;
+    }
+
+    QString AutosaveService::GetSource(const QString& orphan)
+    {
+        QFile file(sourceFilename(orphan));
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return {};
+        }
+        return QString::fromUtf8(file.readAll());
+    }
+
+    TreeSnapshot AutosaveService::Adopt(const QString& orphan)
+    {
+        if (recoveryFilename.isEmpty() || !orphans.contains(orphan))
+        {
+            return nullptr;
+        }
+
+        // renamed, as the orphan's name is free for another instance once released
+        const auto adopted = baselineFilename(recoveryFilename);
+        QFile::remove(adopted);
+        const auto renamed = QFile::rename(orphan, adopted);
+        RemoveOrphan(orphan);
+        if (!renamed)
+        {
+            return nullptr;
+        }
+        return [adopted]()
+        {
+            return Document::Read(adopted).root;
+        };
+    }
+
+    void AutosaveService::RemoveOrphan(const QString& orphan)
+    {
+        const auto i = orphans.indexOf(orphan);
+        if (i < 0)
+        {
+            return;
+        }
+        removeRecovery(orphan);
+        QFile::remove(baselineFilename(orphan));
+        orphans.removeAt(i);
+        orphanLocks.erase(orphanLocks.begin() + i);
+    }
+
+    void AutosaveService::ReleaseOrphans()
+    {
+        orphans.clear();
+        orphanLocks.clear();
+    }
+
+    void AutosaveService::Autosave()
+    {
+        if (!dirty || busy || recoveryFilename.isEmpty())
+        {
+            return;
+        }
+        auto snapshot = Capture();
+        if (!snapshot)
+        {
+            return;
+        }
+
+        busy = true;
+        dirty = false;
+        discarded = false;
+        pool.start([this, snapshot = std::move(snapshot), recovery = recoveryFilename,
+            source = document.GetFilename(), gen = generation]()
+        {
+            const auto root = snapshot();
+
+            QSaveFile sidecar(sourceFilename(recovery));
+            QSaveFile target(recovery);
+            const auto ok = root && sidecar.open(QIODevice::WriteOnly) && sidecar.write(source.toUtf8()) >= 0 &&
+                sidecar.commit() && target.open(QIODevice::WriteOnly) && WriteTree(*root, target) && target.commit();
+
+            QMetaObject::invokeMethod(this, [this, ok, gen]() { Finish(ok, gen); }, Qt::QueuedConnection);
+        });
+    }
+
+    void AutosaveService::Finish(bool success, int gen)
+    {
+        busy = false;
+        if (gen != generation)
+        {
+            // saved or reloaded in the meantime
+            removeRecovery(recoveryFilename);
+            return;
+        }
+        if (!success)
+        {
+            dirty = true;
+        }
+        emit Saved(success);
+    }
+}
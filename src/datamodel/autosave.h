@@ -0,0 +1,105 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QLockFile;
+
+namespace CtqTool
+{
+    class CtqModel;
+    class Document;
+    class TreeItem;
+
+    // Builds a tree on a worker from what was captured when it was taken, e.g.
+    // files opened and edits copied, so that it does not depend on the model.
+    // Null if it cannot be built.
+    using TreeSnapshot = std::function<std::unique_ptr<TreeItem>()>;
+
+    // Periodically writes the model to a recovery file. The GUI thread only
+    // copies the edits made since the document was last saved; rebuilding and
+    // writing the tree happens on a worker, which replays those edits on the
+    // saved file (or on a baseline snapshot if the journal cannot describe the model).
+    // Every running instance has a recovery file of its own, locked while it
+    // runs and removed once discarded, so those left behind are of instances
+    // that did not shut down cleanly.
+    class AutosaveService : public QObject
+    {
+        Q_OBJECT
+    public:
+        AutosaveService(const CtqModel&, const Document&, QObject* parent = nullptr);
+        ~AutosaveService();
+
+        void SetInterval(int milliseconds);
+        // off for a model the recovery file cannot describe, e.g. one read from a database
+        void SetEnabled(bool);
+
+        // the model as it is now; null when it is disabled, or the journal
+        // cannot describe the model and there is no baseline
+        TreeSnapshot Capture() const;
+
+        // the tree the journal applies to after a reset that is not backed by the document
+        void SetBaseline(TreeSnapshot);
+        void ClearBaseline();
+
+        // drops the recovery file, e.g. after a save or on a clean exit
+        void Discard();
+
+        // the recovery files left by other instances, reserved for this one
+        // until they are removed or released
+        QStringList GetOrphans() const;
+        // the document an orphan is a recovery of, empty if untitled
+        static QString GetSource(const QString& orphan);
+        // takes an orphan over as the baseline of the tree recovered from it
+        TreeSnapshot Adopt(const QString& orphan);
+        void RemoveOrphan(const QString&);
+        // leaves the orphans not removed to the next instance to start
+        void ReleaseOrphans();
+
+    signals:
+        void Saved(bool success);
+
+    private:
+        void Autosave();
+        void Finish(bool success, int generation);
+
+        const CtqModel& model;
+        const Document& document;
+        TreeSnapshot baseline;
+        QString recoveryFilename;               // empty if no slot could be locked
+        std::unique_ptr<QLockFile> lock;
+        QStringList orphans;
+        std::vector<std::unique_ptr<QLockFile>> orphanLocks;
+        QTimer timer;
+        QThreadPool pool;
+        int generation = 0;
+        bool enabled = true;
+        bool dirty = false;
+        bool busy = false;
+        bool discarded = true;
+    };
+}
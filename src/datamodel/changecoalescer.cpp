@@ -0,0 +1,120 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "changecoalescer.h"
+
+#include <algorithm>
+
+namespace
+{
+    // the union of two role lists, where an empty list stands for all roles
+    void mergeRoles(QList<int>& roles, const QList<int>& more)
+    {
+        if (roles.isEmpty())
+        {
+            return;
+        }
+        if (more.isEmpty())
+        {
+            roles.clear();
+            return;
+        }
+        for (const auto role : more)
+        {
+            if (!roles.contains(role))
+            {
+                roles.append(role);
+            }
+        }
+    }
+}
+
+namespace CtqTool
+{
+    ChangeCoalescer::ChangeCoalescer(QAbstractItemModel& m, int interval) :
+        model(m)
+    {
+        timer.setSingleShot(true);
+        timer.setInterval(interval);
+        connect(&timer, &QTimer::timeout, this, &ChangeCoalescer::Flush);
+
+        connect(&model, &QAbstractItemModel::rowsAboutToBeInserted, this, &ChangeCoalescer::Flush);
+        connect(&model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &ChangeCoalescer::Flush);
+        connect(&model, &QAbstractItemModel::rowsAboutToBeMoved, this, &ChangeCoalescer::Flush);
+        connect(&model, &QAbstractItemModel::columnsAboutToBeInserted, this, &ChangeCoalescer::Flush);
+        connect(&model, &QAbstractItemModel::columnsAboutToBeRemoved, this, &ChangeCoalescer::Flush);
+        connect(&model, &QAbstractItemModel::layoutAboutToBeChanged, this, &ChangeCoalescer::Flush);
+        connect(&model, &QAbstractItemModel::modelAboutToBeReset, this, &ChangeCoalescer::Discard);
+    }
+
+    void ChangeCoalescer::Add(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QList<int>& roles)
+    {
+        if (!topLeft.isValid() || !bottomRight.isValid())
+        {
+            return;
+        }
+
+        const auto parent = topLeft.parent();
+        const auto it = byParent.constFind(parent);
+        if (it == byParent.constEnd())
+        {
+            byParent.insert(parent, pending.size());
+            pending.push_back({parent, topLeft.row(), topLeft.column(), bottomRight.row(), bottomRight.column(), roles});
+        }
+        else
+        {
+            auto& range = pending[*it];
+            range.top = std::min(range.top, topLeft.row());
+            range.left = std::min(range.left, topLeft.column());
+            range.bottom = std::max(range.bottom, bottomRight.row());
+            range.right = std::max(range.right, bottomRight.column());
+            mergeRoles(range.roles, roles);
+        }
+
+        if (!timer.isActive())
+        {
+            timer.start();
+        }
+    }
+
+    void ChangeCoalescer::Flush()
+    {
+        timer.stop();
+        if (pending.empty())
+        {
+            return;
+        }
+
+        // changes made by receivers start a new batch
+        const auto ranges = std::move(pending);
+        pending.clear();
+        byParent.clear();
+        for (const auto& range : ranges)
+        {
+            emit model.dataChanged(model.index(range.top, range.left, range.parent),
+                model.index(range.bottom, range.right, range.parent), range.roles);
+        }
+    }
+
+    void ChangeCoalescer::Discard()
+    {
+        timer.stop();
+        pending.clear();
+        byParent.clear();
+    }
+}
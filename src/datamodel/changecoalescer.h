@@ -0,0 +1,63 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QTimer>
+
+#include <vector>
+
+namespace CtqTool
+{
+    // Collects the changes a model reports and emits them as its dataChanged
+    // at most once per frame: one signal per parent, spanning the rows,
+    // columns and roles that changed under it. Pending changes are emitted
+    // before the structure of the model changes, while their indexes are
+    // still valid, and dropped when it resets. It must be created before
+    // views connect to the model, e.g. as one of its members.
+    class ChangeCoalescer : public QObject
+    {
+        Q_OBJECT
+    public:
+        static constexpr int frameInterval = 16; // milliseconds
+
+        explicit ChangeCoalescer(QAbstractItemModel&, int interval = frameInterval);
+
+        void Add(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QList<int>& roles = {});
+        void Flush();
+        void Discard();
+
+    private:
+        struct Range
+        {
+            QModelIndex parent;
+            int top = 0;
+            int left = 0;
+            int bottom = 0;
+            int right = 0;
+            QList<int> roles;                   // empty for all roles
+        };
+
+        QAbstractItemModel& model;
+        std::vector<Range> pending;
+        QHash<QModelIndex, size_t> byParent;    // into pending
+        QTimer timer;
+    };
+}
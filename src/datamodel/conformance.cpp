@@ -0,0 +1,164 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "conformance.h"
+#include "samplestore.h"
+#include "sketch.h"
+#include "target.h"
+
+#include <algorithm>
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto guardBand = 0.1;
+    constexpr size_t lanes = 4;
+    constexpr auto infinity = std::numeric_limits<double>::infinity();
+
+    struct Bounds
+    {
+        double lower = -infinity;
+        double upper = infinity;
+        double nearLower = -infinity;
+        double nearUpper = infinity;
+    };
+
+    Bounds makeBounds(const Target& target)
+    {
+        const auto l = target.GetLowerLimit();
+        const auto u = target.GetUpperLimit();
+        const auto n = target.GetNominal();
+
+        Bounds b;
+        b.lower = b.nearLower = l.value_or(-infinity);
+        b.upper = b.nearUpper = u.value_or(infinity);
+        if (l && u)
+        {
+            const auto band = guardBand * (*u - *l);
+            b.nearLower = *l + band;
+            b.nearUpper = *u - band;
+        }
+        else if (l && n)
+        {
+            b.nearLower = *l + guardBand * std::abs(*n - *l);
+        }
+        else if (u && n)
+        {
+            b.nearUpper = *u - guardBand * std::abs(*u - *n);
+        }
+        return b;
+    }
+
+    // Comparisons are summed rather than branched on, so the loop vectorizes.
+    // The near band contains the out of spec region, hence near = band - out.
+    void count(const double* x, size_t n, const Bounds& b, Conformance& c)
+    {
+        size_t band[lanes] = {};
+        size_t out[lanes] = {};
+        size_t i = 0;
+        for (; i + lanes <= n; i += lanes)
+        {
+            for (size_t k = 0; k < lanes; ++k)
+            {
+                const auto v = x[i + k];
+                band[k] += (v < b.nearLower) | (v > b.nearUpper);
+                out[k] += (v < b.lower) | (v > b.upper);
+            }
+        }
+        for (; i < n; ++i)
+        {
+            band[0] += (x[i] < b.nearLower) | (x[i] > b.nearUpper);
+            out[0] += (x[i] < b.lower) | (x[i] > b.upper);
+        }
+
+        const auto totalBand = (band[0] + band[1]) + (band[2] + band[3]);
+        const auto totalOut = (out[0] + out[1]) + (out[2] + out[3]);
+        c.out += totalOut;
+        c.near += totalBand - totalOut;
+        c.in += n - totalBand;
+    }
+}
+
+namespace CtqTool
+{
+    Conformance::Level Conformance::GetLevel() const
+    {
+        if (!hasLimits || in + near + out == 0)
+            return Level::Unknown;
+        if (out > 0)
+            return Level::Out;
+        if (near > 0)
+            return Level::Near;
+        return Level::In;
+    }
+
+    const Conformance& ConformanceCounter::Get() const
+    {
+        return counts;
+    }
+
+    const Conformance& ConformanceCounter::Update(const SampleStore& samples, const Target& target)
+    {
+        if (revision != target.GetRevision() || samples.Size() < evaluated)
+        {
+            counts = {};
+            evaluated = 0;
+            revision = target.GetRevision();
+        }
+        counts.hasLimits = target.GetLowerLimit() || target.GetUpperLimit();
+
+        const auto bounds = makeBounds(target);
+        for (auto c = evaluated / SampleStore::chunkCapacity; c < samples.ChunkCount(); ++c)
+        {
+            const auto& chunk = samples.GetChunk(c);
+            const auto from = evaluated - c * SampleStore::chunkCapacity;
+            count(chunk.values + from, chunk.size - from, bounds, counts);
+            evaluated += chunk.size - from;
+        }
+        return counts;
+    }
+
+    const Conformance& ConformanceCounter::Add(const double* values, size_t n, const Target& target,
+                                               const QuantileSketch& before)
+    {
+        const auto bounds = makeBounds(target);
+        if (revision != target.GetRevision())
+        {
+            // the fractions strictly below a lower bound and above an upper one
+            const auto total = before.Count();
+            const auto below = [&](double bound) { return before.Rank(std::nextafter(bound, -infinity)); };
+            const auto outside = [&](double lower, double upper)
+            {
+                const auto f = below(lower) + (1.0 - before.Rank(upper));
+                return std::min<size_t>(total, static_cast<size_t>(std::llround(std::clamp(f, 0.0, 1.0) * total)));
+            };
+            const auto band = outside(bounds.nearLower, bounds.nearUpper);
+            counts.out = std::min(band, outside(bounds.lower, bounds.upper));
+            counts.near = band - counts.out;
+            counts.in = total - band;
+            revision = target.GetRevision();
+        }
+        counts.hasLimits = target.GetLowerLimit() || target.GetUpperLimit();
+        count(values, n, bounds, counts);
+        return counts;
+    }
+}
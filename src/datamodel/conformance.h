@@ -0,0 +1,67 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+namespace CtqTool
+{
+    class QuantileSketch;
+    class SampleStore;
+    class Target;
+
+    // Samples are out of spec outside the limits, and near when inside but
+    // within a guard band of 10% of the tolerance from a limit. With a single
+    // limit the tolerance is its distance to the nominal value, if any.
+    struct Conformance
+    {
+        enum class Level
+        {
+            Unknown,    // no samples or no limits
+            In,
+            Near,
+            Out
+        };
+
+        size_t in = 0;
+        size_t near = 0;
+        size_t out = 0;
+        bool hasLimits = false;
+
+        Level GetLevel() const;
+    };
+
+    // Keeps the conformance of a growing sample store, counting only the
+    // samples appended since the last update unless the target changed.
+    // Samples that are not kept are counted as they are appended instead;
+    // when the target changed, the counts of the samples before are first
+    // restated from a sketch of them, within its error bound.
+    class ConformanceCounter
+    {
+    public:
+        const Conformance& Update(const SampleStore&, const Target&);
+        const Conformance& Add(const double*, size_t count, const Target&, const QuantileSketch& before);
+        const Conformance& Get() const;
+
+    private:
+        Conformance counts;
+        size_t evaluated = 0;
+        quint64 revision = ~quint64(0);
+    };
+}
@@ -0,0 +1,418 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "csvimport.h"
+#include "ctq.h"
+#include "ctqmodel.h"
+#include "item.h"
+#include "parallel.h"
+
+#include <QFile>
+#include <QSemaphore>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr size_t maxColumns = 64;
+    constexpr size_t chunksPerThread = 4;
+    constexpr size_t minimumChunkSize = 1 << 20;
+    constexpr size_t maximumChunkSize = 4 << 20;   // bounds the samples parsed and not yet appended
+
+    struct Samples
+    {
+        std::vector<double> values;
+        std::vector<qint64> timestamps;
+        std::vector<quint32> lots;
+    };
+
+    struct ChunkResult
+    {
+        std::unordered_map<size_t, Samples> samples; // by CTQ
+        size_t malformed = 0;
+        size_t unknown = 0;
+        size_t ambiguous = 0;
+    };
+
+    // the texts from the need down to an item, joined by '/'
+    QString pathOf(const TreeItem& item)
+    {
+        QStringList texts;
+        for (const auto* i = &item; i->GetParent() != nullptr; i = i->GetParent())
+        {
+            texts.prepend(i->GetData()->GetText());
+        }
+        return texts.join('/');
+    }
+
+    // The CTQs by text and by path, taken on the model's thread for parsing
+    // on another. A name shared by several CTQs is found as ambiguous. The
+    // index refers into UTF-8 copies of the names.
+    class NameIndex
+    {
+    public:
+        static constexpr auto ambiguous = std::numeric_limits<size_t>::max();
+
+        explicit NameIndex(const std::vector<std::shared_ptr<ItemData>>& ctqs)
+        {
+            for (size_t i = 0; i < ctqs.size(); ++i)
+            {
+                Add(ctqs[i]->GetText(), i);
+                for (const auto* owner : ctqs[i]->GetOwners())
+                {
+                    Add(pathOf(*owner), i);
+                }
+            }
+        }
+
+        bool Find(std::string_view name, size_t& i) const
+        {
+            const auto it = index.find(name);
+            if (it == index.end())
+            {
+                return false;
+            }
+            i = it->second;
+            return true;
+        }
+
+    private:
+        void Add(const QString& name, size_t i)
+        {
+            names.push_back(name.toUtf8());
+            const auto [it, inserted] = index.emplace(std::string_view(names.back().constData(), names.back().size()), i);
+            if (!inserted && it->second != i)
+            {
+                it->second = ambiguous;
+            }
+        }
+
+        std::deque<QByteArray> names;
+        std::unordered_map<std::string_view, size_t> index;
+    };
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    // splits a line into at most maxColumns fields, returning their number
+    size_t split(std::string_view line, char separator, std::string_view* fields)
+    {
+        size_t n = 0;
+        size_t pos = 0;
+        while (n < maxColumns)
+        {
+            auto end = pos;
+            if (pos < line.size() && line[pos] == '"')
+            {
+                const auto close = line.find('"', pos + 1);
+                end = (close == std::string_view::npos) ? line.size() : close;
+            }
+            end = line.find(separator, end);
+            if (end == std::string_view::npos)
+            {
+                fields[n++] = line.substr(pos);
+                break;
+            }
+            fields[n++] = line.substr(pos, end - pos);
+            pos = end + 1;
+        }
+        return n;
+    }
+
+    std::string_view unquote(std::string_view s, std::string& buffer)
+    {
+        if (s.size() < 2 || s.front() != '"' || s.back() != '"')
+        {
+            return s;
+        }
+        s = s.substr(1, s.size() - 2);
+        if (s.find('"') == std::string_view::npos)
+        {
+            return s;
+        }
+        // doubled quotes
+        buffer.clear();
+        for (size_t i = 0; i < s.size(); ++i)
+        {
+            buffer.push_back(s[i]);
+            if (s[i] == '"' && i + 1 < s.size() && s[i + 1] == '"')
+            {
+                ++i;
+            }
+        }
+        return buffer;
+    }
+
+    template<class T>
+    bool parse(std::string_view s, T& value)
+    {
+        s = trim(s);
+        if (!s.empty() && s.front() == '+')
+        {
+            s.remove_prefix(1);
+        }
+        const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+        return ec == std::errc() && end == s.data() + s.size() && !s.empty();
+    }
+
+    void parseChunk(std::string_view chunk, const CsvColumns& columns, const NameIndex& names, ChunkResult& result)
+    {
+        std::string_view fields[maxColumns];
+        std::string buffer;
+        std::string_view lastName;
+        size_t lastCtq = 0;
+        auto lastKnown = false;
+        const auto needed = static_cast<size_t>(std::max({columns.ctq, columns.value, columns.timestamp, columns.lot})) + 1;
+
+        while (!chunk.empty())
+        {
+            const auto eol = chunk.find('\n');
+            const auto line = chunk.substr(0, eol);
+            chunk.remove_prefix((eol == std::string_view::npos) ? chunk.size() : eol + 1);
+            if (trim(line).empty())
+            {
+                continue;
+            }
+
+            double value = 0.0;
+            qint64 timestamp = 0;
+            quint32 lot = 0;
+            if (split(line, columns.separator, fields) < needed ||
+                !parse(fields[columns.value], value) ||
+                (columns.timestamp >= 0 && !parse(fields[columns.timestamp], timestamp)) ||
+                (columns.lot >= 0 && !parse(fields[columns.lot], lot)))
+            {
+                ++result.malformed;
+                continue;
+            }
+
+            // lines are typically grouped by CTQ, so the last lookup is kept
+            const auto name = unquote(trim(fields[columns.ctq]), buffer);
+            if (name != lastName || name.data() == buffer.data())
+            {
+                lastKnown = names.Find(name, lastCtq);
+                lastName = (name.data() == buffer.data()) ? std::string_view() : name;
+            }
+            if (!lastKnown)
+            {
+                ++result.unknown;
+                continue;
+            }
+            if (lastCtq == NameIndex::ambiguous)
+            {
+                ++result.ambiguous;
+                continue;
+            }
+
+            auto& samples = result.samples[lastCtq];
+            samples.values.push_back(value);
+            samples.timestamps.push_back(timestamp);
+            samples.lots.push_back(lot);
+        }
+    }
+
+    // chunks of roughly equal size, each ending after a line break
+    std::vector<std::string_view> splitChunks(std::string_view data)
+    {
+        const auto threads = ParallelThreads();
+        const auto target = std::clamp(data.size() / (threads * chunksPerThread) + 1, minimumChunkSize, maximumChunkSize);
+
+        std::vector<std::string_view> chunks;
+        while (!data.empty())
+        {
+            auto end = std::min(target, data.size());
+            if (end < data.size())
+            {
+                const auto eol = data.find('\n', end - 1);
+                end = (eol == std::string_view::npos) ? data.size() : eol + 1;
+            }
+            chunks.push_back(data.substr(0, end));
+            data.remove_prefix(end);
+        }
+        return chunks;
+    }
+
+    using Window = std::vector<ChunkResult>;
+
+    // Parses the file a window of chunks at a time, as many as there are
+    // threads to parse them, handing each window on in file order.
+    CsvImportResult parse(const QString& filename, const CsvColumns& columns, const NameIndex& names,
+                          const std::function<void(Window)>& parsed)
+    {
+        CsvImportResult result;
+        if (columns.ctq < 0 || columns.value < 0)
+        {
+            result.error = QStringLiteral("no CTQ or value column");
+            return result;
+        }
+
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            result.error = file.errorString();
+            return result;
+        }
+        result.bytes = file.size();
+        if (result.bytes == 0)
+        {
+            return result;
+        }
+        const auto* map = file.map(0, result.bytes);
+        if (map == nullptr)
+        {
+            result.error = file.errorString();
+            return result;
+        }
+
+        std::string_view data(reinterpret_cast<const char*>(map), static_cast<size_t>(result.bytes));
+        if (columns.header)
+        {
+            const auto eol = data.find('\n');
+            data.remove_prefix((eol == std::string_view::npos) ? data.size() : eol + 1);
+        }
+
+        const auto chunks = splitChunks(data);
+        const auto windowSize = ParallelThreads() * chunksPerThread;
+        for (size_t first = 0; first < chunks.size(); first += windowSize)
+        {
+            Window window(std::min(windowSize, chunks.size() - first));
+            ParallelFor(window.size(), [&](size_t i)
+            {
+                parseChunk(chunks[first + i], columns, names, window[i]);
+            });
+            for (const auto& chunk : window)
+            {
+                result.malformed += chunk.malformed;
+                result.unknown += chunk.unknown;
+                result.ambiguous += chunk.ambiguous;
+            }
+            parsed(std::move(window));
+        }
+        return result;
+    }
+
+    // the number of samples appended
+    size_t append(const std::vector<std::shared_ptr<ItemData>>& ctqs, const Window& window, CtqModel& model)
+    {
+        // appended chunk by chunk, so each CTQ's samples stay in file order
+        std::vector<size_t> counts(ctqs.size(), 0);
+        model.WaitForStatistics();
+        ParallelFor(ctqs.size(), [&](size_t i)
+        {
+            auto& measurement = static_cast<Ctq&>(*ctqs[i]).GetMeasurement();
+            for (const auto& chunk : window)
+            {
+                if (const auto it = chunk.samples.find(i); it != chunk.samples.end())
+                {
+                    const auto& s = it->second;
+                    measurement.Append(s.values.data(), s.timestamps.data(), s.lots.data(), s.values.size());
+                    counts[i] += s.values.size();
+                }
+            }
+        });
+
+        size_t samples = 0;
+        std::vector<Ctq*> appended;
+        for (size_t i = 0; i < ctqs.size(); ++i)
+        {
+            if (counts[i] > 0)
+            {
+                appended.push_back(static_cast<Ctq*>(ctqs[i].get()));
+                samples += counts[i];
+            }
+        }
+        if (!appended.empty())
+        {
+            model.SamplesAppended(appended);
+        }
+        return samples;
+    }
+}
+
+namespace CtqTool
+{
+    QStringList ReadCsvHeader(const QString& filename, char separator)
+    {
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return {};
+        }
+        const auto line = file.readLine();
+        std::string_view fields[maxColumns];
+        const auto n = split(std::string_view(line.constData(), line.size()), separator, fields);
+
+        QStringList header;
+        std::string buffer;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const auto field = unquote(trim(fields[i]), buffer);
+            header.push_back(QString::fromUtf8(field.data(), static_cast<qsizetype>(field.size())));
+        }
+        return header;
+    }
+
+    std::function<CsvImportResult(const CsvDeliver&)> PrepareCsvImport(const QString& filename, const CsvColumns& columns,
+                                                                       CtqModel& model)
+    {
+        auto ctqs = std::make_shared<const std::vector<std::shared_ptr<ItemData>>>(model.ShareCtqs());
+        auto names = std::make_shared<const NameIndex>(*ctqs);
+        return [filename, columns, ctqs, names](const CsvDeliver& deliver)
+        {
+            // a window is handed on once the one before was appended, or dropped
+            auto room = std::make_shared<QSemaphore>(1);
+            return parse(filename, columns, *names, [&deliver, &ctqs, &room](Window parsed)
+            {
+                room->acquire();
+                std::shared_ptr<void> release(nullptr, [room](void*) { room->release(); });
+                auto window = std::make_shared<const Window>(std::move(parsed));
+                deliver([ctqs, window, release](CtqModel& model)
+                {
+                    return append(*ctqs, *window, model);
+                });
+            });
+        };
+    }
+
+    CsvImportResult ImportCsv(const QString& filename, const CsvColumns& columns, CtqModel& model)
+    {
+        size_t samples = 0;
+        auto result = PrepareCsvImport(filename, columns, model)([&samples, &model](const CsvAppend& append)
+        {
+            samples += append(model);
+        });
+        result.samples = samples;
+        return result;
+    }
+}
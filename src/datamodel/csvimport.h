@@ -0,0 +1,73 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+namespace CtqTool
+{
+    class CtqModel;
+
+    // Which fields of a line hold what, counted from 0; -1 if absent.
+    // Timestamps are milliseconds since the epoch.
+    struct CsvColumns
+    {
+        int ctq = 0;
+        int value = 1;
+        int timestamp = -1;
+        int lot = -1;
+        char separator = ',';
+        bool header = true;
+    };
+
+    struct CsvImportResult
+    {
+        size_t samples = 0;
+        size_t malformed = 0;   // lines with missing or unparsable fields
+        size_t unknown = 0;     // lines naming no CTQ in the tree
+        size_t ambiguous = 0;   // lines naming several, by a text they share
+        qint64 bytes = 0;
+        QString error;
+    };
+
+    // the fields of the first line, for mapping columns
+    QStringList ReadCsvHeader(const QString& filename, char separator);
+
+    // Appends each line's value to the measurement of the CTQ it names, by
+    // its text or, where CTQs share it, by its path: the texts from the need
+    // down, joined by '/'. The file is mapped and parsed in parallel chunks
+    // split at line breaks, a window of chunks at a time, each appended
+    // before more than the next is parsed; quoted fields may contain
+    // separators, but not line breaks.
+    CsvImportResult ImportCsv(const QString& filename, const CsvColumns&, CtqModel&);
+
+    // The same in steps, for parsing on another thread: PrepareCsvImport takes
+    // the CTQs and their names on the model's thread. The function it returns
+    // parses the file anywhere and hands each window to deliver, as a
+    // function that appends its samples on the model's thread and returns
+    // their number. Parsing waits while a window is neither appended nor
+    // dropped. The result counts all but the samples.
+    using CsvAppend = std::function<size_t(CtqModel&)>;
+    using CsvDeliver = std::function<void(CsvAppend)>;
+    std::function<CsvImportResult(const CsvDeliver&)> PrepareCsvImport(const QString& filename, const CsvColumns&,
+                                                                       CtqModel&);
+}
@@ -20,6 +20,19 @@
 
 namespace CtqTool
 {
+    Ctq::Ctq(QString text, QString note) :
+        ItemData(std::move(text), std::move(note))
+    {
+    }
+
+    std::shared_ptr<ItemData> Ctq::Clone() const
+    {
+        auto copy = std::make_shared<Ctq>(GetText(), GetNote());
+        copy->measurement = measurement.Copy();
+        copy->statistics = statistics;
+        return copy;
+    }
+
     const Measurement& Ctq::GetMeasurement() const
     {
         return measurement;
@@ -29,4 +42,24 @@ namespace CtqTool
     {
         return measurement;
     }
+
+    const Statistics& Ctq::GetStatistics() const
+    {
+        return statistics;
+    }
+
+    void Ctq::SetStatistics(const Statistics& s)
+    {
+        statistics = s;
+    }
+
+    const Conformance& Ctq::UpdateConformance()
+    {
+        return measurement.UpdateConformance();
+    }
+
+    const Conformance& Ctq::GetConformance() const
+    {
+        return measurement.GetConformance();
+    }
 }
@@ -20,16 +20,30 @@
 
 #include "item.h"
 #include "measurement.h"
+#include "statistics.h"
 
 namespace CtqTool
 {
     class Ctq : public ItemData
     {
     public:
+        Ctq(QString text, QString note);
+
+        std::shared_ptr<ItemData> Clone() const override;
+
         Measurement& GetMeasurement();
         const Measurement& GetMeasurement() const;
+
+        // as last computed from the measurement
+        const Statistics& GetStatistics() const;
+        void SetStatistics(const Statistics&);
+
+        // counts the samples appended since the last update
+        const Conformance& UpdateConformance();
+        const Conformance& GetConformance() const;
         
     private:
         Measurement measurement;
+        Statistics statistics;
     };
 }
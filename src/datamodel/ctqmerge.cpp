@@ -0,0 +1,321 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ctqmerge.h"
+#include "item.h"
+
+#include <QHash>
+
+#include <list>
+#include <unordered_map>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto noteColumn = 1;
+    constexpr auto rankColumn = 2;
+
+    quint64 combine(quint64 seed, quint64 value)
+    {
+        return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+    }
+
+    struct FlatNode
+    {
+        quint64 key = 0;        // parent key, text and occurrence among equally named siblings
+        quint64 content = 0;    // note and rank
+        quint64 subtree = 0;    // key and content of the node and all its descendants
+        const TreeItem* item = nullptr;
+        int firstChild = 0;
+        int childCount = 0;
+    };
+
+    // breadth first flattening, so that the children of a node are contiguous
+    class FlatTree
+    {
+    public:
+        explicit FlatTree(const TreeItem& root)
+        {
+            nodes.push_back({combine(0, 0), 0, 0, &root, 0, 0});
+            std::unordered_map<quint64, int> occurrences;
+            for (size_t i = 0; i < nodes.size(); ++i)
+            {
+                const auto* item = nodes[i].item;
+                const auto parentKey = nodes[i].key;
+                nodes[i].firstChild = static_cast<int>(nodes.size());
+                nodes[i].childCount = item->ChildCount();
+
+                occurrences.clear();
+                for (auto r = 0; r < item->ChildCount(); ++r)
+                {
+                    const auto& child = *item->GetChild(r);
+                    const auto& data = *child.GetData();
+                    const auto textHash = qHash(data.GetText());
+                    const auto key = combine(combine(parentKey, textHash), occurrences[textHash]++);
+                    const auto content = combine(qHash(data.GetNote()), child.GetRank());
+                    nodes.push_back({key, content, 0, &child, 0, 0});
+                }
+            }
+
+            index.reserve(nodes.size());
+            for (auto i = static_cast<int>(nodes.size()) - 1; i >= 0; --i)
+            {
+                auto& node = nodes[i];
+                auto hash = combine(node.key, node.content);
+                for (auto c = node.firstChild; c < node.firstChild + node.childCount; ++c)
+                {
+                    hash = combine(hash, nodes[c].subtree);
+                }
+                node.subtree = hash;
+                index.emplace(node.key, i);
+            }
+        }
+
+        const FlatNode& Root() const
+        {
+            return nodes.front();
+        }
+
+        const FlatNode& Child(const FlatNode& node, int i) const
+        {
+            return nodes[node.firstChild + i];
+        }
+
+        const FlatNode* Find(quint64 key) const
+        {
+            const auto it = index.find(key);
+            return it != index.end() ? &nodes[it->second] : nullptr;
+        }
+
+    private:
+        std::vector<FlatNode> nodes;
+        std::unordered_map<quint64, int> index;
+    };
+
+    class Merger
+    {
+    public:
+        Merger(const TreeItem& b, const TreeItem& o, const TreeItem& t) :
+            base(b),
+            ours(o),
+            theirs(t)
+        {
+        }
+
+        MergeResult Run()
+        {
+            MergeResult result;
+            result.root = std::make_unique<TreeItem>(ours.Root().item->GetData());
+            MergeChildren(*result.root, &base.Root(), &ours.Root(), &theirs.Root());
+            result.conflicts = std::move(conflicts);
+            return result;
+        }
+
+    private:
+        struct Slot
+        {
+            const FlatNode* b = nullptr;
+            const FlatNode* o = nullptr;
+            const FlatNode* t = nullptr;
+        };
+
+        // ours' children in their order, with the children only theirs has
+        // inserted after their nearest preceding sibling in theirs
+        void MergeChildren(TreeItem& out, const FlatNode* b, const FlatNode* o, const FlatNode* t)
+        {
+            std::list<Slot> order;
+            std::unordered_map<quint64, std::list<Slot>::iterator> placed;
+            const auto findBase = [&](quint64 key) { return b != nullptr ? base.Find(key) : nullptr; };
+
+            if (o != nullptr)
+            {
+                placed.reserve(o->childCount);
+                for (auto i = 0; i < o->childCount; ++i)
+                {
+                    const auto& child = ours.Child(*o, i);
+                    const auto* inTheirs = t != nullptr ? theirs.Find(child.key) : nullptr;
+                    placed.emplace(child.key, order.insert(order.end(), Slot{findBase(child.key), &child, inTheirs}));
+                }
+            }
+
+            if (t != nullptr)
+            {
+                auto anchor = order.begin();
+                for (auto i = 0; i < t->childCount; ++i)
+                {
+                    const auto& child = theirs.Child(*t, i);
+                    if (const auto it = placed.find(child.key); it != placed.end())
+                    {
+                        anchor = std::next(it->second);
+                    }
+                    else
+                    {
+                        placed.emplace(child.key, order.insert(anchor, Slot{findBase(child.key), nullptr, &child}));
+                    }
+                }
+            }
+
+            for (const auto& slot : order)
+            {
+                Place(out, slot.b, slot.o, slot.t);
+            }
+        }
+
+        void Place(TreeItem& parent, const FlatNode* b, const FlatNode* o, const FlatNode* t)
+        {
+            if (o != nullptr && t != nullptr)
+            {
+                if (o->subtree == t->subtree || (b != nullptr && t->subtree == b->subtree))
+                {
+                    parent.Append(Copy(*o->item, &parent));
+                }
+                else if (b != nullptr && o->subtree == b->subtree)
+                {
+                    parent.Append(Copy(*t->item, &parent));
+                }
+                else
+                {
+                    parent.Append(MergeItem(parent, b, *o, *t));
+                }
+            }
+            else if (o != nullptr || t != nullptr)
+            {
+                const auto* kept = (o != nullptr) ? o : t;
+                if (b == nullptr)
+                {
+                    parent.Append(Copy(*kept->item, &parent));
+                }
+                else if (kept->subtree != b->subtree)
+                {
+                    // deleted on one side, modified on the other: keep the modification
+                    Report(o != nullptr ? MergeConflict::Kind::DeletedByTheirs : MergeConflict::Kind::DeletedByOurs,
+                        *kept->item, -1, {}, {}, {});
+                    parent.Append(Copy(*kept->item, &parent));
+                }
+            }
+        }
+
+        std::shared_ptr<TreeItem> MergeItem(TreeItem& parent, const FlatNode* b, const FlatNode& o, const FlatNode& t)
+        {
+            const auto& oi = *o.item;
+            const auto& ti = *t.item;
+            const auto kind = (b != nullptr) ? MergeConflict::Kind::Modified : MergeConflict::Kind::AddedByBoth;
+
+            // text is part of the key, so only the note determines whose data is taken
+            auto data = oi.GetData();
+            const auto& oursNote = oi.GetData()->GetNote();
+            const auto& theirsNote = ti.GetData()->GetNote();
+            if (oursNote != theirsNote)
+            {
+                const auto baseNote = (b != nullptr) ? b->item->GetData()->GetNote() : QString();
+                if (b != nullptr && oursNote == baseNote)
+                {
+                    data = ti.GetData();
+                }
+                else if (b == nullptr || theirsNote != baseNote)
+                {
+                    Report(kind, oi, noteColumn, (b != nullptr) ? QVariant(baseNote) : QVariant(), oursNote, theirsNote);
+                }
+            }
+
+            auto rank = oi.GetRank();
+            if (oi.GetRank() != ti.GetRank())
+            {
+                if (b != nullptr && oi.GetRank() == b->item->GetRank())
+                {
+                    rank = ti.GetRank();
+                }
+                else if (b == nullptr || ti.GetRank() != b->item->GetRank())
+                {
+                    Report(kind, oi, rankColumn, (b != nullptr) ? QVariant(b->item->GetRank()) : QVariant(),
+                        oi.GetRank(), ti.GetRank());
+                }
+            }
+
+            auto item = std::make_shared<TreeItem>(data, &parent);
+            item->SetRank(rank);
+            // weights and transfers follow whichever side changed them, ours when both did
+            const auto theirsWeightOnly = b != nullptr && oi.GetWeight() == b->item->GetWeight();
+            item->SetWeight(theirsWeightOnly ? ti.GetWeight() : oi.GetWeight());
+            const auto theirsTransferOnly = b != nullptr && oi.GetTransfer() == b->item->GetTransfer();
+            item->SetTransfer(theirsTransferOnly ? ti.GetTransfer() : oi.GetTransfer());
+
+            path.push_back(data->GetText());
+            MergeChildren(*item, b, &o, &t);
+            path.pop_back();
+
+            return item;
+        }
+
+        std::shared_ptr<TreeItem> Copy(const TreeItem& source, TreeItem* parent) const
+        {
+            auto item = std::make_shared<TreeItem>(source.GetData(), parent);
+            item->SetRank(source.GetRank());
+            item->SetWeight(source.GetWeight());
+            item->SetTransfer(source.GetTransfer());
+            for (auto r = 0; r < source.ChildCount(); ++r)
+            {
+                item->Append(Copy(*source.GetChild(r), item.get()));
+            }
+            return item;
+        }
+
+        void Report(MergeConflict::Kind kind, const TreeItem& item, int column,
+            QVariant b, QVariant o, QVariant t)
+        {
+            auto conflictPath = path;
+            conflictPath.push_back(item.GetData()->GetText());
+            conflicts.push_back({kind, std::move(conflictPath), column, std::move(b), std::move(o), std::move(t)});
+        }
+
+        const FlatTree base;
+        const FlatTree ours;
+        const FlatTree theirs;
+        QStringList path;
+        std::vector<MergeConflict> conflicts;
+    };
+}
+
+namespace CtqTool
+{
+    MergeResult Merge(const TreeItem& base, const TreeItem& ours, const TreeItem& theirs)
+    {
+        return Merger(base, ours, theirs).Run();
+    }
+
+    QString ToString(const MergeConflict& conflict)
+    {
+        const auto location = conflict.path.join(" / ");
+        const auto column = (conflict.column == noteColumn) ? QString("note") : QString("rank");
+        switch (conflict.kind)
+        {
+        case MergeConflict::Kind::Modified:
+            return QString("%1: %2 changed on both sides (base '%3', ours '%4', theirs '%5')")
+                .arg(location, column, conflict.base.toString(), conflict.ours.toString(), conflict.theirs.toString());
+        case MergeConflict::Kind::AddedByBoth:
+            return QString("%1: added on both sides with different %2 (ours '%3', theirs '%4')")
+                .arg(location, column, conflict.ours.toString(), conflict.theirs.toString());
+        case MergeConflict::Kind::DeletedByOurs:
+            return QString("%1: deleted in ours, modified in theirs").arg(location);
+        case MergeConflict::Kind::DeletedByTheirs:
+            return QString("%1: deleted in theirs, modified in ours").arg(location);
+        }
+        return location;
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QStringList>
+#include <QVariant>
+
+#include <memory>
+#include <vector>
+
+namespace CtqTool
+{
+    class TreeItem;
+
+    struct MergeConflict
+    {
+        enum class Kind
+        {
+            Modified,           // both sides changed the same column differently
+            AddedByBoth,        // both sides added the item with different contents
+            DeletedByOurs,      // ours deleted what theirs modified; theirs is kept
+            DeletedByTheirs     // theirs deleted what ours modified; ours is kept
+        };
+
+        Kind kind = Kind::Modified;
+        QStringList path;       // item texts from the top level down
+        int column = -1;        // -1 for structural conflicts
+        QVariant base;
+        QVariant ours;
+        QVariant theirs;
+    };
+
+    struct MergeResult
+    {
+        std::unique_ptr<TreeItem> root;
+        std::vector<MergeConflict> conflicts;
+    };
+
+    // Three-way merge of trees as returned by CtqModel::Parse. Items are matched
+    // by the path of texts leading to them; subtrees are compared by hash so that
+    // branches unchanged on one side are copied from the other without being
+    // compared item by item. The copy still visits every item, as tree items
+    // have a single parent and cannot be shared between trees. Conflicting
+    // columns resolve to ours. The merged tree shares item data with the inputs.
+    MergeResult Merge(const TreeItem& base, const TreeItem& ours, const TreeItem& theirs);
+
+    QString ToString(const MergeConflict&);
+}
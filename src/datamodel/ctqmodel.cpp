@@ -1,15 +1,277 @@
 #include "ctqmodel.h"
+#include "ctq.h"
 #include "item.h"
+#include "journal.h"
+#include "parallel.h"
+#include "textformat.h"
 
 #include <QDebug>
 #include <QItemSelection>
 #include <QStringList>
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace
 {
     constexpr auto textColumn = 0;
     constexpr auto noteColumn = 1;
     constexpr auto rankColumn = 2;
+    constexpr auto transferColumn = 3;
+
+    // computed from the measurement of a CTQ, following the item's own columns
+    constexpr auto countColumn = 4;
+    constexpr auto meanColumn = 5;
+    constexpr auto stddevColumn = 6;
+    constexpr auto minColumn = 7;
+    constexpr auto maxColumn = 8;
+    constexpr auto cpColumn = 9;
+    constexpr auto cpkColumn = 10;
+    constexpr auto ppmColumn = 11;
+    constexpr auto medianColumn = 12; // from the quantile sketch, kept up to date while appending
+    constexpr auto p99Column = 13;
+    constexpr auto spcColumn = 14; // the control chart rules violated by the last subgroup
+
+    // rolled up from the subtree of any item
+    constexpr auto worstCpkColumn = 15;
+    constexpr auto conformanceColumn = 16;
+
+    // as last simulated, for any item
+    constexpr auto simulatedMeanColumn = 17;
+    constexpr auto simulatedStddevColumn = 18;
+    constexpr auto simulatedOutColumn = 19;
+
+    // the tolerance stack-up of any item, as last updated
+    constexpr auto stackNominalColumn = 20;
+    constexpr auto worstCaseColumn = 21;
+    constexpr auto rssColumn = 22;
+    constexpr auto statisticalColumn = 23;
+    constexpr auto computedColumns = statisticalColumn - countColumn + 1;
+
+    constexpr auto fetchPage = 1024;            // children fetched from a store at once
+
+    QVariant statisticsData(const CtqTool::TreeItem& item, int column)
+    {
+        const auto* ctq = dynamic_cast<const CtqTool::Ctq*>(item.GetData().get());
+        if (ctq == nullptr)
+        {
+            return QVariant();
+        }
+
+        const auto& s = ctq->GetStatistics();
+        if (column == countColumn)
+        {
+            return static_cast<qulonglong>(s.count);
+        }
+        if (s.count == 0)
+        {
+            return QVariant();
+        }
+
+        switch (column)
+        {
+        case meanColumn:
+            return s.mean;
+        case stddevColumn:
+            return s.stddev;
+        case minColumn:
+            return s.min;
+        case maxColumn:
+            return s.max;
+        case cpColumn:
+            return s.cp ? QVariant(*s.cp) : QVariant();
+        case cpkColumn:
+            return s.cpk ? QVariant(*s.cpk) : QVariant();
+        case ppmColumn:
+            return s.ppm;
+        case medianColumn:
+        case p99Column:
+        {
+            const auto q = ctq->GetMeasurement().GetDistribution().GetSketch().Quantile(column == medianColumn ? 0.5 : 0.99);
+            return q ? QVariant(*q) : QVariant();
+        }
+        case spcColumn:
+        {
+            const auto& spc = ctq->GetMeasurement().GetSpc();
+            if (!spc.IsCalibrated())
+                return QVariant();
+            return spc.GetActiveRules() ? CtqTool::SpcRuleNumbers(spc.GetActiveRules()) : QString("In control");
+        }
+        default:
+            return QVariant();
+        }
+    }
+
+    QVariant rollUpData(const CtqTool::TreeItem& item, int column)
+    {
+        const auto& rollUp = item.GetRollUp();
+        if (column == worstCpkColumn && rollUp.worstCpk)
+        {
+            return *rollUp.worstCpk;
+        }
+        if (column == conformanceColumn && rollUp.conformance)
+        {
+            return 100.0 * *rollUp.conformance;
+        }
+        return QVariant();
+    }
+
+    QVariant simulationData(const CtqTool::TreeItem& item, int column)
+    {
+        const auto& s = item.GetSimulation();
+        if (s.trials == 0)
+        {
+            return QVariant();
+        }
+        switch (column)
+        {
+        case simulatedMeanColumn:
+            return s.mean;
+        case simulatedStddevColumn:
+            return s.stddev;
+        case simulatedOutColumn:
+            return 100.0 * s.outOfSpec;
+        default:
+            return QVariant();
+        }
+    }
+
+    QVariant stackUpData(const CtqTool::TreeItem& item, int column)
+    {
+        const auto& s = item.GetStackUp();
+        if (!s.nominal)
+        {
+            return QVariant();
+        }
+        switch (column)
+        {
+        case stackNominalColumn:
+            return *s.nominal;
+        case worstCaseColumn:
+            return s.worstCase;
+        case rssColumn:
+            return s.rss;
+        case statisticalColumn:
+            return s.statistical;
+        default:
+            return QVariant();
+        }
+    }
+
+    // the items with an invalid stack-up below the given one, by depth below it
+    void collectStaleStackUps(CtqTool::TreeItem& item, std::vector<std::vector<CtqTool::TreeItem*>>& stale,
+        size_t depth = 0)
+    {
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            auto& child = *item.GetChild(r);
+            if (!child.IsStackUpValid())
+            {
+                if (stale.size() <= depth)
+                {
+                    stale.resize(depth + 1);
+                }
+                stale[depth].push_back(&child);
+                collectStaleStackUps(child, stale, depth + 1);
+            }
+        }
+    }
+
+    void collectCtqs(CtqTool::TreeItem& item, std::vector<CtqTool::Ctq*>& ctqs,
+        std::unordered_set<const CtqTool::ItemData*>& seen)
+    {
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            auto& child = *item.GetChild(r);
+            if (auto* ctq = dynamic_cast<CtqTool::Ctq*>(child.GetData().get()); ctq != nullptr)
+            {
+                if (seen.insert(ctq).second)
+                {
+                    ctqs.push_back(ctq);
+                }
+            }
+            collectCtqs(child, ctqs, seen);
+        }
+    }
+
+    // as collectCtqs, sharing ownership of the data
+    void collectCtqData(CtqTool::TreeItem& item, std::vector<std::shared_ptr<CtqTool::ItemData>>& ctqs,
+        std::unordered_set<const CtqTool::ItemData*>& seen)
+    {
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            auto& child = *item.GetChild(r);
+            if (dynamic_cast<CtqTool::Ctq*>(child.GetData().get()) != nullptr && seen.insert(child.GetData().get()).second)
+            {
+                ctqs.push_back(child.GetData());
+            }
+            collectCtqData(child, ctqs, seen);
+        }
+    }
+
+    // bottom up, without signalling
+    void recomputeRollUps(CtqTool::TreeItem& item)
+    {
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            recomputeRollUps(*item.GetChild(r));
+        }
+        item.SetRollUp(CtqTool::ComputeRollUp(item));
+    }
+
+    // kept longest first, without repeats; true if text is among them now
+    bool extendWidthHint(std::vector<QString>& hint, QString text, size_t candidates)
+    {
+        if (text.isEmpty() || (hint.size() == candidates && text.size() <= hint.back().size()))
+        {
+            return false;
+        }
+        const auto at = std::find_if(hint.begin(), hint.end(), [&text](const QString& h) { return h.size() < text.size(); });
+        if (std::find(hint.begin(), at, text) != at)
+        {
+            return false;
+        }
+        hint.insert(at, std::move(text));
+        if (hint.size() > candidates)
+        {
+            hint.pop_back();
+        }
+        return true;
+    }
+
+    // the columns whose hint at the item's level grew, as bits
+    template<typename Hints>
+    unsigned extendWidthHints(const CtqTool::TreeItem& item, int level, Hints& hints, size_t candidates)
+    {
+        auto& atLevel = hints[std::clamp<size_t>(level, 1, hints.size()) - 1];
+        auto grown = 0u;
+        for (size_t c = 0; c < atLevel.size(); ++c)
+        {
+            if (extendWidthHint(atLevel[c], item.Data(static_cast<int>(c)).toString(), candidates))
+            {
+                grown |= 1u << c;
+            }
+        }
+        return grown;
+    }
+
+    template<typename Hints>
+    void collectWidthHints(const CtqTool::TreeItem& item, int level, Hints& hints, size_t candidates)
+    {
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            const auto& child = *item.GetChild(r);
+            extendWidthHints(child, level, hints, candidates);
+            collectWidthHints(child, level + 1, hints, candidates);
+        }
+    }
+
+    auto makeRootItem()
+    {
+        using namespace CtqTool;
+        return std::make_unique<TreeItem>(std::make_shared<ItemData>("Title", "Note"), nullptr);
+    }
 }
 namespace CtqTool
 {
@@ -28,23 +290,141 @@ namespace CtqTool
 
     CtqModel::CtqModel(QObject* parent) :
         QAbstractItemModel(parent),
-        rootItem(std::make_unique<TreeItem>(std::make_shared<ItemData>("Title", "Note"), nullptr))
+        rootItem(makeRootItem())
     {
-        connect(this, &QAbstractItemModel::dataChanged, this, &CtqModel::OnDataChanged);
+        statisticsPool.setMaxThreadCount(1);
+        simulationPool.setMaxThreadCount(1);
     }
 
-    CtqModel::~CtqModel() = default;
+    CtqModel::~CtqModel()
+    {
+        CancelSimulation();
+        simulationPool.waitForDone();
+        statisticsPool.waitForDone();
+    }
 
     void CtqModel::Reset(const QString& data) 
     {
-        SetupModelData(data.split('\n'), *rootItem);
+        Reset(Parse(data));
+    }
+
+    void CtqModel::Reset(std::unique_ptr<TreeItem> root)
+    {
+        beginResetModel();
+        ++statisticsGeneration;
+        ++simulationGeneration;
+        rootItem = root ? std::move(root) : makeRootItem();
+        recomputeRollUps(*rootItem);
+        widthHints = {};
+        collectWidthHints(*rootItem, 1, widthHints, widthCandidates);
+        store.reset();
+        fetches.clear();
+        collapsed.clear();
+        fetchedCount = 0;
+        journal.clear();
+        journalComplete = false;
+        endResetModel();
+    }
+
+    void CtqModel::Reset(std::shared_ptr<NodeStore> s)
+    {
+        beginResetModel();
+        ++statisticsGeneration;
+        ++simulationGeneration;
+        rootItem = makeRootItem();
+        widthHints = {};
+        store = std::move(s);
+        fetches.clear();
+        collapsed.clear();
+        fetchedCount = 0;
+        if (store)
+        {
+            const auto root = store->GetRoot();
+            fetches[rootItem.get()] = {root, store->ChildCount(root)};
+        }
+        journal.clear();
+        journalComplete = false;
+        endResetModel();
+    }
+
+    bool CtqModel::IsLazy() const
+    {
+        return store != nullptr;
+    }
+
+    void CtqModel::SetFetchBudget(size_t items)
+    {
+        fetchBudget = items;
+    }
+
+    bool CtqModel::IsWithinFetchBudget() const
+    {
+        return fetchedCount < fetchBudget;
+    }
+
+    void CtqModel::StoreUpdated()
+    {
+        for (auto& [item, fetch] : fetches)
+        {
+            const auto pending = fetch.total - fetch.fetched;
+            fetch.fetched = item->ChildCount();
+            fetch.total = fetch.fetched + pending;
+            fetch.edited = false;
+        }
+    }
+
+    QModelIndex CtqModel::FetchStored(const std::vector<NodeStore::Id>& ids)
+    {
+        const auto root = fetches.find(rootItem.get());
+        if (ids.empty() || root == fetches.end() || root->second.id != ids.front())
+        {
+            return QModelIndex();
+        }
+
+        // rows edited since the store was written can have moved, so children are found by id
+        QModelIndex index;
+        for (auto id = ids.begin() + 1; id != ids.end(); ++id)
+        {
+            const auto* parent = GetItem(index);
+            auto row = 0;
+            for (;; ++row)
+            {
+                if (row == parent->ChildCount())
+                {
+                    fetchMore(index);
+                    if (row == parent->ChildCount())
+                    {
+                        return QModelIndex();
+                    }
+                }
+                const auto it = fetches.find(parent->GetChild(row).get());
+                if (it != fetches.end() && it->second.id == *id)
+                {
+                    break;
+                }
+            }
+            index = this->index(row, 0, index);
+        }
+        return index;
+    }
+
+    const TreeItem& CtqModel::GetRootItem() const
+    {
+        return *rootItem;
+    }
+
+    std::unique_ptr<TreeItem> CtqModel::Parse(const QString& data)
+    {
+        auto root = makeRootItem();
+        SetupModelData(data.split('\n'), *root);
+        return root;
     }
 
     int CtqModel::columnCount(const QModelIndex& parent) const
     {
         if (parent.isValid())
-            return static_cast<TreeItem*>(parent.internalPointer())->ColumnCount();
-        return rootItem->ColumnCount();
+            return static_cast<TreeItem*>(parent.internalPointer())->ColumnCount() + computedColumns;
+        return rootItem->ColumnCount() + computedColumns;
     }
     
     QVariant CtqModel::data(const QModelIndex& index, int role) const
@@ -54,11 +434,29 @@ namespace CtqTool
             return QVariant();
         }
 
+        TreeItem* item = static_cast<TreeItem*>(index.internalPointer());
+        if (item == nullptr)
+            return QVariant();
+
+        if (role == ConformanceRole)
+            return static_cast<int>(item->GetRollUp().worstLevel);
+        if (role == Qt::ToolTipRole && index.column() == transferColumn)
+        {
+            const auto error = item->GetTransferError();
+            return error.isEmpty() ? QVariant() : QVariant(error);
+        }
         if (role != Qt::DisplayRole && role != Qt::EditRole)
             return QVariant();
 
-        TreeItem* item = static_cast<TreeItem*>(index.internalPointer());
-        return (item != nullptr) ? item->Data(index.column()) : QVariant();
+        if (index.column() >= stackNominalColumn)
+            return stackUpData(*item, index.column());
+        if (index.column() >= simulatedMeanColumn)
+            return simulationData(*item, index.column());
+        if (index.column() >= worstCpkColumn)
+            return rollUpData(*item, index.column());
+        if (index.column() >= countColumn)
+            return statisticsData(*item, index.column());
+        return item->Data(index.column());
     }
     
     Qt::ItemFlags CtqModel::flags(const QModelIndex& index) const
@@ -67,7 +465,7 @@ namespace CtqTool
 
         if (!index.isValid())
             flags = Qt::NoItemFlags;
-        else if (depth(index) == 2 && index.column() == rankColumn)
+        else if ((depth(index) == 2 && index.column() == rankColumn) || index.column() >= countColumn)
             flags = QAbstractItemModel::flags(index);
         else
             flags = QAbstractItemModel::flags(index) | Qt::ItemIsEditable;
@@ -87,6 +485,48 @@ namespace CtqTool
                 return "Note";
             case rankColumn:
                 return "Rank";
+            case transferColumn:
+                return "Transfer";
+            case countColumn:
+                return "N";
+            case meanColumn:
+                return "Mean";
+            case stddevColumn:
+                return "Std dev";
+            case minColumn:
+                return "Min";
+            case maxColumn:
+                return "Max";
+            case cpColumn:
+                return "Cp";
+            case cpkColumn:
+                return "Cpk";
+            case ppmColumn:
+                return "PPM";
+            case medianColumn:
+                return "Median";
+            case p99Column:
+                return "P99";
+            case spcColumn:
+                return "SPC";
+            case worstCpkColumn:
+                return "Worst Cpk";
+            case conformanceColumn:
+                return "Conformance %";
+            case simulatedMeanColumn:
+                return "Simulated mean";
+            case simulatedStddevColumn:
+                return "Simulated std dev";
+            case simulatedOutColumn:
+                return "Simulated out %";
+            case stackNominalColumn:
+                return "Stack nominal";
+            case worstCaseColumn:
+                return "Worst case tolerance";
+            case rssColumn:
+                return "RSS tolerance";
+            case statisticalColumn:
+                return "Statistical tolerance";
             default:
                 return QVariant();
             }
@@ -139,9 +579,158 @@ namespace CtqTool
         return (parentItem != nullptr) ? parentItem->ChildCount() : 0;
     }
     
+    bool CtqModel::hasChildren(const QModelIndex& parent) const
+    {
+        if (parent.column() > 0)
+            return false;
+
+        const auto* parentItem = GetItem(parent);
+        if (parentItem->ChildCount() > 0)
+            return true;
+        const auto it = fetches.find(parentItem);
+        return it != fetches.end() && it->second.fetched < it->second.total;
+    }
+
+    bool CtqModel::canFetchMore(const QModelIndex& parent) const
+    {
+        const auto it = fetches.find(GetItem(parent));
+        return it != fetches.end() && it->second.fetched < it->second.total;
+    }
+
+    void CtqModel::fetchMore(const QModelIndex& parent)
+    {
+        auto* parentItem = GetItem(parent);
+        const auto it = fetches.find(parentItem);
+        if (it == fetches.end() || it->second.fetched >= it->second.total)
+        {
+            return;
+        }
+
+        auto& fetch = it->second;
+        const auto nodes = store->GetChildren(fetch.id, fetch.fetched, std::min(fetchPage, fetch.total - fetch.fetched));
+        if (nodes.empty())
+        {
+            fetch.total = fetch.fetched; // the store has fewer than it claimed
+            return;
+        }
+
+        const auto row = parentItem->ChildCount();
+        const auto depth = parentItem->Depth() + 1;
+        beginInsertRows(parent, row, row + static_cast<int>(nodes.size()) - 1);
+        for (const auto& node : nodes)
+        {
+            auto child = MakeTreeItem(node.item, depth, parentItem);
+            fetches[child.get()] = {node.id, node.childCount};
+            ExtendWidthHints(*child, depth);
+            parentItem->Append(std::move(child));
+        }
+        fetch.fetched += static_cast<int>(nodes.size());
+        fetchedCount += nodes.size();
+        endInsertRows();
+        RefreshRollUps({parentItem});
+    }
+
+    void CtqModel::BranchExpanded(const QModelIndex& index)
+    {
+        const auto it = fetches.find(GetItem(index));
+        if (it != fetches.end() && it->second.collapsed)
+        {
+            collapsed.erase(it->second.position);
+            it->second.collapsed = false;
+        }
+    }
+
+    void CtqModel::BranchCollapsed(const QModelIndex& index)
+    {
+        auto* item = GetItem(index);
+        const auto it = fetches.find(item);
+        if (it == fetches.end() || it->second.collapsed)
+        {
+            return;
+        }
+        it->second.collapsed = true;
+        it->second.position = collapsed.insert(collapsed.end(), item);
+        if (fetchedCount > fetchBudget)
+        {
+            // not while the view is still handling the collapse
+            QMetaObject::invokeMethod(this, &CtqModel::Evict, Qt::QueuedConnection);
+        }
+    }
+
+    void CtqModel::Evict()
+    {
+        while (fetchedCount > fetchBudget && !collapsed.empty())
+        {
+            auto* item = collapsed.front();
+            auto& fetch = fetches.at(item);
+            collapsed.pop_front();
+            fetch.collapsed = false;
+            if (fetch.edited || item->ChildCount() == 0)
+            {
+                continue;
+            }
+
+            const auto parent = (item == rootItem.get()) ? QModelIndex() : createIndex(item->Row(), 0, item);
+            beginRemoveRows(parent, 0, item->ChildCount() - 1);
+            ++simulationGeneration;
+            for (auto r = 0; r < item->ChildCount(); ++r)
+            {
+                Forget(*item->GetChild(r));
+            }
+            item->RemoveChildren(0, item->ChildCount());
+            fetch.fetched = 0;
+            endRemoveRows();
+        }
+    }
+
+    void CtqModel::Forget(TreeItem& item)
+    {
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            Forget(*item.GetChild(r));
+        }
+        if (const auto it = fetches.find(&item); it != fetches.end())
+        {
+            if (it->second.collapsed)
+            {
+                collapsed.erase(it->second.position);
+            }
+            fetches.erase(it);
+            --fetchedCount;
+        }
+    }
+
+    void CtqModel::MarkEdited(const TreeItem* item)
+    {
+        for (const auto* i = item; i != nullptr; i = i->GetParent())
+        {
+            if (const auto it = fetches.find(i); it != fetches.end())
+            {
+                if (it->second.edited)
+                {
+                    return; // and so are its ancestors
+                }
+                it->second.edited = true;
+            }
+        }
+    }
+
+    void CtqModel::ExtendWidthHints(const TreeItem& item, int level)
+    {
+        const auto grown = extendWidthHints(item, (level > 0) ? level : item.Depth(), widthHints, widthCandidates);
+        for (auto c = 0; c < itemColumns; ++c)
+        {
+            if (grown & (1u << c))
+            {
+                emit WidthHintChanged(c);
+            }
+        }
+    }
+
     void CtqModel::SetupModelData(const QStringList& lines, TreeItem& parent)
     {
         std::vector<TreeItem*> parents;
+        std::vector<TreeItem*> items;
         QVector<int> indentations;        
         parents.push_back(&parent);
         indentations << 0;
@@ -161,16 +750,6 @@ namespace CtqTool
 
             if (!lineData.isEmpty()) 
             {
-                // Read the column data from the rest of the line.
-                const QStringList columnStrings =lineData.split(QLatin1Char('\t'), Qt::SkipEmptyParts);
-                std::vector<QString> columnData;
-                columnData.reserve(columnStrings.count());
-
-                for (const auto& columnString : columnStrings)
-                {
-                    columnData.push_back(columnString);
-                }
-
                 if (position > indentations.back()) 
                 {
                     // The last child of the current parent is now the new parent
@@ -192,7 +771,15 @@ namespace CtqTool
                 }
 
                 // Append a new item to the current parent's list of children.
-                parents.back()->Append(std::make_unique<TreeItem>(std::make_shared<ItemData>(columnData[0], columnData[1]), parents.back()));
+                const auto line = ParseItemLine(lineData);
+                auto item = MakeTreeItem(line, static_cast<int>(parents.size()), parents.back());
+                if (line.shared >= 0 && static_cast<size_t>(line.shared) < items.size())
+                {
+                    // the item shares its data with an item earlier in the file
+                    item->CloneDataFrom(*items[line.shared]);
+                }
+                items.push_back(item.get());
+                parents.back()->Append(std::move(item));
             }
             ++number;
         }
@@ -200,10 +787,14 @@ namespace CtqTool
 
     bool CtqModel::setData(const QModelIndex& index, const QVariant &value, int role)
     {
-        if (index.isValid())
+        if (index.isValid() && index.column() < countColumn)
         {
-            static_cast<TreeItem*>(index.internalPointer())->SetData(index.column(), value.toString());
-            dataChanged(index, index);            
+            auto* item = static_cast<TreeItem*>(index.internalPointer());
+            item->SetData(index.column(), value.toString());
+            MarkEdited(item);
+            ExtendWidthHints(*item);
+            journal.push_back({JournalRecord::Operation::SetData, PathOf(*item), index.column(), 0, value.toString(), {}});
+            NotifyChanged(index, index);
             return true;
         }
         else
@@ -239,7 +830,20 @@ namespace CtqTool
         const auto success = parentItem->InsertChildren(position,
                                                         rows,
                                                         rootItem->ColumnCount());
+        if (success)
+        {
+            journal.push_back({JournalRecord::Operation::Insert, PathOf(*parentItem), position, rows, {}, {}});
+            MarkEdited(parentItem);
+            for (auto r = position; r < position + rows; ++r)
+            {
+                ExtendWidthHints(*parentItem->GetChild(r));
+            }
+        }
         endInsertRows();
+        if (success)
+        {
+            RefreshRollUps({parentItem});
+        }
 
         return success;
     }
@@ -251,18 +855,459 @@ namespace CtqTool
             return false;
 
         beginRemoveRows(parent, position, position + rows - 1);
+        ++simulationGeneration;
+        if (store && position >= 0 && position + rows <= parentItem->ChildCount())
+        {
+            for (auto r = position; r < position + rows; ++r)
+            {
+                Forget(*parentItem->GetChild(r));
+            }
+        }
         const auto success = parentItem->RemoveChildren(position, rows);
+        if (success)
+        {
+            journal.push_back({JournalRecord::Operation::Remove, PathOf(*parentItem), position, rows, {}, {}});
+            MarkEdited(parentItem);
+        }
         endRemoveRows();
+        if (success)
+        {
+            RefreshRollUps({parentItem});
+        }
 
         return success;
     }
 
-    void CtqModel::OnDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>&)
+    bool CtqModel::LinkData(const QModelIndex& target, const QModelIndex& source)
+    {
+        if (!target.isValid() || !source.isValid())
+        {
+            return false;
+        }
+
+        auto* targetItem = GetItem(target);
+        const auto* sourceItem = GetItem(source);
+        targetItem->CloneDataFrom(*sourceItem);
+        MarkEdited(targetItem);
+        journal.push_back({JournalRecord::Operation::Link, PathOf(*targetItem), 0, 0, {}, PathOf(*sourceItem)});
+        NotifyChanged(index(target.row(), 0, target.parent()), index(target.row(), columnCount() - 1, target.parent()));
+        RefreshRollUps({targetItem});
+        return true;
+    }
+
+    void CtqModel::UpdateStatistics()
+    {
+        // the worker keeps the CTQs alive and uses copies of their targets,
+        // so only their samples must be left alone until it is done
+        struct Update
+        {
+            std::shared_ptr<ItemData> data;
+            Target target;
+            Statistics statistics;
+        };
+        auto updates = std::make_shared<std::vector<Update>>();
+        for (auto& data : ShareCtqs())
+        {
+            const auto target = static_cast<const Ctq&>(*data).GetMeasurement().GetTarget();
+            updates->push_back({std::move(data), target, {}});
+        }
+
+        statisticsPool.start([this, updates, gen = statisticsGeneration]()
+        {
+            ParallelFor(updates->size(), [&updates](size_t i)
+            {
+                // those keeping no samples are quickly done on the GUI thread
+                auto& update = (*updates)[i];
+                const auto& measurement = static_cast<const Ctq&>(*update.data).GetMeasurement();
+                if (measurement.KeepsSamples())
+                {
+                    update.statistics = ComputeStatistics(measurement.GetSamples(), update.target);
+                }
+            });
+
+            QMetaObject::invokeMethod(this, [this, updates, gen]()
+            {
+                if (gen != statisticsGeneration)
+                {
+                    return;
+                }
+                for (const auto& update : *updates)
+                {
+                    // those appended to or given another target since were updated then
+                    auto& ctq = static_cast<Ctq&>(*update.data);
+                    const auto& measurement = ctq.GetMeasurement();
+                    if (!measurement.KeepsSamples())
+                    {
+                        ctq.SetStatistics(ComputeStatistics(measurement, measurement.GetTarget()));
+                        ctq.UpdateConformance();
+                    }
+                    else if (measurement.GetSamples().Size() == update.statistics.count &&
+                             measurement.GetTarget().GetRevision() == update.target.GetRevision())
+                    {
+                        ctq.SetStatistics(update.statistics);
+                        ctq.UpdateConformance();
+                    }
+                }
+
+                // every item may have changed, so there is nothing to gain from doing this incrementally
+                recomputeRollUps(*rootItem);
+                EmitSubtreeChanged(*rootItem);
+                emit StatisticsUpdated();
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void CtqModel::WaitForStatistics()
+    {
+        statisticsPool.waitForDone();
+    }
+
+    void CtqModel::Simulate(const SimulationOptions& options)
+    {
+        CancelSimulation();
+        auto progress = std::make_shared<SimulationProgress>();
+        simulation = progress;
+        simulationTrials = options.trials;
+        simulationPool.start([this, progress, run = PrepareSimulation(*rootItem, options), gen = simulationGeneration]()
+        {
+            auto store = run(*progress);
+            QMetaObject::invokeMethod(this, [this, progress, store = std::move(store), gen]()
+            {
+                if (progress != simulation)
+                {
+                    return; // superseded by a later one
+                }
+                simulation.reset();
+                const auto completed = store && gen == simulationGeneration;
+                if (completed)
+                {
+                    store();
+                    EmitSubtreeChanged(*rootItem);
+                }
+                emit SimulationFinished(completed);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void CtqModel::CancelSimulation()
+    {
+        if (simulation)
+        {
+            simulation->cancelled = true;
+        }
+    }
+
+    bool CtqModel::IsSimulating() const
+    {
+        return simulation != nullptr;
+    }
+
+    double CtqModel::GetSimulationProgress() const
+    {
+        if (!simulation || simulationTrials == 0)
+        {
+            return 0.0;
+        }
+        return std::min(1.0, static_cast<double>(simulation->trials) / static_cast<double>(simulationTrials));
+    }
+
+    void CtqModel::UpdateStackUps()
+    {
+        std::vector<std::vector<TreeItem*>> stale;
+        collectStaleStackUps(*rootItem, stale);
+
+        // one signal per parent, spanning the rows that changed under it
+        std::unordered_map<TreeItem*, std::pair<int, int>> rows;
+
+        // the deepest first, for every item to be composed from its children's
+        for (auto level = stale.rbegin(); level != stale.rend(); ++level)
+        {
+            // compiling caches on the items, so do it before going parallel; a
+            // stale transfer always comes with a stale stack-up
+            for (const auto* item : *level)
+            {
+                item->GetCompiledTransfer();
+            }
+            std::vector<StackUp> results(level->size());
+            ParallelFor(level->size(), [&](size_t i)
+            {
+                results[i] = ComputeStackUp(*(*level)[i]);
+            });
+
+            for (size_t i = 0; i < level->size(); ++i)
+            {
+                auto* item = (*level)[i];
+                const auto changed = results[i] != item->GetStackUp();
+                item->SetStackUp(std::move(results[i]));
+                if (changed)
+                {
+                    const auto row = item->Row();
+                    const auto [it, inserted] = rows.emplace(item->GetParent(), std::make_pair(row, row));
+                    it->second.first = std::min(it->second.first, row);
+                    it->second.second = std::max(it->second.second, row);
+                }
+            }
+        }
+        rootItem->SetStackUp({});
+
+        for (const auto& [parent, range] : rows)
+        {
+            const auto p = (parent == rootItem.get()) ? QModelIndex() : createIndex(parent->Row(), 0, parent);
+            NotifyChanged(index(range.first, stackNominalColumn, p), index(range.second, statisticalColumn, p), {Qt::DisplayRole});
+        }
+    }
+
+    bool CtqModel::AppendSamples(const QModelIndex& idx, const double* values, const qint64* timestamps,
+                                 const quint32* lots, size_t count)
+    {
+        auto* ctq = idx.isValid() ? dynamic_cast<Ctq*>(GetItem(idx)->GetData().get()) : nullptr;
+        if (ctq == nullptr)
+        {
+            return false;
+        }
+
+        WaitForStatistics();
+        ctq->GetMeasurement().Append(values, timestamps, lots, count);
+        SamplesAppended({ctq});
+        return true;
+    }
+
+    bool CtqModel::SetTarget(const QModelIndex& idx, const Target& target)
+    {
+        auto* item = idx.isValid() ? GetItem(idx) : nullptr;
+        auto* ctq = (item != nullptr) ? dynamic_cast<Ctq*>(item->GetData().get()) : nullptr;
+        if (ctq == nullptr)
+        {
+            return false;
+        }
+
+        auto& measurement = ctq->GetMeasurement();
+        ItemLine line;
+        line.lower = target.GetLowerLimit();
+        line.nominal = target.GetNominal();
+        line.upper = target.GetUpperLimit();
+        line.units = target.GetUnits();
+        CtqTool::SetTarget(measurement.GetTarget(), line);
+        item->TargetChanged();
+
+        QByteArray columns;
+        AppendTarget(columns, measurement.GetTarget());
+        journal.push_back({JournalRecord::Operation::SetTarget, PathOf(*item), 0, 0, QString::fromUtf8(columns), {}});
+
+        // only reads the samples, as a statistics update in progress does
+        ctq->SetStatistics(ComputeStatistics(measurement, measurement.GetTarget()));
+        ctq->UpdateConformance();
+        std::vector<TreeItem*> owners;
+        for (auto* owner : ctq->GetOwners())
+        {
+            const auto* top = owner;
+            while (top->GetParent() != nullptr)
+            {
+                top = top->GetParent();
+            }
+            if (top == rootItem.get())
+            {
+                MarkEdited(owner);
+                owners.push_back(owner);
+                NotifyChanged(createIndex(owner->Row(), countColumn, owner), createIndex(owner->Row(), statisticalColumn, owner));
+            }
+        }
+        RefreshRollUps(owners);
+        return true;
+    }
+
+    std::optional<Target> CtqModel::GetTarget(const QModelIndex& idx) const
+    {
+        const auto* ctq = idx.isValid() ? dynamic_cast<const Ctq*>(GetItem(idx)->GetData().get()) : nullptr;
+        if (ctq == nullptr)
+        {
+            return std::nullopt;
+        }
+        return ctq->GetMeasurement().GetTarget();
+    }
+
+    std::vector<Ctq*> CtqModel::GetCtqs()
+    {
+        std::vector<Ctq*> ctqs;
+        std::unordered_set<const ItemData*> seen;
+        collectCtqs(*rootItem, ctqs, seen);
+        return ctqs;
+    }
+
+    std::vector<std::shared_ptr<ItemData>> CtqModel::ShareCtqs()
+    {
+        std::vector<std::shared_ptr<ItemData>> ctqs;
+        std::unordered_set<const ItemData*> seen;
+        collectCtqData(*rootItem, ctqs, seen);
+        return ctqs;
+    }
+
+    Distribution CtqModel::GetDistribution(const QModelIndex& idx) const
     {
-        if (topLeft.column() <= rankColumn && bottomRight.column() >= rankColumn)
+        auto* item = GetItem(idx);
+        std::vector<Ctq*> ctqs;
+        std::unordered_set<const ItemData*> seen;
+        if (auto* ctq = dynamic_cast<Ctq*>(item->GetData().get()); ctq != nullptr)
+        {
+            ctqs.push_back(ctq);
+            seen.insert(ctq);
+        }
+        collectCtqs(*item, ctqs, seen);
+
+        Distribution distribution;
+        for (const auto* ctq : ctqs)
+        {
+            distribution.Merge(ctq->GetMeasurement().GetDistribution());
+        }
+        return distribution;
+    }
+
+    void CtqModel::SamplesAppended(const std::vector<Ctq*>& ctqs)
+    {
+        ParallelFor(ctqs.size(), [&ctqs](size_t i)
+        {
+            const auto& measurement = ctqs[i]->GetMeasurement();
+            ctqs[i]->SetStatistics(ExtendStatistics(ctqs[i]->GetStatistics(), measurement));
+        });
+
+        std::vector<TreeItem*> owners;
+        QStringList violations;
+        for (auto* ctq : ctqs)
+        {
+            ctq->UpdateConformance();
+
+            const auto pending = ctq->GetMeasurement().GetSpc().TakeViolations();
+            for (const auto& v : pending.violations)
+            {
+                violations.append(QString("%1: subgroup %2, mean %3, range %4: %5").arg(ctq->GetText())
+                    .arg(v.subgroup).arg(v.mean).arg(v.range).arg(SpcRuleDescriptions(v.rules)));
+            }
+            if (pending.dropped > 0)
+            {
+                violations.append(QString("%1: %2 more violations").arg(ctq->GetText()).arg(pending.dropped));
+            }
+
+            // every item sharing the CTQ, wherever it is in the tree
+            for (auto* owner : ctq->GetOwners())
+            {
+                const auto* top = owner;
+                while (top->GetParent() != nullptr)
+                {
+                    top = top->GetParent();
+                }
+                if (top == rootItem.get())
+                {
+                    owners.push_back(owner);
+                    MarkEdited(owner);
+                    NotifyChanged(createIndex(owner->Row(), countColumn, owner), createIndex(owner->Row(), spcColumn, owner));
+                }
+            }
+        }
+        RefreshRollUps(owners);
+        if (!violations.isEmpty())
+        {
+            emit SpcViolations(violations);
+        }
+    }
+
+    void CtqModel::RefreshRollUps(const std::vector<TreeItem*>& changed)
+    {
+        // the changed items and their ancestors, once each, deepest first
+        std::vector<std::pair<int, TreeItem*>> dirty;
+        std::unordered_set<const TreeItem*> seen;
+        for (auto* item : changed)
+        {
+            for (auto* i = item; i != nullptr && seen.insert(i).second; i = i->GetParent())
+            {
+                dirty.emplace_back(i->Depth(), i);
+            }
+        }
+        std::sort(dirty.begin(), dirty.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        // one signal per parent, spanning the rows that changed under it
+        std::unordered_map<TreeItem*, std::pair<int, int>> rows;
+        for (const auto& [d, item] : dirty)
+        {
+            const auto rollUp = ComputeRollUp(*item);
+            if (rollUp == item->GetRollUp())
+            {
+                continue;
+            }
+            item->SetRollUp(rollUp);
+            if (auto* parent = item->GetParent(); parent != nullptr)
+            {
+                const auto row = item->Row();
+                const auto [it, inserted] = rows.emplace(parent, std::make_pair(row, row));
+                it->second.first = std::min(it->second.first, row);
+                it->second.second = std::max(it->second.second, row);
+            }
+        }
+
+        for (const auto& [parent, range] : rows)
+        {
+            const auto p = (parent == rootItem.get()) ? QModelIndex() : createIndex(parent->Row(), 0, parent);
+            NotifyChanged(index(range.first, 0, p), index(range.second, conformanceColumn, p), {Qt::DisplayRole, ConformanceRole});
+        }
+    }
+
+    void CtqModel::EmitSubtreeChanged(TreeItem& parent)
+    {
+        if (parent.ChildCount() == 0)
+        {
+            return;
+        }
+        const auto p = (&parent == rootItem.get()) ? QModelIndex() : createIndex(parent.Row(), 0, &parent);
+        NotifyChanged(index(0, 0, p), index(parent.ChildCount() - 1, statisticalColumn, p), {Qt::DisplayRole, ConformanceRole});
+        for (auto r = 0; r < parent.ChildCount(); ++r)
+        {
+            EmitSubtreeChanged(*parent.GetChild(r));
+        }
+    }
+
+    const std::vector<JournalRecord>& CtqModel::GetJournal() const
+    {
+        return journal;
+    }
+
+    bool CtqModel::IsJournalComplete() const
+    {
+        return journalComplete;
+    }
+
+    void CtqModel::ClearJournal()
+    {
+        journal.clear();
+        journalComplete = true;
+    }
+
+    const std::vector<QString>& CtqModel::GetWidthHints(int column, int level) const
+    {
+        static const std::vector<QString> none;
+        return (column >= 0 && column < itemColumns && level >= 1 && level <= maxDepth) ?
+            widthHints[level - 1][column] : none;
+    }
+
+    void CtqModel::NotifyChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles)
+    {
+        OnDataChanged(topLeft, bottomRight, roles);
+        changes.Add(topLeft, bottomRight, roles);
+    }
+
+    void CtqModel::OnDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles)
+    {
+        const auto textChanged = roles.isEmpty() || roles.contains(Qt::EditRole);
+        if (textChanged && topLeft.column() <= rankColumn && bottomRight.column() >= rankColumn)
         {
             auto* item = GetItem(bottomRight);
             item->PropagateRank();
+
+            // the weights of the item and its whole subtree changed
+            for (auto r = 0; r < item->ChildCount(); ++r)
+            {
+                recomputeRollUps(*item->GetChild(r));
+            }
+            EmitSubtreeChanged(*item);
+            RefreshRollUps({item});
         }
     }
 }
@@ -18,17 +18,37 @@
 
 #pragma once
 
+#include "changecoalescer.h"
+#include "journal.h"
+#include "montecarlo.h"
+#include "nodestore.h"
+#include "sketch.h"
+#include "target.h"
+
 #include <QAbstractItemModel>
+#include <QThreadPool>
 
+#include <array>
+#include <list>
 #include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 namespace CtqTool
 {
+    class Ctq;
+    class ItemData;
     class TreeItem;
     class CtqModel : public QAbstractItemModel
     {
     Q_OBJECT
     public:
+        enum Role
+        {
+            ConformanceRole = Qt::UserRole + 1 // a Conformance::Level, for CTQs
+        };
+
         explicit CtqModel(QObject* parent = nullptr);
         ~CtqModel();
 
@@ -42,6 +62,9 @@ namespace CtqTool
         int rowCount(const QModelIndex& parent = QModelIndex()) const override;
         int columnCount(const QModelIndex& parent = QModelIndex()) const override;
         bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+        bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+        bool canFetchMore(const QModelIndex& parent) const override;
+        void fetchMore(const QModelIndex& parent) override;
           
 
         bool removeRows(int position, int rows,
@@ -50,14 +73,144 @@ namespace CtqTool
                     const QModelIndex &parent = QModelIndex()) override;
         
         void Reset(const QString& data);
+        void Reset(std::unique_ptr<TreeItem> root);
+        const TreeItem& GetRootItem() const;
+
+        // Reads the tree lazily: the children of an item are fetched from the
+        // store in pages as views ask for them, and those of collapsed branches
+        // without edits are dropped again while more than the fetch budget are
+        // in memory. Until the next reset, everything else applies to the items
+        // fetched, and the root item is not the whole tree.
+        void Reset(std::shared_ptr<NodeStore>);
+        bool IsLazy() const;
+        void SetFetchBudget(size_t items);
+        // whether fetching more keeps the items in memory within the budget,
+        // for views that fetch without the user scrolling
+        bool IsWithinFetchBudget() const;
+        // after the journal was applied to the store, where the rows fetched so
+        // far then come before the others; edited branches can be dropped again
+        void StoreUpdated();
+        // the item the store holds under ids, those from the root of the store
+        // down, fetching the branches on the way; invalid when it is not in
+        // the model, such as after it was removed
+        QModelIndex FetchStored(const std::vector<NodeStore::Id>& ids);
+
+        // reported by views, for the branches collapsed longest to be dropped first
+        void BranchExpanded(const QModelIndex&);
+        void BranchCollapsed(const QModelIndex&);
+
+        static std::unique_ptr<TreeItem> Parse(const QString& data);
+
+        // shares the data of source with target, as for an existing item inserted elsewhere
+        bool LinkData(const QModelIndex& target, const QModelIndex& source);
+
+        // recomputes the statistics columns and conformance of all CTQs from
+        // their samples on a worker thread, emitting StatisticsUpdated once
+        // the results are in; appending samples meanwhile must wait for it
+        void UpdateStatistics();
+        void WaitForStatistics();
+
+        // starts a Monte Carlo simulation of the whole tree on a worker thread,
+        // which fills the simulated columns and emits SimulationFinished once it
+        // completes; one cancelled, or run while items were removed, leaves the
+        // columns as they were
+        void Simulate(const SimulationOptions&);
+        void CancelSimulation();
+        bool IsSimulating() const;
+        // the fraction of the trials run so far
+        double GetSimulationProgress() const;
+
+        // recomputes the tolerance stack-ups of the items edited since the last
+        // update and of their ancestors, in parallel
+        void UpdateStackUps();
+
+        // appends samples to the measurement of a CTQ, updating its conformance, distribution
+        // and control chart
+        bool AppendSamples(const QModelIndex& ctq, const double* values, const qint64* timestamps,
+                           const quint32* lots, size_t count);
+
+        // sets the limits, nominal value and units of a CTQ's target, updating
+        // its capability and conformance
+        bool SetTarget(const QModelIndex& ctq, const Target&);
+        // that of a CTQ, or none for other items
+        std::optional<Target> GetTarget(const QModelIndex&) const;
+
+        // every distinct CTQ in the tree, for bulk appends followed by
+        // SamplesAppended, which brings their statistics up to date
+        std::vector<Ctq*> GetCtqs();
+        void SamplesAppended(const std::vector<Ctq*>&);
+        // the same, kept alive for work on another thread
+        std::vector<std::shared_ptr<ItemData>> ShareCtqs();
+
+        // the distributions of the distinct CTQs in the subtree of an item, merged
+        Distribution GetDistribution(const QModelIndex&) const;
+
+        // the edits made since the last ClearJournal; incomplete after a Reset
+        const std::vector<JournalRecord>& GetJournal() const;
+        bool IsJournalComplete() const;
+        void ClearJournal();
+
+        // the longest texts of an item column at a level (1 for needs) seen
+        // since the last reset, by characters and longest first, for views to
+        // measure those in pixels instead of every row; empty for the computed
+        // columns
+        const std::vector<QString>& GetWidthHints(int column, int level) const;
+        static constexpr size_t widthCandidates = 8;
+
+    signals:
+        // one line per control chart violation found by SamplesAppended
+        void SpcViolations(const QStringList&);
+        void WidthHintChanged(int column);
+        void StatisticsUpdated();
+        void SimulationFinished(bool completed);
         
     private:
-        void SetupModelData(const QStringList& lines, TreeItem& parent);
+        static void SetupModelData(const QStringList& lines, TreeItem& parent);
         TreeItem* GetItem(const QModelIndex &index) const;
 
+        // updates what depends on a change at once, and reports it to views
+        // with the changes made within the same frame
+        void NotifyChanged(const QModelIndex&, const QModelIndex&, const QVector<int>& roles = {});
         void OnDataChanged(const QModelIndex&, const QModelIndex&, const QVector<int>&);
 
+        // recomputes the roll-ups of changed items and their ancestors
+        void RefreshRollUps(const std::vector<TreeItem*>& changed);
+        void EmitSubtreeChanged(TreeItem& parent);
+
+        // how much of an item's children has been fetched from the store
+        struct Fetch
+        {
+            NodeStore::Id id = 0;
+            int total = 0;                      // children in the store
+            int fetched = 0;
+            bool edited = false;                // in the subtree, which is then kept
+            bool collapsed = false;
+            std::list<TreeItem*>::iterator position;    // in collapsed
+        };
+
+        void Evict();
+        void Forget(TreeItem&);
+        void MarkEdited(const TreeItem*);
+        // the level if known, else found from the item
+        void ExtendWidthHints(const TreeItem&, int level = 0);
+
         std::unique_ptr<TreeItem> rootItem;
+        std::shared_ptr<NodeStore> store;
+        std::unordered_map<const TreeItem*, Fetch> fetches;
+        std::list<TreeItem*> collapsed;         // least recently collapsed first
+        size_t fetchedCount = 0;
+        size_t fetchBudget = 1 << 20;
+        std::vector<JournalRecord> journal;
+        bool journalComplete = true;
         static constexpr int maxDepth = 3; // i.e. need, driver, ctq
+        static constexpr int itemColumns = 4; // text, note, rank and transfer
+        std::array<std::array<std::vector<QString>, itemColumns>, maxDepth> widthHints;
+        ChangeCoalescer changes{*this};
+        QThreadPool statisticsPool;
+        quint64 statisticsGeneration = 0;  // of the tree, for results of an earlier one to be dropped
+        QThreadPool simulationPool;
+        std::shared_ptr<SimulationProgress> simulation;    // the one running
+        size_t simulationTrials = 0;
+        quint64 simulationGeneration = 0;  // counts removals, after which no results may be stored
     };
 }
@@ -214,8 +214,16 @@ namespace CtqTool
     {
     }
 
-    void CtqProxyModel::SourceRowsInserted(const QModelIndex& p, int, int)
+    void CtqProxyModel::SourceRowsInserted(const QModelIndex& p, int, int last)
     {
+        // Rows appended, as a lazy model fetches them page by page, leave the
+        // others where they are, so the index is rebuilt once for all pages
+        // fetched in one pass.
+        if (last == sourceModel()->rowCount(p) - 1)
+        {
+            ScheduleReset();
+            return;
+        }
         SourceModelReset();
     }
 
@@ -228,15 +236,31 @@ namespace CtqTool
         SourceModelReset();
     }
 
-    void CtqProxyModel::SourceDataChanged(const QModelIndex& tl, const QModelIndex& br)
+    void CtqProxyModel::SourceDataChanged(const QModelIndex& tl, const QModelIndex& br, const QList<int>& roles)
     {
         const auto p_tl = mapFromSource(tl);
         const auto p_br = mapFromSource(br);
-        dataChanged(p_tl, p_br);
+        dataChanged(p_tl, p_br, roles);
+    }
+
+    void CtqProxyModel::ScheduleReset()
+    {
+        if (!resetPending)
+        {
+            resetPending = true;
+            QMetaObject::invokeMethod(this, [this]()
+            {
+                if (resetPending)
+                {
+                    SourceModelReset();
+                }
+            }, Qt::QueuedConnection);
+        }
     }
 
     void CtqProxyModel::SourceModelReset()
     {
+        resetPending = false;
         impl->Reset();
         if (rowCount() > 0)
         {
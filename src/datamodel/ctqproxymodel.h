@@ -48,10 +48,12 @@ namespace CtqTool
         void SourceRowsAboutToBeRemoved(const QModelIndex&, int, int);
         void SourceRowsInserted(const QModelIndex&, int, int);
         void SourceRowsRemoved(const QModelIndex&, int, int);
-        void SourceDataChanged(const QModelIndex&, const QModelIndex&);
+        void SourceDataChanged(const QModelIndex&, const QModelIndex&, const QList<int>& roles);
         void SourceModelReset();
+        void ScheduleReset();
 
         class CtqProxyModelImpl;
         std::unique_ptr<CtqProxyModelImpl> impl;
+        bool resetPending = false;
     };
 }
\ No newline at end of file
@@ -0,0 +1,348 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "document.h"
+#include "ctqmodel.h"
+#include "item.h"
+#include "textformat.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+namespace
+{
+    constexpr char beginLine[] = "%begin\n";
+    constexpr char beginMarker[] = "%begin";
+    constexpr char commitMarker[] = "%commit\t";
+
+    // the journal is compacted once it exceeds this, or half the snapshot size
+    constexpr qint64 minimumCompactionSize = 4 << 20;
+    constexpr qint64 copyChunkSize = 4 << 20;
+
+    bool sync(QFile& file)
+    {
+        if (!file.flush())
+        {
+            return false;
+        }
+#ifdef Q_OS_WIN
+        return _commit(file.handle()) == 0;
+#else
+        return ::fsync(file.handle()) == 0;
+#endif
+    }
+
+    quint16 checksum(const QByteArray& bytes, qsizetype from, qsizetype to)
+    {
+        return qChecksum(QByteArrayView(bytes.constData() + from, to - from));
+    }
+}
+
+namespace CtqTool
+{
+    Document::Document(QObject* parent) :
+        QObject(parent)
+    {
+        pool.setMaxThreadCount(1);
+    }
+
+    Document::~Document()
+    {
+        pool.waitForDone();
+    }
+
+    const QString& Document::GetFilename() const
+    {
+        return filename;
+    }
+
+    qint64 Document::GetCommittedSize() const
+    {
+        return committedSize;
+    }
+
+    void Document::SetFilename(const QString& name)
+    {
+        filename = name;
+        snapshotSize = committedSize = -1;
+        ++generation;
+    }
+
+    void Document::SetFilename(const QString& name, qint64 size)
+    {
+        filename = name;
+        snapshotSize = committedSize = size;
+        ++generation;
+    }
+
+    bool Document::CopyAs(const QString& name)
+    {
+        QFile source(filename);
+        QSaveFile target(name);
+        if (committedSize < 0 || !source.open(QIODevice::ReadOnly) || !target.open(QIODevice::WriteOnly))
+        {
+            return false;
+        }
+        for (auto left = committedSize; left > 0;)
+        {
+            const auto chunk = source.read(std::min(left, copyChunkSize));
+            if (chunk.isEmpty() || target.write(chunk) != chunk.size())
+            {
+                return false;
+            }
+            left -= chunk.size();
+        }
+        if (!target.commit())
+        {
+            return false;
+        }
+
+        filename = name;
+        ++generation;
+        return true;
+    }
+
+    Document::Contents Document::Read(const QString& name, qint64 limit)
+    {
+        QFile file(name);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return {};
+        }
+        return Read(file, limit);
+    }
+
+    Document::Contents Document::Read(QIODevice& device, qint64 limit)
+    {
+        return Read((limit < 0) ? device.readAll() : device.read(limit));
+    }
+
+    Document::Contents Document::Read(const QByteArray& bytes)
+    {
+        Contents contents;
+        qsizetype snapshotEnd = 0;
+        if (!bytes.startsWith(beginLine))
+        {
+            const auto pos = bytes.indexOf(QByteArray("\n") + beginLine);
+            snapshotEnd = (pos < 0) ? bytes.size() : pos + 1;
+        }
+        contents.root = CtqModel::Parse(QString::fromUtf8(bytes.constData(), snapshotEnd));
+        contents.snapshotSize = contents.committedSize = snapshotEnd;
+
+        std::vector<JournalRecord> block;
+        qsizetype blockStart = -1;
+        auto blockValid = false;
+        for (auto pos = snapshotEnd; pos < bytes.size();)
+        {
+            const auto end = bytes.indexOf('\n', pos);
+            if (end < 0)
+            {
+                break; // torn write
+            }
+
+            const auto line = bytes.mid(pos, end - pos);
+            if (line == beginMarker)
+            {
+                block.clear();
+                blockStart = end + 1;
+                blockValid = true;
+            }
+            else if (line.startsWith(commitMarker))
+            {
+                const auto fields = line.split('\t');
+                if (blockStart < 0 || !blockValid || fields.size() != 3 ||
+                    fields[1].toULongLong() != block.size() ||
+                    fields[2].toUShort() != checksum(bytes, blockStart, pos))
+                {
+                    break;
+                }
+                for (const auto& record : block)
+                {
+                    if (!Apply(record, *contents.root))
+                    {
+                        // the block is partly applied, so read again up to the last commit
+                        qWarning() << "document journal does not match its snapshot";
+                        return Read(bytes.left(contents.committedSize));
+                    }
+                }
+                contents.committedSize = end + 1;
+                blockStart = -1;
+            }
+            else if (blockStart >= 0)
+            {
+                JournalRecord record;
+                blockValid = blockValid && Parse(line, record);
+                block.push_back(std::move(record));
+            }
+            else
+            {
+                break;
+            }
+            pos = end + 1;
+        }
+
+        return contents;
+    }
+
+    std::unique_ptr<TreeItem> Document::Load(const QString& name)
+    {
+        auto contents = Read(name);
+        if (!contents.root)
+        {
+            return nullptr;
+        }
+
+        filename = name;
+        snapshotSize = contents.snapshotSize;
+        committedSize = contents.committedSize;
+        ++generation;
+        return std::move(contents.root);
+    }
+
+    bool Document::Save(const std::vector<JournalRecord>& records)
+    {
+        if (filename.isEmpty() || committedSize < 0)
+        {
+            return false;
+        }
+        if (records.empty())
+        {
+            return true;
+        }
+
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadWrite))
+        {
+            return false;
+        }
+        // drop whatever an interrupted save left behind
+        if (file.size() != committedSize && !file.resize(committedSize))
+        {
+            return false;
+        }
+
+        QByteArray block;
+        if (committedSize > 0 && file.seek(committedSize - 1) && file.read(1) != "\n")
+        {
+            block.append('\n');
+        }
+        block.append(beginLine);
+        const auto recordsStart = block.size();
+        for (const auto& record : records)
+        {
+            AppendTo(block, record);
+        }
+
+        // the records are on disk before the commit line that validates them
+        QByteArray commit(commitMarker);
+        commit.append(QByteArray::number(static_cast<qulonglong>(records.size())));
+        commit.append('\t');
+        commit.append(QByteArray::number(checksum(block, recordsStart, block.size())));
+        commit.append('\n');
+        if (!file.seek(committedSize) || file.write(block) != block.size() || !sync(file) ||
+            file.write(commit) != commit.size() || !sync(file))
+        {
+            return false;
+        }
+
+        committedSize += block.size() + commit.size();
+        if (!compacting && committedSize - snapshotSize > std::max(minimumCompactionSize, snapshotSize / 2))
+        {
+            StartCompaction();
+        }
+        return true;
+    }
+
+    bool Document::SaveAs(const TreeItem& root, const QString& name)
+    {
+        QSaveFile file(name);
+        if (!file.open(QIODevice::WriteOnly) || !WriteTree(root, file))
+        {
+            return false;
+        }
+        const auto size = file.pos();
+        if (!file.commit())
+        {
+            return false;
+        }
+
+        filename = name;
+        snapshotSize = committedSize = size;
+        ++generation;
+        return true;
+    }
+
+    void Document::StartCompaction()
+    {
+        compacting = true;
+        pool.start([this, name = filename, compactedSize = committedSize, gen = generation, owner = thread()]()
+        {
+            auto target = std::make_shared<QSaveFile>(name);
+            const auto contents = Read(name, compactedSize);
+            const auto ok = contents.root && contents.committedSize == compactedSize &&
+                target->open(QIODevice::WriteOnly) && WriteTree(*contents.root, *target);
+            const auto snapshot = ok ? target->pos() : 0;
+            target->moveToThread(owner);
+            QMetaObject::invokeMethod(this, [=]()
+            {
+                FinishCompaction(ok ? target : nullptr, compactedSize, snapshot, gen);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void Document::FinishCompaction(std::shared_ptr<QSaveFile> target, qint64 compactedSize, qint64 snapshot, int gen)
+    {
+        compacting = false;
+        if (!target || gen != generation)
+        {
+            emit Compacted(false);
+            return;
+        }
+
+        // carry over the blocks saved while compacting
+        QByteArray tail;
+        if (committedSize > compactedSize)
+        {
+            QFile current(filename);
+            if (!current.open(QIODevice::ReadOnly) || !current.seek(compactedSize))
+            {
+                emit Compacted(false);
+                return;
+            }
+            tail = current.read(committedSize - compactedSize);
+        }
+        if (target->write(tail) != tail.size() || !target->commit())
+        {
+            emit Compacted(false);
+            return;
+        }
+
+        snapshotSize = snapshot;
+        committedSize = snapshot + tail.size();
+        emit Compacted(true);
+    }
+}
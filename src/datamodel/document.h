@@ -0,0 +1,91 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "journal.h"
+
+#include <QObject>
+#include <QThreadPool>
+
+#include <memory>
+#include <vector>
+
+class QIODevice;
+class QSaveFile;
+
+namespace CtqTool
+{
+    class TreeItem;
+
+    // A document file is a snapshot of the tree followed by blocks of journal
+    // records, each appended by a save as
+    //   %begin
+    //   <records>
+    //   %commit<TAB>count<TAB>checksum
+    // Blocks without a valid commit line are ignored. Once the journal grows
+    // past a threshold the file is compacted into a fresh snapshot in the background.
+    class Document : public QObject
+    {
+        Q_OBJECT
+    public:
+        struct Contents
+        {
+            std::unique_ptr<TreeItem> root;
+            qint64 snapshotSize = 0;
+            qint64 committedSize = 0;
+        };
+
+        explicit Document(QObject* parent = nullptr);
+        ~Document();
+
+        std::unique_ptr<TreeItem> Load(const QString& filename);
+        bool Save(const std::vector<JournalRecord>&);
+        bool SaveAs(const TreeItem& root, const QString& filename);
+        const QString& GetFilename() const;
+        qint64 GetCommittedSize() const;
+
+        // attaches to a file without reading it; the next save writes a snapshot
+        void SetFilename(const QString&);
+        // or journals the edits after its first committedSize bytes, which the model holds
+        void SetFilename(const QString&, qint64 committedSize);
+
+        // copies what is committed to another file and continues there, for
+        // a model that only holds part of the tree
+        bool CopyAs(const QString& filename);
+
+        // reads the snapshot and replays the committed journal, up to limit bytes
+        static Contents Read(const QString& filename, qint64 limit = -1);
+        static Contents Read(QIODevice&, qint64 limit = -1);
+        static Contents Read(const QByteArray&);
+
+    signals:
+        void Compacted(bool success);
+
+    private:
+        void StartCompaction();
+        void FinishCompaction(std::shared_ptr<QSaveFile>, qint64 compactedSize, qint64 snapshot, int generation);
+
+        QString filename;
+        qint64 snapshotSize = 0;
+        qint64 committedSize = 0;
+        int generation = 0;
+        bool compacting = false;
+        QThreadPool pool;
+    };
+}
@@ -0,0 +1,324 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "documentstore.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace
+{
+    using namespace CtqTool;
+    using Record = DocumentStore::Record;
+
+    constexpr char magic[8] = {'C', 'T', 'Q', 'I', 'D', 'X', '2', '\0'};
+
+    struct Header
+    {
+        char magic[8];
+        qint64 documentSize;
+        qint64 modified;
+        quint64 count;
+    };
+
+    QString indexFilename(const QString& filename)
+    {
+        return filename + ".idx";
+    }
+
+    qint64 modifiedOf(const QString& filename)
+    {
+        return QFileInfo(filename).lastModified().toMSecsSinceEpoch();
+    }
+
+    bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    // Records of the items by level, the root first, and which record each
+    // item in the file has. Lines nest as in CtqModel::Parse, so that the
+    // children of an item are the items of the next level between those of
+    // its left and right siblings.
+    bool scan(const char* text, qint64 size, std::vector<Record>& records, std::vector<quint32>& order)
+    {
+        struct Entry
+        {
+            quint64 offset;
+            quint32 parent;                     // in the level above
+        };
+        std::vector<std::vector<Entry>> levels(1, {{0, 0}});
+        std::vector<std::pair<quint32, quint32>> lines;   // level and place in it, in file order
+        std::vector<quint32> parents{0};        // open at each level
+        std::vector<qint64> indentations{0};
+
+        for (qint64 pos = 0; pos < size;)
+        {
+            const auto* newline = static_cast<const char*>(std::memchr(text + pos, '\n', size - pos));
+            const auto end = (newline != nullptr) ? newline - text : size;
+            auto position = pos;
+            while (position < end && text[position] == ' ')
+            {
+                ++position;
+            }
+            auto last = end;
+            while (last > position && isBlank(text[last - 1]))
+            {
+                --last;
+            }
+
+            if (last > position)
+            {
+                if (text[pos] == '%')
+                {
+                    return false; // a journal block
+                }
+
+                const auto indentation = position - pos;
+                const auto depth = parents.size();
+                if (indentation > indentations.back())
+                {
+                    // the last child of the current parent is now the parent
+                    if (depth < levels.size() && !levels[depth].empty() && levels[depth].back().parent == parents.back())
+                    {
+                        parents.push_back(static_cast<quint32>(levels[depth].size() - 1));
+                        indentations.push_back(indentation);
+                    }
+                }
+                else
+                {
+                    while (indentation < indentations.back() && parents.size() > 1)
+                    {
+                        parents.pop_back();
+                        indentations.pop_back();
+                    }
+                }
+
+                const auto level = parents.size();
+                if (levels.size() <= level)
+                {
+                    levels.resize(level + 1);
+                }
+                if (levels[level].size() == std::numeric_limits<quint32>::max())
+                {
+                    return false;
+                }
+                lines.emplace_back(static_cast<quint32>(level), static_cast<quint32>(levels[level].size()));
+                levels[level].push_back({static_cast<quint64>(pos), parents.back()});
+            }
+            pos = end + 1;
+        }
+
+        std::vector<quint64> start(levels.size() + 1, 0);
+        for (size_t d = 0; d < levels.size(); ++d)
+        {
+            start[d + 1] = start[d] + levels[d].size();
+        }
+        if (start.back() > std::numeric_limits<quint32>::max())
+        {
+            return false;
+        }
+
+        records.assign(start.back(), Record{0, 0, 0});
+        for (size_t d = 0; d < levels.size(); ++d)
+        {
+            for (size_t i = 0; i < levels[d].size(); ++i)
+            {
+                const auto id = start[d] + i;
+                records[id].offset = levels[d][i].offset;
+                if (d > 0)
+                {
+                    auto& parent = records[start[d - 1] + levels[d][i].parent];
+                    if (parent.childCount++ == 0)
+                    {
+                        parent.firstChild = static_cast<quint32>(id);
+                    }
+                }
+            }
+            levels[d] = {};
+        }
+
+        order.resize(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            order[i] = static_cast<quint32>(start[lines[i].first] + lines[i].second);
+        }
+        return true;
+    }
+}
+
+namespace CtqTool
+{
+    DocumentStore::DocumentStore(const QString& filename) :
+        document(filename)
+    {
+    }
+
+    std::unique_ptr<DocumentStore> DocumentStore::Open(const QString& filename)
+    {
+        std::unique_ptr<DocumentStore> store(new DocumentStore(filename));
+        auto& document = store->document;
+        if (!document.open(QIODevice::ReadOnly))
+        {
+            return nullptr;
+        }
+        store->textSize = document.size();
+        if (store->textSize > 0)
+        {
+            store->text = reinterpret_cast<const char*>(document.map(0, store->textSize));
+            if (store->text == nullptr)
+            {
+                return nullptr;
+            }
+        }
+
+        if (!store->LoadIndex(filename))
+        {
+            if (!scan(store->text, store->textSize, store->built, store->builtOrder))
+            {
+                return nullptr;
+            }
+            store->records = store->built.data();
+            store->order = store->builtOrder.data();
+            store->count = store->built.size();
+            // the index is read back mapped, so it takes no memory once saved
+            if (store->SaveIndex(filename) && store->LoadIndex(filename))
+            {
+                store->built = {};
+                store->builtOrder = {};
+            }
+        }
+        return store;
+    }
+
+    bool DocumentStore::LoadIndex(const QString& filename)
+    {
+        index.setFileName(indexFilename(filename));
+        if (!index.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+
+        const auto size = index.size();
+        const auto* map = (size >= qint64(sizeof(Header))) ? index.map(0, size) : nullptr;
+        Header header{};
+        if (map != nullptr)
+        {
+            std::memcpy(&header, map, sizeof(header));
+        }
+        if (map == nullptr || std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.count == 0 ||
+            header.documentSize != textSize || header.modified != modifiedOf(filename) ||
+            header.count > quint64(size) / sizeof(Record) ||
+            size != qint64(sizeof(Header) + header.count * sizeof(Record) + (header.count - 1) * sizeof(quint32)))
+        {
+            index.close();
+            return false;
+        }
+
+        records = reinterpret_cast<const Record*>(map + sizeof(Header));
+        order = reinterpret_cast<const quint32*>(map + sizeof(Header) + header.count * sizeof(Record));
+        count = header.count;
+        return true;
+    }
+
+    bool DocumentStore::SaveIndex(const QString& filename) const
+    {
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.documentSize = textSize;
+        header.modified = modifiedOf(filename);
+        header.count = count;
+
+        QSaveFile file(indexFilename(filename));
+        const auto bytes = static_cast<qint64>(count * sizeof(Record));
+        const auto orderBytes = static_cast<qint64>((count - 1) * sizeof(quint32));
+        return file.open(QIODevice::WriteOnly) &&
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header)) &&
+            file.write(reinterpret_cast<const char*>(records), bytes) == bytes &&
+            file.write(reinterpret_cast<const char*>(order), orderBytes) == orderBytes && file.commit();
+    }
+
+    NodeStore::Id DocumentStore::GetRoot() const
+    {
+        return 0;
+    }
+
+    int DocumentStore::ChildCount(Id id) const
+    {
+        return (id < count) ? static_cast<int>(records[id].childCount) : 0;
+    }
+
+    std::vector<NodeStore::Node> DocumentStore::GetChildren(Id parent, int first, int n) const
+    {
+        std::vector<Node> nodes;
+        if (parent >= count || first < 0 || n <= 0)
+        {
+            return nodes;
+        }
+
+        const auto& record = records[parent];
+        const auto from = quint64(record.firstChild) + quint64(first);
+        const auto to = std::min({quint64(record.firstChild) + record.childCount, from + quint64(n), count});
+        nodes.reserve(to > from ? to - from : 0);
+        for (auto id = from; id < to; ++id)
+        {
+            const auto& child = records[id];
+            if (child.offset >= quint64(textSize))
+            {
+                break;
+            }
+            auto line = ReadLine(child);
+            if (line.shared >= 0 && quint64(line.shared) < count - 1 && order[line.shared] < count)
+            {
+                // the data is written with the first item showing it
+                const auto data = ReadLine(records[order[line.shared]]);
+                line.text = data.text;
+                line.note = data.note;
+                line.lower = data.lower;
+                line.nominal = data.nominal;
+                line.upper = data.upper;
+                line.units = data.units;
+            }
+            nodes.push_back({id, std::move(line), static_cast<int>(child.childCount)});
+        }
+        return nodes;
+    }
+
+    ItemLine DocumentStore::ReadLine(const Record& record) const
+    {
+        if (record.offset >= quint64(textSize))
+        {
+            return {};
+        }
+        const auto* line = text + record.offset;
+        const auto* newline = static_cast<const char*>(std::memchr(line, '\n', textSize - record.offset));
+        const auto length = (newline != nullptr) ? newline - line : textSize - qint64(record.offset);
+        return ParseItemLine(QString::fromUtf8(line, length).trimmed());
+    }
+
+    quint64 DocumentStore::GetSize() const
+    {
+        return count - 1;
+    }
+}
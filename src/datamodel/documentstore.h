@@ -0,0 +1,74 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "nodestore.h"
+
+#include <QFile>
+
+#include <memory>
+#include <vector>
+
+namespace CtqTool
+{
+    // The snapshot of a document file, read in place. An index of its items in
+    // breadth first order, where the children of an item are adjacent, is kept
+    // next to it as <document>.idx and built again once the document changed.
+    // Both files are memory mapped, so opening does not depend on the size of
+    // the tree and only the items fetched are ever read. The index also maps
+    // the ordinals of the items in the file to their records, so an item
+    // sharing the data of an earlier one (@n) is read with that item's text,
+    // note and target. It is read as a copy, though, not linked to the other.
+    class DocumentStore : public NodeStore
+    {
+    public:
+        // null when the file cannot be mapped or has journal blocks to replay
+        static std::unique_ptr<DocumentStore> Open(const QString& filename);
+
+        Id GetRoot() const override;
+        int ChildCount(Id) const override;
+        std::vector<Node> GetChildren(Id parent, int first, int count) const override;
+
+        // of the items, not counting the root
+        quint64 GetSize() const;
+
+        struct Record
+        {
+            quint64 offset;                     // of the item's line
+            quint32 firstChild;
+            quint32 childCount;
+        };
+
+    private:
+        DocumentStore(const QString& filename);
+        ItemLine ReadLine(const Record&) const;
+        bool LoadIndex(const QString& filename);
+        bool SaveIndex(const QString& filename) const;
+
+        QFile document;
+        QFile index;
+        const char* text = nullptr;
+        qint64 textSize = 0;
+        const Record* records = nullptr;
+        const quint32* order = nullptr;         // the records of the items in file order, the root left out
+        quint64 count = 0;
+        std::vector<Record> built;              // when the index could not be saved
+        std::vector<quint32> builtOrder;
+    };
+}
@@ -0,0 +1,587 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "expression.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto maxNesting = 200;
+    constexpr size_t maxOperands = std::numeric_limits<quint16>::max(); // constants or inputs, as instructions address them
+    constexpr auto unknown = -1;
+    constexpr auto ambiguous = -2;
+}
+
+namespace CtqTool
+{
+    struct Expression::Node
+    {
+        // a long chain of operations is freed without recursing through it
+        ~Node()
+        {
+            auto pending = std::move(args);
+            while (!pending.empty())
+            {
+                auto node = std::move(pending.back());
+                pending.pop_back();
+                for (auto& arg : node->args)
+                {
+                    pending.push_back(std::move(arg));
+                }
+                node->args.clear();
+            }
+        }
+
+        Op op = Op::Constant;
+        double value = 0.0;
+        int input = -1;
+        std::vector<std::unique_ptr<Node>> args;
+    };
+
+    class Expression::Parser
+    {
+    public:
+        Parser(const QString& s, const std::vector<QString>& names) :
+            source(s)
+        {
+            for (size_t i = 0; i < names.size(); ++i)
+            {
+                for (auto* map : {&byName, &byText})
+                {
+                    const auto key = (map == &byName) ? ExpressionName(names[i]) : names[i];
+                    map->insert(key, map->contains(key) ? ambiguous : static_cast<int>(i));
+                }
+            }
+        }
+
+        std::unique_ptr<Node> Parse(QString& error)
+        {
+            auto node = ParseSum();
+            SkipSpace();
+            if (node && pos < source.size())
+            {
+                node = Fail(QString("unexpected '%1'").arg(QString(source[pos])));
+            }
+            if (!node)
+            {
+                error = QString("%1 at position %2").arg(failure).arg(static_cast<qint64>(pos + 1));
+            }
+            return node;
+        }
+
+    private:
+        using Ptr = std::unique_ptr<Node>;
+
+        Ptr Fail(const QString& message)
+        {
+            if (failure.isEmpty())
+            {
+                failure = message;
+            }
+            return nullptr;
+        }
+
+        void SkipSpace()
+        {
+            while (pos < source.size() && source[pos].isSpace())
+            {
+                ++pos;
+            }
+        }
+
+        bool Accept(char c)
+        {
+            SkipSpace();
+            if (pos < source.size() && source[pos] == QChar(c))
+            {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+
+        // constant operands are folded right away
+        Ptr Make(Op op, std::vector<Ptr> args)
+        {
+            auto node = std::make_unique<Node>();
+            node->op = op;
+            const auto constant = std::all_of(args.begin(), args.end(), [](const Ptr& a) { return a->op == Op::Constant; });
+            if (constant)
+            {
+                auto value = args[0]->value;
+                for (size_t i = 1; i < args.size(); ++i)
+                {
+                    value = Apply(op, value, args[i]->value);
+                }
+                node->op = Op::Constant;
+                node->value = (args.size() == 1) ? Apply(op, value, 0.0) : value;
+                return node;
+            }
+            node->args = std::move(args);
+            return node;
+        }
+
+        Ptr Binary(Op op, Ptr a, Ptr b)
+        {
+            std::vector<Ptr> args;
+            args.push_back(std::move(a));
+            args.push_back(std::move(b));
+            return Make(op, std::move(args));
+        }
+
+        Ptr ParseSum()
+        {
+            if (++nesting > maxNesting)
+            {
+                return Fail("nested too deeply");
+            }
+            auto left = ParseProduct();
+            while (left)
+            {
+                if (Accept('+'))
+                    left = Combine(Op::Add, std::move(left), ParseProduct());
+                else if (Accept('-'))
+                    left = Combine(Op::Subtract, std::move(left), ParseProduct());
+                else
+                    break;
+            }
+            --nesting;
+            return left;
+        }
+
+        Ptr ParseProduct()
+        {
+            auto left = ParseUnary();
+            while (left)
+            {
+                if (Accept('*'))
+                    left = Combine(Op::Multiply, std::move(left), ParseUnary());
+                else if (Accept('/'))
+                    left = Combine(Op::Divide, std::move(left), ParseUnary());
+                else
+                    break;
+            }
+            return left;
+        }
+
+        // a run of signs is counted rather than recursed into, so that any number of them parses
+        Ptr ParseUnary()
+        {
+            auto negate = false;
+            while (true)
+            {
+                if (Accept('-'))
+                    negate = !negate;
+                else if (!Accept('+'))
+                    break;
+            }
+            auto operand = ParsePower();
+            if (!operand || !negate)
+            {
+                return operand;
+            }
+            std::vector<Ptr> args;
+            args.push_back(std::move(operand));
+            return Make(Op::Negate, std::move(args));
+        }
+
+        // right associative, binding tighter than unary minus on its left
+        Ptr ParsePower()
+        {
+            auto base = ParsePrimary();
+            if (base && Accept('^'))
+            {
+                if (++nesting > maxNesting)
+                {
+                    return Fail("nested too deeply");
+                }
+                auto exponent = ParseUnary();
+                --nesting;
+                return Combine(Op::Power, std::move(base), std::move(exponent));
+            }
+            return base;
+        }
+
+        Ptr Combine(Op op, Ptr a, Ptr b)
+        {
+            return b ? Binary(op, std::move(a), std::move(b)) : nullptr;
+        }
+
+        Ptr ParsePrimary()
+        {
+            SkipSpace();
+            if (pos >= source.size())
+            {
+                return Fail("unexpected end");
+            }
+
+            const auto c = source[pos];
+            if (c.isDigit() || c == '.')
+            {
+                return ParseNumber();
+            }
+            if (Accept('('))
+            {
+                auto node = ParseSum();
+                if (node && !Accept(')'))
+                {
+                    return Fail("expected ')'");
+                }
+                return node;
+            }
+            if (Accept('['))
+            {
+                const auto end = source.indexOf(']', pos);
+                if (end < 0)
+                {
+                    return Fail("expected ']'");
+                }
+                const auto text = source.mid(pos, end - pos);
+                pos = end + 1;
+                return Reference(byText, text);
+            }
+            if (c.isLetter() || c == '_')
+            {
+                const auto start = pos;
+                while (pos < source.size() && (source[pos].isLetterOrNumber() || source[pos] == '_'))
+                {
+                    ++pos;
+                }
+                const auto name = source.mid(start, pos - start);
+                if (Accept('('))
+                {
+                    return ParseCall(name);
+                }
+                return Reference(byName, name);
+            }
+            return Fail(QString("unexpected '%1'").arg(QString(c)));
+        }
+
+        Ptr ParseNumber()
+        {
+            const auto start = pos;
+            while (pos < source.size() && (source[pos].isDigit() || source[pos] == '.'))
+            {
+                ++pos;
+            }
+            if (pos < source.size() && (source[pos] == 'e' || source[pos] == 'E'))
+            {
+                ++pos;
+                if (pos < source.size() && (source[pos] == '+' || source[pos] == '-'))
+                {
+                    ++pos;
+                }
+                while (pos < source.size() && source[pos].isDigit())
+                {
+                    ++pos;
+                }
+            }
+
+            auto ok = false;
+            auto node = std::make_unique<Node>();
+            node->value = source.mid(start, pos - start).toDouble(&ok);
+            return ok ? std::move(node) : Fail("malformed number");
+        }
+
+        Ptr ParseCall(const QString& name)
+        {
+            struct Function
+            {
+                const char* name;
+                Op op;
+                int arity; // -1 for one or more
+            };
+            static constexpr Function functions[] = {
+                {"min", Op::Min, -1}, {"max", Op::Max, -1}, {"abs", Op::Abs, 1}, {"sqrt", Op::Sqrt, 1},
+                {"exp", Op::Exp, 1}, {"log", Op::Log, 1}, {"pow", Op::Power, 2}
+            };
+            const auto* f = std::find_if(std::begin(functions), std::end(functions),
+                [&name](const Function& f) { return name == f.name; });
+            if (f == std::end(functions))
+            {
+                return Fail(QString("unknown function '%1'").arg(name));
+            }
+
+            std::vector<Ptr> args;
+            if (!Accept(')'))
+            {
+                do
+                {
+                    auto arg = ParseSum();
+                    if (!arg)
+                    {
+                        return nullptr;
+                    }
+                    args.push_back(std::move(arg));
+                } while (Accept(','));
+                if (!Accept(')'))
+                {
+                    return Fail("expected ')'");
+                }
+            }
+            if (args.empty() || (f->arity > 0 && static_cast<int>(args.size()) != f->arity))
+            {
+                return Fail(QString("wrong number of arguments to %1").arg(name));
+            }
+            if (f->op == Op::Min || f->op == Op::Max)
+            {
+                // folded pairwise, as emitted
+                auto left = std::move(args[0]);
+                for (size_t i = 1; i < args.size(); ++i)
+                {
+                    left = Binary(f->op, std::move(left), std::move(args[i]));
+                }
+                return left;
+            }
+            return Make(f->op, std::move(args));
+        }
+
+        Ptr Reference(const QHash<QString, int>& map, const QString& name)
+        {
+            const auto input = map.value(name, unknown);
+            if (input == unknown)
+            {
+                return Fail(QString("unknown name '%1'").arg(name));
+            }
+            if (input == ambiguous)
+            {
+                return Fail(QString("ambiguous name '%1'").arg(name));
+            }
+            auto node = std::make_unique<Node>();
+            node->op = Op::Input;
+            node->input = input;
+            return node;
+        }
+
+        const QString& source;
+        qsizetype pos = 0;
+        int nesting = 0;
+        QString failure;
+        QHash<QString, int> byName;
+        QHash<QString, int> byText;
+    };
+
+    double Expression::Apply(Op op, double a, double b)
+    {
+        switch (op)
+        {
+        case Op::Add: return a + b;
+        case Op::Subtract: return a - b;
+        case Op::Multiply: return a * b;
+        case Op::Divide: return a / b;
+        case Op::Power: return std::pow(a, b);
+        case Op::Negate: return -a;
+        case Op::Min: return std::min(a, b);
+        case Op::Max: return std::max(a, b);
+        case Op::Abs: return std::abs(a);
+        case Op::Sqrt: return std::sqrt(a);
+        case Op::Exp: return std::exp(a);
+        case Op::Log: return std::log(a);
+        default: return a;
+        }
+    }
+
+    std::shared_ptr<const Expression> Expression::Compile(const QString& source, const std::vector<QString>& names,
+        QString& error)
+    {
+        if (names.size() > maxOperands)
+        {
+            error = QString("more than %1 inputs").arg(maxOperands);
+            return nullptr;
+        }
+        Parser parser(source, names);
+        const auto root = parser.Parse(error);
+        if (!root)
+        {
+            return nullptr;
+        }
+
+        auto expression = std::make_shared<Expression>();
+        expression->inputCount = names.size();
+        expression->Emit(*root, 0);
+        if (expression->constants.size() > maxOperands)
+        {
+            error = QString("more than %1 constants").arg(maxOperands);
+            return nullptr;
+        }
+        return expression;
+    }
+
+    // Leaves the value of node in register target, using the registers above it
+    // as temporaries. Walks the tree with a stack of its own, as a sum of many
+    // terms is a chain as long as their number.
+    quint16 Expression::Emit(const Node& root, quint16 target)
+    {
+        struct Pending
+        {
+            const Node* node;
+            quint16 target;
+            bool operandsEmitted;
+        };
+
+        std::vector<Pending> pending{{&root, target, false}};
+        while (!pending.empty())
+        {
+            const auto [node, t, operandsEmitted] = pending.back();
+            pending.pop_back();
+            registers = std::max<quint16>(registers, t + 1);
+            switch (node->op)
+            {
+            case Op::Constant:
+                code.push_back({Op::Constant, t, static_cast<quint16>(constants.size()), 0});
+                constants.push_back(node->value);
+                break;
+            case Op::Input:
+                code.push_back({Op::Input, t, static_cast<quint16>(node->input), 0});
+                break;
+            default:
+                if (operandsEmitted)
+                {
+                    const auto second = (node->args.size() > 1) ? t + 1 : t;
+                    code.push_back({node->op, t, t, static_cast<quint16>(second)});
+                    break;
+                }
+                // the first operand is emitted first, the operation last
+                pending.push_back({node, t, true});
+                if (node->args.size() > 1)
+                {
+                    pending.push_back({node->args[1].get(), static_cast<quint16>(t + 1), false});
+                }
+                pending.push_back({node->args[0].get(), t, false});
+            }
+        }
+        return target;
+    }
+
+    void Expression::Evaluate(const double* const* inputs, size_t count, double* out) const
+    {
+        std::vector<double> r(size_t(registers) * batchSize);
+        for (size_t start = 0; start < count; start += batchSize)
+        {
+            const auto n = std::min(batchSize, count - start);
+            for (const auto& i : code)
+            {
+                auto* t = &r[i.target * batchSize];
+                switch (i.op)
+                {
+                case Op::Constant:
+                    std::fill_n(t, n, constants[i.a]);
+                    continue;
+                case Op::Input:
+                    std::copy_n(inputs[i.a] + start, n, t);
+                    continue;
+                default:
+                    break;
+                }
+
+                const auto* a = &r[i.a * batchSize];
+                const auto* b = &r[i.b * batchSize];
+                switch (i.op)
+                {
+                case Op::Add:
+                    for (size_t k = 0; k < n; ++k) t[k] = a[k] + b[k];
+                    break;
+                case Op::Subtract:
+                    for (size_t k = 0; k < n; ++k) t[k] = a[k] - b[k];
+                    break;
+                case Op::Multiply:
+                    for (size_t k = 0; k < n; ++k) t[k] = a[k] * b[k];
+                    break;
+                case Op::Divide:
+                    for (size_t k = 0; k < n; ++k) t[k] = a[k] / b[k];
+                    break;
+                case Op::Power:
+                    for (size_t k = 0; k < n; ++k) t[k] = std::pow(a[k], b[k]);
+                    break;
+                case Op::Negate:
+                    for (size_t k = 0; k < n; ++k) t[k] = -a[k];
+                    break;
+                case Op::Min:
+                    for (size_t k = 0; k < n; ++k) t[k] = std::min(a[k], b[k]);
+                    break;
+                case Op::Max:
+                    for (size_t k = 0; k < n; ++k) t[k] = std::max(a[k], b[k]);
+                    break;
+                case Op::Abs:
+                    for (size_t k = 0; k < n; ++k) t[k] = std::abs(a[k]);
+                    break;
+                case Op::Sqrt:
+                    for (size_t k = 0; k < n; ++k) t[k] = std::sqrt(a[k]);
+                    break;
+                case Op::Exp:
+                    for (size_t k = 0; k < n; ++k) t[k] = std::exp(a[k]);
+                    break;
+                case Op::Log:
+                    for (size_t k = 0; k < n; ++k) t[k] = std::log(a[k]);
+                    break;
+                default:
+                    break;
+                }
+            }
+            std::copy_n(r.data(), n, out + start);
+        }
+    }
+
+    double Expression::Evaluate(const double* inputs) const
+    {
+        std::vector<const double*> pointers(inputCount);
+        for (size_t i = 0; i < inputCount; ++i)
+        {
+            pointers[i] = inputs + i;
+        }
+        auto out = 0.0;
+        Evaluate(pointers.data(), 1, &out);
+        return out;
+    }
+
+    size_t Expression::GetInstructionCount() const
+    {
+        return code.size();
+    }
+
+    QString ExpressionName(const QString& text)
+    {
+        QString name;
+        name.reserve(text.size());
+        auto separator = false;
+        for (const auto c : text)
+        {
+            if (c.isLetterOrNumber())
+            {
+                if (separator && !name.isEmpty())
+                {
+                    name.append('_');
+                }
+                name.append(c.toLower());
+                separator = false;
+            }
+            else
+            {
+                separator = true;
+            }
+        }
+        return name;
+    }
+}
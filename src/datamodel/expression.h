@@ -0,0 +1,95 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+namespace CtqTool
+{
+    // An arithmetic expression over named inputs, such as
+    //   0.4 * ctq_a + max(ctq_b, ctq_c)
+    // with + - * / ^, unary minus, parentheses and the functions min, max,
+    // abs, sqrt, exp, log and pow. A name refers to the input whose text,
+    // lower case with every run of other characters than letters and digits
+    // replaced by an underscore, matches it; [text] refers to a text as is.
+    //
+    // The source is parsed once into a syntax tree, which is folded and
+    // compiled into instructions on registers. Each register holds a batch
+    // of values, so that evaluating runs one tight loop per instruction.
+    class Expression
+    {
+    public:
+        static constexpr size_t batchSize = 256;
+
+        // null, with a description in error, if the source does not compile
+        static std::shared_ptr<const Expression> Compile(const QString& source, const std::vector<QString>& names,
+            QString& error);
+
+        // inputs[i] holds count values for the i-th name
+        void Evaluate(const double* const* inputs, size_t count, double* out) const;
+        // inputs[i] is the value for the i-th name
+        double Evaluate(const double* inputs) const;
+
+        size_t GetInstructionCount() const;
+
+    private:
+        enum class Op : quint8
+        {
+            Constant,
+            Input,
+            Add,
+            Subtract,
+            Multiply,
+            Divide,
+            Power,
+            Negate,
+            Min,
+            Max,
+            Abs,
+            Sqrt,
+            Exp,
+            Log
+        };
+
+        struct Instruction
+        {
+            Op op;
+            quint16 target;
+            quint16 a;  // a register, an input or a constant
+            quint16 b;
+        };
+
+        struct Node;
+        class Parser;
+
+        static double Apply(Op, double a, double b);
+        quint16 Emit(const Node&, quint16 target);
+
+        std::vector<Instruction> code;
+        std::vector<double> constants;
+        size_t inputCount = 0;
+        quint16 registers = 0;
+    };
+
+    // the form of a text a name in an expression refers to it by
+    QString ExpressionName(const QString& text);
+}
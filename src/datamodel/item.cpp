@@ -17,6 +17,10 @@
 */
 
 #include "item.h"
+#include "ctq.h"
+
+#include <algorithm>
+#include <atomic>
 
 namespace CtqTool
 {
@@ -24,10 +28,25 @@ namespace CtqTool
         text(text),
         note(note)
     {
-        static auto counter = 0u;
+        static std::atomic<size_t> counter{0};
         id = counter++;
     }
 
+    std::shared_ptr<ItemData> ItemData::Clone() const
+    {
+        return std::make_shared<ItemData>(text, note);
+    }
+
+    std::shared_ptr<ItemData> MakeItemData(int depth, QString text, QString note)
+    {
+        constexpr auto ctqDepth = 3;
+        if (depth == ctqDepth)
+        {
+            return std::make_shared<Ctq>(std::move(text), std::move(note));
+        }
+        return std::make_shared<ItemData>(std::move(text), std::move(note));
+    }
+
     void ItemData::SetText(QString t)
     {
         text = t;
@@ -48,18 +67,57 @@ namespace CtqTool
        return note;
     }
 
+    const std::vector<TreeItem*>& ItemData::GetOwners() const
+    {
+        return owners;
+    }
+
     TreeItem::TreeItem(std::shared_ptr<ItemData> data, TreeItem* parent) :
         data(std::move(data)), 
         parentItem(parent)
     {
+        Own();
+    }
+
+    TreeItem::~TreeItem()
+    {
+        Disown();
+    }
+
+    void TreeItem::Own()
+    {
+        if (data != nullptr)
+        {
+            data->owners.push_back(this);
+            // the stack-ups of the first item took the data to show there alone
+            if (data->owners.size() == 2)
+            {
+                data->owners.front()->InvalidateStackUp();
+            }
+        }
+    }
+
+    void TreeItem::Disown()
+    {
+        if (data != nullptr)
+        {
+            auto& owners = data->owners;
+            const auto it = std::find(owners.begin(), owners.end(), this);
+            if (it != owners.end())
+            {
+                *it = owners.back();
+                owners.pop_back();
+            }
+        }
     }
 
     void TreeItem::Append(std::shared_ptr<TreeItem> item)
     {
         children.push_back(std::move(item));
+        InvalidateTransfer();
     }
 
-    const std::shared_ptr<TreeItem>& TreeItem::GetChild(int row)
+    const std::shared_ptr<TreeItem>& TreeItem::GetChild(int row) const
     {
         if (row < 0 || row >= children.size())
         {
@@ -75,7 +133,7 @@ namespace CtqTool
     
     int TreeItem::ColumnCount() const
     {
-        constexpr auto count = 3;
+        constexpr auto count = 4;
         return count;
     }
     
@@ -92,6 +150,8 @@ namespace CtqTool
             return data->GetNote();
         else if (column == 2)
             return rank;
+        else if (column == 3)
+            return transfer;
         else
             return QVariant();
     }
@@ -113,13 +173,23 @@ namespace CtqTool
             const auto it = std::find_if(parentItem->children.cbegin(), parentItem->children.cend(), 
             [this](const auto& item) 
             {
-                return item->Data(0) == this->Data(0);
+                return item.get() == this;
             });
             return std::distance(parentItem->children.cbegin(), it);
         }
         return 0;
     }
 
+    int TreeItem::Depth() const
+    {
+        auto depth = 0;
+        for (const auto* p = parentItem; p != nullptr; p = p->parentItem)
+        {
+            ++depth;
+        }
+        return depth;
+    }
+
     void TreeItem::SetData(int col, const QVariant& d)
     {
         if (data != nullptr)
@@ -127,6 +197,7 @@ namespace CtqTool
             if (col == 0)
             {
                 data->SetText(d.toString());
+                InvalidateParentTransfers();
             }
             else if (col == 1)
             {
@@ -136,6 +207,10 @@ namespace CtqTool
             {
                 rank = d.toInt();
             }
+            else if (col == 3)
+            {
+                SetTransfer(d.toString());
+            }
         }
     }
 
@@ -146,9 +221,10 @@ namespace CtqTool
 
         for (int row = 0; row < count; ++row) 
         {
-            auto item = std::make_shared<TreeItem>(std::make_shared<ItemData>("[not set]", "[not set]"), this);
+            auto item = std::make_shared<TreeItem>(MakeItemData(Depth() + 1, "[not set]", "[not set]"), this);
             children.insert(children.begin() + position, item);
         }
+        InvalidateTransfer();
 
         return true;
     }
@@ -160,13 +236,26 @@ namespace CtqTool
 
         for (int row = 0; row < count; ++row)
             children.erase(children.begin() + position);
+        InvalidateTransfer();
 
         return true;
     }
 
     void TreeItem::CloneDataFrom(const TreeItem& item)
     {
+        Disown();
+        if (parentItem != nullptr)
+        {
+            parentItem->InvalidateTransfer();
+        }
+        InvalidateStackUp();
         data = item.data;
+        Own();
+    }
+
+    const std::shared_ptr<ItemData>& TreeItem::GetData() const
+    {
+        return data;
     }
 
     void TreeItem::PropagateRank()
@@ -188,4 +277,124 @@ namespace CtqTool
     {
         return rank;
     }
+
+    const RollUp& TreeItem::GetRollUp() const
+    {
+        return rollUp;
+    }
+
+    void TreeItem::SetRollUp(const RollUp& r)
+    {
+        rollUp = r;
+    }
+
+    double TreeItem::GetWeight() const
+    {
+        return weight;
+    }
+
+    void TreeItem::SetWeight(double w)
+    {
+        weight = w;
+        InvalidateStackUp();
+    }
+
+    const QString& TreeItem::GetTransfer() const
+    {
+        return transfer;
+    }
+
+    void TreeItem::SetTransfer(QString t)
+    {
+        transfer = std::move(t);
+        InvalidateTransfer();
+    }
+
+    std::shared_ptr<const Expression> TreeItem::GetCompiledTransfer() const
+    {
+        if (!transferCompiled)
+        {
+            compiledTransfer.reset();
+            transferError.clear();
+            if (!transfer.trimmed().isEmpty())
+            {
+                std::vector<QString> names;
+                names.reserve(children.size());
+                for (const auto& child : children)
+                {
+                    names.push_back(child->data->GetText());
+                }
+                compiledTransfer = Expression::Compile(transfer, names, transferError);
+            }
+            transferCompiled = true;
+        }
+        return compiledTransfer;
+    }
+
+    QString TreeItem::GetTransferError() const
+    {
+        GetCompiledTransfer();
+        return transferError;
+    }
+
+    void TreeItem::InvalidateTransfer()
+    {
+        transferCompiled = false;
+        InvalidateStackUp();
+    }
+
+    void TreeItem::TargetChanged()
+    {
+        for (auto* owner : data->owners)
+        {
+            owner->InvalidateStackUp();
+        }
+    }
+
+    void TreeItem::InvalidateStackUp()
+    {
+        stackUpValid = false;
+        // an invalid item's ancestors are invalid already
+        for (auto* p = parentItem; p != nullptr && p->stackUpValid; p = p->parentItem)
+        {
+            p->stackUpValid = false;
+        }
+    }
+
+    void TreeItem::InvalidateParentTransfers()
+    {
+        for (auto* owner : data->owners)
+        {
+            if (owner->parentItem != nullptr)
+            {
+                owner->parentItem->InvalidateTransfer();
+            }
+        }
+    }
+
+    const SimulationResult& TreeItem::GetSimulation() const
+    {
+        return simulation;
+    }
+
+    void TreeItem::SetSimulation(const SimulationResult& s)
+    {
+        simulation = s;
+    }
+
+    const StackUp& TreeItem::GetStackUp() const
+    {
+        return stackUp;
+    }
+
+    void TreeItem::SetStackUp(const StackUp& s)
+    {
+        stackUp = s;
+        stackUpValid = true;
+    }
+
+    bool TreeItem::IsStackUpValid() const
+    {
+        return stackUpValid;
+    }
 }
@@ -18,6 +18,11 @@
 
 #pragma once
 
+#include "expression.h"
+#include "montecarlo.h"
+#include "rollup.h"
+#include "stackup.h"
+
 #include <QString>
 #include <QVariant>
 
@@ -26,10 +31,16 @@
 
 namespace CtqTool
 {
+    class TreeItem;
+
     class ItemData
     {
     public:
         ItemData(QString, QString);
+        virtual ~ItemData() = default;
+
+        // a copy that is not shared with this item, down to a CTQ's samples
+        virtual std::shared_ptr<ItemData> Clone() const;
         
         void SetText(QString);
         QString GetText() const;
@@ -37,27 +48,41 @@ namespace CtqTool
         void SetNote(QString);
         QString GetNote() const;
 
+        // the items showing this data, more than one if it is shared
+        const std::vector<TreeItem*>& GetOwners() const;
+
     private:
+        friend class TreeItem;
+
+        std::vector<TreeItem*> owners;
         size_t id = 0;
         QString text;
         QString note;
     };
+
+    // the data for an item at the given depth, i.e. a Ctq at depth 3
+    std::shared_ptr<ItemData> MakeItemData(int depth, QString text, QString note);
     
     class TreeItem
     {
     public:
         explicit TreeItem(std::shared_ptr<ItemData> data, TreeItem* parentItem = nullptr);
+        ~TreeItem();
+        TreeItem(const TreeItem&) = delete;
+        TreeItem& operator=(const TreeItem&) = delete;
 
         void Append(std::shared_ptr<TreeItem> child);
         bool InsertChildren(int position, int count, int columns);
         bool RemoveChildren(int position, int count);
-        const std::shared_ptr<TreeItem>& GetChild(int row);
+        const std::shared_ptr<TreeItem>& GetChild(int row) const;
         int ChildCount() const;
         int ColumnCount() const;
         QVariant Data(int column) const;
         void SetData(int column, const QVariant&);
         void CloneDataFrom(const TreeItem&);
+        const std::shared_ptr<ItemData>& GetData() const;
         int Row() const;
+        int Depth() const;
 
         TreeItem const* GetParent() const;
         TreeItem* GetParent();
@@ -66,10 +91,55 @@ namespace CtqTool
         void SetRank(unsigned short);
         unsigned short GetRank() const;
 
+        // the aggregate of this item and its subtree, as maintained by the model
+        const RollUp& GetRollUp() const;
+        void SetRollUp(const RollUp&);
+
+        // how much of this item's value is passed on to its parent
+        double GetWeight() const;
+        void SetWeight(double);
+
+        // an expression of the children's values by name, used instead of their weighted sum
+        const QString& GetTransfer() const;
+        void SetTransfer(QString);
+
+        // compiled on first use after the transfer, the children or their texts
+        // changed; null without a transfer or when it does not compile
+        std::shared_ptr<const Expression> GetCompiledTransfer() const;
+        QString GetTransferError() const;
+
+        // as last simulated by the model
+        const SimulationResult& GetSimulation() const;
+        void SetSimulation(const SimulationResult&);
+
+        // as last computed by the model; invalid once anything in the subtree
+        // changed, and then so are the stack-ups of all the ancestors
+        const StackUp& GetStackUp() const;
+        void SetStackUp(const StackUp&);
+        bool IsStackUpValid() const;
+        // after the target of a CTQ changed, for every item showing it
+        void TargetChanged();
+
     private:
+        void Own();
+        void Disown();
+        void InvalidateTransfer();
+        void InvalidateStackUp();
+        // the parents of every item showing this item's data
+        void InvalidateParentTransfers();
+
         std::vector<std::shared_ptr<TreeItem>> children;
         std::shared_ptr<ItemData> data = nullptr;
         TreeItem* parentItem = nullptr;
         unsigned short rank = 0;
+        double weight = 1.0;
+        QString transfer;
+        mutable std::shared_ptr<const Expression> compiledTransfer;
+        mutable QString transferError;
+        mutable bool transferCompiled = true;
+        RollUp rollUp;
+        SimulationResult simulation;
+        StackUp stackUp;
+        bool stackUpValid = false;
     };
 }
@@ -0,0 +1,205 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "journal.h"
+#include "ctq.h"
+#include "item.h"
+#include "textformat.h"
+
+#include <QList>
+
+#include <algorithm>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto rankColumn = 2;
+
+    void appendPath(QByteArray& out, const std::vector<int>& path)
+    {
+        if (path.empty())
+        {
+            out.append('-');
+            return;
+        }
+        for (size_t i = 0; i < path.size(); ++i)
+        {
+            if (i > 0)
+            {
+                out.append(',');
+            }
+            out.append(QByteArray::number(path[i]));
+        }
+    }
+
+    bool parsePath(const QByteArray& field, std::vector<int>& path)
+    {
+        path.clear();
+        if (field == "-")
+        {
+            return true;
+        }
+        for (const auto& row : field.split(','))
+        {
+            auto ok = false;
+            path.push_back(row.toInt(&ok));
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    TreeItem* resolve(TreeItem& root, const std::vector<int>& path)
+    {
+        auto* item = &root;
+        for (const auto row : path)
+        {
+            if (row < 0 || row >= item->ChildCount())
+            {
+                return nullptr;
+            }
+            item = item->GetChild(row).get();
+        }
+        return item;
+    }
+}
+
+namespace CtqTool
+{
+    std::vector<int> PathOf(const TreeItem& item)
+    {
+        std::vector<int> path;
+        for (const auto* i = &item; i->GetParent() != nullptr; i = i->GetParent())
+        {
+            path.push_back(i->Row());
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    void AppendTo(QByteArray& out, const JournalRecord& record)
+    {
+        out.append(static_cast<char>(record.operation));
+        out.append('\t');
+        appendPath(out, record.path);
+        out.append('\t');
+        switch (record.operation)
+        {
+        case JournalRecord::Operation::SetData:
+            out.append(QByteArray::number(record.column));
+            out.append('\t');
+            AppendEscaped(out, record.value);
+            break;
+        case JournalRecord::Operation::SetTarget:
+            AppendEscaped(out, record.value);
+            break;
+        case JournalRecord::Operation::Insert:
+        case JournalRecord::Operation::Remove:
+            out.append(QByteArray::number(record.column));
+            out.append('\t');
+            out.append(QByteArray::number(record.count));
+            break;
+        case JournalRecord::Operation::Link:
+            appendPath(out, record.source);
+            break;
+        }
+        out.append('\n');
+    }
+
+    bool Parse(const QByteArray& line, JournalRecord& record)
+    {
+        const auto fields = line.split('\t');
+        if (fields.size() < 3 || fields[0].size() != 1 || !parsePath(fields[1], record.path))
+        {
+            return false;
+        }
+
+        auto ok = true;
+        record.operation = static_cast<JournalRecord::Operation>(fields[0][0]);
+        switch (record.operation)
+        {
+        case JournalRecord::Operation::SetData:
+            record.column = fields[2].toInt(&ok);
+            record.value = (fields.size() > 3) ? Unescape(QString::fromUtf8(fields[3])) : QString();
+            return ok;
+        case JournalRecord::Operation::Insert:
+        case JournalRecord::Operation::Remove:
+            if (fields.size() < 4)
+            {
+                return false;
+            }
+            record.column = fields[2].toInt(&ok);
+            record.count = ok ? fields[3].toInt(&ok) : 0;
+            return ok;
+        case JournalRecord::Operation::Link:
+            return parsePath(fields[2], record.source);
+        case JournalRecord::Operation::SetTarget:
+            record.value = Unescape(QString::fromUtf8(fields[2]));
+            return true;
+        }
+        return false;
+    }
+
+    bool Apply(const JournalRecord& record, TreeItem& root)
+    {
+        auto* item = resolve(root, record.path);
+        if (item == nullptr)
+        {
+            return false;
+        }
+
+        switch (record.operation)
+        {
+        case JournalRecord::Operation::SetData:
+            item->SetData(record.column, record.value);
+            if (record.column == rankColumn)
+            {
+                item->PropagateRank();
+            }
+            return true;
+        case JournalRecord::Operation::Insert:
+            return item->InsertChildren(record.column, record.count, root.ColumnCount());
+        case JournalRecord::Operation::Remove:
+            return item->RemoveChildren(record.column, record.count);
+        case JournalRecord::Operation::Link:
+            if (const auto* source = resolve(root, record.source); source != nullptr)
+            {
+                item->CloneDataFrom(*source);
+                return true;
+            }
+            return false;
+        case JournalRecord::Operation::SetTarget:
+            if (auto* ctq = dynamic_cast<Ctq*>(item->GetData().get()); ctq != nullptr)
+            {
+                ItemLine line;
+                for (const auto& column : record.value.split('\t', Qt::SkipEmptyParts))
+                {
+                    ParseTargetColumn(column, line);
+                }
+                SetTarget(ctq->GetMeasurement().GetTarget(), line);
+                item->TargetChanged();
+                return true;
+            }
+            return false;
+        }
+        return false;
+    }
+}
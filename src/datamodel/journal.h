@@ -0,0 +1,57 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <vector>
+
+namespace CtqTool
+{
+    class TreeItem;
+
+    // a single model edit; items are addressed by their rows from the root down
+    struct JournalRecord
+    {
+        enum class Operation : char
+        {
+            SetData = 'S',
+            Insert = 'I',
+            Remove = 'R',
+            Link = 'L',
+            SetTarget = 'T'
+        };
+
+        Operation operation = Operation::SetData;
+        std::vector<int> path;      // the edited item, or the parent for Insert and Remove
+        int column = 0;             // SetData column, or the first row for Insert and Remove
+        int count = 0;              // number of rows for Insert and Remove
+        QString value;              // SetData value, or the target columns of the text format for SetTarget
+        std::vector<int> source;    // Link: the item whose data becomes shared
+    };
+
+    std::vector<int> PathOf(const TreeItem&);
+
+    void AppendTo(QByteArray&, const JournalRecord&);
+    bool Parse(const QByteArray& line, JournalRecord&);
+
+    // replays the edit on a tree; returns false if the record does not fit the tree
+    bool Apply(const JournalRecord&, TreeItem& root);
+}
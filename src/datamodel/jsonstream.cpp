@@ -0,0 +1,891 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "jsonstream.h"
+#include "ctq.h"
+#include "item.h"
+
+#include <QIODevice>
+
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr qint64 chunkSize = 64 << 10;
+    constexpr auto flushSize = 1 << 20;
+    constexpr size_t maxNesting = 512;
+
+    // A pull parser; Next() returns one token at a time. Names, strings and
+    // numbers are left in Value(), strings with their escapes resolved.
+    class JsonReader
+    {
+    public:
+        enum class Token
+        {
+            BeginObject,
+            EndObject,
+            BeginArray,
+            EndArray,
+            Name,
+            String,
+            Number,
+            True,
+            False,
+            Null,
+            End,
+            Error
+        };
+
+        explicit JsonReader(QIODevice& d) :
+            device(d)
+        {
+        }
+
+        Token Next()
+        {
+            if (!error.isEmpty())
+            {
+                return Token::Error;
+            }
+
+            SkipWhitespace();
+            auto c = Peek();
+            if (stack.empty())
+            {
+                if (afterValue)
+                {
+                    return (c < 0) ? Token::End : Fail("unexpected data after the document");
+                }
+            }
+            else
+            {
+                const auto inObject = stack.back() == '{';
+                if (c == (inObject ? '}' : ']') && !afterName && (afterValue || first))
+                {
+                    Get();
+                    stack.pop_back();
+                    afterValue = true;
+                    first = false;
+                    return inObject ? Token::EndObject : Token::EndArray;
+                }
+                if (afterValue)
+                {
+                    if (c != ',')
+                    {
+                        return Fail(inObject ? "expected ',' or '}'" : "expected ',' or ']'");
+                    }
+                    Get();
+                    SkipWhitespace();
+                    c = Peek();
+                    afterValue = false;
+                }
+                first = false;
+
+                if (inObject && !afterName)
+                {
+                    if (c != '"' || !ReadString())
+                    {
+                        return Fail("expected a member name");
+                    }
+                    SkipWhitespace();
+                    if (Get() != ':')
+                    {
+                        return Fail("expected ':'");
+                    }
+                    afterName = true;
+                    return Token::Name;
+                }
+            }
+
+            afterName = false;
+            switch (c)
+            {
+            case '{':
+            case '[':
+                if (stack.size() == maxNesting)
+                {
+                    return Fail("nesting too deep");
+                }
+                Get();
+                stack.push_back(static_cast<char>(c));
+                first = true;
+                afterValue = false;
+                return (c == '{') ? Token::BeginObject : Token::BeginArray;
+            case '"':
+                if (!ReadString())
+                {
+                    return Token::Error;
+                }
+                afterValue = true;
+                return Token::String;
+            case 't':
+                return ReadLiteral("true", Token::True);
+            case 'f':
+                return ReadLiteral("false", Token::False);
+            case 'n':
+                return ReadLiteral("null", Token::Null);
+            case -1:
+                return Fail("unexpected end of document");
+            default:
+                if (c == '-' || (c >= '0' && c <= '9'))
+                {
+                    value.clear();
+                    while ((c = Peek()) == '-' || c == '+' || c == '.' || c == 'e' || c == 'E' || (c >= '0' && c <= '9'))
+                    {
+                        value.append(static_cast<char>(Get()));
+                    }
+                    afterValue = true;
+                    return Token::Number;
+                }
+                return Fail("unexpected character");
+            }
+        }
+
+        // skips the value that follows, including everything nested in it
+        bool Skip()
+        {
+            auto depth = 0;
+            do
+            {
+                switch (Next())
+                {
+                case Token::BeginObject:
+                case Token::BeginArray:
+                    ++depth;
+                    break;
+                case Token::EndObject:
+                case Token::EndArray:
+                    --depth;
+                    break;
+                case Token::Error:
+                case Token::End:
+                    return false;
+                default:
+                    break;
+                }
+            } while (depth > 0);
+            return true;
+        }
+
+        const QByteArray& Value() const
+        {
+            return value;
+        }
+
+        QString ErrorString() const
+        {
+            return QStringLiteral("%1 at byte %2").arg(error).arg(consumed + pos);
+        }
+
+        Token Fail(const QString& message)
+        {
+            if (error.isEmpty())
+            {
+                error = message;
+            }
+            return Token::Error;
+        }
+
+    private:
+        int Peek()
+        {
+            if (pos == buffer.size())
+            {
+                consumed += buffer.size();
+                buffer = device.read(chunkSize);
+                pos = 0;
+                if (buffer.isEmpty())
+                {
+                    return -1;
+                }
+            }
+            return static_cast<unsigned char>(buffer[pos]);
+        }
+
+        int Get()
+        {
+            const auto c = Peek();
+            if (c >= 0)
+            {
+                ++pos;
+            }
+            return c;
+        }
+
+        void SkipWhitespace()
+        {
+            for (auto c = Peek(); c == ' ' || c == '\t' || c == '\n' || c == '\r'; c = Peek())
+            {
+                ++pos;
+            }
+        }
+
+        Token ReadLiteral(const char* literal, Token token)
+        {
+            for (const auto* l = literal; *l != '\0'; ++l)
+            {
+                if (Get() != *l)
+                {
+                    return Fail("invalid literal");
+                }
+            }
+            afterValue = true;
+            return token;
+        }
+
+        bool ReadHex(unsigned& code)
+        {
+            code = 0;
+            for (auto i = 0; i < 4; ++i)
+            {
+                const auto c = Get();
+                code <<= 4;
+                if (c >= '0' && c <= '9')
+                    code |= c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    code |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    code |= c - 'A' + 10;
+                else
+                    return false;
+            }
+            return true;
+        }
+
+        void AppendUtf8(unsigned code)
+        {
+            if (code < 0x80)
+            {
+                value.append(static_cast<char>(code));
+            }
+            else if (code < 0x800)
+            {
+                value.append(static_cast<char>(0xc0 | (code >> 6)));
+                value.append(static_cast<char>(0x80 | (code & 0x3f)));
+            }
+            else if (code < 0x10000)
+            {
+                value.append(static_cast<char>(0xe0 | (code >> 12)));
+                value.append(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+                value.append(static_cast<char>(0x80 | (code & 0x3f)));
+            }
+            else
+            {
+                value.append(static_cast<char>(0xf0 | (code >> 18)));
+                value.append(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+                value.append(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+                value.append(static_cast<char>(0x80 | (code & 0x3f)));
+            }
+        }
+
+        bool ReadString()
+        {
+            Get(); // opening quote
+            value.clear();
+            for (;;)
+            {
+                if (Peek() < 0)
+                {
+                    Fail("unterminated string");
+                    return false;
+                }
+
+                // copy the run up to the next quote or escape in one go
+                auto end = pos;
+                while (end < buffer.size() && buffer[end] != '"' && buffer[end] != '\\')
+                {
+                    ++end;
+                }
+                value.append(buffer.constData() + pos, end - pos);
+                pos = end;
+                if (pos == buffer.size())
+                {
+                    continue;
+                }
+
+                if (Get() == '"')
+                {
+                    return true;
+                }
+
+                const auto c = Get();
+                unsigned code = 0;
+                switch (c)
+                {
+                case '"':
+                case '\\':
+                case '/':
+                    value.append(static_cast<char>(c));
+                    break;
+                case 'b':
+                    value.append('\b');
+                    break;
+                case 'f':
+                    value.append('\f');
+                    break;
+                case 'n':
+                    value.append('\n');
+                    break;
+                case 'r':
+                    value.append('\r');
+                    break;
+                case 't':
+                    value.append('\t');
+                    break;
+                case 'u':
+                    if (!ReadHex(code))
+                    {
+                        Fail("invalid unicode escape");
+                        return false;
+                    }
+                    if (code >= 0xd800 && code < 0xdc00)
+                    {
+                        unsigned low = 0;
+                        if (Get() != '\\' || Get() != 'u' || !ReadHex(low) || low < 0xdc00 || low >= 0xe000)
+                        {
+                            Fail("invalid surrogate pair");
+                            return false;
+                        }
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    AppendUtf8(code);
+                    break;
+                default:
+                    Fail("invalid escape");
+                    return false;
+                }
+            }
+        }
+
+        QIODevice& device;
+        QByteArray buffer;
+        qsizetype pos = 0;
+        qint64 consumed = 0;
+        QByteArray value;
+        QString error;
+        std::vector<char> stack;
+        bool first = false;
+        bool afterName = false;
+        bool afterValue = false;
+    };
+
+    using Token = JsonReader::Token;
+
+    class TreeBuilder
+    {
+    public:
+        explicit TreeBuilder(JsonReader& r) :
+            reader(r)
+        {
+        }
+
+        // reads the members of an object whose opening brace was just read
+        bool Read(TreeItem& item)
+        {
+            auto linked = false;
+            for (;;)
+            {
+                const auto token = reader.Next();
+                if (token == Token::EndObject)
+                {
+                    return true;
+                }
+                if (token != Token::Name)
+                {
+                    return false;
+                }
+
+                const auto& name = reader.Value();
+                if (name == "text" || name == "note")
+                {
+                    const auto isText = name == "text";
+                    if (reader.Next() != Token::String)
+                    {
+                        return Fail("expected a string");
+                    }
+                    if (!linked)
+                    {
+                        item.SetData(isText ? textColumn : noteColumn, QString::fromUtf8(reader.Value()));
+                    }
+                }
+                else if (name == "rank")
+                {
+                    auto ok = false;
+                    const auto rank = (reader.Next() == Token::Number) ? reader.Value().toUShort(&ok) : 0;
+                    if (!ok)
+                    {
+                        return Fail("expected a rank");
+                    }
+                    item.SetRank(rank);
+                }
+                else if (name == "weight")
+                {
+                    auto ok = false;
+                    const auto weight = (reader.Next() == Token::Number) ? reader.Value().toDouble(&ok) : 0.0;
+                    if (!ok)
+                    {
+                        return Fail("expected a weight");
+                    }
+                    item.SetWeight(weight);
+                }
+                else if (name == "transfer")
+                {
+                    if (reader.Next() != Token::String)
+                    {
+                        return Fail("expected a string");
+                    }
+                    item.SetTransfer(QString::fromUtf8(reader.Value()));
+                }
+                else if (name == "link")
+                {
+                    auto ok = false;
+                    const auto ordinal = (reader.Next() == Token::Number) ? reader.Value().toULongLong(&ok) : 0;
+                    if (!ok || ordinal >= items.size())
+                    {
+                        return Fail("expected the number of a preceding item");
+                    }
+                    item.CloneDataFrom(*items[ordinal]);
+                    linked = true;
+                }
+                else if (name == "measurement")
+                {
+                    auto* ctq = linked ? nullptr : dynamic_cast<Ctq*>(item.GetData().get());
+                    if (ctq == nullptr)
+                    {
+                        if (!reader.Skip())
+                        {
+                            return false;
+                        }
+                        continue;
+                    }
+                    if (reader.Next() != Token::BeginObject || !ReadMeasurement(ctq->GetMeasurement()))
+                    {
+                        return Fail("expected a measurement");
+                    }
+                    if (ctq->GetMeasurement().GetSamples().Size() > 0)
+                    {
+                        const auto& measurement = ctq->GetMeasurement();
+                        ctq->SetStatistics(ComputeStatistics(measurement.GetSamples(), measurement.GetTarget()));
+                        ctq->UpdateConformance();
+                    }
+                }
+                else if (name == "children")
+                {
+                    if (reader.Next() != Token::BeginArray)
+                    {
+                        return Fail("expected an array of children");
+                    }
+                    for (auto token = reader.Next(); token != Token::EndArray; token = reader.Next())
+                    {
+                        if (token != Token::BeginObject)
+                        {
+                            return Fail("expected an item");
+                        }
+                        auto child = std::make_shared<TreeItem>(MakeItemData(item.Depth() + 1, QString(), QString()), &item);
+                        items.push_back(child.get());
+                        item.Append(child);
+                        if (!Read(*child))
+                        {
+                            return false;
+                        }
+                    }
+                }
+                else if (!reader.Skip())
+                {
+                    return false;
+                }
+            }
+        }
+
+    private:
+        bool Fail(const QString& message)
+        {
+            reader.Fail(message);
+            return false;
+        }
+
+        bool ReadString(QString& s)
+        {
+            if (reader.Next() != Token::String)
+            {
+                return Fail("expected a string");
+            }
+            s = QString::fromUtf8(reader.Value());
+            return true;
+        }
+
+        bool ReadNumber(double& d)
+        {
+            auto ok = reader.Next() == Token::Number;
+            d = ok ? reader.Value().toDouble(&ok) : 0.0;
+            return ok || Fail("expected a number");
+        }
+
+        // reads the members of an object whose opening brace was just read
+        bool ReadMeasurement(Measurement& measurement)
+        {
+            for (auto token = reader.Next(); token != Token::EndObject; token = reader.Next())
+            {
+                if (token != Token::Name)
+                {
+                    return false;
+                }
+                const auto& name = reader.Value();
+                QString text;
+                if (name == "description")
+                {
+                    if (!ReadString(text))
+                    {
+                        return false;
+                    }
+                    measurement.SetDescription(text);
+                }
+                else if (name == "target")
+                {
+                    if (reader.Next() != Token::BeginObject || !ReadTarget(measurement.GetTarget()))
+                    {
+                        return Fail("expected a target");
+                    }
+                }
+                else if (name == "samples")
+                {
+                    if (reader.Next() != Token::BeginArray || !ReadSamples(measurement))
+                    {
+                        return Fail("expected an array of samples");
+                    }
+                }
+                else if (!reader.Skip())
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool ReadTarget(Target& target)
+        {
+            for (auto token = reader.Next(); token != Token::EndObject; token = reader.Next())
+            {
+                if (token != Token::Name)
+                {
+                    return false;
+                }
+                const auto name = reader.Value();
+                QString text;
+                auto limit = 0.0;
+                if (name == "description" || name == "units")
+                {
+                    if (!ReadString(text))
+                    {
+                        return false;
+                    }
+                    if (name == "units")
+                        target.SetUnits(text);
+                    else
+                        target.SetDescription(text);
+                }
+                else if (name == "lower" || name == "nominal" || name == "upper")
+                {
+                    if (!ReadNumber(limit))
+                    {
+                        return false;
+                    }
+                    if (name == "lower")
+                        target.SetLowerLimit(limit);
+                    else if (name == "nominal")
+                        target.SetNominal(limit);
+                    else
+                        target.SetUpperLimit(limit);
+                }
+                else if (!reader.Skip())
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // appended a chunk at a time, as they are read
+        bool ReadSamples(Measurement& measurement)
+        {
+            values.clear();
+            timestamps.clear();
+            lots.clear();
+            for (auto token = reader.Next(); token != Token::EndArray; token = reader.Next())
+            {
+                auto value = 0.0;
+                auto ok = token == Token::BeginArray && ReadNumber(value) && reader.Next() == Token::Number;
+                const auto timestamp = ok ? reader.Value().toLongLong(&ok) : 0;
+                ok = ok && reader.Next() == Token::Number;
+                const auto lot = ok ? reader.Value().toUInt(&ok) : 0;
+                if (!ok || reader.Next() != Token::EndArray)
+                {
+                    return Fail("expected a sample");
+                }
+                values.push_back(value);
+                timestamps.push_back(timestamp);
+                lots.push_back(lot);
+                if (values.size() == SampleStore::chunkCapacity)
+                {
+                    measurement.Append(values.data(), timestamps.data(), lots.data(), values.size());
+                    values.clear();
+                    timestamps.clear();
+                    lots.clear();
+                }
+            }
+            measurement.Append(values.data(), timestamps.data(), lots.data(), values.size());
+            return true;
+        }
+
+        static constexpr int textColumn = 0;
+        static constexpr int noteColumn = 1;
+
+        JsonReader& reader;
+        std::vector<const TreeItem*> items;
+        std::vector<double> values;
+        std::vector<qint64> timestamps;
+        std::vector<quint32> lots;
+    };
+
+    class JsonWriter
+    {
+    public:
+        explicit JsonWriter(QIODevice& d) :
+            device(d)
+        {
+            buffer.reserve(flushSize + 4096);
+        }
+
+        bool WriteRoot(const TreeItem& root)
+        {
+            buffer.append("{\"text\":");
+            AppendString(root.GetData()->GetText());
+            buffer.append(",\"note\":");
+            AppendString(root.GetData()->GetNote());
+            return WriteChildren(root) && Append("}\n");
+        }
+
+        bool Flush()
+        {
+            const auto ok = device.write(buffer) == buffer.size();
+            buffer.clear();
+            return ok;
+        }
+
+    private:
+        bool Write(const TreeItem& item)
+        {
+            const auto& data = item.GetData();
+            const auto [it, inserted] = ordinals.emplace(data.get(), count++);
+            if (inserted)
+            {
+                buffer.append("{\"text\":");
+                AppendString(data->GetText());
+                buffer.append(",\"note\":");
+                AppendString(data->GetNote());
+                if (const auto* ctq = dynamic_cast<const Ctq*>(data.get()); ctq != nullptr &&
+                    !WriteMeasurement(ctq->GetMeasurement()))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                buffer.append("{\"link\":");
+                buffer.append(QByteArray::number(it->second));
+            }
+            buffer.append(",\"rank\":");
+            buffer.append(QByteArray::number(item.GetRank()));
+            if (item.GetWeight() != 1.0)
+            {
+                buffer.append(",\"weight\":");
+                buffer.append(QByteArray::number(item.GetWeight(), 'g', 17));
+            }
+            if (!item.GetTransfer().isEmpty())
+            {
+                buffer.append(",\"transfer\":");
+                AppendString(item.GetTransfer());
+            }
+            return WriteChildren(item) && Append("}");
+        }
+
+        bool WriteMeasurement(const Measurement& measurement)
+        {
+            const auto& target = measurement.GetTarget();
+            buffer.append(",\"measurement\":{\"description\":");
+            AppendString(measurement.GetDescription());
+            buffer.append(",\"target\":{\"description\":");
+            AppendString(target.GetDescription());
+            const std::pair<const char*, std::optional<double>> limits[] = {
+                {",\"lower\":", target.GetLowerLimit()},
+                {",\"nominal\":", target.GetNominal()},
+                {",\"upper\":", target.GetUpperLimit()}};
+            for (const auto& [member, limit] : limits)
+            {
+                if (limit)
+                {
+                    buffer.append(member);
+                    buffer.append(QByteArray::number(*limit, 'g', 17));
+                }
+            }
+            if (!target.GetUnits().isEmpty())
+            {
+                buffer.append(",\"units\":");
+                AppendString(target.GetUnits());
+            }
+            buffer.append('}');
+
+            const auto& samples = measurement.GetSamples();
+            if (samples.Size() > 0)
+            {
+                auto ok = true;
+                auto first = true;
+                buffer.append(",\"samples\":[");
+                samples.ForEachChunk([&](const SampleStore::Chunk& chunk)
+                {
+                    for (size_t i = 0; ok && i < chunk.size; ++i)
+                    {
+                        buffer.append(first ? "[" : ",[");
+                        first = false;
+                        buffer.append(QByteArray::number(chunk.values[i], 'g', 17));
+                        buffer.append(',');
+                        buffer.append(QByteArray::number(chunk.timestamps[i]));
+                        buffer.append(',');
+                        buffer.append(QByteArray::number(chunk.lots[i]));
+                        ok = Append("]");
+                    }
+                });
+                if (!ok)
+                {
+                    return false;
+                }
+                buffer.append(']');
+            }
+            return Append("}");
+        }
+
+        bool WriteChildren(const TreeItem& item)
+        {
+            if (item.ChildCount() == 0)
+            {
+                return true;
+            }
+
+            buffer.append(",\"children\":[\n");
+            for (auto r = 0; r < item.ChildCount(); ++r)
+            {
+                if (r > 0)
+                {
+                    buffer.append(",\n");
+                }
+                if (!Write(*item.GetChild(r)))
+                {
+                    return false;
+                }
+            }
+            buffer.append(']');
+            return true;
+        }
+
+        bool Append(const char* s)
+        {
+            buffer.append(s);
+            return buffer.size() <= flushSize || Flush();
+        }
+
+        void AppendString(const QString& s)
+        {
+            static constexpr char hex[] = "0123456789abcdef";
+            buffer.append('"');
+            for (const auto c : s.toUtf8())
+            {
+                switch (c)
+                {
+                case '"':
+                    buffer.append("\\\"");
+                    break;
+                case '\\':
+                    buffer.append("\\\\");
+                    break;
+                case '\n':
+                    buffer.append("\\n");
+                    break;
+                case '\r':
+                    buffer.append("\\r");
+                    break;
+                case '\t':
+                    buffer.append("\\t");
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                    {
+                        buffer.append("\\u00");
+                        buffer.append(hex[c >> 4]);
+                        buffer.append(hex[c & 0xf]);
+                    }
+                    else
+                    {
+                        buffer.append(c);
+                    }
+                }
+            }
+            buffer.append('"');
+        }
+
+        QIODevice& device;
+        QByteArray buffer;
+        std::unordered_map<const ItemData*, qint64> ordinals;
+        qint64 count = 0;
+    };
+}
+
+namespace CtqTool
+{
+    std::unique_ptr<TreeItem> ReadJson(QIODevice& device, QString* error)
+    {
+        JsonReader reader(device);
+        auto root = std::make_unique<TreeItem>(std::make_shared<ItemData>("Title", "Note"));
+        TreeBuilder builder(reader);
+
+        auto ok = reader.Next() == Token::BeginObject && builder.Read(*root);
+        if (ok && reader.Next() != Token::End)
+        {
+            reader.Fail("unexpected data after the document");
+            ok = false;
+        }
+        if (!ok)
+        {
+            reader.Fail("expected an object");
+            if (error != nullptr)
+            {
+                *error = reader.ErrorString();
+            }
+            return nullptr;
+        }
+        return root;
+    }
+
+    bool WriteJson(const TreeItem& root, QIODevice& device)
+    {
+        JsonWriter writer(device);
+        return writer.WriteRoot(root) && writer.Flush();
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+
+#include <memory>
+
+class QIODevice;
+
+namespace CtqTool
+{
+    class TreeItem;
+
+    // Trees are exchanged as nested objects
+    //   {"text": "...", "note": "...", "rank": 0, "weight": 1, "transfer": "...", "children": [...]}
+    // where the weight is left out when it is 1, the transfer when it is empty, and an item sharing its data with the n-th item of the document
+    // (counted depth first, excluding the root) carries "link": n instead of
+    // text and note. A CTQ also has
+    //   "measurement": {"description": "...", "target": {"description": "...",
+    //       "lower": 0, "nominal": 0, "upper": 0, "units": "..."},
+    //       "samples": [[value, timestamp, lot], ...]}
+    // where missing limits are left out. Unknown members are skipped.
+    //
+    // Both directions stream: the reader pulls tokens from a fixed size buffer
+    // and the writer flushes as it goes, so neither holds the document in memory.
+    std::unique_ptr<TreeItem> ReadJson(QIODevice&, QString* error = nullptr);
+    bool WriteJson(const TreeItem& root, QIODevice&);
+}
@@ -29,4 +29,111 @@ namespace CtqTool
     {
         description = std::move(s);
     }
+
+    Target& Measurement::GetTarget()
+    {
+        return target;
+    }
+
+    const Target& Measurement::GetTarget() const
+    {
+        return target;
+    }
+
+    SampleStore& Measurement::GetSamples()
+    {
+        return *samples;
+    }
+
+    const SampleStore& Measurement::GetSamples() const
+    {
+        return *samples;
+    }
+
+    void Measurement::Append(const double* values, const qint64* timestamps, const quint32* lots, size_t count)
+    {
+        if (keepsSamples && samples->Size() + count > sampleLimit)
+        {
+            StopKeepingSamples();
+        }
+        if (keepsSamples)
+        {
+            samples->Append(values, timestamps, lots, count);
+        }
+        else
+        {
+            // against the distribution of the samples before, for a changed target
+            running.Add(values, count, target, distribution->GetSketch());
+            conformance.Add(values, count, target, distribution->GetSketch());
+        }
+        distribution->Add(values, count, target);
+        spc->Append(values, count);
+    }
+
+    void Measurement::SetSampleLimit(size_t limit)
+    {
+        sampleLimit = limit;
+        if (keepsSamples && (samples->Size() > sampleLimit || sampleLimit == 0))
+        {
+            StopKeepingSamples();
+        }
+    }
+
+    bool Measurement::KeepsSamples() const
+    {
+        return keepsSamples;
+    }
+
+    const RunningStatistics& Measurement::GetRunningStatistics() const
+    {
+        return running;
+    }
+
+    // carries the statistics and conformance of the samples so far over
+    void Measurement::StopKeepingSamples()
+    {
+        running.Reset(ComputeStatistics(*samples, target), target);
+        conformance.Update(*samples, target);
+        samples->Clear();
+        keepsSamples = false;
+    }
+
+    const Conformance& Measurement::UpdateConformance()
+    {
+        if (keepsSamples)
+        {
+            return conformance.Update(*samples, target);
+        }
+        return conformance.Add(nullptr, 0, target, distribution->GetSketch());
+    }
+
+    const Conformance& Measurement::GetConformance() const
+    {
+        return conformance.Get();
+    }
+
+    const Distribution& Measurement::GetDistribution() const
+    {
+        return *distribution;
+    }
+
+    SpcChart& Measurement::GetSpc()
+    {
+        return *spc;
+    }
+
+    const SpcChart& Measurement::GetSpc() const
+    {
+        return *spc;
+    }
+
+    Measurement Measurement::Copy() const
+    {
+        auto copy = *this;
+        copy.samples = std::make_shared<SampleStore>();
+        copy.samples->AppendFrom(*samples);
+        copy.distribution = std::make_shared<Distribution>(*distribution);
+        copy.spc = std::make_shared<SpcChart>(*spc);
+        return copy;
+    }
 }
@@ -18,19 +18,71 @@
 
 #pragma once
 
+#include "conformance.h"
+#include "samplestore.h"
+#include "sketch.h"
+#include "spc.h"
+#include "statistics.h"
 #include "target.h"
 #include <QString>
 
+#include <memory>
+
 namespace CtqTool
 {
     class Measurement
     {
     public:
+        // 32M samples, taking 640 MB in memory or spilled
+        static constexpr size_t defaultSampleLimit = size_t(1) << 25;
+
         const QString& GetDescription() const;
         void SetDescription(QString);
 
+        Target& GetTarget();
+        const Target& GetTarget() const;
+
+        // copies of a measurement share its samples
+        SampleStore& GetSamples();
+        const SampleStore& GetSamples() const;
+
+        // appends to the samples, the distribution and the control chart;
+        // the latter two outlive clearing the samples and copies share them as well
+        void Append(const double* values, const qint64* timestamps, const quint32* lots, size_t count);
+        const Distribution& GetDistribution() const;
+
+        SpcChart& GetSpc();
+        const SpcChart& GetSpc() const;
+
+        // a copy with samples, distribution and control chart of its own
+        Measurement Copy() const;
+
+        // Once appending would keep more samples than the limit, the samples
+        // are dropped and no more are kept: appending then updates only the
+        // distribution, the control chart, and running statistics and
+        // conformance, so memory stays constant however long the stream.
+        // A limit of 0 keeps none from the start. Samples that are not kept
+        // are not saved either.
+        void SetSampleLimit(size_t);
+        bool KeepsSamples() const;
+        const RunningStatistics& GetRunningStatistics() const;
+
+        // counts the samples appended since the last update unless the
+        // target changed, as the conformance counter does
+        const Conformance& UpdateConformance();
+        const Conformance& GetConformance() const;
+
     private:
+        void StopKeepingSamples();
+
         QString description;
         Target target;
+        size_t sampleLimit = defaultSampleLimit;
+        bool keepsSamples = true;
+        RunningStatistics running;
+        ConformanceCounter conformance;
+        std::shared_ptr<SampleStore> samples = std::make_shared<SampleStore>();
+        std::shared_ptr<Distribution> distribution = std::make_shared<Distribution>();
+        std::shared_ptr<SpcChart> spc = std::make_shared<SpcChart>();
     };
 }
\ No newline at end of file
@@ -0,0 +1,447 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "montecarlo.h"
+#include "ctq.h"
+#include "item.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr size_t shards = 64;
+    constexpr size_t maxBatch = 1024;
+    constexpr size_t scratchValues = 1 << 20; // per shard, across all items
+    constexpr auto infinity = std::numeric_limits<double>::infinity();
+    constexpr auto twoPi = 6.283185307179586;
+
+    // Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+    struct Block
+    {
+        quint32 v[4];
+    };
+
+    Block philox(Block c, quint32 k0, quint32 k1)
+    {
+        for (auto round = 0; round < 10; ++round)
+        {
+            const auto p0 = quint64(0xD2511F53) * c.v[0];
+            const auto p1 = quint64(0xCD9E8D57) * c.v[2];
+            c = {{quint32(p1 >> 32) ^ c.v[1] ^ k0, quint32(p1), quint32(p0 >> 32) ^ c.v[3] ^ k1, quint32(p0)}};
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        return c;
+    }
+
+    double uniform(quint32 x)
+    {
+        return (x + 0.5) * (1.0 / 4294967296.0); // in (0, 1)
+    }
+
+    struct Input
+    {
+        double mean = 0.0;
+        double sigma = 0.0;
+        double lower = -infinity;
+        double upper = infinity;
+    };
+
+    // fitted from the statistics when there are enough samples, else from the target
+    std::optional<Input> inputOf(const Ctq& ctq, bool fitted)
+    {
+        const auto& target = ctq.GetMeasurement().GetTarget();
+        const auto& statistics = ctq.GetStatistics();
+        const auto l = target.GetLowerLimit();
+        const auto u = target.GetUpperLimit();
+        const auto n = target.GetNominal();
+
+        Input input;
+        input.lower = l.value_or(-infinity);
+        input.upper = u.value_or(infinity);
+        if (fitted && statistics.count >= 2)
+        {
+            input.mean = statistics.mean;
+            input.sigma = statistics.stddev;
+        }
+        else if (l && u)
+        {
+            input.mean = n.value_or((*l + *u) / 2);
+            input.sigma = (*u - *l) / 6;
+        }
+        else if (n)
+        {
+            const auto limit = l ? l : u;
+            input.mean = *n;
+            input.sigma = limit ? std::abs(*limit - *n) / 3 : 0.0;
+        }
+        else
+        {
+            return std::nullopt;
+        }
+        return input;
+    }
+
+    struct Node
+    {
+        TreeItem* item = nullptr;
+        int parent = -1;
+        int input = -1;         // for CTQs
+        double weight = 1.0;
+        bool active = false;    // has a simulated CTQ in its subtree
+        std::shared_ptr<const Expression> transfer;
+        std::vector<int> children;
+    };
+
+    // the items depth first, so children follow their parents
+    void flatten(TreeItem& item, int parent, std::vector<Node>& nodes, std::vector<Input>& inputs,
+        std::unordered_map<const ItemData*, int>& inputIndex, bool fitted)
+    {
+        const auto index = static_cast<int>(nodes.size());
+        nodes.push_back({&item, parent});
+        nodes[index].weight = item.GetWeight();
+        if (const auto* ctq = dynamic_cast<const Ctq*>(item.GetData().get()); ctq != nullptr)
+        {
+            const auto [it, inserted] = inputIndex.emplace(ctq, -1);
+            if (inserted)
+            {
+                if (const auto input = inputOf(*ctq, fitted))
+                {
+                    it->second = static_cast<int>(inputs.size());
+                    inputs.push_back(*input);
+                }
+            }
+            nodes[index].input = it->second;
+        }
+        else
+        {
+            nodes[index].transfer = item.GetCompiledTransfer();
+        }
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            nodes[index].children.push_back(static_cast<int>(nodes.size()));
+            flatten(*item.GetChild(r), index, nodes, inputs, inputIndex, fitted);
+        }
+    }
+
+    void activate(std::vector<Node>& nodes)
+    {
+        for (auto k = nodes.size(); k-- > 0;)
+        {
+            if (nodes[k].input >= 0 || nodes[k].active)
+            {
+                nodes[k].active = true;
+                if (nodes[k].parent >= 0)
+                {
+                    nodes[nodes[k].parent].active = true;
+                }
+            }
+        }
+    }
+
+    struct Accumulator
+    {
+        double count = 0.0;
+        double mean = 0.0;
+        double m2 = 0.0;
+        double min = infinity;
+        double max = -infinity;
+        quint64 out = 0;
+
+        void Merge(const Accumulator& other)
+        {
+            if (other.count == 0.0)
+            {
+                return;
+            }
+            const auto total = count + other.count;
+            const auto delta = other.mean - mean;
+            mean += delta * other.count / total;
+            m2 += other.m2 + delta * delta * count * other.count / total;
+            count = total;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            out += other.out;
+        }
+    };
+
+    Accumulator summarize(const double* x, const quint8* out, size_t n)
+    {
+        Accumulator a;
+        a.count = static_cast<double>(n);
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += x[i];
+            a.min = std::min(a.min, x[i]);
+            a.max = std::max(a.max, x[i]);
+            a.out += out[i];
+        }
+        a.mean = sum / a.count;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const auto d = x[i] - a.mean;
+            a.m2 += d * d;
+        }
+        return a;
+    }
+
+    class Shard
+    {
+    public:
+        Shard(const std::vector<Node>& n, const std::vector<Input>& i, quint64 s, size_t batch) :
+            nodes(n),
+            inputs(i),
+            seed(s),
+            batchSize(batch),
+            values(nodes.size() * batch),
+            out(nodes.size() * batch),
+            draws(inputs.size() * batch),
+            drawsOut(inputs.size() * batch),
+            bits(batch),
+            normals(batch)
+        {
+        }
+
+        // trials [from, to), from a multiple of four, optionally keeping the first node's values;
+        // counts them into the progress and stops between batches once it is cancelled
+        std::vector<Accumulator> Run(size_t from, size_t to, std::vector<double>* kept = nullptr,
+            SimulationProgress* progress = nullptr)
+        {
+            std::vector<Accumulator> result(nodes.size());
+            for (auto first = from; first < to; first += batchSize)
+            {
+                if (progress != nullptr && progress->cancelled)
+                {
+                    break;
+                }
+                const auto n = std::min(batchSize, to - first);
+                Draw(first, n);
+                Propagate(n);
+                if (kept != nullptr)
+                {
+                    kept->insert(kept->end(), values.begin(), values.begin() + n);
+                }
+                for (size_t k = 0; k < nodes.size(); ++k)
+                {
+                    if (nodes[k].active)
+                    {
+                        result[k].Merge(summarize(&values[k * batchSize], &out[k * batchSize], n));
+                    }
+                }
+                if (progress != nullptr)
+                {
+                    progress->trials += n;
+                }
+            }
+            return result;
+        }
+
+    private:
+        // four trials per generator call, so a trial's draws do not depend on how trials are batched;
+        // each step runs over the whole batch, for the loops to vectorize
+        void Draw(size_t first, size_t n)
+        {
+            const auto k0 = static_cast<quint32>(seed);
+            const auto k1 = static_cast<quint32>(seed >> 32);
+            const auto blocks = (n + 3) / 4; // the batch size is a multiple of four
+            for (size_t i = 0; i < inputs.size(); ++i)
+            {
+                for (size_t b = 0; b < blocks; ++b)
+                {
+                    const quint64 block = first / 4 + b;
+                    const auto r = philox({{quint32(block), quint32(block >> 32), quint32(i), 0}}, k0, k1);
+                    std::copy_n(r.v, 4, &bits[4 * b]);
+                }
+
+                // Box-Muller on pairs of words, the radius from the first and the angle from the second
+                for (size_t j = 0; j < 4 * blocks; j += 2)
+                {
+                    const auto radius = std::sqrt(-2.0 * std::log(uniform(bits[j])));
+                    const auto angle = twoPi * uniform(bits[j + 1]);
+                    normals[j] = radius * std::cos(angle);
+                    normals[j + 1] = radius * std::sin(angle);
+                }
+
+                auto* x = &draws[i * batchSize];
+                auto* o = &drawsOut[i * batchSize];
+                const auto& input = inputs[i];
+                for (size_t j = 0; j < n; ++j)
+                {
+                    const auto v = input.mean + input.sigma * normals[j];
+                    x[j] = v;
+                    o[j] = (v < input.lower) | (v > input.upper);
+                }
+            }
+        }
+
+        // children before their parents
+        void Propagate(size_t n)
+        {
+            std::fill(values.begin(), values.end(), 0.0);
+            std::fill(out.begin(), out.end(), quint8(0));
+            for (auto k = nodes.size(); k-- > 0;)
+            {
+                const auto& node = nodes[k];
+                if (!node.active)
+                {
+                    continue;
+                }
+                auto* x = &values[k * batchSize];
+                auto* o = &out[k * batchSize];
+                if (node.input >= 0)
+                {
+                    std::copy_n(&draws[node.input * batchSize], n, x);
+                    std::copy_n(&drawsOut[node.input * batchSize], n, o);
+                }
+                else if (node.transfer)
+                {
+                    // replaces the weighted sum the children added
+                    arguments.clear();
+                    for (const auto c : node.children)
+                    {
+                        arguments.push_back(&values[c * batchSize]);
+                    }
+                    node.transfer->Evaluate(arguments.data(), n, x);
+                }
+                if (node.parent >= 0)
+                {
+                    auto* px = &values[node.parent * batchSize];
+                    auto* po = &out[node.parent * batchSize];
+                    const auto w = node.weight;
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        px[i] += w * x[i];
+                        po[i] |= o[i];
+                    }
+                }
+            }
+        }
+
+        const std::vector<Node>& nodes;
+        const std::vector<Input>& inputs;
+        quint64 seed;
+        size_t batchSize;
+        std::vector<double> values;
+        std::vector<quint8> out;
+        std::vector<double> draws;
+        std::vector<quint8> drawsOut;
+        std::vector<quint32> bits;
+        std::vector<double> normals;
+        std::vector<const double*> arguments;
+    };
+}
+
+namespace CtqTool
+{
+    void Simulate(TreeItem& root, const SimulationOptions& options)
+    {
+        SimulationProgress progress;
+        PrepareSimulation(root, options)(progress)();
+    }
+
+    std::function<StoreSimulation(SimulationProgress&)> PrepareSimulation(TreeItem& root, const SimulationOptions& options)
+    {
+        auto nodes = std::make_shared<std::vector<Node>>();
+        auto inputs = std::make_shared<std::vector<Input>>();
+        std::unordered_map<const ItemData*, int> inputIndex;
+        flatten(root, -1, *nodes, *inputs, inputIndex, true);
+        activate(*nodes);
+
+        return [nodes, inputs, options](SimulationProgress& progress) -> StoreSimulation
+        {
+            // whole generator blocks per shard
+            const auto perShard = ((options.trials + shards - 1) / shards + 3) / 4 * 4;
+            const auto batch = std::clamp<size_t>(scratchValues / std::max<size_t>(nodes->size(), 1) / 4 * 4, 4, maxBatch);
+            std::vector<std::vector<Accumulator>> results(shards);
+            ParallelFor(shards, [&](size_t s)
+            {
+                const auto from = std::min(s * perShard, options.trials);
+                const auto to = std::min(from + perShard, options.trials);
+                if (from < to)
+                {
+                    Shard shard(*nodes, *inputs, options.seed, batch);
+                    results[s] = shard.Run(from, to, nullptr, &progress);
+                }
+            });
+            if (progress.cancelled)
+            {
+                return {};
+            }
+
+            std::vector<SimulationResult> totals(nodes->size());
+            for (size_t k = 0; k < nodes->size(); ++k)
+            {
+                Accumulator total;
+                for (const auto& shard : results)
+                {
+                    if (!shard.empty())
+                    {
+                        total.Merge(shard[k]);
+                    }
+                }
+
+                auto& result = totals[k];
+                if (total.count > 0.0)
+                {
+                    result.trials = static_cast<size_t>(total.count);
+                    result.mean = total.mean;
+                    result.stddev = (total.count > 1.0) ? std::sqrt(total.m2 / (total.count - 1.0)) : 0.0;
+                    result.min = total.min;
+                    result.max = total.max;
+                    result.outOfSpec = total.out / total.count;
+                }
+            }
+
+            return [nodes, totals = std::move(totals)]()
+            {
+                for (size_t k = 0; k < nodes->size(); ++k)
+                {
+                    (*nodes)[k].item->SetSimulation(totals[k]);
+                }
+            };
+        };
+    }
+
+    std::vector<double> SimulateTolerances(TreeItem& item, size_t trials, quint64 seed)
+    {
+        std::vector<Node> nodes;
+        std::vector<Input> inputs;
+        std::unordered_map<const ItemData*, int> inputIndex;
+        flatten(item, -1, nodes, inputs, inputIndex, false);
+        activate(nodes);
+
+        std::vector<double> values;
+        if (nodes[0].active)
+        {
+            values.reserve(trials);
+            const auto batch = std::clamp<size_t>(scratchValues / nodes.size() / 4 * 4, 4, maxBatch);
+            Shard(nodes, inputs, seed, batch).Run(0, trials, &values);
+        }
+        return values;
+    }
+}
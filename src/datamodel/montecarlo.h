@@ -0,0 +1,82 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace CtqTool
+{
+    class TreeItem;
+
+    struct SimulationResult
+    {
+        size_t trials = 0;      // none for items without simulated CTQs below them
+        double mean = 0.0;
+        double stddev = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        double outOfSpec = 0.0; // the fraction of trials with a CTQ of the subtree out of spec
+    };
+
+    struct SimulationOptions
+    {
+        quint64 seed = 1;
+        size_t trials = 1 << 20;
+    };
+
+    // shared with a simulation running on another thread
+    struct SimulationProgress
+    {
+        std::atomic<size_t> trials{0};      // run so far
+        std::atomic<bool> cancelled{false};
+    };
+
+    // stores the results of a simulation on the items
+    using StoreSimulation = std::function<void()>;
+
+    // Runs Monte Carlo trials over the tree. In each trial every distinct CTQ
+    // is drawn from a normal distribution, fitted from its statistics when it
+    // has two samples or more and otherwise centered on its target with the
+    // tolerance as six sigma. Every other item takes its transfer expression
+    // of its children or, without one, their weighted sum. The results are
+    // stored on the items.
+    //
+    // The draws come from Philox4x32-10, a counter based generator keyed by
+    // the seed and counting over trial and CTQ. Trials run in a fixed number
+    // of shards reduced in order, so the results depend on the seed alone and
+    // not on the number of threads.
+    void Simulate(TreeItem& root, const SimulationOptions&);
+
+    // The same in two steps: this reads the tree and returns the simulation,
+    // which no longer reads it and so can run on another thread while the tree
+    // is in use. It counts its trials into the progress as they complete and,
+    // once cancelled, stops early and returns nothing. Otherwise it returns
+    // the store, which writes the results to the items when called on the
+    // thread of the tree; none of them may have been removed meanwhile.
+    std::function<StoreSimulation(SimulationProgress&)> PrepareSimulation(TreeItem& root, const SimulationOptions&);
+
+    // the values the item takes in the given number of trials when every CTQ
+    // below it is drawn from its target alone, ignoring its samples; runs on
+    // the calling thread, so separate subtrees can be sampled in parallel
+    std::vector<double> SimulateTolerances(TreeItem& item, size_t trials, quint64 seed);
+}
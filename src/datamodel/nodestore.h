@@ -0,0 +1,51 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "textformat.h"
+
+#include <QtGlobal>
+
+#include <vector>
+
+namespace CtqTool
+{
+    // A tree kept outside memory, from which CtqModel fetches the children of
+    // an item once a view shows them. Children keep the order of their rows.
+    class NodeStore
+    {
+    public:
+        using Id = quint64;
+
+        struct Node
+        {
+            Id id = 0;
+            ItemLine item;
+            int childCount = 0;
+        };
+
+        virtual ~NodeStore() = default;
+
+        virtual Id GetRoot() const = 0;
+        virtual int ChildCount(Id) const = 0;
+
+        // up to count children of parent, from row first on
+        virtual std::vector<Node> GetChildren(Id parent, int first, int count) const = 0;
+    };
+}
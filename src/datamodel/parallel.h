@@ -0,0 +1,103 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace CtqTool
+{
+    // whether this thread is running calls of a ParallelFor
+    inline bool& InParallelFor()
+    {
+        thread_local bool inside = false;
+        return inside;
+    }
+
+    // the most threads a ParallelFor runs on, the calling one included
+    inline size_t ParallelThreads()
+    {
+        return static_cast<size_t>(std::max(QThreadPool::globalInstance()->maxThreadCount(), 1));
+    }
+
+    // Calls f(i) for i in [0, count) on the threads of the global thread pool
+    // and the calling one, and returns when all calls are done. The calling
+    // thread takes whatever the pool does not get to, so a busy pool only
+    // makes it slower. Called from within f, it runs on the calling thread
+    // alone instead of fanning out again.
+    template<class F>
+    void ParallelFor(size_t count, F&& f)
+    {
+        if (count < 2 || InParallelFor())
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                f(i);
+            }
+            return;
+        }
+
+        // shared with the tasks, which the pool may only start once all calls are done
+        struct State
+        {
+            std::atomic<size_t> next{0};
+            size_t done = 0;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        auto state = std::make_shared<State>();
+        auto* function = &f;
+        const auto work = [state, function, count]()
+        {
+            auto& inside = InParallelFor();
+            inside = true;
+            size_t calls = 0;
+            for (auto i = state->next++; i < count; i = state->next++)
+            {
+                (*function)(i);
+                ++calls;
+            }
+            inside = false;
+            if (calls > 0)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done += calls;
+                if (state->done == count)
+                {
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        const auto helpers = std::min(ParallelThreads(), count) - 1;
+        for (size_t h = 0; h < helpers; ++h)
+        {
+            QThreadPool::globalInstance()->start(work);
+        }
+        work();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state, count]() { return state->done == count; });
+    }
+}
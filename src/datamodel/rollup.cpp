@@ -0,0 +1,99 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rollup.h"
+#include "ctq.h"
+#include "item.h"
+
+#include <algorithm>
+
+namespace
+{
+    using namespace CtqTool;
+
+    double weight(const TreeItem& item)
+    {
+        return item.GetRank() + 1.0;
+    }
+
+    class Accumulator
+    {
+    public:
+        void Add(std::optional<double> cpk, std::optional<double> conformance, Conformance::Level level, double w)
+        {
+            if (cpk)
+            {
+                result.worstCpk = result.worstCpk ? std::min(*result.worstCpk, *cpk) : *cpk;
+            }
+            if (conformance)
+            {
+                sum += w * *conformance;
+                total += w;
+            }
+            result.worstLevel = std::max(result.worstLevel, level);
+        }
+
+        RollUp Get()
+        {
+            if (total > 0.0)
+            {
+                result.conformance = sum / total;
+            }
+            return result;
+        }
+
+    private:
+        RollUp result;
+        double sum = 0.0;
+        double total = 0.0;
+    };
+}
+
+namespace CtqTool
+{
+    bool RollUp::operator==(const RollUp& other) const
+    {
+        return worstCpk == other.worstCpk && conformance == other.conformance && worstLevel == other.worstLevel;
+    }
+
+    bool RollUp::operator!=(const RollUp& other) const
+    {
+        return !(*this == other);
+    }
+
+    RollUp ComputeRollUp(const TreeItem& item)
+    {
+        Accumulator accumulator;
+        if (const auto* ctq = dynamic_cast<const Ctq*>(item.GetData().get()); ctq != nullptr)
+        {
+            const auto& c = ctq->GetConformance();
+            const auto samples = c.in + c.near + c.out;
+            const auto conformance = (c.hasLimits && samples > 0) ?
+                std::optional<double>(static_cast<double>(c.in + c.near) / samples) : std::nullopt;
+            accumulator.Add(ctq->GetStatistics().cpk, conformance, c.GetLevel(), weight(item));
+        }
+
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            const auto& child = *item.GetChild(r);
+            const auto& rollUp = child.GetRollUp();
+            accumulator.Add(rollUp.worstCpk, rollUp.conformance, rollUp.worstLevel, weight(child));
+        }
+        return accumulator.Get();
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "conformance.h"
+
+#include <optional>
+
+namespace CtqTool
+{
+    class TreeItem;
+
+    // The health of an item's subtree. Items are weighted by their rank
+    // plus one, so unranked items still count.
+    struct RollUp
+    {
+        std::optional<double> worstCpk;
+        std::optional<double> conformance; // weighted fraction of samples within spec
+        Conformance::Level worstLevel = Conformance::Level::Unknown;
+
+        bool operator==(const RollUp&) const;
+        bool operator!=(const RollUp&) const;
+    };
+
+    // from the item's own CTQ, if any, and the roll-ups of its children;
+    // O(children), so keeping a tree up to date only costs the ancestors of a change
+    RollUp ComputeRollUp(const TreeItem&);
+}
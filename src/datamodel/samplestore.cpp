@@ -0,0 +1,203 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "samplestore.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QTemporaryFile>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr qint64 valuesBytes = CtqTool::SampleStore::chunkCapacity * sizeof(double);
+    constexpr qint64 timestampsBytes = CtqTool::SampleStore::chunkCapacity * sizeof(qint64);
+    constexpr qint64 lotsBytes = CtqTool::SampleStore::chunkCapacity * sizeof(quint32);
+    constexpr qint64 chunkBytes = valuesBytes + timestampsBytes + lotsBytes;
+}
+
+namespace CtqTool
+{
+    SampleStore::SampleStore() :
+        spillDirectory(QDir::tempPath())
+    {
+    }
+
+    SampleStore::~SampleStore() = default;
+
+    size_t SampleStore::Size() const
+    {
+        return size;
+    }
+
+    size_t SampleStore::ChunkCount() const
+    {
+        return blocks.size();
+    }
+
+    const SampleStore::Chunk& SampleStore::GetChunk(size_t i) const
+    {
+        return blocks.at(i).chunk;
+    }
+
+    SampleStore::Sample SampleStore::At(size_t i) const
+    {
+        const auto& chunk = GetChunk(i / chunkCapacity);
+        const auto j = i % chunkCapacity;
+        if (j >= chunk.size)
+        {
+            throw std::runtime_error("wrong index");
+        }
+        return {chunk.values[j], chunk.timestamps[j], chunk.lots[j]};
+    }
+
+    SampleStore::Block& SampleStore::Writable()
+    {
+        if (blocks.empty() || blocks.back().chunk.size == chunkCapacity)
+        {
+            // left uninitialized; only the first chunk.size entries are ever read
+            Block block;
+            block.values.reset(new double[chunkCapacity]);
+            block.timestamps.reset(new qint64[chunkCapacity]);
+            block.lots.reset(new quint32[chunkCapacity]);
+            block.chunk = {block.values.get(), block.timestamps.get(), block.lots.get(), 0};
+            blocks.push_back(std::move(block));
+        }
+        return blocks.back();
+    }
+
+    void SampleStore::Append(double value, qint64 timestamp, quint32 lot)
+    {
+        auto& block = Writable();
+        const auto i = block.chunk.size;
+        block.values[i] = value;
+        block.timestamps[i] = timestamp;
+        block.lots[i] = lot;
+        ++size;
+        if (++block.chunk.size == chunkCapacity)
+        {
+            OnChunkFull();
+        }
+    }
+
+    void SampleStore::Append(const double* values, const qint64* timestamps, const quint32* lots, size_t count)
+    {
+        while (count > 0)
+        {
+            auto& block = Writable();
+            const auto offset = block.chunk.size;
+            const auto n = std::min(count, chunkCapacity - offset);
+            std::memcpy(block.values.get() + offset, values, n * sizeof(double));
+            std::memcpy(block.timestamps.get() + offset, timestamps, n * sizeof(qint64));
+            std::memcpy(block.lots.get() + offset, lots, n * sizeof(quint32));
+
+            values += n;
+            timestamps += n;
+            lots += n;
+            count -= n;
+            size += n;
+            block.chunk.size += n;
+            if (block.chunk.size == chunkCapacity)
+            {
+                OnChunkFull();
+            }
+        }
+    }
+
+    void SampleStore::AppendFrom(const SampleStore& other)
+    {
+        other.ForEachChunk([this](const Chunk& chunk)
+        {
+            Append(chunk.values, chunk.timestamps, chunk.lots, chunk.size);
+        });
+    }
+
+    void SampleStore::Clear()
+    {
+        blocks.clear();
+        spillFile.reset();
+        size = 0;
+        spilled = 0;
+    }
+
+    void SampleStore::SetSpill(const QString& directory, size_t maxResidentChunks)
+    {
+        spillDirectory = directory;
+        maxResident = maxResidentChunks;
+        if (!blocks.empty() && blocks.back().chunk.size == chunkCapacity)
+        {
+            OnChunkFull();
+        }
+    }
+
+    void SampleStore::OnChunkFull()
+    {
+        const auto full = blocks.size() - ((blocks.back().chunk.size == chunkCapacity) ? 0 : 1);
+        if (!spillDirectory.isEmpty() && full - spilled > maxResident && !Spill())
+        {
+            qWarning() << "could not spill samples to" << spillDirectory;
+            spillDirectory.clear();
+        }
+    }
+
+    bool SampleStore::Spill()
+    {
+        if (!spillFile)
+        {
+            spillFile = std::make_unique<QTemporaryFile>(QDir(spillDirectory).filePath("samples-XXXXXX.bin"));
+            if (!spillFile->open())
+            {
+                spillFile.reset();
+                return false;
+            }
+        }
+
+        // the oldest go, as appends and recent samples are read most
+        const auto full = blocks.size() - ((blocks.back().chunk.size == chunkCapacity) ? 0 : 1);
+        for (; full - spilled > maxResident; ++spilled)
+        {
+            auto& block = blocks[spilled];
+            const auto offset = static_cast<qint64>(spilled) * chunkBytes;
+            if (!spillFile->seek(offset) ||
+                spillFile->write(reinterpret_cast<const char*>(block.values.get()), valuesBytes) != valuesBytes ||
+                spillFile->write(reinterpret_cast<const char*>(block.timestamps.get()), timestampsBytes) != timestampsBytes ||
+                spillFile->write(reinterpret_cast<const char*>(block.lots.get()), lotsBytes) != lotsBytes ||
+                !spillFile->flush())
+            {
+                return false;
+            }
+
+            // chunkBytes is a multiple of the page size, so each mapping is aligned
+            auto* map = spillFile->map(offset, chunkBytes);
+            if (map == nullptr)
+            {
+                return false;
+            }
+            block.chunk.values = reinterpret_cast<const double*>(map);
+            block.chunk.timestamps = reinterpret_cast<const qint64*>(map + valuesBytes);
+            block.chunk.lots = reinterpret_cast<const quint32*>(map + valuesBytes + timestampsBytes);
+            block.values.reset();
+            block.timestamps.reset();
+            block.lots.reset();
+        }
+        return true;
+    }
+}
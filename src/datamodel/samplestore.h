@@ -0,0 +1,116 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+class QTemporaryFile;
+
+namespace CtqTool
+{
+    // Measured samples stored column-wise in fixed size chunks, so that an
+    // append never moves the samples already stored and a scan over a column
+    // runs over contiguous arrays:
+    //
+    //   store.ForEachChunk([&](const SampleStore::Chunk& chunk)
+    //   {
+    //       for (size_t i = 0; i < chunk.size; ++i)
+    //           sum += chunk.values[i];
+    //   });
+    //
+    // Full chunks beyond a number kept in memory, the most recent ones, are
+    // moved to a memory mapped file in the temporary directory, leaving paging
+    // them in and out to the OS.
+    class SampleStore
+    {
+    public:
+        static constexpr size_t chunkCapacity = 1 << 16;
+        // 4M samples, or 80 MB
+        static constexpr size_t defaultResidentChunks = 64;
+
+        struct Chunk
+        {
+            const double* values = nullptr;
+            const qint64* timestamps = nullptr; // ms since epoch
+            const quint32* lots = nullptr;
+            size_t size = 0;
+        };
+
+        struct Sample
+        {
+            double value = 0.0;
+            qint64 timestamp = 0;
+            quint32 lot = 0;
+        };
+
+        SampleStore();
+        ~SampleStore();
+        SampleStore(const SampleStore&) = delete;
+        SampleStore& operator=(const SampleStore&) = delete;
+
+        void Append(double value, qint64 timestamp, quint32 lot);
+        void Append(const double* values, const qint64* timestamps, const quint32* lots, size_t count);
+        void Clear();
+
+        size_t Size() const;
+        Sample At(size_t i) const;
+
+        size_t ChunkCount() const;
+        const Chunk& GetChunk(size_t) const;
+
+        template<class F>
+        void ForEachChunk(F&& f) const
+        {
+            for (const auto& block : blocks)
+            {
+                f(block.chunk);
+            }
+        }
+
+        // keeps at most maxResidentChunks full chunks in memory, spilling
+        // the older ones to a temporary file in directory, or none if empty
+        void SetSpill(const QString& directory, size_t maxResidentChunks);
+
+        // appends the samples of another store
+        void AppendFrom(const SampleStore&);
+
+    private:
+        struct Block
+        {
+            std::unique_ptr<double[]> values;
+            std::unique_ptr<qint64[]> timestamps;
+            std::unique_ptr<quint32[]> lots;
+            Chunk chunk;
+        };
+
+        Block& Writable();
+        void OnChunkFull();
+        bool Spill();
+
+        std::vector<Block> blocks;
+        size_t size = 0;
+        size_t spilled = 0; // the first blocks, which are mapped from spillFile
+        QString spillDirectory;
+        size_t maxResident = defaultResidentChunks;
+        std::unique_ptr<QTemporaryFile> spillFile;
+    };
+}
@@ -0,0 +1,379 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sketch.h"
+#include "target.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    using namespace CtqTool;
+
+    // each level below the top is this much smaller than the one above it
+    constexpr auto levelRatio = 2.0 / 3.0;
+
+    // the tolerance with half of it to either side
+    std::optional<std::pair<double, double>> toleranceRange(const Target& target)
+    {
+        const auto l = target.GetLowerLimit();
+        const auto u = target.GetUpperLimit();
+        const auto n = target.GetNominal();
+        if (l && u && *u > *l)
+        {
+            const auto t = *u - *l;
+            return std::make_pair(*l - t / 2, *u + t / 2);
+        }
+
+        const auto limit = l ? l : u;
+        if (limit && n && *limit != *n)
+        {
+            const auto d = 1.5 * std::abs(*limit - *n);
+            return std::make_pair(*n - d, *n + d);
+        }
+        return std::nullopt;
+    }
+
+    std::pair<double, double> spreadRange(const QuantileSketch& sketch)
+    {
+        auto spread = sketch.Max() - sketch.Min();
+        if (spread <= 0.0)
+        {
+            spread = std::max(std::abs(sketch.Min()), 1.0);
+        }
+        return {sketch.Min() - spread / 2, sketch.Max() + spread / 2};
+    }
+}
+
+namespace CtqTool
+{
+    void QuantileSketch::Add(double value)
+    {
+        Add(&value, 1);
+    }
+
+    void QuantileSketch::Add(const double* values, size_t n)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+        if (levels.empty())
+        {
+            levels.emplace_back();
+            maxRetained = Capacity(0);
+        }
+        if (count == 0)
+        {
+            min = max = values[0];
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            min = std::min(min, values[i]);
+            max = std::max(max, values[i]);
+            levels[0].push_back(values[i]);
+            if (++retained >= maxRetained)
+            {
+                Compress();
+            }
+        }
+        count += n;
+        sortedValid = false;
+    }
+
+    void QuantileSketch::Merge(const QuantileSketch& other)
+    {
+        if (&other == this)
+        {
+            const auto copy = other;
+            Merge(copy);
+            return;
+        }
+        if (other.count == 0)
+        {
+            return;
+        }
+
+        min = (count == 0) ? other.min : std::min(min, other.min);
+        max = (count == 0) ? other.max : std::max(max, other.max);
+        if (levels.size() < other.levels.size())
+        {
+            levels.resize(other.levels.size());
+        }
+        for (size_t h = 0; h < other.levels.size(); ++h)
+        {
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        }
+        count += other.count;
+        retained += other.retained;
+
+        maxRetained = 0;
+        for (size_t h = 0; h < levels.size(); ++h)
+        {
+            maxRetained += Capacity(h);
+        }
+        while (retained >= maxRetained)
+        {
+            Compress();
+        }
+        sortedValid = false;
+    }
+
+    quint64 QuantileSketch::Count() const
+    {
+        return count;
+    }
+
+    double QuantileSketch::Min() const
+    {
+        return min;
+    }
+
+    double QuantileSketch::Max() const
+    {
+        return max;
+    }
+
+    std::optional<double> QuantileSketch::Quantile(double q) const
+    {
+        if (count == 0)
+        {
+            return std::nullopt;
+        }
+        if (q <= 0.0)
+        {
+            return min;
+        }
+        if (q >= 1.0)
+        {
+            return max;
+        }
+
+        const auto& values = Sorted();
+        const auto rank = q * static_cast<double>(count);
+        const auto it = std::lower_bound(values.begin(), values.end(), rank,
+            [](const std::pair<double, quint64>& v, double r) { return static_cast<double>(v.second) < r; });
+        return (it == values.end()) ? max : it->first;
+    }
+
+    double QuantileSketch::Rank(double value) const
+    {
+        if (count == 0)
+        {
+            return 0.0;
+        }
+
+        const auto& values = Sorted();
+        const auto it = std::upper_bound(values.begin(), values.end(), value,
+            [](double v, const std::pair<double, quint64>& p) { return v < p.first; });
+        return (it == values.begin()) ? 0.0 : static_cast<double>(std::prev(it)->second) / count;
+    }
+
+    size_t QuantileSketch::Capacity(size_t level) const
+    {
+        const auto height = static_cast<double>(levels.size() - 1 - level);
+        return std::max<size_t>(2, static_cast<size_t>(std::ceil(k * std::pow(levelRatio, height))));
+    }
+
+    // compacts the lowest full level into the one above it
+    void QuantileSketch::Compress()
+    {
+        for (size_t h = 0; h < levels.size(); ++h)
+        {
+            if (levels[h].size() < Capacity(h))
+            {
+                continue;
+            }
+            if (h + 1 == levels.size())
+            {
+                levels.emplace_back();
+                maxRetained = 0;
+                for (size_t l = 0; l < levels.size(); ++l)
+                {
+                    maxRetained += Capacity(l);
+                }
+            }
+
+            auto& level = levels[h];
+            auto& next = levels[h + 1];
+            std::sort(level.begin(), level.end());
+
+            // xorshift decides between the odd and the even values, an odd one out stays
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            const size_t kept = level.size() % 2;
+            const auto before = level.size();
+            for (auto i = kept + (random & 1); i < level.size(); i += 2)
+            {
+                next.push_back(level[i]);
+            }
+            level.resize(kept);
+            retained -= before - kept - (before - kept) / 2;
+            return;
+        }
+    }
+
+    const std::vector<std::pair<double, quint64>>& QuantileSketch::Sorted() const
+    {
+        if (!sortedValid)
+        {
+            sorted.clear();
+            sorted.reserve(retained);
+            ForEachValue([this](double v, quint64 w) { sorted.emplace_back(v, w); });
+            std::sort(sorted.begin(), sorted.end());
+
+            quint64 cumulative = 0;
+            for (auto& [v, w] : sorted)
+            {
+                cumulative += w;
+                w = cumulative;
+            }
+            sortedValid = true;
+        }
+        return sorted;
+    }
+
+    Histogram::Histogram(double l, double u) :
+        lower(l),
+        upper(u),
+        scale((u > l) ? binCount / (u - l) : 0.0)
+    {
+    }
+
+    bool Histogram::HasRange() const
+    {
+        return upper > lower;
+    }
+
+    double Histogram::GetLower() const
+    {
+        return lower;
+    }
+
+    double Histogram::GetUpper() const
+    {
+        return upper;
+    }
+
+    void Histogram::Add(const double* values, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            Add(values[i], 1);
+        }
+    }
+
+    void Histogram::Add(double value, quint64 weight)
+    {
+        // NaN ends up below the range
+        const auto position = (value - lower) * scale;
+        const auto bin = !(position >= 0.0) ? 0 :
+            (position >= binCount) ? binCount + 1 : static_cast<size_t>(position) + 1;
+        counts[bin] += weight;
+    }
+
+    bool Histogram::Merge(const Histogram& other)
+    {
+        if (other.lower != lower || other.upper != upper)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            counts[i] += other.counts[i];
+        }
+        return true;
+    }
+
+    quint64 Histogram::GetCount(size_t bin) const
+    {
+        return counts[bin + 1];
+    }
+
+    quint64 Histogram::GetUnderflow() const
+    {
+        return counts.front();
+    }
+
+    quint64 Histogram::GetOverflow() const
+    {
+        return counts.back();
+    }
+
+    void Distribution::Add(const double* values, size_t n, const Target& target)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        sketch.Add(values, n);
+        if (revision != target.GetRevision() || !histogram.HasRange())
+        {
+            revision = target.GetRevision();
+            auto range = toleranceRange(target);
+            if (!range && !histogram.HasRange())
+            {
+                range = spreadRange(sketch);
+            }
+            if (range && (range->first != histogram.GetLower() || range->second != histogram.GetUpper()))
+            {
+                // the sketch already holds the new values
+                SetRange(range->first, range->second);
+                return;
+            }
+        }
+        histogram.Add(values, n);
+    }
+
+    void Distribution::Merge(const Distribution& other)
+    {
+        sketch.Merge(other.sketch);
+        if (!other.histogram.HasRange())
+        {
+            return;
+        }
+        if (!histogram.HasRange())
+        {
+            histogram = other.histogram;
+        }
+        else if (!histogram.Merge(other.histogram))
+        {
+            other.sketch.ForEachValue([this](double v, quint64 w) { histogram.Add(v, w); });
+        }
+    }
+
+    const QuantileSketch& Distribution::GetSketch() const
+    {
+        return sketch;
+    }
+
+    const Histogram& Distribution::GetHistogram() const
+    {
+        return histogram;
+    }
+
+    void Distribution::SetRange(double lower, double upper)
+    {
+        histogram = Histogram(lower, upper);
+        sketch.ForEachValue([this](double v, quint64 w) { histogram.Add(v, w); });
+    }
+}
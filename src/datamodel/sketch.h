@@ -0,0 +1,136 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <array>
+#include <optional>
+#include <vector>
+
+namespace CtqTool
+{
+    class Target;
+
+    // A KLL quantile sketch: a stack of compactors where level h holds values
+    // of weight 2^h and a full level passes every other one of its sorted
+    // values to the next. With k = 200 it keeps about 3k values whatever the
+    // number of samples, and a quantile's rank is off by at most about 1.7%
+    // of the count with 99% confidence. Sketches of disjoint samples, such as
+    // lots or sibling CTQs, merge into a sketch of their union with the same bound.
+    class QuantileSketch
+    {
+    public:
+        static constexpr size_t k = 200;
+
+        void Add(double);
+        void Add(const double*, size_t count);
+        void Merge(const QuantileSketch&);
+
+        quint64 Count() const;
+        double Min() const;
+        double Max() const;
+
+        // the value at rank q * count, q in [0, 1]; none while empty
+        std::optional<double> Quantile(double q) const;
+        // the fraction of the samples at or below value
+        double Rank(double value) const;
+
+        // the values kept and their weights, in no particular order
+        template<class F>
+        void ForEachValue(F&& f) const
+        {
+            for (size_t h = 0; h < levels.size(); ++h)
+            {
+                for (const auto v : levels[h])
+                {
+                    f(v, quint64(1) << h);
+                }
+            }
+        }
+
+    private:
+        size_t Capacity(size_t level) const;
+        void Compress();
+        const std::vector<std::pair<double, quint64>>& Sorted() const;
+
+        std::vector<std::vector<double>> levels;
+        size_t retained = 0;
+        size_t maxRetained = 0;
+        quint64 count = 0;
+        double min = 0.0;
+        double max = 0.0;
+        quint64 random = 0x9e3779b97f4a7c15;
+
+        mutable std::vector<std::pair<double, quint64>> sorted; // cumulative weights
+        mutable bool sortedValid = false;
+    };
+
+    // Counts samples in equal width bins over a fixed range, with one bin
+    // below and one above it.
+    class Histogram
+    {
+    public:
+        static constexpr size_t binCount = 50;
+
+        Histogram() = default;
+        Histogram(double lower, double upper);
+
+        bool HasRange() const;
+        double GetLower() const;
+        double GetUpper() const;
+
+        void Add(const double*, size_t count);
+        void Add(double value, quint64 weight);
+        // fails when the ranges differ
+        bool Merge(const Histogram&);
+
+        quint64 GetCount(size_t bin) const;
+        quint64 GetUnderflow() const;
+        quint64 GetOverflow() const;
+
+    private:
+        double lower = 0.0;
+        double upper = 0.0;
+        double scale = 0.0;
+        std::array<quint64, binCount + 2> counts = {};
+    };
+
+    // A quantile sketch and a histogram of the samples of a measurement, both
+    // of constant size. The histogram spans the tolerance with half of it to
+    // either side, or, without limits, the spread of the first samples. When
+    // the limits change it is redistributed from the sketch, which is approximate.
+    class Distribution
+    {
+    public:
+        void Add(const double*, size_t count, const Target&);
+        // a histogram over a different range is merged through its sketch
+        void Merge(const Distribution&);
+
+        const QuantileSketch& GetSketch() const;
+        const Histogram& GetHistogram() const;
+
+    private:
+        void SetRange(double lower, double upper);
+
+        QuantileSketch sketch;
+        Histogram histogram;
+        quint64 revision = ~quint64(0);
+    };
+}
@@ -0,0 +1,231 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "spc.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+    using namespace CtqTool;
+
+    // d2 and d3 relate the mean and standard deviation of a subgroup's
+    // range to the process sigma, for subgroups of 2 to 10
+    constexpr double d2Table[] = {1.128, 1.693, 2.059, 2.326, 2.534, 2.704, 2.847, 2.970, 3.078};
+    constexpr double d3Table[] = {0.853, 0.888, 0.880, 0.864, 0.848, 0.833, 0.820, 0.808, 0.797};
+    constexpr size_t minSubgroupSize = 2;
+    constexpr size_t maxSubgroupSize = 10;
+
+    struct RuleName
+    {
+        SpcRule rule;
+        const char* number;
+        const char* description;
+    };
+
+    constexpr RuleName ruleNames[] = {
+        {BeyondLimitsRule, "1", "beyond 3 sigma"},
+        {SameSideRule, "2", "nine on one side"},
+        {TrendRule, "3", "six trending"},
+        {AlternatingRule, "4", "fourteen alternating"},
+        {TwoOfThreeRule, "5", "two of three beyond 2 sigma"},
+        {FourOfFiveRule, "6", "four of five beyond 1 sigma"},
+        {StratificationRule, "7", "fifteen within 1 sigma"},
+        {MixtureRule, "8", "eight beyond 1 sigma on both sides"},
+        {RangeRule, "R", "range out of limits"}
+    };
+
+    QString join(quint32 rules, bool describe)
+    {
+        QStringList names;
+        for (const auto& name : ruleNames)
+        {
+            if (rules & name.rule)
+            {
+                names.append(describe ? name.description : name.number);
+            }
+        }
+        return names.join(describe ? "; " : ", ");
+    }
+
+    int count(quint32 bits)
+    {
+        return static_cast<int>(std::bitset<32>(bits).count());
+    }
+}
+
+namespace CtqTool
+{
+    QString SpcRuleNumbers(quint32 rules)
+    {
+        return join(rules, false);
+    }
+
+    QString SpcRuleDescriptions(quint32 rules)
+    {
+        return join(rules, true);
+    }
+
+    SpcChart::SpcChart(size_t size, size_t baseline) :
+        subgroupSize(std::clamp(size, minSubgroupSize, maxSubgroupSize)),
+        baselineSubgroups(std::max<size_t>(baseline, 1)),
+        d2(d2Table[subgroupSize - minSubgroupSize]),
+        d3(d3Table[subgroupSize - minSubgroupSize])
+    {
+    }
+
+    void SpcChart::Append(const double* values, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto v = values[i];
+            if (filled == 0)
+            {
+                sum = 0.0;
+                min = max = v;
+            }
+            sum += v;
+            min = std::min(min, v);
+            max = std::max(max, v);
+            if (++filled == subgroupSize)
+            {
+                AddSubgroup(sum / subgroupSize, max - min);
+                filled = 0;
+            }
+        }
+    }
+
+    bool SpcChart::IsCalibrated() const
+    {
+        return calibrated;
+    }
+
+    double SpcChart::GetCenter() const
+    {
+        return center;
+    }
+
+    double SpcChart::GetSigma() const
+    {
+        return sigma;
+    }
+
+    double SpcChart::GetRangeCenter() const
+    {
+        return rangeCenter;
+    }
+
+    quint64 SpcChart::GetSubgroupCount() const
+    {
+        return subgroups;
+    }
+
+    quint32 SpcChart::GetActiveRules() const
+    {
+        return active;
+    }
+
+    SpcChart::Pending SpcChart::TakeViolations()
+    {
+        return std::exchange(pending, {});
+    }
+
+    void SpcChart::AddSubgroup(double mean, double range)
+    {
+        ++subgroups;
+        if (!calibrated)
+        {
+            baselineMeans += mean;
+            baselineRanges += range;
+            if (subgroups == baselineSubgroups)
+            {
+                center = baselineMeans / baselineSubgroups;
+                rangeCenter = baselineRanges / baselineSubgroups;
+                sigma = rangeCenter / d2 / std::sqrt(static_cast<double>(subgroupSize));
+                rangeUpper = rangeCenter * (1.0 + 3.0 * d3 / d2);
+                rangeLower = std::max(0.0, rangeCenter * (1.0 - 3.0 * d3 / d2));
+                calibrated = true;
+            }
+            previous = mean;
+            return;
+        }
+
+        const auto rules = Evaluate(mean, range);
+        const auto started = rules & ~active;
+        active = rules;
+        if (started != 0)
+        {
+            if (pending.violations.size() < maxPending)
+            {
+                pending.violations.push_back({subgroups - 1, started, mean, range});
+            }
+            else
+            {
+                ++pending.dropped;
+            }
+        }
+    }
+
+    quint32 SpcChart::Evaluate(double mean, double range)
+    {
+        const auto z = (sigma > 0.0) ? (mean - center) / sigma :
+            (mean == center) ? 0.0 : std::copysign(std::numeric_limits<double>::infinity(), mean - center);
+
+        sideRun = (z > 0.0) ? std::max(sideRun, 0) + 1 : (z < 0.0) ? std::min(sideRun, 0) - 1 : 0;
+
+        const auto step = (mean > previous) - (mean < previous);
+        trendRun = (step == 0) ? 0 : (step == direction) ? trendRun + 1 : 1;
+        alternatingRun = (step == 0) ? 0 : (step == -direction) ? alternatingRun + 1 : 1;
+        direction = step;
+        previous = mean;
+
+        above1 = (above1 << 1) | (z > 1.0);
+        below1 = (below1 << 1) | (z < -1.0);
+        above2 = (above2 << 1) | (z > 2.0);
+        below2 = (below2 << 1) | (z < -2.0);
+        withinRun = (std::abs(z) < 1.0) ? withinRun + 1 : 0;
+        outsideRun = (std::abs(z) > 1.0) ? outsideRun + 1 : 0;
+
+        quint32 rules = 0;
+        if (std::abs(z) > 3.0)
+            rules |= BeyondLimitsRule;
+        if (std::abs(sideRun) >= 9)
+            rules |= SameSideRule;
+        if (trendRun >= 5)
+            rules |= TrendRule;
+        if (alternatingRun >= 13)
+            rules |= AlternatingRule;
+        if ((z > 2.0 && count(above2 & 0x7) >= 2) || (z < -2.0 && count(below2 & 0x7) >= 2))
+            rules |= TwoOfThreeRule;
+        if ((z > 1.0 && count(above1 & 0x1f) >= 4) || (z < -1.0 && count(below1 & 0x1f) >= 4))
+            rules |= FourOfFiveRule;
+        if (withinRun >= 15)
+            rules |= StratificationRule;
+        if (outsideRun >= 8 && (above1 & 0xff) != 0 && (below1 & 0xff) != 0)
+            rules |= MixtureRule;
+        if (range > rangeUpper || range < rangeLower)
+            rules |= RangeRule;
+        return rules;
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+
+#include <vector>
+
+namespace CtqTool
+{
+    // The Western Electric and Nelson run rules on the subgroup means, by
+    // their Nelson number, and the limits of the range chart.
+    enum SpcRule : quint32
+    {
+        BeyondLimitsRule = 1 << 0,      // 1: a mean beyond 3 sigma
+        SameSideRule = 1 << 1,          // 2: nine on the same side of the center line
+        TrendRule = 1 << 2,             // 3: six steadily increasing or decreasing
+        AlternatingRule = 1 << 3,       // 4: fourteen alternating up and down
+        TwoOfThreeRule = 1 << 4,        // 5: two out of three beyond 2 sigma on the same side
+        FourOfFiveRule = 1 << 5,        // 6: four out of five beyond 1 sigma on the same side
+        StratificationRule = 1 << 6,    // 7: fifteen within 1 sigma
+        MixtureRule = 1 << 7,           // 8: eight beyond 1 sigma, on both sides
+        RangeRule = 1 << 8              // a range outside the R chart limits
+    };
+
+    // "1, 5, R"
+    QString SpcRuleNumbers(quint32 rules);
+    QString SpcRuleDescriptions(quint32 rules);
+
+    struct SpcViolation
+    {
+        quint64 subgroup = 0;
+        quint32 rules = 0;  // the rules this subgroup started violating
+        double mean = 0.0;
+        double range = 0.0;
+    };
+
+    // An X-bar/R chart fed one sample at a time. The samples form subgroups
+    // of a fixed size; the first subgroups set the center lines and limits,
+    // after which every subgroup is checked against all rules. Each rule
+    // keeps a run length or a few bits of history, so a sample costs the
+    // same however long the chart runs.
+    class SpcChart
+    {
+    public:
+        struct Pending
+        {
+            std::vector<SpcViolation> violations;
+            size_t dropped = 0; // beyond maxPending
+        };
+
+        static constexpr size_t maxPending = 1024;
+
+        // subgroup sizes are limited to 2 to 10
+        explicit SpcChart(size_t subgroupSize = 5, size_t baselineSubgroups = 25);
+
+        void Append(const double* values, size_t count);
+
+        bool IsCalibrated() const;
+        double GetCenter() const;
+        double GetSigma() const; // of the subgroup means
+        double GetRangeCenter() const;
+        quint64 GetSubgroupCount() const;
+
+        // the rules violated by the last subgroup
+        quint32 GetActiveRules() const;
+
+        // the violations since the last call
+        Pending TakeViolations();
+
+    private:
+        void AddSubgroup(double mean, double range);
+        quint32 Evaluate(double mean, double range);
+
+        size_t subgroupSize;
+        size_t baselineSubgroups;
+        double d2;
+        double d3;
+
+        // the subgroup being filled
+        size_t filled = 0;
+        double sum = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+
+        quint64 subgroups = 0;
+        double baselineMeans = 0.0;
+        double baselineRanges = 0.0;
+        bool calibrated = false;
+        double center = 0.0;
+        double sigma = 0.0;
+        double rangeCenter = 0.0;
+        double rangeLower = 0.0;
+        double rangeUpper = 0.0;
+
+        // rule state
+        double previous = 0.0;
+        int direction = 0;
+        int sideRun = 0;            // positive above the center line, negative below
+        int trendRun = 0;
+        int alternatingRun = 0;
+        int withinRun = 0;
+        int outsideRun = 0;
+        quint32 above1 = 0;         // bit i: the i-th last mean was beyond 1 sigma above
+        quint32 below1 = 0;
+        quint32 above2 = 0;
+        quint32 below2 = 0;
+        quint32 active = 0;
+
+        Pending pending;
+    };
+}
@@ -0,0 +1,650 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sqlstore.h"
+#include "ctq.h"
+#include "item.h"
+#include "journal.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QVariant>
+
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto textColumn = 0;
+    constexpr auto noteColumn = 1;
+    constexpr auto rankColumn = 2;
+    constexpr auto transferColumn = 3;
+    constexpr auto placeholder = "[not set]"; // as for rows inserted in a tree
+
+    int connections = 0;
+
+    const char* const schema[] = {
+        "PRAGMA journal_mode = WAL",
+        "PRAGMA synchronous = NORMAL",
+        "CREATE TABLE IF NOT EXISTS node (id INTEGER PRIMARY KEY, parent INTEGER, row INTEGER NOT NULL, "
+            "depth INTEGER NOT NULL, text TEXT NOT NULL, note TEXT NOT NULL, rank INTEGER NOT NULL DEFAULT 0, "
+            "weight REAL NOT NULL DEFAULT 1, transfer TEXT NOT NULL DEFAULT '', children INTEGER NOT NULL DEFAULT 0, "
+            "lower REAL, nominal REAL, upper REAL, units TEXT NOT NULL DEFAULT '')",
+        "CREATE TABLE IF NOT EXISTS closure (ancestor INTEGER NOT NULL, descendant INTEGER NOT NULL, "
+            "distance INTEGER NOT NULL, PRIMARY KEY (ancestor, descendant)) WITHOUT ROWID"
+    };
+
+    // the target columns, added to databases created before they were stored
+    const std::pair<const char*, const char*> targetColumns[] = {
+        {"lower", "ALTER TABLE node ADD COLUMN lower REAL"},
+        {"nominal", "ALTER TABLE node ADD COLUMN nominal REAL"},
+        {"upper", "ALTER TABLE node ADD COLUMN upper REAL"},
+        {"units", "ALTER TABLE node ADD COLUMN units TEXT NOT NULL DEFAULT ''"}
+    };
+
+    // dropped while a whole tree is written, and created again afterwards
+    const char* const nodeIndexes[] = {
+        "CREATE INDEX IF NOT EXISTS node_children ON node (parent, row)",
+        "CREATE INDEX IF NOT EXISTS node_level ON node (depth, parent, row)",
+        "CREATE INDEX IF NOT EXISTS node_text ON node (text)"
+    };
+    constexpr auto closureIndex = "CREATE INDEX IF NOT EXISTS closure_descendant ON closure (descendant)";
+    const char* const clear[] = {
+        "DELETE FROM closure",
+        "DELETE FROM node",
+        "DROP INDEX IF EXISTS node_children",
+        "DROP INDEX IF EXISTS node_level",
+        "DROP INDEX IF EXISTS node_text",
+        "DROP INDEX IF EXISTS closure_descendant"
+    };
+
+    // read into a NodeStore::Node, in this order
+    const QString nodeColumns = "n.id, n.text, n.note, n.rank, n.weight, n.transfer, n.children, "
+        "n.lower, n.nominal, n.upper, n.units";
+
+    // NULL for a missing limit or nominal value
+    QVariant toVariant(std::optional<double> value)
+    {
+        return value ? QVariant(*value) : QVariant();
+    }
+
+    std::optional<double> toOptional(const QVariant& value)
+    {
+        if (value.isNull())
+        {
+            return std::nullopt;
+        }
+        return value.toDouble();
+    }
+
+    // the target columns from column first on
+    void readTarget(const QSqlQuery& query, int first, ItemLine& line)
+    {
+        line.lower = toOptional(query.value(first));
+        line.nominal = toOptional(query.value(first + 1));
+        line.upper = toOptional(query.value(first + 2));
+        line.units = query.value(first + 3).toString();
+    }
+
+    bool run(QSqlQuery& query, std::initializer_list<QVariant> values)
+    {
+        auto i = 0;
+        for (const auto& value : values)
+        {
+            query.bindValue(i++, value);
+        }
+        return query.exec();
+    }
+
+    // positioned on the first row, if there is one
+    bool first(QSqlQuery& query, std::initializer_list<QVariant> values)
+    {
+        return run(query, values) && query.next();
+    }
+
+    std::vector<NodeStore::Node> fetch(QSqlQuery& query, std::initializer_list<QVariant> values)
+    {
+        std::vector<NodeStore::Node> nodes;
+        if (run(query, values))
+        {
+            while (query.next())
+            {
+                NodeStore::Node node;
+                node.id = query.value(0).toULongLong();
+                node.item.text = query.value(1).toString();
+                node.item.note = query.value(2).toString();
+                node.item.rank = static_cast<unsigned short>(query.value(3).toUInt());
+                node.item.weight = query.value(4).toDouble();
+                node.item.transfer = query.value(5).toString();
+                node.childCount = query.value(6).toInt();
+                readTarget(query, 7, node.item);
+                nodes.push_back(std::move(node));
+            }
+        }
+        query.finish();
+        return nodes;
+    }
+
+    QString globPrefix(const QString& prefix)
+    {
+        QString pattern;
+        pattern.reserve(prefix.size() + 1);
+        for (const auto c : prefix)
+        {
+            if (c == '*' || c == '?' || c == '[')
+            {
+                pattern.append('[').append(c).append(']');
+            }
+            else
+            {
+                pattern.append(c);
+            }
+        }
+        return pattern.append('*');
+    }
+
+    // in preorder, so that the ids of a subtree follow that of its root; the
+    // closure is derived a level of ancestors at a time rather than per node
+    bool writeTree(QSqlDatabase& db, const TreeItem& root)
+    {
+        QSqlQuery query(db);
+        for (const auto* statement : clear)
+        {
+            if (!query.exec(statement))
+            {
+                return false;
+            }
+        }
+
+        QSqlQuery insert(db);
+        if (!insert.prepare("INSERT INTO node (id, parent, row, depth, text, note, rank, weight, transfer, children, "
+            "lower, nominal, upper, units) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"))
+        {
+            return false;
+        }
+
+        struct Pending
+        {
+            const TreeItem* item;
+            QVariant parent;
+            int row;
+            int depth;
+        };
+        std::vector<Pending> stack{{&root, QVariant(), 0, 0}};
+        const Target none;
+        qint64 id = 0;
+        auto height = 0;
+        while (!stack.empty())
+        {
+            const auto [item, parent, row, depth] = stack.back();
+            stack.pop_back();
+            const auto& data = *item->GetData();
+            const auto* ctq = dynamic_cast<const Ctq*>(&data);
+            const auto& target = ctq != nullptr ? ctq->GetMeasurement().GetTarget() : none;
+            if (!run(insert, {++id, parent, row, depth, data.GetText(), data.GetNote(), item->GetRank(),
+                item->GetWeight(), item->GetTransfer(), item->ChildCount(), toVariant(target.GetLowerLimit()),
+                toVariant(target.GetNominal()), toVariant(target.GetUpperLimit()), target.GetUnits()}))
+            {
+                return false;
+            }
+            height = std::max(height, depth);
+            for (auto r = item->ChildCount() - 1; r >= 0; --r)
+            {
+                stack.push_back({item->GetChild(r).get(), id, r, depth + 1});
+            }
+        }
+
+        for (const auto* statement : nodeIndexes)
+        {
+            if (!query.exec(statement))
+            {
+                return false;
+            }
+        }
+        if (!query.exec("INSERT INTO closure (ancestor, descendant, distance) SELECT id, id, 0 FROM node"))
+        {
+            return false;
+        }
+        QSqlQuery ancestors(db);
+        if (!ancestors.prepare("INSERT INTO closure (ancestor, descendant, distance) "
+            "SELECT n.parent, c.descendant, c.distance + 1 FROM closure c JOIN node n ON n.id = c.ancestor "
+            "WHERE c.distance = ? AND n.parent IS NOT NULL ORDER BY 1, 2"))
+        {
+            return false;
+        }
+        for (auto distance = 1; distance <= height; ++distance)
+        {
+            if (!run(ancestors, {distance - 1}))
+            {
+                return false;
+            }
+        }
+        return query.exec(closureIndex);
+    }
+}
+
+namespace CtqTool
+{
+    struct SqlStore::Queries
+    {
+        explicit Queries(const QSqlDatabase& db) :
+            children(db), subtree(db), level(db), search(db), ancestry(db), child(db), node(db),
+            setText(db), setNote(db), setRank(db), setTransfer(db), setTarget(db), link(db),
+            shift(db), insert(db), insertClosure(db), addChildren(db), removeNodes(db), removeClosure(db)
+        {
+        }
+
+        QSqlQuery children;
+        QSqlQuery subtree;
+        QSqlQuery level;
+        QSqlQuery search;
+        QSqlQuery ancestry;
+        QSqlQuery child;                        // the id at a row
+        QSqlQuery node;                         // depth and number of children
+        QSqlQuery setText;
+        QSqlQuery setNote;
+        QSqlQuery setRank;                      // of a whole subtree
+        QSqlQuery setTransfer;
+        QSqlQuery setTarget;
+        QSqlQuery link;
+        QSqlQuery shift;                        // the rows of a parent from a row on
+        QSqlQuery insert;
+        QSqlQuery insertClosure;
+        QSqlQuery addChildren;
+        QSqlQuery removeNodes;                  // of a subtree
+        QSqlQuery removeClosure;
+    };
+
+    SqlStore::SqlStore(QString f, QString c) :
+        filename(std::move(f)),
+        connection(std::move(c))
+    {
+    }
+
+    SqlStore::~SqlStore()
+    {
+        // the connection can only go once nothing uses it
+        queries.reset();
+        QSqlDatabase::database(connection, false).close();
+        QSqlDatabase::removeDatabase(connection);
+    }
+
+    std::unique_ptr<SqlStore> SqlStore::Open(const QString& filename)
+    {
+        std::unique_ptr<SqlStore> store(new SqlStore(filename, QString("ctqtool-store-%1").arg(++connections)));
+        {
+            auto db = QSqlDatabase::addDatabase("QSQLITE", store->connection);
+            db.setDatabaseName(filename);
+            if (!db.open())
+            {
+                return nullptr;
+            }
+        }
+        if (!store->Prepare())
+        {
+            return nullptr;
+        }
+        return store;
+    }
+
+    bool SqlStore::Prepare()
+    {
+        auto db = QSqlDatabase::database(connection, false);
+        QSqlQuery query(db);
+        for (const auto* statement : schema)
+        {
+            if (!query.exec(statement))
+            {
+                return false;
+            }
+        }
+        QStringList columns;
+        if (!query.exec("PRAGMA table_info(node)"))
+        {
+            return false;
+        }
+        while (query.next())
+        {
+            columns.append(query.value(1).toString());
+        }
+        for (const auto& [column, statement] : targetColumns)
+        {
+            if (!columns.contains(column) && !query.exec(statement))
+            {
+                return false;
+            }
+        }
+        for (const auto* statement : nodeIndexes)
+        {
+            if (!query.exec(statement))
+            {
+                return false;
+            }
+        }
+        if (!query.exec(closureIndex))
+        {
+            return false;
+        }
+
+        queries = std::make_unique<Queries>(db);
+        auto& q = *queries;
+        for (auto* select : {&q.children, &q.subtree, &q.level, &q.search, &q.ancestry, &q.child, &q.node})
+        {
+            select->setForwardOnly(true);
+        }
+        const std::pair<QSqlQuery*, QString> statements[] = {
+            {&q.children, "SELECT " + nodeColumns + " FROM node n WHERE n.parent = ? AND n.row >= ? ORDER BY n.row LIMIT ?"},
+            {&q.subtree, "SELECT " + nodeColumns + " FROM closure c JOIN node n ON n.id = c.descendant "
+                "WHERE c.ancestor = ? ORDER BY c.distance, n.parent, n.row"},
+            {&q.level, "SELECT " + nodeColumns + " FROM node n WHERE n.depth = ? ORDER BY n.parent, n.row LIMIT ? OFFSET ?"},
+            {&q.search, "SELECT " + nodeColumns + " FROM node n WHERE n.text GLOB ? ORDER BY n.text LIMIT ?"},
+            {&q.ancestry, "SELECT ancestor FROM closure WHERE descendant = ? ORDER BY distance DESC"},
+            {&q.child, "SELECT id FROM node WHERE parent = ? AND row = ?"},
+            {&q.node, "SELECT depth, children FROM node WHERE id = ?"},
+            {&q.setText, "UPDATE node SET text = ? WHERE id = ?"},
+            {&q.setNote, "UPDATE node SET note = ? WHERE id = ?"},
+            {&q.setRank, "UPDATE node SET rank = ? WHERE id IN (SELECT descendant FROM closure WHERE ancestor = ?)"},
+            {&q.setTransfer, "UPDATE node SET transfer = ? WHERE id = ?"},
+            {&q.setTarget, "UPDATE node SET lower = ?, nominal = ?, upper = ?, units = ? WHERE id = ?"},
+            {&q.link, "UPDATE node SET (text, note, lower, nominal, upper, units) = "
+                "(SELECT text, note, lower, nominal, upper, units FROM node WHERE id = ?) WHERE id = ?"},
+            {&q.shift, "UPDATE node SET row = row + ? WHERE parent = ? AND row >= ?"},
+            {&q.insert, "INSERT INTO node (parent, row, depth, text, note) VALUES (?, ?, ?, ?, ?)"},
+            {&q.insertClosure, "INSERT INTO closure (ancestor, descendant, distance) "
+                "SELECT ancestor, ?, distance + 1 FROM closure WHERE descendant = ? UNION ALL SELECT ?, ?, 0"},
+            {&q.addChildren, "UPDATE node SET children = children + ? WHERE id = ?"},
+            {&q.removeNodes, "DELETE FROM node WHERE id IN (SELECT descendant FROM closure WHERE ancestor = ?)"},
+            {&q.removeClosure, "DELETE FROM closure WHERE descendant IN (SELECT descendant FROM closure WHERE ancestor = ?)"}
+        };
+        for (const auto& [statement, sql] : statements)
+        {
+            if (!statement->prepare(sql))
+            {
+                return false;
+            }
+        }
+
+        // a new database holds an empty tree
+        if (query.exec("SELECT id FROM node WHERE parent IS NULL") && query.next())
+        {
+            root = query.value(0).toULongLong();
+            return true;
+        }
+        if (!query.exec("INSERT INTO node (parent, row, depth, text, note) VALUES (NULL, 0, 0, 'Title', 'Note')"))
+        {
+            return false;
+        }
+        root = query.lastInsertId().toULongLong();
+        return run(q.insertClosure, {root, root, root, root});
+    }
+
+    const QString& SqlStore::GetFilename() const
+    {
+        return filename;
+    }
+
+    NodeStore::Id SqlStore::GetRoot() const
+    {
+        return root;
+    }
+
+    int SqlStore::ChildCount(Id id) const
+    {
+        auto& query = queries->node;
+        const auto count = first(query, {id}) ? query.value(1).toInt() : 0;
+        query.finish();
+        return count;
+    }
+
+    std::vector<NodeStore::Node> SqlStore::GetChildren(Id parent, int from, int count) const
+    {
+        return fetch(queries->children, {parent, from, count});
+    }
+
+    std::vector<NodeStore::Node> SqlStore::GetSubtree(Id id) const
+    {
+        return fetch(queries->subtree, {id});
+    }
+
+    std::vector<NodeStore::Node> SqlStore::GetLevel(int depth, int from, int count) const
+    {
+        return fetch(queries->level, {depth, count, from});
+    }
+
+    std::vector<NodeStore::Node> SqlStore::Search(const QString& prefix, int limit) const
+    {
+        return fetch(queries->search, {globPrefix(prefix), limit});
+    }
+
+    std::vector<NodeStore::Id> SqlStore::GetAncestry(Id id) const
+    {
+        auto& query = queries->ancestry;
+        std::vector<Id> ids;
+        if (run(query, {id}))
+        {
+            while (query.next())
+            {
+                ids.push_back(query.value(0).toULongLong());
+            }
+        }
+        query.finish();
+        return ids;
+    }
+
+    std::unique_ptr<TreeItem> SqlStore::Read() const
+    {
+        QSqlQuery query(QSqlDatabase::database(connection, false));
+        query.setForwardOnly(true);
+        if (!query.exec("SELECT id, parent, depth, text, note, rank, weight, transfer, lower, nominal, upper, units "
+            "FROM node ORDER BY depth, parent, row"))
+        {
+            return nullptr;
+        }
+
+        // parents come before their children, which come by row
+        std::unique_ptr<TreeItem> tree;
+        std::unordered_map<qint64, TreeItem*> items;
+        while (query.next())
+        {
+            ItemLine line;
+            line.text = query.value(3).toString();
+            line.note = query.value(4).toString();
+            line.rank = static_cast<unsigned short>(query.value(5).toUInt());
+            line.weight = query.value(6).toDouble();
+            line.transfer = query.value(7).toString();
+            readTarget(query, 8, line);
+            const auto id = query.value(0).toLongLong();
+            if (!tree)
+            {
+                tree = std::make_unique<TreeItem>(std::make_shared<ItemData>(line.text, line.note), nullptr);
+                items.emplace(id, tree.get());
+                continue;
+            }
+
+            const auto parent = items.find(query.value(1).toLongLong());
+            if (parent == items.end())
+            {
+                return nullptr;
+            }
+            auto item = MakeTreeItem(line, query.value(2).toInt(), parent->second);
+            items.emplace(id, item.get());
+            parent->second->Append(std::move(item));
+        }
+        return tree;
+    }
+
+    bool SqlStore::Write(const TreeItem& tree)
+    {
+        auto db = QSqlDatabase::database(connection, false);
+        if (!db.transaction())
+        {
+            return false;
+        }
+        if (!writeTree(db, tree) || !db.commit())
+        {
+            db.rollback();
+            return false;
+        }
+        root = 1;
+        return true;
+    }
+
+    bool SqlStore::Apply(const std::vector<JournalRecord>& records)
+    {
+        if (records.empty())
+        {
+            return true;
+        }
+
+        auto db = QSqlDatabase::database(connection, false);
+        if (!db.transaction())
+        {
+            return false;
+        }
+        const auto applied = std::all_of(records.begin(), records.end(), [this](const auto& r) { return Run(r); });
+        if (!applied || !db.commit())
+        {
+            db.rollback();
+            return false;
+        }
+        return true;
+    }
+
+    bool SqlStore::Resolve(const std::vector<int>& path, Id& id) const
+    {
+        auto& query = queries->child;
+        id = root;
+        for (const auto row : path)
+        {
+            if (!first(query, {id, row}))
+            {
+                query.finish();
+                return false;
+            }
+            id = query.value(0).toULongLong();
+        }
+        query.finish();
+        return true;
+    }
+
+    // as Apply does on a tree
+    bool SqlStore::Run(const JournalRecord& record)
+    {
+        auto& q = *queries;
+        Id id = 0;
+        if (!Resolve(record.path, id))
+        {
+            return false;
+        }
+
+        switch (record.operation)
+        {
+        case JournalRecord::Operation::SetData:
+            switch (record.column)
+            {
+            case textColumn:
+                return run(q.setText, {record.value, id});
+            case noteColumn:
+                return run(q.setNote, {record.value, id});
+            case rankColumn:
+                return run(q.setRank, {record.value.toInt(), id});
+            case transferColumn:
+                return run(q.setTransfer, {record.value, id});
+            default:
+                return true;
+            }
+        case JournalRecord::Operation::Insert:
+        case JournalRecord::Operation::Remove:
+        {
+            if (!first(q.node, {id}))
+            {
+                return false;
+            }
+            const auto depth = q.node.value(0).toInt();
+            const auto children = q.node.value(1).toInt();
+            q.node.finish();
+
+            const auto position = record.column;
+            const auto count = record.count;
+            if (record.operation == JournalRecord::Operation::Insert)
+            {
+                if (position < 0 || position > children || count < 0 || !run(q.shift, {count, id, position}))
+                {
+                    return false;
+                }
+                for (auto i = 0; i < count; ++i)
+                {
+                    if (!run(q.insert, {id, position + i, depth + 1, placeholder, placeholder}))
+                    {
+                        return false;
+                    }
+                    const auto child = q.insert.lastInsertId();
+                    if (!run(q.insertClosure, {child, id, child, child}))
+                    {
+                        return false;
+                    }
+                }
+                return run(q.addChildren, {count, id});
+            }
+
+            if (position < 0 || count < 0 || position + count > children)
+            {
+                return false;
+            }
+            std::vector<Id> removed;
+            for (auto row = position; row < position + count; ++row)
+            {
+                if (!first(q.child, {id, row}))
+                {
+                    return false;
+                }
+                removed.push_back(q.child.value(0).toULongLong());
+                q.child.finish();
+            }
+            for (const auto child : removed)
+            {
+                // the nodes first, while the closure still tells which they are
+                if (!run(q.removeNodes, {child}) || !run(q.removeClosure, {child}))
+                {
+                    return false;
+                }
+            }
+            return run(q.shift, {-count, id, position + count}) && run(q.addChildren, {-count, id});
+        }
+        case JournalRecord::Operation::Link:
+        {
+            Id source = 0;
+            return Resolve(record.source, source) && run(q.link, {source, id});
+        }
+        case JournalRecord::Operation::SetTarget:
+        {
+            ItemLine line;
+            for (const auto& column : record.value.split('\t', Qt::SkipEmptyParts))
+            {
+                ParseTargetColumn(column, line);
+            }
+            return run(q.setTarget, {toVariant(line.lower), toVariant(line.nominal), toVariant(line.upper), line.units, id});
+        }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "nodestore.h"
+
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+namespace CtqTool
+{
+    class TreeItem;
+    struct JournalRecord;
+
+    // A tree in an SQLite database: a table of nodes, each with its parent and
+    // row, and a closure table relating every node to each of its ancestors.
+    // Children, subtrees, levels and text prefixes are all found through
+    // indexes, with statements prepared once. Items sharing data are stored
+    // as copies, targets with their items, and measured samples not at all. A
+    // store is used from the thread that opened it.
+    class SqlStore : public NodeStore
+    {
+    public:
+        // opens or creates the database; null when it cannot be opened
+        static std::unique_ptr<SqlStore> Open(const QString& filename);
+        ~SqlStore();
+
+        const QString& GetFilename() const;
+
+        Id GetRoot() const override;
+        int ChildCount(Id) const override;
+        std::vector<Node> GetChildren(Id parent, int first, int count) const override;
+
+        // id and everything below it, nearest first
+        std::vector<Node> GetSubtree(Id) const;
+        // the items at a depth, grouped by parent
+        std::vector<Node> GetLevel(int depth, int first, int count) const;
+        // the items whose text starts with prefix, by text
+        std::vector<Node> Search(const QString& prefix, int limit) const;
+        // the ids from the root down to id, empty if there is no such item
+        std::vector<Id> GetAncestry(Id) const;
+
+        // the whole tree
+        std::unique_ptr<TreeItem> Read() const;
+        // replaces the contents with a tree, in one transaction
+        bool Write(const TreeItem& root);
+        // replays model edits in one transaction, all or none of them
+        bool Apply(const std::vector<JournalRecord>&);
+
+    private:
+        struct Queries;
+
+        SqlStore(QString filename, QString connection);
+        bool Prepare();
+        bool Run(const JournalRecord&);
+        bool Resolve(const std::vector<int>& path, Id&) const;
+
+        QString filename;
+        QString connection;
+        std::unique_ptr<Queries> queries;
+        Id root = 0;
+    };
+}
@@ -0,0 +1,212 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stackup.h"
+#include "ctq.h"
+#include "item.h"
+#include "montecarlo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr size_t trials = 1 << 14;
+    constexpr quint64 seed = 1;
+    constexpr auto tail = 0.00135; // beyond three sigma on either side
+    constexpr auto relativeStep = 1e-3;
+
+    // the same reading of the target as the simulation's
+    StackUp ctqStackUp(const Ctq& ctq, const ItemData& data)
+    {
+        const auto& target = ctq.GetMeasurement().GetTarget();
+        const auto l = target.GetLowerLimit();
+        const auto u = target.GetUpperLimit();
+        const auto n = target.GetNominal();
+
+        StackUp result;
+        if (l && u)
+        {
+            result.nominal = n.value_or((*l + *u) / 2);
+            result.worstCase = (*u - *l) / 2;
+        }
+        else if (n)
+        {
+            const auto limit = l ? l : u;
+            result.nominal = *n;
+            result.worstCase = limit ? std::abs(*limit - *n) : 0.0;
+        }
+        else
+        {
+            return {};
+        }
+        result.rss = result.worstCase;
+        result.statistical = result.worstCase;
+        if (data.GetOwners().size() > 1)
+        {
+            result.linked.emplace_back(&data, result.worstCase);
+        }
+        else
+        {
+            result.independentWorstCase = result.worstCase;
+            result.independentVariance = result.worstCase * result.worstCase;
+        }
+        return result;
+    }
+
+    // the linear part, from the children's stack-ups
+    StackUp compose(const TreeItem& item)
+    {
+        std::vector<const StackUp*> parts;
+        parts.reserve(item.ChildCount());
+        auto any = false;
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            parts.push_back(&item.GetChild(r)->GetStackUp());
+            any = any || parts.back()->nominal.has_value();
+        }
+        if (!any)
+        {
+            return {};
+        }
+
+        StackUp result;
+        std::unordered_map<const ItemData*, size_t> linkedIndex;
+        const auto add = [&](double sensitivity, const StackUp& part)
+        {
+            result.independentWorstCase += std::abs(sensitivity) * part.independentWorstCase;
+            result.independentVariance += sensitivity * sensitivity * part.independentVariance;
+            for (const auto& [data, width] : part.linked)
+            {
+                const auto [it, inserted] = linkedIndex.emplace(data, result.linked.size());
+                if (inserted)
+                {
+                    result.linked.emplace_back(data, 0.0);
+                }
+                result.linked[it->second].second += sensitivity * width;
+            }
+            result.nonlinear = result.nonlinear || part.nonlinear;
+        };
+
+        if (const auto transfer = item.GetCompiledTransfer())
+        {
+            // children without CTQs below them count as zero, as in the simulation
+            std::vector<double> x(parts.size());
+            for (size_t i = 0; i < parts.size(); ++i)
+            {
+                x[i] = parts[i]->nominal.value_or(0.0);
+            }
+            result.nominal = transfer->Evaluate(x.data());
+            result.nonlinear = true;
+
+            // central differences, a step small against the child's tolerance
+            for (size_t i = 0; i < parts.size(); ++i)
+            {
+                if (parts[i]->worstCase > 0.0)
+                {
+                    const auto h = relativeStep * parts[i]->worstCase;
+                    x[i] = *parts[i]->nominal + h;
+                    const auto up = transfer->Evaluate(x.data());
+                    x[i] = *parts[i]->nominal - h;
+                    const auto down = transfer->Evaluate(x.data());
+                    x[i] = *parts[i]->nominal;
+                    add((up - down) / (2 * h), *parts[i]);
+                }
+            }
+        }
+        else
+        {
+            auto nominal = 0.0;
+            for (size_t i = 0; i < parts.size(); ++i)
+            {
+                const auto w = item.GetChild(static_cast<int>(i))->GetWeight();
+                nominal += w * parts[i]->nominal.value_or(0.0);
+                add(w, *parts[i]);
+            }
+            result.nominal = nominal;
+        }
+
+        result.worstCase = result.independentWorstCase;
+        auto variance = result.independentVariance;
+        for (const auto& [data, width] : result.linked)
+        {
+            result.worstCase += std::abs(width);
+            variance += width * width;
+        }
+        result.rss = std::sqrt(variance);
+        if (!std::isfinite(*result.nominal) || !std::isfinite(result.worstCase) || !std::isfinite(result.rss))
+        {
+            return {};
+        }
+        return result;
+    }
+
+    // half the central 99.73% of the sampled subtree
+    double sampleStatistical(TreeItem& item)
+    {
+        auto values = SimulateTolerances(item, trials, seed);
+        values.erase(std::remove_if(values.begin(), values.end(), [](double v) { return !std::isfinite(v); }),
+            values.end());
+        if (values.empty())
+        {
+            return 0.0;
+        }
+        const auto last = values.size() - 1;
+        const auto low = values.begin() + static_cast<std::ptrdiff_t>(std::floor(tail * last));
+        const auto high = values.begin() + static_cast<std::ptrdiff_t>(std::ceil((1.0 - tail) * last));
+        std::nth_element(values.begin(), low, values.end());
+        const auto lowValue = *low;
+        std::nth_element(low, high, values.end());
+        return (*high - lowValue) / 2;
+    }
+}
+
+namespace CtqTool
+{
+    bool StackUp::operator==(const StackUp& other) const
+    {
+        return nominal == other.nominal && worstCase == other.worstCase && rss == other.rss &&
+            statistical == other.statistical;
+    }
+
+    bool StackUp::operator!=(const StackUp& other) const
+    {
+        return !(*this == other);
+    }
+
+    StackUp ComputeStackUp(TreeItem& item)
+    {
+        // a CTQ is a leaf, its statistical stack-up its tolerance
+        if (const auto* ctq = dynamic_cast<const Ctq*>(item.GetData().get()); ctq != nullptr)
+        {
+            return ctqStackUp(*ctq, *item.GetData());
+        }
+
+        auto result = compose(item);
+        if (result.nominal)
+        {
+            // a linear combination of normal CTQs is normal, with the RSS as three sigma
+            result.statistical = result.nonlinear ? sampleStatistical(item) : result.rss;
+        }
+        return result;
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace CtqTool
+{
+    class ItemData;
+    class TreeItem;
+
+    // How the tolerances of the CTQs below an item add up at that item. The
+    // widths are half widths around the nominal value.
+    struct StackUp
+    {
+        std::optional<double> nominal;  // none without toleranced CTQs below
+        double worstCase = 0.0;         // every CTQ at its limit at once
+        double rss = 0.0;               // root sum of squares
+        double statistical = 0.0;       // half the central 99.73% of simulated values
+
+        // For composing the parent's. CTQs shown by one item add up in the
+        // independent sums. A CTQ linked under several items varies as one
+        // wherever it shows, so its signed half width is kept per CTQ and
+        // added up before it is squared.
+        double independentWorstCase = 0.0;
+        double independentVariance = 0.0;
+        std::vector<std::pair<const ItemData*, double>> linked;
+        bool nonlinear = false;         // a transfer expression at or below the item
+
+        // of the columns shown
+        bool operator==(const StackUp&) const;
+        bool operator!=(const StackUp&) const;
+    };
+
+    // Worst case and RSS propagate linearly: through the weights or, for items
+    // with a transfer expression, through its sensitivities at the children's
+    // nominal values. The statistical stack-up takes every CTQ normally
+    // distributed around its nominal, its tolerance being three sigma. That
+    // makes it the RSS where everything below is linear; otherwise the subtree
+    // is sampled.
+    //
+    // Composed from the children's stack-ups, which must be valid, so items
+    // are computed children first. O(children) unless the subtree is sampled.
+    // Reads nothing outside the subtree and writes nothing, so items of one
+    // depth can be computed in parallel once their transfers are compiled.
+    StackUp ComputeStackUp(TreeItem&);
+}
@@ -0,0 +1,244 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "statistics.h"
+#include "measurement.h"
+#include "samplestore.h"
+#include "sketch.h"
+#include "target.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    using namespace CtqTool;
+
+    // independent accumulators, so the loops below vectorize without
+    // reassociating floating point additions
+    constexpr size_t lanes = 4;
+    constexpr auto infinity = std::numeric_limits<double>::infinity();
+
+    struct Partial
+    {
+        size_t count = 0;
+        double mean = 0.0;
+        double m2 = 0.0; // sum of squared deviations from mean
+        double min = infinity;
+        double max = -infinity;
+        size_t outside = 0;
+    };
+
+    // Chan et al.'s pairwise update of Welford's running mean and variance
+    void merge(Partial& a, const Partial& b)
+    {
+        if (b.count == 0)
+        {
+            return;
+        }
+        const auto count = a.count + b.count;
+        const auto delta = b.mean - a.mean;
+        a.mean += delta * b.count / count;
+        a.m2 += b.m2 + delta * delta * (static_cast<double>(a.count) * b.count / count);
+        a.min = std::min(a.min, b.min);
+        a.max = std::max(a.max, b.max);
+        a.outside += b.outside;
+        a.count = count;
+    }
+
+    // one pass over a chunk, with Welford's running update in each lane;
+    // the lanes see the same count, so that one division serves them all
+    Partial scan(const double* x, size_t n, double lower, double upper)
+    {
+        Partial p;
+        if (n == 0)
+        {
+            return p;
+        }
+
+        double mean[lanes] = {};
+        double m2[lanes] = {};
+        double lo[lanes] = {infinity, infinity, infinity, infinity};
+        double hi[lanes] = {-infinity, -infinity, -infinity, -infinity};
+        size_t outside[lanes] = {};
+        size_t i = 0;
+        size_t count = 0;
+        for (; i + lanes <= n; i += lanes)
+        {
+            const auto weight = 1.0 / ++count;
+            for (size_t k = 0; k < lanes; ++k)
+            {
+                const auto v = x[i + k];
+                const auto d = v - mean[k];
+                mean[k] += d * weight;
+                m2[k] += d * (v - mean[k]);
+                lo[k] = std::min(lo[k], v);
+                hi[k] = std::max(hi[k], v);
+                outside[k] += (v < lower) | (v > upper);
+            }
+        }
+
+        p.count = count;
+        p.mean = mean[0];
+        p.m2 = m2[0];
+        for (size_t k = 1; k < lanes; ++k)
+        {
+            merge(p, {count, mean[k], m2[k]});
+        }
+        for (; i < n; ++i)
+        {
+            const auto v = x[i];
+            const auto d = v - p.mean;
+            p.mean += d / ++p.count;
+            p.m2 += d * (v - p.mean);
+            lo[0] = std::min(lo[0], v);
+            hi[0] = std::max(hi[0], v);
+            outside[0] += (v < lower) | (v > upper);
+        }
+        p.min = std::min(std::min(lo[0], lo[1]), std::min(lo[2], lo[3]));
+        p.max = std::max(std::max(hi[0], hi[1]), std::max(hi[2], hi[3]));
+        p.outside = (outside[0] + outside[1]) + (outside[2] + outside[3]);
+        return p;
+    }
+
+    Partial partialOf(const Statistics& s)
+    {
+        Partial p;
+        if (s.count > 0)
+        {
+            p.count = s.count;
+            p.mean = s.mean;
+            p.m2 = s.stddev * s.stddev * (s.count - 1);
+            p.min = s.min;
+            p.max = s.max;
+            p.outside = static_cast<size_t>(std::llround(s.ppm * s.count / 1e6));
+        }
+        return p;
+    }
+
+    Statistics statisticsOf(const Partial& p, const Target& target)
+    {
+        const auto lower = target.GetLowerLimit();
+        const auto upper = target.GetUpperLimit();
+
+        Statistics s;
+        s.count = p.count;
+        if (s.count == 0)
+        {
+            return s;
+        }
+
+        s.mean = p.mean;
+        s.stddev = (s.count > 1) ? std::sqrt(std::max(p.m2, 0.0) / (s.count - 1)) : 0.0;
+        s.min = p.min;
+        s.max = p.max;
+        s.ppm = 1e6 * p.outside / s.count;
+
+        if (s.stddev > 0.0)
+        {
+            if (lower && upper)
+            {
+                s.cp = (*upper - *lower) / (6.0 * s.stddev);
+            }
+            if (upper)
+            {
+                s.cpk = (*upper - s.mean) / (3.0 * s.stddev);
+            }
+            if (lower)
+            {
+                const auto cpl = (s.mean - *lower) / (3.0 * s.stddev);
+                s.cpk = s.cpk ? std::min(*s.cpk, cpl) : cpl;
+            }
+        }
+        return s;
+    }
+
+    // against another target, counting those outside it by their ranks in a sketch
+    Statistics restate(const Statistics& s, const Target& target, const QuantileSketch& sketch)
+    {
+        auto p = partialOf(s);
+        const auto lower = target.GetLowerLimit();
+        const auto upper = target.GetUpperLimit();
+        const auto below = lower ? sketch.Rank(std::nextafter(*lower, -infinity)) : 0.0;
+        const auto above = upper ? 1.0 - sketch.Rank(*upper) : 0.0;
+        p.outside = static_cast<size_t>(std::llround(std::clamp(below + above, 0.0, 1.0) * p.count));
+        return statisticsOf(p, target);
+    }
+}
+
+namespace CtqTool
+{
+    Statistics ComputeStatistics(const SampleStore& samples, const Target& target)
+    {
+        return ExtendStatistics({}, samples, target);
+    }
+
+    Statistics ExtendStatistics(const Statistics& previous, const SampleStore& samples, const Target& target)
+    {
+        const auto lower = target.GetLowerLimit().value_or(-infinity);
+        const auto upper = target.GetUpperLimit().value_or(infinity);
+
+        // the previous statistics as a partial result, if they still describe a prefix of the samples
+        auto total = (previous.count <= samples.Size()) ? partialOf(previous) : Partial();
+        for (auto c = total.count / SampleStore::chunkCapacity; c < samples.ChunkCount(); ++c)
+        {
+            const auto& chunk = samples.GetChunk(c);
+            const auto skip = std::min(chunk.size, total.count - std::min(total.count, c * SampleStore::chunkCapacity));
+            merge(total, scan(chunk.values + skip, chunk.size - skip, lower, upper));
+        }
+        return statisticsOf(total, target);
+    }
+
+    Statistics ComputeStatistics(const Measurement& measurement, const Target& target)
+    {
+        if (measurement.KeepsSamples())
+        {
+            return ComputeStatistics(measurement.GetSamples(), target);
+        }
+        return measurement.GetRunningStatistics().Get(target, measurement.GetDistribution().GetSketch());
+    }
+
+    Statistics ExtendStatistics(const Statistics& previous, const Measurement& measurement)
+    {
+        if (measurement.KeepsSamples())
+        {
+            return ExtendStatistics(previous, measurement.GetSamples(), measurement.GetTarget());
+        }
+        return ComputeStatistics(measurement, measurement.GetTarget());
+    }
+
+    void RunningStatistics::Reset(const Statistics& s, const Target& target)
+    {
+        statistics = s;
+        revision = target.GetRevision();
+    }
+
+    void RunningStatistics::Add(const double* values, size_t count, const Target& target, const QuantileSketch& before)
+    {
+        auto total = partialOf(Get(target, before));
+        merge(total, scan(values, count, target.GetLowerLimit().value_or(-infinity), target.GetUpperLimit().value_or(infinity)));
+        statistics = statisticsOf(total, target);
+        revision = target.GetRevision();
+    }
+
+    Statistics RunningStatistics::Get(const Target& target, const QuantileSketch& sketch) const
+    {
+        return (revision == target.GetRevision()) ? statistics : restate(statistics, target, sketch);
+    }
+}
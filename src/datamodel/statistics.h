@@ -0,0 +1,69 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <optional>
+
+namespace CtqTool
+{
+    class Measurement;
+    class QuantileSketch;
+    class SampleStore;
+    class Target;
+
+    struct Statistics
+    {
+        size_t count = 0;
+        double mean = 0.0;
+        double stddev = 0.0;   // sample standard deviation
+        double min = 0.0;
+        double max = 0.0;
+        std::optional<double> cp;   // needs both limits
+        std::optional<double> cpk;
+        double ppm = 0.0;      // observed parts per million out of specification
+    };
+
+    Statistics ComputeStatistics(const SampleStore&, const Target&);
+
+    // as ComputeStatistics, scanning only the samples appended since the
+    // previous statistics were computed against the same target
+    Statistics ExtendStatistics(const Statistics& previous, const SampleStore&, const Target&);
+
+    // the same for a measurement, which may keep no samples
+    Statistics ComputeStatistics(const Measurement&, const Target&);
+    Statistics ExtendStatistics(const Statistics& previous, const Measurement&);
+
+    // Statistics of samples that are not kept, taken as they are appended.
+    // They are exact, but for the share out of specification once the target
+    // changed, which is then restated from a sketch of the samples before.
+    class RunningStatistics
+    {
+    public:
+        // from the statistics of the samples kept so far
+        void Reset(const Statistics&, const Target&);
+        void Add(const double*, size_t count, const Target&, const QuantileSketch& before);
+        Statistics Get(const Target&, const QuantileSketch&) const;
+
+    private:
+        Statistics statistics;
+        quint64 revision = 0;
+    };
+}
@@ -29,4 +29,52 @@ namespace CtqTool
     {
         description = std::move(s);
     }
+
+    std::optional<double> Target::GetLowerLimit() const
+    {
+        return lower;
+    }
+
+    std::optional<double> Target::GetUpperLimit() const
+    {
+        return upper;
+    }
+
+    void Target::SetLowerLimit(std::optional<double> l)
+    {
+        lower = l;
+        ++revision;
+    }
+
+    void Target::SetUpperLimit(std::optional<double> u)
+    {
+        upper = u;
+        ++revision;
+    }
+
+    std::optional<double> Target::GetNominal() const
+    {
+        return nominal;
+    }
+
+    void Target::SetNominal(std::optional<double> n)
+    {
+        nominal = n;
+        ++revision;
+    }
+
+    const QString& Target::GetUnits() const
+    {
+        return units;
+    }
+
+    void Target::SetUnits(QString s)
+    {
+        units = std::move(s);
+    }
+
+    quint64 Target::GetRevision() const
+    {
+        return revision;
+    }
 }
\ No newline at end of file
@@ -20,6 +20,8 @@
 
 #include "item.h"
 
+#include <optional>
+
 namespace CtqTool
 {
     class Target
@@ -28,7 +30,27 @@ namespace CtqTool
         const QString& GetDescription() const;
         void SetDescription(QString);
 
+        // the specification limits; a missing limit is one-sided
+        std::optional<double> GetLowerLimit() const;
+        std::optional<double> GetUpperLimit() const;
+        void SetLowerLimit(std::optional<double>);
+        void SetUpperLimit(std::optional<double>);
+
+        std::optional<double> GetNominal() const;
+        void SetNominal(std::optional<double>);
+
+        const QString& GetUnits() const;
+        void SetUnits(QString);
+
+        // changes whenever a limit or the nominal value does
+        quint64 GetRevision() const;
+
     private:
         QString description;
+        QString units;
+        std::optional<double> lower;
+        std::optional<double> nominal;
+        std::optional<double> upper;
+        quint64 revision = 0;
     };
 }
@@ -0,0 +1,342 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "textformat.h"
+#include "ctq.h"
+#include "item.h"
+
+#include <QIODevice>
+
+#include <unordered_map>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto indentation = 4;
+    constexpr auto flushSize = 1 << 20;
+
+    // taken for indentation or trimmed off when at either end of a line
+    bool isTrimmed(QChar c)
+    {
+        return c.isSpace() && c != '\t' && c != '\n' && c != '\r';
+    }
+
+    QByteArray escapedSpace(QChar c)
+    {
+        if (c == ' ')
+        {
+            return "\\s";
+        }
+        return "\\u" + QByteArray::number(c.unicode(), 16).rightJustified(4, '0');
+    }
+
+    void appendNumber(QByteArray& out, const char* key, std::optional<double> value)
+    {
+        if (value)
+        {
+            out.append(key);
+            out.append(QByteArray::number(*value, 'g', 17));
+        }
+    }
+
+    std::optional<double> toNumber(const QString& s)
+    {
+        auto ok = false;
+        const auto value = s.toDouble(&ok);
+        return ok ? std::optional<double>(value) : std::nullopt;
+    }
+
+    class TreeWriter
+    {
+    public:
+        explicit TreeWriter(QIODevice& d) :
+            device(d)
+        {
+            buffer.reserve(flushSize + 4096);
+        }
+
+        bool Write(const TreeItem& item, int depth)
+        {
+            for (auto r = 0; r < item.ChildCount(); ++r)
+            {
+                const auto& child = *item.GetChild(r);
+                const auto& data = child.GetData();
+
+                buffer.append(depth * indentation, ' ');
+                AppendEscaped(buffer, data->GetText());
+                buffer.append('\t');
+                AppendEscaped(buffer, data->GetNote());
+                buffer.append('\t');
+                buffer.append(QByteArray::number(child.GetRank()));
+                if (child.GetWeight() != 1.0)
+                {
+                    buffer.append("\tw=");
+                    buffer.append(QByteArray::number(child.GetWeight(), 'g', 17));
+                }
+                if (!child.GetTransfer().isEmpty())
+                {
+                    buffer.append("\tt=");
+                    AppendEscaped(buffer, child.GetTransfer());
+                }
+
+                const auto [it, inserted] = ordinals.emplace(data.get(), count);
+                if (!inserted)
+                {
+                    buffer.append("\t@");
+                    buffer.append(QByteArray::number(it->second));
+                }
+                else if (const auto* ctq = dynamic_cast<const Ctq*>(data.get()); ctq != nullptr)
+                {
+                    AppendTarget(buffer, ctq->GetMeasurement().GetTarget());
+                }
+                buffer.append('\n');
+                ++count;
+
+                if (buffer.size() > flushSize && !Flush())
+                {
+                    return false;
+                }
+                if (!Write(child, depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool Flush()
+        {
+            const auto ok = device.write(buffer) == buffer.size();
+            buffer.clear();
+            return ok;
+        }
+
+    private:
+        QIODevice& device;
+        QByteArray buffer;
+        std::unordered_map<const ItemData*, qint64> ordinals;
+        qint64 count = 0;
+    };
+}
+
+namespace CtqTool
+{
+    bool WriteTree(const TreeItem& root, QIODevice& device)
+    {
+        TreeWriter writer(device);
+        return writer.Write(root, 0) && writer.Flush();
+    }
+
+    ItemLine ParseItemLine(const QString& columns)
+    {
+        ItemLine line;
+        const auto fields = columns.split('\t', Qt::SkipEmptyParts);
+        if (fields.isEmpty())
+        {
+            return line;
+        }
+        line.text = Unescape(fields[0]);
+        if (fields.size() > 1)
+        {
+            line.note = Unescape(fields[1]);
+        }
+        if (fields.size() > 2)
+        {
+            line.rank = fields[2].toUShort();
+        }
+        for (auto c = 3; c < fields.size(); ++c)
+        {
+            if (fields[c].startsWith("w="))
+            {
+                line.weight = fields[c].mid(2).toDouble();
+            }
+            else if (fields[c].startsWith("t="))
+            {
+                line.transfer = Unescape(fields[c].mid(2));
+            }
+            else if (fields[c].startsWith('@'))
+            {
+                line.shared = fields[c].mid(1).toLongLong();
+            }
+            else
+            {
+                ParseTargetColumn(fields[c], line);
+            }
+        }
+        return line;
+    }
+
+    void AppendTarget(QByteArray& out, const Target& target)
+    {
+        appendNumber(out, "\tl=", target.GetLowerLimit());
+        appendNumber(out, "\tn=", target.GetNominal());
+        appendNumber(out, "\tu=", target.GetUpperLimit());
+        if (!target.GetUnits().isEmpty())
+        {
+            out.append("\tm=");
+            AppendEscaped(out, target.GetUnits());
+        }
+    }
+
+    bool ParseTargetColumn(const QString& column, ItemLine& line)
+    {
+        if (column.size() < 2 || column[1] != '=')
+        {
+            return false;
+        }
+        const auto value = column.mid(2);
+        switch (column[0].unicode())
+        {
+        case 'l':
+            line.lower = toNumber(value);
+            return true;
+        case 'n':
+            line.nominal = toNumber(value);
+            return true;
+        case 'u':
+            line.upper = toNumber(value);
+            return true;
+        case 'm':
+            line.units = Unescape(value);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void SetTarget(Target& target, const ItemLine& line)
+    {
+        target.SetLowerLimit(line.lower);
+        target.SetNominal(line.nominal);
+        target.SetUpperLimit(line.upper);
+        target.SetUnits(line.units);
+    }
+
+    std::shared_ptr<TreeItem> MakeTreeItem(const ItemLine& line, int depth, TreeItem* parent)
+    {
+        auto item = std::make_shared<TreeItem>(MakeItemData(depth, line.text, line.note), parent);
+        item->SetRank(line.rank);
+        if (line.weight != 1.0)
+        {
+            item->SetWeight(line.weight);
+        }
+        if (!line.transfer.isEmpty())
+        {
+            item->SetTransfer(line.transfer);
+        }
+        if (auto* ctq = dynamic_cast<Ctq*>(item->GetData().get()); ctq != nullptr)
+        {
+            SetTarget(ctq->GetMeasurement().GetTarget(), line);
+        }
+        return item;
+    }
+
+    void AppendEscaped(QByteArray& out, const QString& s)
+    {
+        if (s.isEmpty())
+        {
+            out.append("\\e");
+            return;
+        }
+
+        auto from = 0;
+        auto to = s.size();
+        QByteArray head;
+        QByteArray tail;
+        if (isTrimmed(s.front()))
+        {
+            head = escapedSpace(s.front());
+            ++from;
+        }
+        if (to > from && isTrimmed(s.back()))
+        {
+            tail = escapedSpace(s.back());
+            --to;
+        }
+
+        const auto utf8 = s.mid(from, to - from).toUtf8();
+        out.append(head);
+        if (head.isEmpty() && utf8.startsWith('%'))
+        {
+            out.append('\\');
+        }
+        for (const auto c : utf8)
+        {
+            switch (c)
+            {
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            default:
+                out.append(c);
+            }
+        }
+        out.append(tail);
+    }
+
+    QString Unescape(const QString& s)
+    {
+        if (!s.contains('\\'))
+        {
+            return s;
+        }
+
+        QString out;
+        out.reserve(s.size());
+        for (auto i = 0; i < s.size(); ++i)
+        {
+            if (s[i] != '\\' || i + 1 == s.size())
+            {
+                out.append(s[i]);
+                continue;
+            }
+
+            const auto c = s[++i];
+            if (c == 't')
+                out.append('\t');
+            else if (c == 'n')
+                out.append('\n');
+            else if (c == 'r')
+                out.append('\r');
+            else if (c == 's')
+                out.append(' ');
+            else if (c == 'e')
+                continue;
+            else if (c == 'u' && i + 4 < s.size())
+            {
+                auto ok = false;
+                const auto code = s.mid(i + 1, 4).toUShort(&ok, 16);
+                out.append(ok ? QChar(code) : c);
+                i += ok ? 4 : 0;
+            }
+            else
+                out.append(c);
+        }
+        return out;
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <memory>
+#include <optional>
+
+class QIODevice;
+
+namespace CtqTool
+{
+    class Target;
+    class TreeItem;
+
+    // Items are written one per line, indented by depth, as
+    //   text<TAB>note<TAB>rank[<TAB>w=weight][<TAB>t=transfer]
+    //       [<TAB>l=lower][<TAB>n=nominal][<TAB>u=upper][<TAB>m=units][<TAB>@n]
+    // where the weight is left out when it is 1, the transfer when it is empty,
+    // the limits, nominal value and units of a CTQ's target when they are not
+    // set, and @n marks an item sharing its data with the n-th item of the file.
+    // Tabs, line breaks, backslashes and a leading '%' are escaped with a backslash,
+    // as is whitespace at either end of a column, written \s for a space and
+    // \uXXXX otherwise, and an empty column is written \e. A line thus reads
+    // back the same although it is trimmed and its empty columns are skipped,
+    // as they are in files written by hand. Measured samples are not part of
+    // the format and are lost on save; the XML and JSON exchange formats keep them.
+    bool WriteTree(const TreeItem& root, QIODevice&);
+
+    // the columns of one such line, without its indentation
+    struct ItemLine
+    {
+        QString text;
+        QString note;
+        unsigned short rank = 0;
+        double weight = 1.0;
+        QString transfer;
+        std::optional<double> lower;
+        std::optional<double> nominal;
+        std::optional<double> upper;
+        QString units;
+        qint64 shared = -1;                     // the ordinal after @, if any
+    };
+    ItemLine ParseItemLine(const QString& columns);
+
+    // the target columns, each after a tab, and one of them read back;
+    // false for a column that is not one
+    void AppendTarget(QByteArray&, const Target&);
+    bool ParseTargetColumn(const QString& column, ItemLine&);
+    void SetTarget(Target&, const ItemLine&);
+
+    // an item at depth below parent, without data shared with others
+    std::shared_ptr<TreeItem> MakeTreeItem(const ItemLine&, int depth, TreeItem* parent);
+
+    void AppendEscaped(QByteArray&, const QString&);
+    QString Unescape(const QString&);
+}
@@ -0,0 +1,392 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "xmlstream.h"
+#include "ctq.h"
+#include "item.h"
+
+#include <QIODevice>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto textColumn = 0;
+    constexpr auto noteColumn = 1;
+    constexpr auto version = 1;
+    constexpr auto maxNesting = 512;    // item elements, each read by a nested call
+
+    QString elementName(int depth)
+    {
+        switch (depth)
+        {
+        case 1:
+            return QStringLiteral("need");
+        case 2:
+            return QStringLiteral("driver");
+        case 3:
+            return QStringLiteral("ctq");
+        default:
+            return QStringLiteral("item");
+        }
+    }
+
+    bool isItemElement(QStringView name)
+    {
+        return name == u"need" || name == u"driver" || name == u"ctq" || name == u"item";
+    }
+
+    class TreeBuilder
+    {
+    public:
+        explicit TreeBuilder(QXmlStreamReader& r) :
+            reader(r)
+        {
+        }
+
+        // reads the contents of the element the reader is positioned at
+        bool Read(TreeItem& item, int depth)
+        {
+            const auto attributes = reader.attributes();
+            auto linked = false;
+            if (depth > 0)
+            {
+                if (attributes.hasAttribute(u"rank"))
+                {
+                    item.SetRank(attributes.value(u"rank").toUShort());
+                }
+                if (attributes.hasAttribute(u"weight"))
+                {
+                    item.SetWeight(attributes.value(u"weight").toDouble());
+                }
+                if (attributes.hasAttribute(u"transfer"))
+                {
+                    item.SetTransfer(attributes.value(u"transfer").toString());
+                }
+                if (attributes.hasAttribute(u"link"))
+                {
+                    auto ok = false;
+                    const auto ordinal = attributes.value(u"link").toULongLong(&ok);
+                    if (!ok || ordinal >= items.size())
+                    {
+                        reader.raiseError(QStringLiteral("link to an unknown item"));
+                        return false;
+                    }
+                    item.CloneDataFrom(*items[ordinal]);
+                    linked = true;
+                }
+            }
+
+            while (reader.readNextStartElement())
+            {
+                const auto name = reader.name();
+                if (name == u"text" || name == u"note")
+                {
+                    const auto column = (name == u"text") ? textColumn : noteColumn;
+                    const auto value = reader.readElementText();
+                    if (!linked)
+                    {
+                        item.SetData(column, value);
+                    }
+                }
+                else if (name == u"measurement")
+                {
+                    auto* ctq = linked ? nullptr : dynamic_cast<Ctq*>(item.GetData().get());
+                    if (ctq == nullptr)
+                    {
+                        reader.skipCurrentElement();
+                    }
+                    else
+                    {
+                        ReadMeasurement(ctq->GetMeasurement());
+                        if (ctq->GetMeasurement().GetSamples().Size() > 0)
+                        {
+                            const auto& measurement = ctq->GetMeasurement();
+                            ctq->SetStatistics(ComputeStatistics(measurement.GetSamples(), measurement.GetTarget()));
+                            ctq->UpdateConformance();
+                        }
+                    }
+                }
+                else if (isItemElement(name))
+                {
+                    if (depth == maxNesting)
+                    {
+                        reader.raiseError(QStringLiteral("nesting too deep"));
+                        return false;
+                    }
+                    auto child = std::make_shared<TreeItem>(MakeItemData(depth + 1, QString(), QString()), &item);
+                    items.push_back(child.get());
+                    item.Append(child);
+                    if (!Read(*child, depth + 1))
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    reader.skipCurrentElement();
+                }
+            }
+            return !reader.hasError();
+        }
+
+    private:
+        void ReadMeasurement(Measurement& measurement)
+        {
+            while (reader.readNextStartElement())
+            {
+                if (reader.name() == u"description")
+                {
+                    measurement.SetDescription(reader.readElementText());
+                }
+                else if (reader.name() == u"target")
+                {
+                    while (reader.readNextStartElement())
+                    {
+                        auto& target = measurement.GetTarget();
+                        if (reader.name() == u"description")
+                        {
+                            target.SetDescription(reader.readElementText());
+                        }
+                        else if (reader.name() == u"units")
+                        {
+                            target.SetUnits(reader.readElementText());
+                        }
+                        else if (reader.name() == u"lower" || reader.name() == u"nominal" || reader.name() == u"upper")
+                        {
+                            const auto name = reader.name().toString();
+                            auto ok = false;
+                            const auto limit = reader.readElementText().toDouble(&ok);
+                            if (!ok)
+                            {
+                                reader.raiseError(QStringLiteral("invalid specification limit"));
+                                return;
+                            }
+                            if (name == "lower")
+                                target.SetLowerLimit(limit);
+                            else if (name == "nominal")
+                                target.SetNominal(limit);
+                            else
+                                target.SetUpperLimit(limit);
+                        }
+                        else
+                        {
+                            reader.skipCurrentElement();
+                        }
+                    }
+                }
+                else if (reader.name() == u"samples")
+                {
+                    if (!ReadSamples(measurement))
+                    {
+                        return;
+                    }
+                }
+                else
+                {
+                    reader.skipCurrentElement();
+                }
+            }
+        }
+
+        bool ReadSamples(Measurement& measurement)
+        {
+            const auto text = reader.readElementText();
+            values.clear();
+            timestamps.clear();
+            lots.clear();
+            for (const auto untrimmed : QStringView(text).tokenize(u'\n', Qt::SkipEmptyParts))
+            {
+                const auto line = untrimmed.trimmed();
+                if (line.isEmpty())
+                {
+                    continue;
+                }
+                const auto first = line.indexOf(u'\t');
+                const auto second = (first < 0) ? -1 : line.indexOf(u'\t', first + 1);
+                auto ok = second > 0;
+                const auto value = ok ? line.left(first).toDouble(&ok) : 0.0;
+                const auto timestamp = ok ? line.mid(first + 1, second - first - 1).toLongLong(&ok) : 0;
+                const auto lot = ok ? line.mid(second + 1).toUInt(&ok) : 0;
+                if (!ok)
+                {
+                    reader.raiseError(QStringLiteral("invalid sample"));
+                    return false;
+                }
+                values.push_back(value);
+                timestamps.push_back(timestamp);
+                lots.push_back(lot);
+            }
+            measurement.Append(values.data(), timestamps.data(), lots.data(), values.size());
+            return true;
+        }
+
+        QXmlStreamReader& reader;
+        std::vector<const TreeItem*> items;
+        std::vector<double> values;
+        std::vector<qint64> timestamps;
+        std::vector<quint32> lots;
+    };
+
+    class TreeWriter
+    {
+    public:
+        explicit TreeWriter(QIODevice& device) :
+            writer(&device)
+        {
+            writer.setAutoFormatting(true);
+        }
+
+        bool Write(const TreeItem& root)
+        {
+            writer.writeStartDocument();
+            writer.writeStartElement(QStringLiteral("ctqtree"));
+            writer.writeAttribute(QStringLiteral("version"), QString::number(version));
+            WriteChildren(root, 1);
+            writer.writeEndElement();
+            writer.writeEndDocument();
+            return !writer.hasError();
+        }
+
+    private:
+        void WriteChildren(const TreeItem& item, int depth)
+        {
+            for (auto r = 0; r < item.ChildCount() && !writer.hasError(); ++r)
+            {
+                const auto& child = *item.GetChild(r);
+                const auto& data = child.GetData();
+
+                writer.writeStartElement(elementName(depth));
+                writer.writeAttribute(QStringLiteral("rank"), QString::number(child.GetRank()));
+                if (child.GetWeight() != 1.0)
+                {
+                    writer.writeAttribute(QStringLiteral("weight"), QString::number(child.GetWeight(), 'g', 17));
+                }
+                if (!child.GetTransfer().isEmpty())
+                {
+                    writer.writeAttribute(QStringLiteral("transfer"), child.GetTransfer());
+                }
+                const auto [it, inserted] = ordinals.emplace(data.get(), count++);
+                if (inserted)
+                {
+                    writer.writeTextElement(QStringLiteral("text"), data->GetText());
+                    writer.writeTextElement(QStringLiteral("note"), data->GetNote());
+                    if (const auto* ctq = dynamic_cast<const Ctq*>(data.get()); ctq != nullptr)
+                    {
+                        WriteMeasurement(ctq->GetMeasurement());
+                    }
+                }
+                else
+                {
+                    writer.writeAttribute(QStringLiteral("link"), QString::number(it->second));
+                }
+                WriteChildren(child, depth + 1);
+                writer.writeEndElement();
+            }
+        }
+
+        void WriteMeasurement(const Measurement& measurement)
+        {
+            writer.writeStartElement(QStringLiteral("measurement"));
+            writer.writeTextElement(QStringLiteral("description"), measurement.GetDescription());
+            const auto& target = measurement.GetTarget();
+            writer.writeStartElement(QStringLiteral("target"));
+            writer.writeTextElement(QStringLiteral("description"), target.GetDescription());
+            if (const auto lower = target.GetLowerLimit(); lower)
+            {
+                writer.writeTextElement(QStringLiteral("lower"), QString::number(*lower, 'g', 17));
+            }
+            if (const auto nominal = target.GetNominal(); nominal)
+            {
+                writer.writeTextElement(QStringLiteral("nominal"), QString::number(*nominal, 'g', 17));
+            }
+            if (const auto upper = target.GetUpperLimit(); upper)
+            {
+                writer.writeTextElement(QStringLiteral("upper"), QString::number(*upper, 'g', 17));
+            }
+            if (!target.GetUnits().isEmpty())
+            {
+                writer.writeTextElement(QStringLiteral("units"), target.GetUnits());
+            }
+            writer.writeEndElement();
+
+            measurement.GetSamples().ForEachChunk([this](const SampleStore::Chunk& chunk)
+            {
+                lines.clear();
+                for (size_t i = 0; i < chunk.size; ++i)
+                {
+                    lines.append(QString::number(chunk.values[i], 'g', 17));
+                    lines.append(u'\t');
+                    lines.append(QString::number(chunk.timestamps[i]));
+                    lines.append(u'\t');
+                    lines.append(QString::number(chunk.lots[i]));
+                    lines.append(u'\n');
+                }
+                writer.writeTextElement(QStringLiteral("samples"), lines);
+            });
+            writer.writeEndElement();
+        }
+
+        QXmlStreamWriter writer;
+        QString lines;
+        std::unordered_map<const ItemData*, qint64> ordinals;
+        qint64 count = 0;
+    };
+}
+
+namespace CtqTool
+{
+    std::unique_ptr<TreeItem> ReadXml(QIODevice& device, QString* error)
+    {
+        QXmlStreamReader reader(&device);
+        auto root = std::make_unique<TreeItem>(std::make_shared<ItemData>("Title", "Note"));
+        TreeBuilder builder(reader);
+
+        if (reader.readNextStartElement())
+        {
+            if (reader.name() == u"ctqtree")
+            {
+                builder.Read(*root, 0);
+            }
+            else
+            {
+                reader.raiseError(QStringLiteral("not a CTQ tree"));
+            }
+        }
+        if (reader.hasError())
+        {
+            if (error != nullptr)
+            {
+                *error = QStringLiteral("%1 at line %2").arg(reader.errorString()).arg(reader.lineNumber());
+            }
+            return nullptr;
+        }
+        return root;
+    }
+
+    bool WriteXml(const TreeItem& root, QIODevice& device)
+    {
+        TreeWriter writer(device);
+        return writer.Write(root);
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+
+#include <memory>
+
+class QIODevice;
+
+namespace CtqTool
+{
+    class TreeItem;
+
+    // Trees are exchanged as
+    //   <ctqtree version="1">
+    //     <need rank="0">
+    //       <text>...</text><note>...</note>
+    //       <driver rank="0">
+    //         ...
+    //         <ctq rank="0">
+    //           ...
+    //           <measurement>
+    //             <description>...</description>
+    //             <target>
+    //               <description>...</description>
+    //               <lower>...</lower><nominal>...</nominal><upper>...</upper>
+    //               <units>...</units>
+    //             </target>
+    //             <samples>value<TAB>timestamp<TAB>lot, one sample per line</samples>
+    //           </measurement>
+    //         </ctq>
+    //       </driver>
+    //     </need>
+    //   </ctqtree>
+    // Items below a CTQ are written as <item>. A weight other than 1 and a
+    // transfer expression are written as attributes next to the rank. An item sharing its data with
+    // the n-th item of the document (counted depth first) has a link="n"
+    // attribute instead of text, note and measurement. The samples are written
+    // in elements of at most SampleStore::chunkCapacity lines. Unknown elements are skipped.
+    //
+    // The tree is read in a single pass straight from the device.
+    std::unique_ptr<TreeItem> ReadXml(QIODevice&, QString* error = nullptr);
+    bool WriteXml(const TreeItem& root, QIODevice&);
+}
@@ -16,12 +16,21 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "datamodel/ctqmodel.h"
+#include "datamodel/document.h"
+#include "datamodel/item.h"
+#include "ui/ctqtreescene.h"
+#include "ui/diagramexport.h"
+#include "ui/diagramitem.h"
 #include "ui/mainwindow.h"
 
+#include <QCommandLineParser>
 #include <QFile>
 #include <QTextStream>
 #include <QtWidgets/QApplication>
 
+#include <cstring>
+
 namespace
 {
     void setStyleSheet(const QString& location)
@@ -31,15 +40,89 @@ namespace
 	QTextStream ts(&f);
 	qApp->setStyleSheet(ts.readAll());
     }
+
+    bool exporting(int argc, char* argv[])
+    {
+        for (auto i = 1; i < argc; ++i)
+        {
+            // as the parser takes it, --export file or --export=file
+            if (std::strcmp(argv[i], "--export") == 0 || std::strncmp(argv[i], "--export=", 9) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // lays out the document as the diagram view would, without showing it
+    int exportDiagram(const QString& document, const QString& filename, const CtqTool::DiagramExportOptions& options)
+    {
+        auto contents = CtqTool::Document::Read(document);
+        if (!contents.root)
+        {
+            qCritical("Could not read %s", qUtf8Printable(document));
+            return 1;
+        }
+
+        CtqTool::CtqModel model;
+        model.Reset(std::move(contents.root));
+        CtqTool::CtqTreeScene scene;
+        scene.SetModel(&model);
+        const auto index = scene.GetIndex();
+        if (!index || !CtqTool::ExportDiagram(*index, filename, options))
+        {
+            qCritical("Could not write %s", qUtf8Printable(filename));
+            return 1;
+        }
+        return 0;
+    }
 }
 
 int main(int argc, char* argv[])
 {
+    // an export needs no display
+    if (exporting(argc, argv) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
     QApplication a(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("document", QApplication::translate("main", "The CTQ document to open."));
+    const QCommandLineOption exportOption("export",
+        QApplication::translate("main", "Write the diagram of the document as a TIFF image, SVG or PDF and exit."), "file");
+    const QCommandLineOption scaleOption("scale",
+        QApplication::translate("main", "Pixels per unit of the diagram in a TIFF image."), "scale", "2");
+    const QCommandLineOption dpiOption("dpi",
+        QApplication::translate("main", "The resolution recorded in a TIFF image."), "dpi", "300");
+    parser.addOptions({exportOption, scaleOption, dpiOption});
+    parser.process(a);
+
+    const auto documents = parser.positionalArguments();
+    if (parser.isSet(exportOption))
+    {
+        if (documents.size() != 1)
+        {
+            parser.showHelp(1);
+        }
+        CtqTool::DiagramExportOptions options;
+        options.scale = parser.value(scaleOption).toDouble();
+        options.dpi = parser.value(dpiOption).toInt();
+        if (!(options.scale > 0.0) || options.dpi <= 0)
+        {
+            parser.showHelp(1);
+        }
+        return exportDiagram(documents.front(), parser.value(exportOption), options);
+    }
+
     setStyleSheet(":qdarkstyle/style.qss");
 
     CtqTool::MainWindow w;
+    if (!documents.isEmpty())
+    {
+        w.LoadFile(documents.front());
+    }
     w.show();
 
     return QApplication::exec();
@@ -0,0 +1,174 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "columnsizer.h"
+
+#include "datamodel/ctqmodel.h"
+
+#include <QHeaderView>
+#include <QScrollBar>
+#include <QStyle>
+#include <QTreeView>
+
+#include <algorithm>
+
+namespace
+{
+    constexpr auto delay = 50;                  // milliseconds, to coalesce changes
+    constexpr auto maxSampledRows = 256;
+    constexpr auto unshownRows = 32;            // sampled before the view has been laid out
+    constexpr auto maxWidth = 480;              // pixels; longer texts are elided
+
+    // below the root of a view, counting from 1
+    int levelOf(QModelIndex index, const QModelIndex& root)
+    {
+        auto level = 0;
+        for (; index.isValid() && index != root; index = index.parent())
+        {
+            ++level;
+        }
+        return level;
+    }
+}
+
+namespace CtqTool
+{
+    ColumnSizer::ColumnSizer(QAbstractItemView& v, QHeaderView& h, const CtqModel& m, std::vector<int> l,
+        QObject* parent) :
+        QObject(parent),
+        view(v),
+        header(h),
+        hints(m),
+        levels(std::move(l))
+    {
+        timer.setSingleShot(true);
+        timer.setInterval(delay);
+        connect(&timer, &QTimer::timeout, this, &ColumnSizer::Resize);
+
+        const auto fitAll = [this]() { Schedule(true); };
+        const auto widen = [this]() { Schedule(false); };
+        connect(&hints, &QAbstractItemModel::modelReset, this, fitAll);
+        connect(&hints, &CtqModel::WidthHintChanged, this, widen);
+        connect(view.model(), &QAbstractItemModel::modelReset, this, fitAll);
+        connect(view.model(), &QAbstractItemModel::layoutChanged, this, widen);
+        connect(view.model(), &QAbstractItemModel::rowsInserted, this, widen);
+        connect(view.verticalScrollBar(), &QScrollBar::valueChanged, this, widen);
+        connect(&header, &QHeaderView::sectionResized, this, [this](int section, int, int)
+        {
+            if (!resizing && section >= 0)
+            {
+                userSized.resize(std::max(userSized.size(), static_cast<size_t>(section) + 1));
+                userSized[section] = true;
+            }
+        });
+        Schedule(true);
+    }
+
+    void ColumnSizer::Schedule(bool fitAll)
+    {
+        fit = fit || fitAll;
+        if (!timer.isActive())
+        {
+            timer.start();
+        }
+    }
+
+    void ColumnSizer::Resize()
+    {
+        const auto* model = view.model();
+        if (model == nullptr)
+        {
+            return;
+        }
+
+        // as the margins item delegates leave around text
+        const auto padding = (view.style()->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, &view) + 1) * 2;
+        const auto rows = SampleRows();
+        const auto metrics = view.fontMetrics();
+        resizing = true;
+        for (auto c = 0; c < model->columnCount(); ++c)
+        {
+            if (header.isSectionHidden(c) || (static_cast<size_t>(c) < userSized.size() && userSized[c]))
+            {
+                continue;
+            }
+
+            auto width = header.sectionSizeHint(c);
+            for (const auto& row : rows)
+            {
+                const auto index = row.siblingAtColumn(c);
+                const auto indentation = Indentation(c, levelOf(index, view.rootIndex()));
+                width = std::max(width, view.sizeHintForIndex(index).width() + indentation);
+            }
+            // the longest by characters need not be the widest in pixels
+            for (const auto level : levels)
+            {
+                for (const auto& text : hints.GetWidthHints(c, level))
+                {
+                    width = std::max(width, metrics.horizontalAdvance(text) + padding + Indentation(c, level));
+                }
+            }
+            width = std::min(width, maxWidth);
+            if (fit || width > header.sectionSize(c))
+            {
+                header.resizeSection(c, width);
+            }
+        }
+        resizing = false;
+        fit = false;
+    }
+
+    std::vector<QModelIndex> ColumnSizer::SampleRows() const
+    {
+        std::vector<QModelIndex> rows;
+        const auto height = view.viewport()->height();
+        if (view.isVisible() && height > 0)
+        {
+            for (auto y = 0; y < height && rows.size() < maxSampledRows;)
+            {
+                const auto index = view.indexAt(QPoint(0, y));
+                if (!index.isValid())
+                {
+                    break;
+                }
+                rows.push_back(index);
+                y = std::max(y + 1, view.visualRect(index).bottom() + 1);
+            }
+            return rows;
+        }
+
+        const auto* model = view.model();
+        const auto root = view.rootIndex();
+        for (auto r = 0; r < std::min(model->rowCount(root), unshownRows); ++r)
+        {
+            rows.push_back(model->index(r, 0, root));
+        }
+        return rows;
+    }
+
+    // of the text in the tree column, as for items at a level
+    int ColumnSizer::Indentation(int column, int levels) const
+    {
+        const auto* tree = qobject_cast<const QTreeView*>(&view);
+        if (tree == nullptr || column != std::max(tree->treePosition(), 0))
+        {
+            return 0;
+        }
+        return (tree->rootIsDecorated() ? levels : levels - 1) * tree->indentation();
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QModelIndex>
+#include <QObject>
+#include <QTimer>
+
+#include <vector>
+
+class QAbstractItemView;
+class QHeaderView;
+
+namespace CtqTool
+{
+    class CtqModel;
+
+    // Sizes the columns of a view to their contents without measuring every
+    // row: only the rows in view, or the first few before the view is shown,
+    // and the longest texts the model has seen in the column at the levels
+    // the view shows, in the view's font and indented as there. Columns are
+    // fitted after a reset and only widened afterwards, on a timer so that a
+    // burst of changes costs one pass. Columns the user resized are left alone.
+    // The view's model must be set, and have the columns of the CtqModel.
+    class ColumnSizer : public QObject
+    {
+        Q_OBJECT
+    public:
+        // levels counts from 1 for needs
+        ColumnSizer(QAbstractItemView&, QHeaderView&, const CtqModel& hints, std::vector<int> levels,
+            QObject* parent = nullptr);
+
+    private:
+        void Schedule(bool fit);
+        void Resize();
+        std::vector<QModelIndex> SampleRows() const;
+        int Indentation(int column, int levels) const;
+
+        QAbstractItemView& view;
+        QHeaderView& header;
+        const CtqModel& hints;
+        std::vector<int> levels;
+        QTimer timer;
+        std::vector<bool> userSized;
+        bool fit = false;
+        bool resizing = false;
+    };
+}
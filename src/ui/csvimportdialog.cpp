@@ -0,0 +1,140 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "csvimportdialog.h"
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QVBoxLayout>
+
+namespace
+{
+    // picks the first column whose title contains any of the hints
+    int guess(const QStringList& titles, const QStringList& hints, int fallback)
+    {
+        for (auto i = 0; i < titles.size(); ++i)
+        {
+            for (const auto& hint : hints)
+            {
+                if (titles[i].contains(hint, Qt::CaseInsensitive))
+                {
+                    return i;
+                }
+            }
+        }
+        return fallback;
+    }
+}
+
+namespace CtqTool
+{
+    CsvImportDialog::CsvImportDialog(const QString& f, QWidget* parent) :
+        QDialog(parent),
+        filename(f),
+        separator(new QComboBox(this)),
+        header(new QCheckBox(tr("First line holds column titles"), this)),
+        ctqColumn(new QComboBox(this)),
+        valueColumn(new QComboBox(this)),
+        timestampColumn(new QComboBox(this)),
+        lotColumn(new QComboBox(this)),
+        buttonBox(new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel))
+    {
+        this->setWindowTitle("Import measurements");
+        separator->addItem(tr("Comma"), QChar(','));
+        separator->addItem(tr("Semicolon"), QChar(';'));
+        separator->addItem(tr("Tab"), QChar('\t'));
+        header->setChecked(true);
+        MakeLayout();
+        ReadHeader();
+
+        connect(separator, &QComboBox::currentIndexChanged, this, &CsvImportDialog::ReadHeader);
+        connect(header, &QCheckBox::toggled, this, &CsvImportDialog::ReadHeader);
+        connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    }
+
+    CsvImportDialog::~CsvImportDialog() = default;
+
+    void CsvImportDialog::MakeLayout()
+    {
+        auto* form = new QFormLayout;
+        form->addRow(tr("Separator"), separator);
+        form->addRow(header);
+        form->addRow(tr("CTQ name"), ctqColumn);
+        form->addRow(tr("Value"), valueColumn);
+        form->addRow(tr("Timestamp (ms)"), timestampColumn);
+        form->addRow(tr("Lot"), lotColumn);
+
+        auto* layout = new QVBoxLayout;
+        layout->addLayout(form);
+        layout->addWidget(buttonBox);
+        this->setLayout(layout);
+    }
+
+    char CsvImportDialog::GetSeparator() const
+    {
+        return separator->currentData().toChar().toLatin1();
+    }
+
+    void CsvImportDialog::ReadHeader()
+    {
+        auto titles = ReadCsvHeader(filename, GetSeparator());
+        if (!header->isChecked())
+        {
+            for (auto i = 0; i < titles.size(); ++i)
+            {
+                titles[i] = tr("Column %1").arg(i + 1);
+            }
+        }
+
+        for (auto* combo : {ctqColumn, valueColumn, timestampColumn, lotColumn})
+        {
+            combo->clear();
+        }
+        for (auto* combo : {timestampColumn, lotColumn})
+        {
+            combo->addItem(tr("(none)"), -1);
+        }
+        for (auto i = 0; i < titles.size(); ++i)
+        {
+            for (auto* combo : {ctqColumn, valueColumn, timestampColumn, lotColumn})
+            {
+                combo->addItem(titles[i], i);
+            }
+        }
+
+        ctqColumn->setCurrentIndex(guess(titles, {"ctq", "name"}, 0));
+        valueColumn->setCurrentIndex(guess(titles, {"value", "measured"}, std::min<int>(1, titles.size() - 1)));
+        timestampColumn->setCurrentIndex(guess(titles, {"time", "date"}, -1) + 1);
+        lotColumn->setCurrentIndex(guess(titles, {"lot", "batch"}, -1) + 1);
+    }
+
+    CsvColumns CsvImportDialog::GetColumns() const
+    {
+        CsvColumns columns;
+        columns.ctq = ctqColumn->currentData().toInt();
+        columns.value = valueColumn->currentData().toInt();
+        columns.timestamp = timestampColumn->currentData().toInt();
+        columns.lot = lotColumn->currentData().toInt();
+        columns.separator = GetSeparator();
+        columns.header = header->isChecked();
+        return columns;
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "datamodel/csvimport.h"
+
+#include <QDialog>
+
+class QCheckBox;
+class QComboBox;
+class QDialogButtonBox;
+
+namespace CtqTool
+{
+    // maps the columns of a CSV file onto CTQ name, value, timestamp and lot
+    class CsvImportDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        CsvImportDialog(const QString& filename, QWidget* parent = nullptr);
+        virtual ~CsvImportDialog();
+
+        CsvColumns GetColumns() const;
+
+    private:
+        void MakeLayout();
+        void ReadHeader();
+        char GetSeparator() const;
+
+        QString filename;
+        QComboBox* separator = nullptr;
+        QCheckBox* header = nullptr;
+        QComboBox* ctqColumn = nullptr;
+        QComboBox* valueColumn = nullptr;
+        QComboBox* timestampColumn = nullptr;
+        QComboBox* lotColumn = nullptr;
+        QDialogButtonBox* buttonBox = nullptr;
+    };
+}
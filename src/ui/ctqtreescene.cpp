@@ -17,22 +17,184 @@
  */
 
 #include "ctqtreescene.h"
+#include "diagramitem.h"
 
-#include "datamodel/ctqtree.h"
-#include "datamodel/driver.h"
-#include "datamodel/ctq.h"
+#include <QAbstractItemModel>
+#include <QFontMetricsF>
 
-#include <QGraphicsRectItem>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr auto padding = 6.0;
+    constexpr auto minWidth = 40.0;
+    constexpr auto maxWidth = 160.0;
+    constexpr auto margin = 20.0;
+    constexpr auto frameInterval = 16; // milliseconds
+
+    double widthOf(const QFontMetricsF& metrics, const QString& text)
+    {
+        return std::clamp(std::ceil(metrics.horizontalAdvance(text)) + 2 * padding, minWidth, maxWidth);
+    }
+}
 
 namespace CtqTool
 {
     CtqTreeScene::CtqTreeScene(QObject* parent) :
-        QGraphicsScene(parent)
+        QGraphicsScene(parent),
+        diagram(new DiagramItem)
+    {
+        // one item, which indexes its nodes itself
+        setItemIndexMethod(QGraphicsScene::NoIndex);
+        addItem(diagram);
+
+        relayoutTimer.setSingleShot(true);
+        relayoutTimer.setInterval(frameInterval);
+        connect(&relayoutTimer, &QTimer::timeout, this, &CtqTreeScene::Relayout);
+    }
+
+    void CtqTreeScene::SetModel(QAbstractItemModel* m)
     {
+        if (model != nullptr)
+        {
+            disconnect(model, nullptr, this, nullptr);
+        }
+        model = m;
+        if (model != nullptr)
+        {
+            connect(model, &QAbstractItemModel::modelReset, this, &CtqTreeScene::Rebuild);
+            connect(model, &QAbstractItemModel::layoutChanged, this, &CtqTreeScene::Rebuild);
+            connect(model, &QAbstractItemModel::rowsInserted, this, &CtqTreeScene::OnRowsInserted);
+            connect(model, &QAbstractItemModel::rowsRemoved, this, &CtqTreeScene::OnRowsRemoved);
+            connect(model, &QAbstractItemModel::dataChanged, this, &CtqTreeScene::OnDataChanged);
+        }
+        Rebuild();
     }
 
-    void CtqTreeScene::SetTree(const CtqTree& tree)
+    void CtqTreeScene::Rebuild()
     {
+        layout.Clear();
+        if (model != nullptr && model->rowCount() > 0)
+        {
+            Build(layout.GetRoot(), QModelIndex(), 0, model->rowCount() - 1);
+        }
+        Relayout();
+    }
 
+    void CtqTreeScene::Build(TreeLayout::Node& parent, const QModelIndex& index, int first, int last)
+    {
+        const QFontMetricsF metrics(font());
+        for (auto row = first; row <= last; ++row)
+        {
+            const auto child = model->index(row, 0, index);
+            auto text = child.data().toString();
+            const auto width = widthOf(metrics, text);
+            auto& node = layout.Insert(parent, row, std::move(text), width);
+
+            const auto rows = model->rowCount(child);
+            if (rows > 0)
+            {
+                Build(node, child, 0, rows - 1);
+            }
+        }
+    }
+
+    TreeLayout::Node* CtqTreeScene::NodeOf(const QModelIndex& index)
+    {
+        std::vector<int> rows;
+        for (auto i = index; i.isValid(); i = i.parent())
+        {
+            rows.push_back(i.row());
+        }
+
+        auto* node = &layout.GetRoot();
+        for (auto it = rows.rbegin(); it != rows.rend(); ++it)
+        {
+            if (*it >= static_cast<int>(node->children.size()))
+            {
+                return nullptr;
+            }
+            node = node->children[*it].get();
+        }
+        return node;
+    }
+
+    void CtqTreeScene::Relayout()
+    {
+        relayoutTimer.stop();
+        layout.Update();
+        diagram->SetLayout(layout.GetRoot());
+        setSceneRect(diagram->boundingRect().adjusted(-margin, -margin, margin, margin));
+        emit DiagramChanged();
+    }
+
+    // the nodes follow each edit right away; their positions and the index,
+    // which is rebuilt over the whole tree, once the edits of a frame are in
+    void CtqTreeScene::ScheduleRelayout()
+    {
+        if (!relayoutTimer.isActive())
+        {
+            relayoutTimer.start();
+        }
+    }
+
+    std::shared_ptr<const DiagramIndex> CtqTreeScene::GetIndex()
+    {
+        if (relayoutTimer.isActive())
+        {
+            Relayout();
+        }
+        return diagram->GetIndex();
+    }
+
+    void CtqTreeScene::OnRowsInserted(const QModelIndex& parent, int first, int last)
+    {
+        if (auto* node = NodeOf(parent); node != nullptr)
+        {
+            Build(*node, parent, first, last);
+            ScheduleRelayout();
+        }
+    }
+
+    void CtqTreeScene::OnRowsRemoved(const QModelIndex& parent, int first, int last)
+    {
+        auto* node = NodeOf(parent);
+        if (node == nullptr || last >= static_cast<int>(node->children.size()))
+        {
+            return;
+        }
+        layout.Remove(*node, first, last - first + 1);
+        ScheduleRelayout();
+    }
+
+    void CtqTreeScene::OnDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+    {
+        if (topLeft.column() > 0)
+        {
+            return;
+        }
+        const QFontMetricsF metrics(font());
+        auto changed = false;
+        for (auto row = topLeft.row(); row <= bottomRight.row(); ++row)
+        {
+            const auto index = topLeft.siblingAtRow(row);
+            auto* node = NodeOf(index);
+            if (node == nullptr)
+            {
+                continue;
+            }
+            auto text = index.data().toString();
+            if (text != node->text)
+            {
+                const auto width = widthOf(metrics, text);
+                layout.SetText(*node, std::move(text), width);
+                changed = true;
+            }
+        }
+        if (changed)
+        {
+            ScheduleRelayout();
+        }
     }
 }
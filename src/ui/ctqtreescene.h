@@ -18,15 +18,53 @@
 
 #pragma once
 
+#include "treelayout.h"
+
 #include <QGraphicsScene>
+#include <QTimer>
+
+#include <memory>
+
+class QAbstractItemModel;
+class QModelIndex;
 
 namespace CtqTool
 {
-    class CtqTree;
+    class DiagramIndex;
+    class DiagramItem;
+
+    // The tree of a model as a diagram of boxes and edges. The layout follows
+    // the model's signals, so an edit only lays out again what it affects, and
+    // the diagram is drawn by a single item. Its index is rebuilt at most once
+    // a frame, however many edits came in meanwhile.
     class CtqTreeScene : public QGraphicsScene
     {
+        Q_OBJECT
     public:
         CtqTreeScene(QObject* parent = nullptr);
-        void SetTree(const CtqTree&);
+        void SetModel(QAbstractItemModel*);
+
+        // a snapshot of the diagram, safe to draw from any thread; lays out any
+        // edits still pending first
+        std::shared_ptr<const DiagramIndex> GetIndex();
+
+    signals:
+        void DiagramChanged();
+
+    private:
+        void Rebuild();
+        void Build(TreeLayout::Node& parent, const QModelIndex& index, int first, int last);
+        TreeLayout::Node* NodeOf(const QModelIndex&);
+        void Relayout();
+        void ScheduleRelayout();
+
+        void OnRowsInserted(const QModelIndex& parent, int first, int last);
+        void OnRowsRemoved(const QModelIndex& parent, int first, int last);
+        void OnDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+
+        QAbstractItemModel* model = nullptr;
+        TreeLayout layout;
+        DiagramItem* diagram = nullptr;
+        QTimer relayoutTimer;
     };
 }
@@ -18,16 +18,30 @@
 
 #include "ctqview.h"
 
+#include "columnsizer.h"
 #include "ctqtreescene.h"
+#include "diagramitem.h"
+#include "diagramview.h"
+#include "minimap.h"
+#include "targetdialog.h"
 #include "treeview.h"
 #include "utilities.h"
 #include "itemdialog.h"
 
+#include "datamodel/autosave.h"
 #include "datamodel/ctqmodel.h"
 #include "datamodel/ctqproxymodel.h"
+#include "datamodel/document.h"
+#include "datamodel/documentstore.h"
 #include "datamodel/item.h"
+#include "datamodel/jsonstream.h"
+#include "datamodel/sqlstore.h"
+#include "datamodel/xmlstream.h"
 
 #include <QFile>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QSaveFile>
 #include <QSplitter>
 #include <QTabWidget>
 #include <QTableView>
@@ -35,6 +49,24 @@
 
 namespace
 {
+    // text and note are filled in for new rows, the other columns keep their defaults
+    constexpr auto placeholderColumns = 2;
+
+    // documents this large are read in place, fetching items as they are shown
+    constexpr qint64 lazyDocumentSize = qint64(64) << 20;
+    // items of a database looked up by Find beyond those fetched
+    constexpr auto storedHits = 100;
+
+    bool isXml(const QString& filename)
+    {
+        return filename.endsWith(".xml", Qt::CaseInsensitive);
+    }
+
+    bool isDatabase(const QString& filename)
+    {
+        return filename.endsWith(".ctqdb", Qt::CaseInsensitive);
+    }
+
     auto getDepth(const QModelIndex& idx)
     {
         auto depth = 0;
@@ -57,7 +89,9 @@ namespace CtqTool
         needTable(new QTableView(this)),
         driverTable(new QTableView(this)),
         ctqTable(new QTableView(this)),
-        tabs(new QTabWidget(this))
+        diagram(new DiagramView(this)),
+        tabs(new QTabWidget(this)),
+        document(new Document(this))
     {                
         needsModel = std::make_unique<CtqProxyModel>(1, this);
         needTable->setModel(needsModel.get());
@@ -72,20 +106,29 @@ namespace CtqTool
 
         model = std::make_unique<CtqModel>();
         tree->setModel(model.get());
+        connect(tree, &QTreeView::expanded, model.get(), &CtqModel::BranchExpanded);
+        connect(tree, &QTreeView::collapsed, model.get(), &CtqModel::BranchCollapsed);
         needsModel->setSourceModel(model.get());
         driversModel->setSourceModel(model.get());
         ctqsModel->setSourceModel(model.get());
-        for (int column = 0; column < model->columnCount(); ++column)
+        autosave = new AutosaveService(*model, *document, this);
+        connect(model.get(), &CtqModel::SpcViolations, this, &CtqView::SpcViolations);
+        connect(model.get(), &CtqModel::StatisticsUpdated, this, &CtqView::StatisticsUpdated);
+        connect(model.get(), &CtqModel::SimulationFinished, this, &CtqView::SimulationFinished);
+        scene->SetModel(model.get());
+        diagram->setScene(scene);
+        minimap = new Minimap(*scene, *diagram, this);
+        new ColumnSizer(*tree, *tree->header(), *model, {1, 2, 3}, this);
+        auto level = 1;
+        for (auto* table : {needTable, driverTable, ctqTable})
         {
-            tree->resizeColumnToContents(column);
-            needTable->resizeColumnToContents(column);
-            driverTable->resizeColumnToContents(column);
-            ctqTable->resizeColumnToContents(column);
+            new ColumnSizer(*table, *table->horizontalHeader(), *model, {level++}, this);
         }
 
         tabs->addTab(needTable, "needs");
         tabs->addTab(driverTable, "drivers");
         tabs->addTab(ctqTable, "CTQs");
+        tabs->addTab(diagram, "diagram");
 
         auto* splitter = new QSplitter(Qt::Vertical, this);
         splitter->addWidget(tree);
@@ -98,7 +141,445 @@ namespace CtqTool
         setLayout(layout);
     }
 
-    CtqView::~CtqView() = default;
+    CtqView::~CtqView()
+    {
+        pool.waitForDone();
+    }
+
+    QWidget* CtqView::GetMinimap() const
+    {
+        return minimap;
+    }
+
+    void CtqView::SetSingleLineRows(bool on)
+    {
+        tree->SetRowHeights(on ? TreeView::RowHeights::Uniform : TreeView::RowHeights::PerRow);
+    }
+
+    void CtqView::ExpandToDepth(int depth)
+    {
+        tree->ExpandToDepth(depth);
+    }
+
+    void CtqView::CollapseAll()
+    {
+        tree->collapseAll();
+    }
+
+    bool CtqView::Find(const QString& text)
+    {
+        auto hits = model->match(model->index(0, 0), Qt::DisplayRole, text, 1,
+            Qt::MatchContains | Qt::MatchRecursive | Qt::MatchWrap);
+        if (hits.isEmpty() && database && model->IsLazy())
+        {
+            // items not fetched yet, by the start of their text through the index of the database;
+            // unsaved edits can have changed the text since
+            for (const auto& node : database->Search(text, storedHits))
+            {
+                const auto index = model->FetchStored(database->GetAncestry(node.id));
+                if (index.isValid() && index.data().toString().contains(text, Qt::CaseInsensitive))
+                {
+                    hits.append(index);
+                    break;
+                }
+            }
+        }
+        if (hits.isEmpty())
+        {
+            return false;
+        }
+        tree->ExpandTo(hits.first());
+        return true;
+    }
+
+    bool CtqView::LoadFile(const QString& filename)
+    {
+        const auto reload = !filename.isEmpty() && filename == GetFilename();
+        const auto expansion = reload ? tree->SaveExpansion() : TreeView::Expansion();
+        if (!Load(filename))
+        {
+            return false;
+        }
+        tree->RestoreExpansion(expansion);
+        return true;
+    }
+
+    bool CtqView::Load(const QString& filename)
+    {
+        if (isDatabase(filename))
+        {
+            std::shared_ptr<SqlStore> store = SqlStore::Open(filename);
+            if (!store)
+            {
+                return false;
+            }
+            document->SetFilename(QString());
+            model->Reset(std::shared_ptr<NodeStore>(store));
+            model->ClearJournal();
+            autosave->ClearBaseline();
+            autosave->Discard();
+            SetDatabase(std::move(store));
+            return true;
+        }
+
+        if (const auto size = QFileInfo(filename).size(); size >= lazyDocumentSize)
+        {
+            // null for a document with a journal, which is read as a whole
+            if (auto store = DocumentStore::Open(filename))
+            {
+                document->SetFilename(filename, size);
+                model->Reset(std::shared_ptr<NodeStore>(std::move(store)));
+                model->ClearJournal();
+                autosave->ClearBaseline();
+                autosave->Discard();
+                SetDatabase(nullptr);
+                return true;
+            }
+        }
+
+        auto root = document->Load(filename);
+        if (!root)
+        {
+            return false;
+        }
+        model->Reset(std::move(root));
+        model->ClearJournal();
+        autosave->ClearBaseline();
+        autosave->Discard();
+        SetDatabase(nullptr);
+        return true;
+    }
+
+    bool CtqView::Save()
+    {
+        if (database)
+        {
+            // a model that is not complete is never lazy, see Reset
+            const auto saved = model->IsJournalComplete() ?
+                database->Apply(model->GetJournal()) :
+                database->Write(model->GetRootItem());
+            if (saved)
+            {
+                if (model->IsLazy())
+                {
+                    model->StoreUpdated();
+                }
+                model->ClearJournal();
+                autosave->ClearBaseline();
+                autosave->Discard();
+            }
+            return saved;
+        }
+        if (document->GetFilename().isEmpty())
+        {
+            return false;
+        }
+
+        // after a reset (e.g. a merge) the journal cannot describe the tree,
+        // which is then never lazy, so the root item is all of it
+        const auto saved = model->IsJournalComplete() ?
+            document->Save(model->GetJournal()) :
+            document->SaveAs(model->GetRootItem(), document->GetFilename());
+        if (saved)
+        {
+            model->ClearJournal();
+            autosave->ClearBaseline();
+            autosave->Discard();
+        }
+        return saved;
+    }
+
+    bool CtqView::SaveAs(const QString& filename)
+    {
+        // a lazy model holds only part of the tree, the store the rest
+        std::unique_ptr<TreeItem> whole;
+        if (model->IsLazy() && (database || isDatabase(filename)))
+        {
+            whole = ReadTree();
+            if (!whole)
+            {
+                return false;
+            }
+        }
+        const auto& root = whole ? *whole : model->GetRootItem();
+
+        if (isDatabase(filename))
+        {
+            std::shared_ptr<SqlStore> store = (database && database->GetFilename() == filename) ?
+                database : SqlStore::Open(filename);
+            if (!store || !store->Write(root))
+            {
+                return false;
+            }
+            // the ids the model fetched by are those of the old store
+            if (model->IsLazy())
+            {
+                model->Reset(std::shared_ptr<NodeStore>(store));
+            }
+            document->SetFilename(QString());
+            SetDatabase(std::move(store));
+        }
+        else if (model->IsLazy() && !database)
+        {
+            if (!document->CopyAs(filename) || !document->Save(model->GetJournal()))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (!document->SaveAs(root, filename))
+            {
+                return false;
+            }
+            if (whole)
+            {
+                model->Reset(std::move(whole));
+            }
+            SetDatabase(nullptr);
+        }
+        model->ClearJournal();
+        autosave->ClearBaseline();
+        autosave->Discard();
+        return true;
+    }
+
+    QString CtqView::GetFilename() const
+    {
+        return database ? database->GetFilename() : document->GetFilename();
+    }
+
+    void CtqView::SetDatabase(std::shared_ptr<SqlStore> store)
+    {
+        database = std::move(store);
+        // recoveries are documents, which could only be recovered as such;
+        // a database instead commits every save as one transaction
+        autosave->SetEnabled(database == nullptr);
+    }
+
+    std::unique_ptr<TreeItem> CtqView::ReadTree() const
+    {
+        auto root = database ?
+            database->Read() :
+            Document::Read(document->GetFilename(), document->GetCommittedSize()).root;
+        if (!root)
+        {
+            return nullptr;
+        }
+        for (const auto& record : model->GetJournal())
+        {
+            if (!Apply(record, *root))
+            {
+                return nullptr;
+            }
+        }
+        return root;
+    }
+
+    std::optional<std::vector<MergeConflict>> CtqView::Merge(const QString& baseFilename, const QString& theirsFilename)
+    {
+        // kept open for autosaves to merge again on their worker
+        auto baseFile = std::make_shared<QFile>(baseFilename);
+        auto theirsFile = std::make_shared<QFile>(theirsFilename);
+        if (!baseFile->open(QIODevice::ReadOnly) || !theirsFile->open(QIODevice::ReadOnly))
+        {
+            return std::nullopt;
+        }
+        const auto base = Document::Read(*baseFile).root;
+        const auto theirs = Document::Read(*theirsFile).root;
+        if (!base || !theirs)
+        {
+            return std::nullopt;
+        }
+
+        // a lazy model holds only part of the tree, the store the rest
+        std::unique_ptr<TreeItem> whole;
+        if (model->IsLazy())
+        {
+            whole = ReadTree();
+            if (!whole)
+            {
+                return std::nullopt;
+            }
+        }
+
+        auto ours = autosave->Capture();
+        auto result = CtqTool::Merge(*base, whole ? *whole : model->GetRootItem(), *theirs);
+        autosave->SetBaseline(ours ? TreeSnapshot([=]() -> std::unique_ptr<TreeItem>
+        {
+            const auto oursRoot = ours();
+            const auto baseRoot = baseFile->seek(0) ? Document::Read(*baseFile).root : nullptr;
+            const auto theirsRoot = theirsFile->seek(0) ? Document::Read(*theirsFile).root : nullptr;
+            if (!oursRoot || !baseRoot || !theirsRoot)
+            {
+                return nullptr;
+            }
+            return std::move(CtqTool::Merge(*baseRoot, *oursRoot, *theirsRoot).root);
+        }) : TreeSnapshot());
+        model->Reset(std::move(result.root));
+        return std::move(result.conflicts);
+    }
+
+    bool CtqView::IsModified() const
+    {
+        return !model->IsJournalComplete() || !model->GetJournal().empty();
+    }
+
+    QStringList CtqView::GetRecoveries() const
+    {
+        return autosave->GetOrphans();
+    }
+
+    bool CtqView::Recover(const QString& recovery)
+    {
+        auto root = Document::Read(recovery).root;
+        if (!root)
+        {
+            return false;
+        }
+        // the recovered tree is only written back to its source by a full save
+        document->SetFilename(AutosaveService::GetSource(recovery));
+        autosave->SetBaseline(autosave->Adopt(recovery));
+        model->Reset(std::move(root));
+        SetDatabase(nullptr);
+        return true;
+    }
+
+    void CtqView::RemoveRecovery(const QString& recovery)
+    {
+        autosave->RemoveOrphan(recovery);
+    }
+
+    void CtqView::ReleaseRecoveries()
+    {
+        autosave->ReleaseOrphans();
+    }
+
+    void CtqView::DiscardRecovery()
+    {
+        autosave->ClearBaseline();
+        autosave->Discard();
+    }
+
+    bool CtqView::Import(const QString& filename, QString& error)
+    {
+        // kept open for autosaves to read again on their worker
+        auto file = std::make_shared<QFile>(filename);
+        if (!file->open(QIODevice::ReadOnly))
+        {
+            error = file->errorString();
+            return false;
+        }
+        const auto xml = isXml(filename);
+        auto root = xml ? ReadXml(*file, &error) : ReadJson(*file, &error);
+        if (!root)
+        {
+            return false;
+        }
+        // an imported tree is not backed by a document until it is saved as one
+        document->SetFilename(QString());
+        autosave->SetBaseline([file, xml]() -> std::unique_ptr<TreeItem>
+        {
+            if (!file->seek(0))
+            {
+                return nullptr;
+            }
+            return xml ? ReadXml(*file) : ReadJson(*file);
+        });
+        model->Reset(std::move(root));
+        SetDatabase(nullptr);
+        return true;
+    }
+
+    bool CtqView::Export(const QString& filename)
+    {
+        // a lazy model holds only part of the tree, the store the rest
+        std::unique_ptr<TreeItem> whole;
+        if (model->IsLazy())
+        {
+            whole = ReadTree();
+            if (!whole)
+            {
+                return false;
+            }
+        }
+        const auto& root = whole ? *whole : model->GetRootItem();
+
+        QSaveFile file(filename);
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            return false;
+        }
+        return (isXml(filename) ? WriteXml(root, file) : WriteJson(root, file)) && file.commit();
+    }
+
+    bool CtqView::ExportDiagram(const QString& filename, const DiagramExportOptions& options)
+    {
+        const auto index = scene->GetIndex();
+        return index && CtqTool::ExportDiagram(*index, filename, options);
+    }
+
+    void CtqView::ImportMeasurements(const QString& filename, const CsvColumns& columns,
+                                     std::function<void(const CsvImportResult&)> done)
+    {
+        pool.start([this, parse = PrepareCsvImport(filename, columns, *model), done = std::move(done)]()
+        {
+            // counted on the GUI thread, where the result is reported after the last window
+            auto samples = std::make_shared<size_t>(0);
+            auto result = parse([this, samples](CsvAppend append)
+            {
+                QMetaObject::invokeMethod(this, [this, samples, append = std::move(append)]()
+                {
+                    *samples += append(*model);
+                }, Qt::QueuedConnection);
+            });
+            QMetaObject::invokeMethod(this, [result, samples, done]() mutable
+            {
+                result.samples = *samples;
+                done(result);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void CtqView::EditTarget()
+    {
+        const auto index = tree->selectionModel()->currentIndex();
+        const auto target = model->GetTarget(index);
+        if (!target)
+        {
+            return;
+        }
+        TargetDialog dialog(model->data(index.siblingAtColumn(0), Qt::DisplayRole).toString(), *target, this);
+        if (dialog.exec() == QDialog::Accepted)
+        {
+            model->SetTarget(index, dialog.GetTarget());
+        }
+    }
+
+    void CtqView::Simulate(const SimulationOptions& options)
+    {
+        model->Simulate(options);
+    }
+
+    void CtqView::CancelSimulation()
+    {
+        model->CancelSimulation();
+    }
+
+    double CtqView::GetSimulationProgress() const
+    {
+        return model->GetSimulationProgress();
+    }
+
+    void CtqView::UpdateStatistics()
+    {
+        model->UpdateStatistics();
+    }
+
+    void CtqView::UpdateStackUps()
+    {
+        model->UpdateStackUps();
+    }
 
     void CtqView::InsertRow()
     {
@@ -110,7 +591,7 @@ namespace CtqTool
 
         UpdateActions();
 
-        for (int column = 0; column < model->columnCount(index.parent()); ++column) 
+        for (int column = 0; column < placeholderColumns; ++column) 
         {
             const auto child = model->index(index.row() + 1, column, index.parent());
             model->setData(child, QVariant(tr("[No data]")), Qt::EditRole);
@@ -127,7 +608,7 @@ namespace CtqTool
 
         UpdateActions();
 
-        for (int column = 0; column < model->columnCount(index.parent()); ++column) 
+        for (int column = 0; column < placeholderColumns; ++column) 
         {
             const auto child = model->index(index.row() + 1, column, index.parent());
             model->setData(child, QVariant(tr("[No data]")), Qt::EditRole);
@@ -158,8 +639,10 @@ namespace CtqTool
 
         for (int column = 0; column < model->columnCount(currentIndex); ++column) 
         {
-            const auto child = model->index(0, column, currentIndex);
-            model->setData(child, QVariant(tr("[No data]")), Qt::EditRole);
+            if (column < placeholderColumns)
+            {
+                model->setData(model->index(0, column, currentIndex), QVariant(tr("[No data]")), Qt::EditRole);
+            }
             if (!model->headerData(column, Qt::Horizontal).isValid())
             {
                 model->setHeaderData(column, Qt::Horizontal, QVariant(tr("[No header]")), Qt::EditRole);
@@ -223,9 +706,7 @@ namespace CtqTool
             if (!model->insertRow(0, currentIndex))
                 return;
     
-            const auto& existingItem = *static_cast<TreeItem*>(idx.internalPointer());
-            auto& child = *static_cast<TreeItem*>(model->index(0, 0, currentIndex).internalPointer());
-            child.CloneDataFrom(existingItem);
+            this->model->LinkData(model->index(0, 0, currentIndex), idx);
             
             tree->selectionModel()->setCurrentIndex(model->index(0, 0, currentIndex),
                 QItemSelectionModel::ClearAndSelect);
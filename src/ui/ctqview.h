@@ -18,19 +18,31 @@
 
 #pragma once
 
+#include "datamodel/csvimport.h"
+#include "datamodel/ctqmerge.h"
 #include "datamodel/ctqmodel.h"
+#include "diagramexport.h"
 
+#include <QThreadPool>
 #include <QWidget>
 
+#include <optional>
+
 class QTableView;
 class QTabWidget;
 
 namespace CtqTool
 {
     class CtqTreeScene;
+    class DiagramView;
+    class Minimap;
     class TreeView;
     class CtqModel;
     class CtqProxyModel;
+    class Document;
+    class AutosaveService;
+    class SqlStore;
+    class TreeItem;
 
     class CtqView : public QWidget
     {
@@ -40,29 +52,95 @@ namespace CtqTool
         CtqView(QWidget* parent = nullptr);
         ~CtqView();
 
-        void LoadFile(const QString& filename);
+        // a document or, for files ending in .ctqdb, a database; reloading
+        // the current file keeps what is expanded in the tree
+        bool LoadFile(const QString& filename);
+        bool Save();
+        bool SaveAs(const QString& filename);
+        QString GetFilename() const;
+        std::optional<std::vector<MergeConflict>> Merge(const QString& baseFilename, const QString& theirsFilename);
+
+        // edited since it was loaded or saved
+        bool IsModified() const;
+
+        // the recovery files of sessions that did not shut down cleanly, to
+        // restore the tree from one of them
+        QStringList GetRecoveries() const;
+        bool Recover(const QString& recovery);
+        void RemoveRecovery(const QString& recovery);
+        // leaves the others to the next session
+        void ReleaseRecoveries();
+        // drops this session's recovery file, on a clean exit
+        void DiscardRecovery();
+
+        // JSON or, for files ending in .xml, XML
+        bool Import(const QString& filename, QString& error);
+        bool Export(const QString& filename);
+
+        // the diagram as an image, SVG or PDF
+        bool ExportDiagram(const QString& filename, const DiagramExportOptions& = {});
+
+        // parses the file on a worker thread, then appends and calls done on this one
+        void ImportMeasurements(const QString& filename, const CsvColumns&,
+                                std::function<void(const CsvImportResult&)> done);
+
+        // edits the target of the current item, if it is a CTQ
+        void EditTarget();
+
+        // an overview of the diagram, for the main window to dock
+        QWidget* GetMinimap() const;
+
+        // notes on one line and rows of one height, which lays out large trees fastest
+        void SetSingleLineRows(bool);
+
+        void ExpandToDepth(int depth);
+        void CollapseAll();
+        // shows and selects the first item whose text contains text, among those fetched
+        bool Find(const QString& text);
         
         void InsertChild();
         void InsertExistingChild();
         void InsertRow();
         void InsertExistingRow();
         void RemoveRow();
+        void UpdateStatistics();
+        void UpdateStackUps();
+        // starts a simulation, emitting SimulationFinished once it is done
+        void Simulate(const SimulationOptions&);
+        void CancelSimulation();
+        double GetSimulationProgress() const;
+
+    signals:
+        void SpcViolations(const QStringList&);
+        void StatisticsUpdated();
+        void SimulationFinished(bool completed);
         
     private:
 
         void SetCurrentFile(const QString& fileName);
         void UpdateActions();
+        void SetDatabase(std::shared_ptr<SqlStore>);
+        bool Load(const QString& filename);
+
+        // the whole tree of a lazy model, as saved with the edits since
+        std::unique_ptr<TreeItem> ReadTree() const;
 
         CtqTreeScene* scene = nullptr;
         TreeView* tree = nullptr;
         QTableView* needTable = nullptr;
         QTableView* driverTable = nullptr;
         QTableView* ctqTable = nullptr;
+        DiagramView* diagram = nullptr;
+        Minimap* minimap = nullptr;
         QTabWidget* tabs = nullptr;
+        Document* document = nullptr;
+        AutosaveService* autosave = nullptr;
+        std::shared_ptr<SqlStore> database;
 
         std::unique_ptr<CtqModel> model;
         std::unique_ptr<CtqProxyModel> driversModel;
         std::unique_ptr<CtqProxyModel> needsModel;
         std::unique_ptr<CtqProxyModel> ctqsModel;
+        QThreadPool pool;
     };
 }
@@ -0,0 +1,315 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "diagramexport.h"
+#include "diagramitem.h"
+#include "datamodel/parallel.h"
+
+#include <QFileInfo>
+#include <QImage>
+#include <QPageSize>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QSaveFile>
+#include <QSvgGenerator>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto margin = 20.0;               // scene units around the diagram
+    constexpr auto vectorScale = 1.0;           // vector output is collected at full detail
+    constexpr auto screenDpi = 96.0;            // the scene is laid out in pixels of a screen
+    constexpr auto maxPagePoints = 14400.0;     // 200 inch, the largest page most PDF readers open
+
+    // A baseline little endian RGB TIFF, written strip by strip. The image
+    // file directory that lists the strips comes last, once they are known.
+    class TiffWriter
+    {
+    public:
+        explicit TiffWriter(QIODevice& d) :
+            device(d)
+        {
+        }
+
+        bool Begin()
+        {
+            return device.write("II*\0\0\0\0\0", 8) == 8;
+        }
+
+        bool Append(const QByteArray& strip)
+        {
+            offsets.push_back(static_cast<quint32>(device.pos()));
+            counts.push_back(static_cast<quint32>(strip.size()));
+            return device.write(strip) == strip.size() && fits(device.pos());
+        }
+
+        bool Finish(int width, int height, int rowsPerStrip, int dpi)
+        {
+            QByteArray data;
+            if (device.pos() % 2 != 0)
+            {
+                data.append('\0');
+            }
+            const auto at = [&]() { return static_cast<quint32>(device.pos() + data.size()); };
+
+            const auto bitsPerSample = at();
+            put16(data, 8);
+            put16(data, 8);
+            put16(data, 8);
+            const auto resolution = at();
+            put32(data, static_cast<quint32>(dpi));
+            put32(data, 1);
+            const auto stripOffsets = at();
+            for (const auto offset : offsets)
+            {
+                put32(data, offset);
+            }
+            const auto stripByteCounts = at();
+            for (const auto count : counts)
+            {
+                put32(data, count);
+            }
+
+            const auto directory = at();
+            const auto strips = static_cast<quint32>(offsets.size());
+            put16(data, 13);
+            entry(data, 256, long_, 1, static_cast<quint32>(width));
+            entry(data, 257, long_, 1, static_cast<quint32>(height));
+            entry(data, 258, short_, 3, bitsPerSample);
+            entry(data, 259, short_, 1, 8);     // deflate
+            entry(data, 262, short_, 1, 2);     // RGB
+            entry(data, 273, long_, strips, strips == 1 ? offsets[0] : stripOffsets);
+            entry(data, 277, short_, 1, 3);
+            entry(data, 278, long_, 1, static_cast<quint32>(rowsPerStrip));
+            entry(data, 279, long_, strips, strips == 1 ? counts[0] : stripByteCounts);
+            entry(data, 282, rational, 1, resolution);
+            entry(data, 283, rational, 1, resolution);
+            entry(data, 284, short_, 1, 1);     // chunky
+            entry(data, 296, short_, 1, 2);     // inch
+            put32(data, 0);
+
+            QByteArray header;
+            put32(header, directory);
+            return device.write(data) == data.size() && fits(device.pos()) &&
+                device.seek(4) && device.write(header) == header.size();
+        }
+
+    private:
+        enum Type : quint16
+        {
+            short_ = 3,
+            long_ = 4,
+            rational = 5
+        };
+
+        static bool fits(qint64 position)
+        {
+            return position <= std::numeric_limits<quint32>::max();
+        }
+
+        static void put16(QByteArray& out, quint16 value)
+        {
+            const auto le = qToLittleEndian(value);
+            out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+        }
+
+        static void put32(QByteArray& out, quint32 value)
+        {
+            const auto le = qToLittleEndian(value);
+            out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+        }
+
+        // a single short is stored in the entry itself, in its first two bytes
+        static void entry(QByteArray& out, quint16 tag, Type type, quint32 count, quint32 value)
+        {
+            put16(out, tag);
+            put16(out, type);
+            put32(out, count);
+            if (type == short_ && count == 1)
+            {
+                put16(out, static_cast<quint16>(value));
+                put16(out, 0);
+            }
+            else
+            {
+                put32(out, value);
+            }
+        }
+
+        QIODevice& device;
+        std::vector<quint32> offsets;
+        std::vector<quint32> counts;
+    };
+
+    // rows of packed RGB, deflated as TIFF expects
+    QByteArray renderStrip(const DiagramIndex& index, const QRectF& area, const QSize& size, double scale)
+    {
+        QImage image(size, QImage::Format_RGB32);
+        if (image.isNull())
+        {
+            return {};
+        }
+        image.fill(Qt::white);
+
+        DiagramIndex::Primitives primitives;
+        index.Collect(area, scale, primitives);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.scale(scale, scale);
+        painter.translate(-area.topLeft());
+        DiagramIndex::Draw(painter, primitives);
+        painter.end();
+
+        QByteArray rgb(qsizetype(size.width()) * size.height() * 3, Qt::Uninitialized);
+        auto* out = rgb.data();
+        for (auto y = 0; y < size.height(); ++y)
+        {
+            const auto* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            for (auto x = 0; x < size.width(); ++x)
+            {
+                *out++ = static_cast<char>(qRed(line[x]));
+                *out++ = static_cast<char>(qGreen(line[x]));
+                *out++ = static_cast<char>(qBlue(line[x]));
+            }
+        }
+        // qCompress puts the uncompressed size in front of the zlib stream
+        return qCompress(rgb).mid(4);
+    }
+
+    bool exportRaster(const DiagramIndex& index, const QRectF& area, const QString& filename,
+        const DiagramExportOptions& options)
+    {
+        const auto width = std::ceil(area.width() * options.scale);
+        const auto height = std::ceil(area.height() * options.scale);
+        if (!(width >= 1 && height >= 1 && width <= std::numeric_limits<int>::max() &&
+            height <= std::numeric_limits<int>::max()))
+        {
+            return false;
+        }
+
+        const auto w = static_cast<int>(width);
+        const auto h = static_cast<int>(height);
+        // a strip per thread in flight, the budget shared between them
+        const auto batch = ParallelThreads();
+        const auto stripBytes = options.stripBytes / static_cast<qint64>(batch);
+        const auto rowsPerStrip = static_cast<int>(std::clamp<qint64>(stripBytes / (4 * qint64(w)), 1, h));
+        const auto strips = (h + rowsPerStrip - 1) / rowsPerStrip;
+
+        QSaveFile file(filename);
+        TiffWriter tiff(file);
+        if (!file.open(QIODevice::WriteOnly) || !tiff.Begin())
+        {
+            return false;
+        }
+
+        // a batch of strips is rendered in parallel, then written in order
+        std::vector<QByteArray> rendered(batch);
+        for (auto first = 0; first < strips; first += static_cast<int>(batch))
+        {
+            const auto count = std::min<size_t>(batch, strips - first);
+            ParallelFor(count, [&](size_t i)
+            {
+                const auto row = (first + static_cast<int>(i)) * rowsPerStrip;
+                const auto rows = std::min(rowsPerStrip, h - row);
+                const QRectF strip(area.left(), area.top() + row / options.scale, area.width(), rows / options.scale);
+                rendered[i] = renderStrip(index, strip, QSize(w, rows), options.scale);
+            });
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (rendered[i].isEmpty() || !tiff.Append(rendered[i]))
+                {
+                    return false;
+                }
+                rendered[i] = QByteArray();
+            }
+        }
+        return tiff.Finish(w, h, rowsPerStrip, options.dpi) && file.commit();
+    }
+
+    bool exportSvg(const DiagramIndex& index, const QRectF& area, const QString& filename)
+    {
+        DiagramIndex::Primitives primitives;
+        index.Collect(area, vectorScale, primitives);
+
+        QSvgGenerator svg;
+        svg.setFileName(filename);
+        svg.setSize(area.size().toSize());
+        svg.setViewBox(QRectF(QPointF(), area.size()));
+        svg.setTitle(QFileInfo(filename).completeBaseName());
+
+        QPainter painter;
+        if (!painter.begin(&svg))
+        {
+            return false;
+        }
+        painter.translate(-area.topLeft());
+        DiagramIndex::Draw(painter, primitives);
+        return painter.end();
+    }
+
+    // one page, shrunk to fit when the diagram is larger than a page can be
+    bool exportPdf(const DiagramIndex& index, const QRectF& area, const QString& filename)
+    {
+        DiagramIndex::Primitives primitives;
+        index.Collect(area, vectorScale, primitives);
+
+        const auto points = area.size() * (72.0 / screenDpi);
+        const auto fit = std::min(1.0, maxPagePoints / std::max(points.width(), points.height()));
+        QPdfWriter pdf(filename);
+        pdf.setResolution(static_cast<int>(screenDpi));
+        pdf.setPageSize(QPageSize(points * fit, QPageSize::Point, QString(), QPageSize::ExactMatch));
+        pdf.setPageMargins(QMarginsF());
+        pdf.setTitle(QFileInfo(filename).completeBaseName());
+        pdf.setCreator("CTQ tool");
+
+        QPainter painter;
+        if (!painter.begin(&pdf))
+        {
+            return false;
+        }
+        painter.scale(fit, fit);
+        painter.translate(-area.topLeft());
+        DiagramIndex::Draw(painter, primitives);
+        return painter.end();
+    }
+}
+
+namespace CtqTool
+{
+    bool ExportDiagram(const DiagramIndex& index, const QString& filename, const DiagramExportOptions& options)
+    {
+        const auto area = index.GetBounds().adjusted(-margin, -margin, margin, margin);
+        const auto suffix = QFileInfo(filename).suffix().toLower();
+        if (suffix == "svg")
+        {
+            return exportSvg(index, area, filename);
+        }
+        if (suffix == "pdf")
+        {
+            return exportPdf(index, area, filename);
+        }
+        return exportRaster(index, area, filename, options);
+    }
+}
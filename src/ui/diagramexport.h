@@ -0,0 +1,40 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+
+namespace CtqTool
+{
+    class DiagramIndex;
+
+    struct DiagramExportOptions
+    {
+        double scale = 2.0;                     // pixels per scene unit of a raster
+        int dpi = 300;                          // recorded in a raster
+        qint64 stripBytes = 256 << 20;          // rendered at once, shared by the threads
+    };
+
+    // Writes the diagram without a window, by the suffix of filename as SVG,
+    // PDF or else a TIFF raster. A raster is rendered in horizontal strips in
+    // parallel, each compressed and appended to the file as it is done, so
+    // only stripBytes are held in memory however large the image and however
+    // many threads render it.
+    bool ExportDiagram(const DiagramIndex&, const QString& filename, const DiagramExportOptions& = {});
+}
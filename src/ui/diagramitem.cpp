@@ -0,0 +1,251 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "diagramitem.h"
+
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include <algorithm>
+
+namespace
+{
+    constexpr auto glyphSpan = 6.0;         // pixels, below which a subtree is one glyph
+    constexpr auto minTextHeight = 12.0;    // pixels of box height
+    constexpr auto padding = 6.0;
+
+    const QColor edgeColor(110, 110, 110);
+    const QColor glyphColor(160, 160, 160);
+}
+
+namespace CtqTool
+{
+    void DiagramIndex::Primitives::Clear()
+    {
+        boxes.clear();
+        glyphs.clear();
+        edges.clear();
+        labels.clear();
+    }
+
+    void DiagramIndex::Rebuild(const TreeLayout::Node& root)
+    {
+        // keeping the vectors' capacity, as the tree mostly changes a little
+        for (auto& level : levels)
+        {
+            level.Clear();
+        }
+        for (const auto& child : root.children)
+        {
+            Add(*child, 0, child->x, -1);
+        }
+        while (!levels.empty() && levels.back().x.empty())
+        {
+            levels.pop_back();
+        }
+        for (size_t l = 0; l < levels.size(); ++l)
+        {
+            levels[l].firstChild.push_back((l + 1 < levels.size()) ? static_cast<int>(levels[l + 1].x.size()) : 0);
+        }
+
+        // subtree extents bottom up
+        for (auto l = levels.size(); l-- > 0;)
+        {
+            auto& level = levels[l];
+            for (size_t i = 0; i < level.x.size(); ++i)
+            {
+                for (auto c = level.firstChild[i]; c < level.firstChild[i + 1]; ++c)
+                {
+                    const auto& below = levels[l + 1];
+                    level.left[i] = std::min(level.left[i], below.left[c]);
+                    level.right[i] = std::max(level.right[i], below.right[c]);
+                    level.height[i] = std::max(level.height[i], below.height[c] + 1);
+                }
+                level.reach = std::max({level.reach, level.x[i] - level.left[i], level.right[i] - level.x[i]});
+                level.widest = std::max(level.widest, level.right[i] - level.left[i]);
+            }
+        }
+
+        bounds = QRectF();
+        if (!levels.empty())
+        {
+            const auto& needs = levels.front();
+            const auto left = *std::min_element(needs.left.begin(), needs.left.end());
+            const auto right = *std::max_element(needs.right.begin(), needs.right.end());
+            bounds = QRectF(left, -TreeLayout::boxHeight / 2, right - left,
+                (levels.size() - 1) * TreeLayout::levelHeight + TreeLayout::boxHeight);
+        }
+    }
+
+    const QRectF& DiagramIndex::GetBounds() const
+    {
+        return bounds;
+    }
+
+    void DiagramIndex::Add(const TreeLayout::Node& node, size_t depth, double x, int parent)
+    {
+        if (levels.size() <= depth)
+        {
+            levels.resize(depth + 1);
+        }
+        {
+            auto& level = levels[depth];
+            level.x.push_back(x);
+            level.width.push_back(static_cast<float>(node.width));
+            level.left.push_back(x - node.width / 2);
+            level.right.push_back(x + node.width / 2);
+            level.parent.push_back(parent);
+            level.height.push_back(0);
+            level.text.push_back(node.text);
+            level.firstChild.push_back((depth + 1 < levels.size()) ? static_cast<int>(levels[depth + 1].x.size()) : 0);
+        }
+
+        const auto index = static_cast<int>(levels[depth].x.size()) - 1;
+        for (const auto& child : node.children)
+        {
+            Add(*child, depth + 1, x + child->x, index);
+        }
+    }
+
+    void DiagramIndex::Level::Clear()
+    {
+        x.clear();
+        width.clear();
+        left.clear();
+        right.clear();
+        parent.clear();
+        firstChild.clear();
+        height.clear();
+        text.clear();
+        reach = 0.0;
+        widest = 0.0;
+    }
+
+    void DiagramIndex::Collect(const QRectF& exposed, double scale, Primitives& primitives) const
+    {
+        const auto collapsed = [scale](double span) { return span * scale < glyphSpan; };
+        const auto half = TreeLayout::boxHeight / 2;
+        const auto labelled = TreeLayout::boxHeight * scale >= minTextHeight;
+
+        primitives.Clear();
+        for (size_t l = 0; l < levels.size(); ++l)
+        {
+            const auto& level = levels[l];
+            const auto y = l * TreeLayout::levelHeight;
+            if (y - TreeLayout::levelHeight / 2 > exposed.bottom() || (l > 0 && collapsed(levels[l - 1].widest)))
+            {
+                break; // and so are the levels below
+            }
+
+            const auto from = std::lower_bound(level.x.begin(), level.x.end(), exposed.left() - level.reach) - level.x.begin();
+            const auto to = std::upper_bound(level.x.begin(), level.x.end(), exposed.right() + level.reach) - level.x.begin();
+            for (auto i = from; i < to; ++i)
+            {
+                const auto bottom = y + level.height[i] * TreeLayout::levelHeight + half;
+                const auto p = level.parent[i];
+                if (level.right[i] < exposed.left() || level.left[i] > exposed.right() || bottom < exposed.top() ||
+                    (p >= 0 && collapsed(levels[l - 1].right[p] - levels[l - 1].left[p])))
+                {
+                    continue;
+                }
+                if (collapsed(level.right[i] - level.left[i]))
+                {
+                    primitives.glyphs.emplace_back(QPointF(level.left[i], y - half), QPointF(level.right[i], bottom));
+                    continue;
+                }
+
+                const auto x = level.x[i];
+                const QRectF box(x - level.width[i] / 2, y - half, level.width[i], TreeLayout::boxHeight);
+                primitives.boxes.push_back(box);
+                if (p >= 0)
+                {
+                    primitives.edges.emplace_back(x, y - half, x, y - TreeLayout::levelHeight / 2);
+                }
+                if (level.firstChild[i] < level.firstChild[i + 1])
+                {
+                    const auto& below = levels[l + 1].x;
+                    const auto middle = y + TreeLayout::levelHeight / 2;
+                    primitives.edges.emplace_back(x, y + half, x, middle);
+                    primitives.edges.emplace_back(below[level.firstChild[i]], middle, below[level.firstChild[i + 1] - 1], middle);
+                }
+                if (labelled && box.intersects(exposed))
+                {
+                    primitives.labels.emplace_back(box, level.text[i]);
+                }
+            }
+        }
+    }
+
+    void DiagramIndex::Draw(QPainter& painter, const Primitives& primitives)
+    {
+        const auto& [boxes, glyphs, edges, labels] = primitives;
+        painter.setPen(QPen(edgeColor, 0));
+        painter.drawLines(edges.data(), static_cast<int>(edges.size()));
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(glyphColor);
+        painter.drawRects(glyphs.data(), static_cast<int>(glyphs.size()));
+        painter.setPen(QPen(Qt::black, 0));
+        painter.setBrush(Qt::white);
+        painter.drawRects(boxes.data(), static_cast<int>(boxes.size()));
+
+        const QFontMetricsF metrics(painter.font());
+        for (const auto& [box, text] : labels)
+        {
+            const auto inner = box.adjusted(padding, 0, -padding, 0);
+            painter.drawText(inner, Qt::AlignCenter, metrics.elidedText(text, Qt::ElideRight, inner.width()));
+        }
+    }
+
+    DiagramItem::DiagramItem()
+    {
+        setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+    }
+
+    void DiagramItem::SetLayout(const TreeLayout::Node& root)
+    {
+        prepareGeometryChange();
+        // a snapshot still in use elsewhere is left alone
+        if (!index || index.use_count() > 1)
+        {
+            index = std::make_shared<DiagramIndex>();
+        }
+        index->Rebuild(root);
+        update();
+    }
+
+    std::shared_ptr<const DiagramIndex> DiagramItem::GetIndex() const
+    {
+        return index;
+    }
+
+    QRectF DiagramItem::boundingRect() const
+    {
+        return index ? index->GetBounds() : QRectF();
+    }
+
+    void DiagramItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*)
+    {
+        if (index)
+        {
+            index->Collect(option->exposedRect, QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform()),
+                primitives);
+            DiagramIndex::Draw(*painter, primitives);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "treelayout.h"
+
+#include <QGraphicsItem>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace CtqTool
+{
+    // An index of the laid out tree for drawing it. Each level keeps its nodes
+    // in tree order, which is also the order of their x, so the nodes near an
+    // exposed area are found by binary search. A subtree narrower than a few
+    // pixels is drawn as a single glyph without visiting its nodes, and text
+    // only once boxes are tall enough to read it. Const access is thread safe.
+    class DiagramIndex
+    {
+    public:
+        // what to draw, in scene units
+        struct Primitives
+        {
+            std::vector<QRectF> boxes;
+            std::vector<QRectF> glyphs;
+            std::vector<QLineF> edges;
+            std::vector<std::pair<QRectF, QString>> labels;
+
+            void Clear();
+        };
+
+        // O(n), keeping the capacity of the previous index
+        void Rebuild(const TreeLayout::Node& root);
+        const QRectF& GetBounds() const;
+
+        // the part of the diagram within exposed, at scale pixels per unit
+        void Collect(const QRectF& exposed, double scale, Primitives&) const;
+        static void Draw(QPainter&, const Primitives&);
+
+    private:
+        struct Level
+        {
+            std::vector<double> x;
+            std::vector<float> width;
+            std::vector<double> left;           // of the subtree
+            std::vector<double> right;
+            std::vector<int> parent;            // in the level above
+            std::vector<int> firstChild;        // in the level below, one more than there are nodes
+            std::vector<int> height;            // levels below the node
+            std::vector<QString> text;
+            double reach = 0.0;                 // the most any subtree extends from its node
+            double widest = 0.0;                // subtree
+
+            void Clear();
+        };
+
+        void Add(const TreeLayout::Node&, size_t depth, double x, int parent);
+
+        std::vector<Level> levels;
+        QRectF bounds;
+    };
+
+    // The whole diagram as one item rather than an item per node
+    class DiagramItem : public QGraphicsItem
+    {
+    public:
+        DiagramItem();
+
+        void SetLayout(const TreeLayout::Node& root);
+
+        // a snapshot, unaffected by later layouts
+        std::shared_ptr<const DiagramIndex> GetIndex() const;
+
+        QRectF boundingRect() const override;
+        void paint(QPainter*, const QStyleOptionGraphicsItem*, QWidget*) override;
+
+    private:
+        std::shared_ptr<DiagramIndex> index;
+        DiagramIndex::Primitives primitives;
+    };
+}
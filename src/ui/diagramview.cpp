@@ -0,0 +1,68 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "diagramview.h"
+
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr auto zoomPerDegree = 1.0025;
+    constexpr auto minScale = 1e-7;
+    constexpr auto maxScale = 8.0;
+}
+
+namespace CtqTool
+{
+    DiagramView::DiagramView(QWidget* parent) :
+        QGraphicsView(parent)
+    {
+        setDragMode(QGraphicsView::ScrollHandDrag);
+        setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+        setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+    }
+
+    QRectF DiagramView::GetVisibleRect() const
+    {
+        return mapToScene(viewport()->rect()).boundingRect();
+    }
+
+    void DiagramView::wheelEvent(QWheelEvent* event)
+    {
+        const auto degrees = event->angleDelta().y() / 8.0;
+        const auto current = transform().m11();
+        const auto target = std::clamp(current * std::pow(zoomPerDegree, degrees), minScale, maxScale);
+        scale(target / current, target / current);
+        emit ViewportChanged();
+    }
+
+    void DiagramView::scrollContentsBy(int dx, int dy)
+    {
+        QGraphicsView::scrollContentsBy(dx, dy);
+        emit ViewportChanged();
+    }
+
+    void DiagramView::resizeEvent(QResizeEvent* event)
+    {
+        QGraphicsView::resizeEvent(event);
+        emit ViewportChanged();
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QGraphicsView>
+
+namespace CtqTool
+{
+    // A view of the diagram zoomed with the mouse wheel around the cursor
+    class DiagramView : public QGraphicsView
+    {
+        Q_OBJECT
+    public:
+        DiagramView(QWidget* parent = nullptr);
+
+        // the part of the scene in view
+        QRectF GetVisibleRect() const;
+
+    signals:
+        // scrolled, zoomed or resized
+        void ViewportChanged();
+
+    protected:
+        void wheelEvent(QWheelEvent*) override;
+        void scrollContentsBy(int dx, int dy) override;
+        void resizeEvent(QResizeEvent*) override;
+    };
+}
@@ -18,21 +18,31 @@
 
 #include "mainwindow.h"
 
+#include "csvimportdialog.h"
 #include "ctqview.h"
 #include "ctqtreescene.h"
 #include "itemdialog.h"
 #include "treeview.h"
 #include "utilities.h"
 
+#include "datamodel/autosave.h"
 #include "datamodel/ctqmodel.h"
 #include "datamodel/ctqproxymodel.h"
 
 #include <QtWidgets>
 
+#include <limits>
+
 #define _CTQ_VERSION_ "0.0.1"
 
 namespace
 {
+    QString throughput(qint64 bytes, const QElapsedTimer& timer)
+    {
+        const auto seconds = std::max<qint64>(timer.nsecsElapsed(), 1) / 1e9;
+        return QString::number(bytes / seconds / 1e6, 'f', 1) + " MB/s";
+    }
+
     auto* MakeAction(const QString& title, QObject* parent, const QKeySequence& shortcut)
     {
         auto* action = new QAction(title, parent);
@@ -50,6 +60,8 @@ namespace CtqTool
         setCentralWidget(view);
         setAcceptDrops(true);
 
+        MakeSpcLog();
+        MakeMinimap();
         MakeMenus();
         MakeStatusBar();
 
@@ -57,6 +69,8 @@ namespace CtqTool
         constexpr auto height = 700;
         constexpr auto width = 1100;
         resize(width, height);
+
+        QTimer::singleShot(0, this, &MainWindow::OfferRecovery);
     }
 
     void MainWindow::About()
@@ -112,6 +126,17 @@ namespace CtqTool
         auto* removeRowAction = MakeAction(tr("Remove row"), this, QKeySequence::Delete);
         connect(removeRowAction, &QAction::triggered, view, &CtqView::RemoveRow);
         editMenu->addAction(removeRowAction);
+
+        auto* targetAction = MakeAction(tr("&Target..."), this, QKeySequence(Qt::CTRL | Qt::Key_T));
+        targetAction->setStatusTip(tr("Edit the specification limits, nominal value and units of the current CTQ"));
+        connect(targetAction, &QAction::triggered, view, &CtqView::EditTarget);
+        editMenu->addAction(targetAction);
+
+        editMenu->addSeparator();
+        auto* findAction = MakeAction(tr("&Find..."), this, QKeySequence::Find);
+        findAction->setStatusTip(tr("Show the first item whose text contains a search text"));
+        connect(findAction, &QAction::triggered, this, &MainWindow::Find);
+        editMenu->addAction(findAction);
     }
 
     void MainWindow::SetClipBoard(const QString& text)
@@ -142,6 +167,31 @@ namespace CtqTool
         connect(saveAsAction, &QAction::triggered, this, &MainWindow::SaveAs);
         fileMenu->addAction(saveAsAction);
 
+        auto* mergeAction = new QAction(tr("&Merge..."), this);
+        mergeAction->setStatusTip(tr("Three-way merge a base and a modified copy into the current tree"));
+        connect(mergeAction, &QAction::triggered, this, &MainWindow::Merge);
+        fileMenu->addAction(mergeAction);
+
+        auto* importAction = new QAction(tr("&Import..."), this);
+        importAction->setStatusTip(tr("Read a tree exchanged as JSON or XML"));
+        connect(importAction, &QAction::triggered, this, &MainWindow::Import);
+        fileMenu->addAction(importAction);
+
+        auto* exportAction = new QAction(tr("&Export..."), this);
+        exportAction->setStatusTip(tr("Write the tree as JSON or XML"));
+        connect(exportAction, &QAction::triggered, this, &MainWindow::Export);
+        fileMenu->addAction(exportAction);
+
+        auto* exportDiagramAction = new QAction(tr("Export &diagram..."), this);
+        exportDiagramAction->setStatusTip(tr("Write the diagram as a TIFF image, SVG or PDF"));
+        connect(exportDiagramAction, &QAction::triggered, this, &MainWindow::ExportDiagram);
+        fileMenu->addAction(exportDiagramAction);
+
+        auto* importMeasurementsAction = new QAction(tr("Import &measurements..."), this);
+        importMeasurementsAction->setStatusTip(tr("Append samples from a CSV file to the CTQs they name"));
+        connect(importMeasurementsAction, &QAction::triggered, this, &MainWindow::ImportMeasurements);
+        fileMenu->addAction(importMeasurementsAction);
+
         auto* reloadAction = MakeAction(tr("&Reload"), this, QKeySequence(QKeySequence::Refresh));
         connect(reloadAction, &QAction::triggered, this, &MainWindow::OnReloadTriggered);
         fileMenu->addAction(reloadAction);
@@ -167,6 +217,93 @@ namespace CtqTool
     void MainWindow::MakeViewMenu()
     {
         auto* viewMenu = menuBar()->addMenu(tr("&View"));
+
+        auto* statisticsAction = MakeAction(tr("Update &statistics"), this, QKeySequence(Qt::Key_F9));
+        statisticsAction->setStatusTip(tr("Recompute the statistics of all CTQs from their samples"));
+        connect(statisticsAction, &QAction::triggered, this, [this]()
+        {
+            statusBar()->showMessage(tr("Updating statistics..."));
+            view->UpdateStatistics();
+        });
+        connect(view, &CtqView::StatisticsUpdated, this, [this]() { statusBar()->showMessage(tr("Statistics updated")); });
+        viewMenu->addAction(statisticsAction);
+
+        auto* simulateAction = new QAction(tr("Run s&imulation..."), this);
+        simulateAction->setStatusTip(tr("Propagate the variation of the CTQs up the tree by Monte Carlo simulation"));
+        connect(simulateAction, &QAction::triggered, this, &MainWindow::Simulate);
+        connect(view, &CtqView::SimulationFinished, this, [this](bool completed)
+        {
+            if (simulationProgress != nullptr)
+            {
+                simulationProgress->deleteLater();
+                simulationProgress = nullptr;
+            }
+            statusBar()->showMessage(completed ?
+                tr("Simulated %1 trials in %2 s").arg(simulationTrials).arg(simulationTimer.elapsed() / 1000.0, 0, 'f', 1) :
+                tr("Simulation cancelled"));
+        });
+        viewMenu->addAction(simulateAction);
+
+        auto* stackUpAction = MakeAction(tr("Update stack-&ups"), this, QKeySequence(Qt::SHIFT | Qt::Key_F9));
+        stackUpAction->setStatusTip(tr("Recompute how the CTQ tolerances add up where the tree changed"));
+        connect(stackUpAction, &QAction::triggered, view, &CtqView::UpdateStackUps);
+        viewMenu->addAction(stackUpAction);
+
+        auto* singleLineAction = new QAction(tr("Single-line &rows"), this);
+        singleLineAction->setStatusTip(tr("Show notes on one line, which keeps scrolling large trees fast"));
+        singleLineAction->setCheckable(true);
+        connect(singleLineAction, &QAction::toggled, view, &CtqView::SetSingleLineRows);
+        viewMenu->addAction(singleLineAction);
+
+        auto* expandAllAction = new QAction(tr("&Expand all"), this);
+        connect(expandAllAction, &QAction::triggered, this, [this]() { view->ExpandToDepth(std::numeric_limits<int>::max()); });
+        viewMenu->addAction(expandAllAction);
+
+        auto* expandToLevelAction = new QAction(tr("Expand to &level..."), this);
+        connect(expandToLevelAction, &QAction::triggered, this, &MainWindow::ExpandToLevel);
+        viewMenu->addAction(expandToLevelAction);
+
+        auto* collapseAllAction = new QAction(tr("&Collapse all"), this);
+        connect(collapseAllAction, &QAction::triggered, view, &CtqView::CollapseAll);
+        viewMenu->addAction(collapseAllAction);
+
+        auto* spcLogAction = spcLog->toggleViewAction();
+        spcLogAction->setText(tr("SPC &log"));
+        viewMenu->addAction(spcLogAction);
+
+        auto* minimapAction = minimap->toggleViewAction();
+        minimapAction->setText(tr("&Overview"));
+        viewMenu->addAction(minimapAction);
+    }
+
+    void MainWindow::MakeSpcLog()
+    {
+        constexpr auto maximumLines = 10000;
+
+        auto* log = new QPlainTextEdit(this);
+        log->setReadOnly(true);
+        log->setMaximumBlockCount(maximumLines);
+        connect(view, &CtqView::SpcViolations, log, [log](const QStringList& lines)
+        {
+            log->appendPlainText(lines.join('\n'));
+        });
+
+        spcLog = new QDockWidget(tr("SPC log"), this);
+        spcLog->setWidget(log);
+        addDockWidget(Qt::BottomDockWidgetArea, spcLog);
+        spcLog->hide();
+        connect(view, &CtqView::SpcViolations, spcLog, &QWidget::show);
+    }
+
+    void MainWindow::MakeMinimap()
+    {
+        constexpr auto height = 90;
+
+        minimap = new QDockWidget(tr("Overview"), this);
+        minimap->setWidget(view->GetMinimap());
+        minimap->widget()->setMinimumHeight(height);
+        addDockWidget(Qt::BottomDockWidgetArea, minimap);
+        minimap->hide();
     }
 
     void MainWindow::MakeStatusBar()
@@ -176,23 +313,328 @@ namespace CtqTool
 
     void MainWindow::Open()
     {
-        QFileDialog dialog(this, "Open log file...");
+        if (!MaybeSave())
+        {
+            return;
+        }
+
+        QFileDialog dialog(this, "Open CTQ tree...");
         dialog.setFileMode(QFileDialog::ExistingFile);
-        dialog.setNameFilter(tr("Log file (*.log)"));
+        dialog.setNameFilter(tr("CTQ tree (*.ctq *.txt);;CTQ database (*.ctqdb);;All files (*)"));
         dialog.setViewMode(QFileDialog::Detail);
 
         if (dialog.exec() == QDialog::Accepted)
         {
-            // todo implement
+            LoadFile(dialog.selectedFiles().first());
         }
     }
     
-    void MainWindow::Save()
+    void MainWindow::Merge()
     {
+        if (!MaybeSave())
+        {
+            return;
+        }
+
+        const auto filter = tr("CTQ tree (*.ctq *.txt);;All files (*)");
+        const auto base = QFileDialog::getOpenFileName(this, tr("Select the common base..."), QString(), filter);
+        if (base.isEmpty())
+        {
+            return;
+        }
+        const auto theirs = QFileDialog::getOpenFileName(this, tr("Select the modified copy to merge..."), QString(), filter);
+        if (theirs.isEmpty())
+        {
+            return;
+        }
+
+        const auto result = view->Merge(base, theirs);
+        if (!result)
+        {
+            QMessageBox::critical(this, tr("Error merging..."), tr("The selected files could not be read."));
+            return;
+        }
+
+        const auto& conflicts = *result;
+        if (conflicts.empty())
+        {
+            statusBar()->showMessage(tr("Merged without conflicts"));
+            return;
+        }
+
+        QStringList lines;
+        for (const auto& conflict : conflicts)
+        {
+            lines.push_back(ToString(conflict));
+        }
+        QMessageBox box(QMessageBox::Warning, tr("Merge conflicts"),
+            tr("%1 conflict(s) were resolved in favour of the current tree.").arg(conflicts.size()),
+            QMessageBox::Ok, this);
+        box.setDetailedText(lines.join('\n'));
+        box.exec();
+    }
+
+    void MainWindow::OfferRecovery()
+    {
+        // the most recent first, until one is recovered
+        for (const auto& recovery : view->GetRecoveries())
+        {
+            const auto source = AutosaveService::GetSource(recovery);
+            const auto answer = QMessageBox::question(this, tr("Recover unsaved changes"),
+                tr("A session of CTQ tool did not shut down cleanly. Recover its unsaved changes to %1?")
+                    .arg(source.isEmpty() ? tr("an untitled tree") : source));
+            if (answer != QMessageBox::Yes)
+            {
+                view->RemoveRecovery(recovery);
+                continue;
+            }
+
+            if (!MaybeSave())
+            {
+                break;
+            }
+            if (!view->Recover(recovery))
+            {
+                QMessageBox::critical(this, tr("Error recovering..."), tr("The recovery file could not be read."));
+                break;
+            }
+            if (!source.isEmpty())
+            {
+                SetCurrentFile(source);
+            }
+            statusBar()->showMessage(tr("Recovered unsaved changes"));
+            break;
+        }
+        view->ReleaseRecoveries();
     }
 
-    void MainWindow::SaveAs()
+    bool MainWindow::MaybeSave()
     {
+        if (!view->IsModified())
+        {
+            return true;
+        }
+
+        const auto answer = QMessageBox::warning(this, tr("Unsaved changes"),
+            tr("The tree has been modified. Save the changes?"),
+            QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
+        if (answer == QMessageBox::Save)
+        {
+            return Save();
+        }
+        return answer == QMessageBox::Discard;
+    }
+
+    void MainWindow::closeEvent(QCloseEvent* event)
+    {
+        if (!MaybeSave())
+        {
+            event->ignore();
+            return;
+        }
+        // a clean exit leaves no recovery file behind
+        view->DiscardRecovery();
+        event->accept();
+    }
+
+    void MainWindow::Import()
+    {
+        if (!MaybeSave())
+        {
+            return;
+        }
+
+        const auto filename = QFileDialog::getOpenFileName(this, tr("Import CTQ tree..."), QString(),
+            tr("JSON (*.json);;XML (*.xml);;All files (*)"));
+        if (filename.isEmpty())
+        {
+            return;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QString error;
+        if (!view->Import(filename, error))
+        {
+            QMessageBox::critical(this, "Error importing file...", "File " + filename + " could not be imported: " + error);
+            return;
+        }
+        SetCurrentFile(QString());
+        statusBar()->showMessage(tr("Imported %1 (%2)").arg(filename, throughput(QFileInfo(filename).size(), timer)));
+    }
+
+    void MainWindow::Export()
+    {
+        const auto filename = QFileDialog::getSaveFileName(this, tr("Export CTQ tree..."), QString(),
+            tr("JSON (*.json);;XML (*.xml);;All files (*)"));
+        if (filename.isEmpty())
+        {
+            return;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!view->Export(filename))
+        {
+            QMessageBox::critical(this, "Error exporting file...", "File " + filename + " could not be written.");
+            return;
+        }
+        statusBar()->showMessage(tr("Exported %1 (%2)").arg(filename, throughput(QFileInfo(filename).size(), timer)));
+    }
+
+    void MainWindow::ExportDiagram()
+    {
+        const auto filename = QFileDialog::getSaveFileName(this, tr("Export diagram..."), QString(),
+            tr("TIFF image (*.tif *.tiff);;SVG (*.svg);;PDF (*.pdf)"));
+        if (filename.isEmpty())
+        {
+            return;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!view->ExportDiagram(filename))
+        {
+            QMessageBox::critical(this, "Error exporting diagram...", "File " + filename + " could not be written.");
+            return;
+        }
+        statusBar()->showMessage(tr("Exported %1 (%2)").arg(filename, throughput(QFileInfo(filename).size(), timer)));
+    }
+
+    void MainWindow::ImportMeasurements()
+    {
+        const auto filename = QFileDialog::getOpenFileName(this, tr("Import measurements..."), QString(),
+            tr("CSV (*.csv *.txt);;All files (*)"));
+        if (filename.isEmpty())
+        {
+            return;
+        }
+        CsvImportDialog dialog(filename, this);
+        if (dialog.exec() != QDialog::Accepted)
+        {
+            return;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        statusBar()->showMessage(tr("Importing %1...").arg(filename));
+        view->ImportMeasurements(filename, dialog.GetColumns(), [this, filename, timer](const CsvImportResult& result)
+        {
+            if (!result.error.isEmpty())
+            {
+                QMessageBox::critical(this, "Error importing file...", "File " + filename + " could not be imported: " + result.error);
+                return;
+            }
+
+            statusBar()->showMessage(tr("Imported %1 samples from %2 (%3)")
+                .arg(result.samples).arg(filename, throughput(result.bytes, timer)));
+            if (result.malformed > 0 || result.unknown > 0 || result.ambiguous > 0)
+            {
+                QMessageBox::warning(this, tr("Import measurements"),
+                    tr("%1 line(s) could not be parsed, %2 line(s) named no CTQ in the tree and %3 line(s) named "
+                       "several CTQs; these can be named by path instead, as Need/Driver/CTQ.")
+                        .arg(result.malformed).arg(result.unknown).arg(result.ambiguous));
+            }
+        });
+    }
+
+    void MainWindow::Simulate()
+    {
+        constexpr auto defaultTrials = 1000000;
+        constexpr auto minimumTrials = 1000;
+        constexpr auto maximumTrials = 100000000;
+
+        auto ok = false;
+        const auto trials = QInputDialog::getInt(this, tr("Run simulation"), tr("Trials"),
+            defaultTrials, minimumTrials, maximumTrials, minimumTrials, &ok);
+        if (!ok)
+        {
+            return;
+        }
+
+        // the simulation runs on the thread pool, the dialog polling its progress
+        constexpr auto steps = 1000;
+        constexpr auto pollInterval = 100; // ms
+        if (simulationProgress == nullptr)
+        {
+            simulationProgress = new QProgressDialog(tr("Running the simulation..."), tr("Cancel"), 0, steps, this);
+            simulationProgress->setWindowModality(Qt::WindowModal);
+            simulationProgress->setAutoClose(false);
+            simulationProgress->setAutoReset(false);
+            connect(simulationProgress, &QProgressDialog::canceled, view, &CtqView::CancelSimulation);
+            auto* poll = new QTimer(simulationProgress);
+            connect(poll, &QTimer::timeout, simulationProgress, [this]()
+            {
+                simulationProgress->setValue(static_cast<int>(view->GetSimulationProgress() * steps));
+            });
+            poll->start(pollInterval);
+        }
+        simulationProgress->setValue(0);
+
+        SimulationOptions options;
+        options.trials = static_cast<size_t>(trials);
+        simulationTrials = trials;
+        simulationTimer.start();
+        statusBar()->showMessage(tr("Simulating %1 trials...").arg(trials));
+        view->Simulate(options);
+    }
+
+    void MainWindow::Find()
+    {
+        auto ok = false;
+        const auto text = QInputDialog::getText(this, tr("Find"), tr("Text"), QLineEdit::Normal, QString(), &ok);
+        if (ok && !text.isEmpty() && !view->Find(text))
+        {
+            statusBar()->showMessage(tr("\"%1\" was not found").arg(text));
+        }
+    }
+
+    void MainWindow::ExpandToLevel()
+    {
+        // any number, as items can be inserted or imported below CTQs and a
+        // lazy model does not know how deep the tree is
+        constexpr auto levels = std::numeric_limits<int>::max();
+
+        auto ok = false;
+        const auto level = QInputDialog::getInt(this, tr("Expand to level"), tr("Levels"), 1, 1, levels, 1, &ok);
+        if (ok)
+        {
+            view->ExpandToDepth(level);
+        }
+    }
+
+    bool MainWindow::Save()
+    {
+        if (view->GetFilename().isEmpty())
+        {
+            return SaveAs();
+        }
+        if (view->Save())
+        {
+            statusBar()->showMessage(tr("Saved %1").arg(view->GetFilename()));
+            return true;
+        }
+        QMessageBox::critical(this, "Error saving file...", "File " + view->GetFilename() + " could not be written.");
+        return false;
+    }
+
+    bool MainWindow::SaveAs()
+    {
+        const auto filename = QFileDialog::getSaveFileName(this, tr("Save CTQ tree as..."), view->GetFilename(),
+            tr("CTQ tree (*.ctq *.txt);;CTQ database (*.ctqdb);;All files (*)"));
+        if (filename.isEmpty())
+        {
+            return false;
+        }
+
+        if (view->SaveAs(filename))
+        {
+            SetCurrentFile(filename);
+            statusBar()->showMessage(tr("Saved %1").arg(filename));
+            return true;
+        }
+        QMessageBox::critical(this, "Error saving file...", "File " + filename + " could not be written.");
+        return false;
     }
 
     void MainWindow::LoadFile(const QString& filename)
@@ -203,8 +645,12 @@ namespace CtqTool
             return;
         }
 
-        // todo implement
-        
+        if (!view->LoadFile(filename))
+        {
+            QMessageBox::critical(this, "Error opening file...", "File " + filename + " could not be read.");
+            return;
+        }
+
         SetCurrentFile(filename);
     }
 
@@ -221,7 +667,7 @@ namespace CtqTool
         const auto mimeData = event->mimeData();
 
         // check for our needed mime type, here a file or a list of files
-        if (mimeData->hasUrls())
+        if (mimeData->hasUrls() && MaybeSave())
         {
             const auto urlList = mimeData->urls();
             QStringList pathList;
@@ -256,7 +702,7 @@ namespace CtqTool
     void MainWindow::OpenRecentFile()
     {
         const auto action = qobject_cast<QAction*>(sender());
-        if (action)
+        if (action && MaybeSave())
         {
             LoadFile(action->data().toString());
         }
@@ -298,5 +744,9 @@ namespace CtqTool
 
     void MainWindow::OnReloadTriggered()
     {
+        if (!view->GetFilename().isEmpty() && MaybeSave())
+        {
+            LoadFile(view->GetFilename());
+        }
     }
 }
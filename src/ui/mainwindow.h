@@ -18,9 +18,13 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include "datamodel/ctqmodel.h"
 
+class QDockWidget;
+class QProgressDialog;
+
 namespace CtqTool
 {
     class CtqTreeScene;
@@ -37,13 +41,27 @@ namespace CtqTool
         void dragEnterEvent(QDragEnterEvent* event);
         void dropEvent(QDropEvent* event);
     
+    protected:
+        void closeEvent(QCloseEvent* event) override;
+
     private:
         void About();
-        void Save();
-        void SaveAs();
+        bool Save();
+        bool SaveAs();
+        // asks to save unsaved changes; false if the user cancelled or saving failed
+        bool MaybeSave();
         virtual void keyPressEvent(QKeyEvent* e);
         void OnLogWidgetStatusChanged(QString message);
         void Open();
+        void Merge();
+        void OfferRecovery();
+        void Import();
+        void Export();
+        void ExportDiagram();
+        void ImportMeasurements();
+        void Simulate();
+        void Find();
+        void ExpandToLevel();
         void OpenRecentFile();
         void OnReloadTriggered();
         void CopyLines();
@@ -54,6 +72,8 @@ namespace CtqTool
         void MakeEditMenu();
         void MakeViewMenu();
         void MakeStatusBar();
+        void MakeSpcLog();
+        void MakeMinimap();
 
         void SetCurrentFile(const QString& fileName);
         void ShowMarkupFilters();
@@ -65,5 +85,10 @@ namespace CtqTool
         QList<QAction*> recentFileActions;
         CtqTreeScene* scene;
         CtqView* view;
+        QDockWidget* spcLog = nullptr;
+        QDockWidget* minimap = nullptr;
+        QProgressDialog* simulationProgress = nullptr;
+        QElapsedTimer simulationTimer;
+        int simulationTrials = 0;
     };
 }
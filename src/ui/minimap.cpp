@@ -0,0 +1,263 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "minimap.h"
+#include "ctqtreescene.h"
+#include "diagramview.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    using namespace CtqTool;
+
+    constexpr auto tileWidth = 256;
+    constexpr auto maxTiles = 128;
+    constexpr auto maxZoom = 12;                // beyond the scale at which the whole diagram fits
+    constexpr auto minViewportWidth = 16.0;     // pixels
+    constexpr auto minOutline = 3.0;            // pixels
+    constexpr auto margin = 4.0;                // pixels above and below the diagram
+
+    size_t signatureOf(const DiagramIndex::Primitives& primitives)
+    {
+        auto seed = qHashBits(primitives.boxes.data(), primitives.boxes.size() * sizeof(QRectF));
+        seed = qHashBits(primitives.glyphs.data(), primitives.glyphs.size() * sizeof(QRectF), seed);
+        return qHashBits(primitives.edges.data(), primitives.edges.size() * sizeof(QLineF), seed);
+    }
+}
+
+namespace CtqTool
+{
+    Minimap::Minimap(CtqTreeScene& s, DiagramView& v, QWidget* parent) :
+        QWidget(parent),
+        scene(s),
+        view(v)
+    {
+        pool.setMaxThreadCount(2);
+        setMinimumSize(160, 60);
+        connect(&scene, &CtqTreeScene::DiagramChanged, this, [this]()
+        {
+            ++generation;
+            update();
+        });
+        connect(&view, &DiagramView::ViewportChanged, this, qOverload<>(&QWidget::update));
+    }
+
+    Minimap::~Minimap()
+    {
+        pool.clear();
+        pool.waitForDone();
+    }
+
+    std::optional<Minimap::Window> Minimap::GetWindow(const DiagramIndex& index) const
+    {
+        const auto& bounds = index.GetBounds();
+        if (bounds.isEmpty() || width() <= 0 || height() <= 2 * margin)
+        {
+            return std::nullopt;
+        }
+
+        // from the largest scale at which the whole diagram fits, zoomed in
+        // until the part in view is wide enough to point at
+        const auto fit = static_cast<int>(std::ceil(std::log2(bounds.width() / width())));
+        const auto visible = view.GetVisibleRect();
+        auto zoom = 0;
+        while (zoom < maxZoom && visible.width() * std::ldexp(1.0, zoom - fit) < minViewportWidth)
+        {
+            ++zoom;
+        }
+
+        Window window;
+        window.exponent = fit - zoom;
+        window.scaleX = std::ldexp(1.0, -window.exponent);
+        window.scaleY = (height() - 2 * margin) / bounds.height();
+        window.top = bounds.top() - margin / window.scaleY;
+        const auto left = bounds.left() * window.scaleX;
+        const auto right = bounds.right() * window.scaleX;
+        if (right - left <= width())
+        {
+            window.origin = (left + right - width()) / 2;
+        }
+        else
+        {
+            window.origin = std::clamp(visible.center().x() * window.scaleX - width() / 2.0, left, right - width());
+        }
+        return window;
+    }
+
+    void Minimap::paintEvent(QPaintEvent*)
+    {
+        QPainter painter(this);
+        painter.fillRect(rect(), Qt::white);
+        const auto index = scene.GetIndex();
+        const auto window = index ? GetWindow(*index) : std::nullopt;
+        if (!window)
+        {
+            return;
+        }
+        if (window->scaleY != tiledScaleY)
+        {
+            tiles.clear();
+            ++epoch;
+            tiledScaleY = window->scaleY;
+        }
+
+        std::vector<Key> visible;
+        const auto first = static_cast<qint64>(std::floor(window->origin / tileWidth));
+        const auto last = static_cast<qint64>(std::floor((window->origin + width() - 1) / tileWidth));
+        for (auto column = first; column <= last; ++column)
+        {
+            const Key key(window->exponent, column);
+            visible.push_back(key);
+            auto& tile = tiles[key];
+            tile.lastUse = ++uses;
+
+            // a tile being drawn is checked again once it is done
+            if (!tile.rendering && tile.checked != generation)
+            {
+                tile.checked = generation;
+                const QRectF area(column * tileWidth / window->scaleX, window->top, tileWidth / window->scaleX,
+                    height() / window->scaleY);
+                index->Collect(area, window->scaleX, primitives);
+                const auto signature = signatureOf(primitives);
+                if (!tile.drawn || signature != tile.signature)
+                {
+                    if (primitives.boxes.empty() && primitives.glyphs.empty() && primitives.edges.empty())
+                    {
+                        tile.image = QImage();
+                        tile.signature = signature;
+                        tile.drawn = true;
+                    }
+                    else
+                    {
+                        Render(key, *window, index, signature);
+                    }
+                }
+            }
+            if (!tile.image.isNull())
+            {
+                painter.drawImage(QPointF(column * tileWidth - window->origin, 0.0), tile.image);
+            }
+        }
+        Evict(visible);
+
+        const auto inView = view.GetVisibleRect();
+        QRectF outline(inView.left() * window->scaleX - window->origin, (inView.top() - window->top) * window->scaleY,
+            inView.width() * window->scaleX, inView.height() * window->scaleY);
+        if (outline.width() < minOutline)
+        {
+            outline.adjust(-minOutline / 2, 0, minOutline / 2, 0);
+        }
+        painter.setPen(QPen(QColor(220, 50, 47), 0));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(outline);
+    }
+
+    void Minimap::mousePressEvent(QMouseEvent* event)
+    {
+        if (event->button() == Qt::LeftButton)
+        {
+            Navigate(event->position());
+        }
+    }
+
+    void Minimap::mouseMoveEvent(QMouseEvent* event)
+    {
+        if (event->buttons() & Qt::LeftButton)
+        {
+            Navigate(event->position());
+        }
+    }
+
+    void Minimap::Navigate(const QPointF& position)
+    {
+        const auto index = scene.GetIndex();
+        if (const auto window = index ? GetWindow(*index) : std::nullopt)
+        {
+            view.centerOn(QPointF((window->origin + position.x()) / window->scaleX,
+                window->top + position.y() / window->scaleY));
+        }
+    }
+
+    void Minimap::Render(const Key& key, const Window& window, std::shared_ptr<const DiagramIndex> index, size_t signature)
+    {
+        tiles[key].rendering = true;
+        const QRectF area(key.second * tileWidth / window.scaleX, window.top, tileWidth / window.scaleX,
+            height() / window.scaleY);
+        const QSize size(tileWidth, height());
+        pool.start([this, key, area, size, window, index = std::move(index), signature, e = epoch]()
+        {
+            QImage image(size, QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+            DiagramIndex::Primitives primitives;
+            index->Collect(area, window.scaleX, primitives);
+            primitives.labels.clear(); // unreadable at these scales
+
+            QPainter painter(&image);
+            painter.scale(window.scaleX, window.scaleY);
+            painter.translate(-area.left(), -area.top());
+            DiagramIndex::Draw(painter, primitives);
+            painter.end();
+
+            QMetaObject::invokeMethod(this, [=]()
+            {
+                Rendered(key, image, signature, e);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void Minimap::Rendered(const Key& key, const QImage& image, size_t signature, int e)
+    {
+        const auto it = tiles.find(key);
+        if (e != epoch || it == tiles.end())
+        {
+            return;
+        }
+        auto& tile = it->second;
+        tile.image = image;
+        tile.signature = signature;
+        tile.drawn = true;
+        tile.rendering = false;
+        update();
+    }
+
+    void Minimap::Evict(const std::vector<Key>& visible)
+    {
+        while (tiles.size() > maxTiles)
+        {
+            auto oldest = tiles.end();
+            for (auto it = tiles.begin(); it != tiles.end(); ++it)
+            {
+                const auto shown = std::find(visible.begin(), visible.end(), it->first) != visible.end();
+                if (!it->second.rendering && !shown && (oldest == tiles.end() || it->second.lastUse < oldest->second.lastUse))
+                {
+                    oldest = it;
+                }
+            }
+            if (oldest == tiles.end())
+            {
+                return;
+            }
+            tiles.erase(oldest);
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "diagramitem.h"
+
+#include <QImage>
+#include <QThreadPool>
+#include <QWidget>
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace CtqTool
+{
+    class CtqTreeScene;
+    class DiagramView;
+
+    // An overview of the diagram with the part in view outlined; clicking or
+    // dragging centers the view there. The diagram is drawn into tiles on
+    // worker threads. Tiles are columns of the diagram at scales of a power
+    // of two, anchored at x = 0, so a tile stays valid as long as what it
+    // shows does. After a change, a tile is only drawn again when the
+    // primitives that fall within it changed.
+    class Minimap : public QWidget
+    {
+        Q_OBJECT
+    public:
+        Minimap(CtqTreeScene&, DiagramView&, QWidget* parent = nullptr);
+        ~Minimap();
+
+    protected:
+        void paintEvent(QPaintEvent*) override;
+        void mousePressEvent(QMouseEvent*) override;
+        void mouseMoveEvent(QMouseEvent*) override;
+
+    private:
+        // a column of tileWidth pixels at a scale of 2^-exponent pixels per unit
+        using Key = std::pair<int, qint64>;
+
+        struct Tile
+        {
+            QImage image;
+            size_t signature = 0;
+            quint64 checked = 0;    // the generation of the diagram last compared against
+            bool drawn = false;     // image shows signature
+            bool rendering = false;
+            quint64 lastUse = 0;
+        };
+
+        // what the widget shows of the diagram
+        struct Window
+        {
+            int exponent = 0;
+            double scaleX = 1.0;
+            double scaleY = 1.0;
+            double top = 0.0;       // in scene units
+            double origin = 0.0;    // the pixel at the left edge, counted from x = 0
+        };
+
+        std::optional<Window> GetWindow(const DiagramIndex&) const;
+        void Navigate(const QPointF&);
+        void Render(const Key&, const Window&, std::shared_ptr<const DiagramIndex>, size_t signature);
+        void Rendered(const Key&, const QImage&, size_t signature, int epoch);
+        void Evict(const std::vector<Key>& visible);
+
+        CtqTreeScene& scene;
+        DiagramView& view;
+        std::map<Key, Tile> tiles;
+        quint64 generation = 1;
+        quint64 uses = 0;
+        int epoch = 0;              // of the tiles, changing with the vertical scale
+        double tiledScaleY = 0.0;
+        DiagramIndex::Primitives primitives;
+        QThreadPool pool;
+    };
+}
@@ -0,0 +1,111 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "targetdialog.h"
+
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+namespace
+{
+    QString toText(std::optional<double> value)
+    {
+        return value ? QString::number(*value, 'g', 17) : QString();
+    }
+
+    // empty for not set; false when neither empty nor a number
+    bool toValue(const QLineEdit& edit, std::optional<double>& value)
+    {
+        const auto text = edit.text().trimmed();
+        value.reset();
+        if (text.isEmpty())
+        {
+            return true;
+        }
+        auto ok = false;
+        const auto v = text.toDouble(&ok);
+        if (ok)
+        {
+            value = v;
+        }
+        return ok;
+    }
+}
+
+namespace CtqTool
+{
+    TargetDialog::TargetDialog(const QString& ctq, const Target& target, QWidget* parent) :
+        QDialog(parent),
+        lower(new QLineEdit(toText(target.GetLowerLimit()), this)),
+        nominal(new QLineEdit(toText(target.GetNominal()), this)),
+        upper(new QLineEdit(toText(target.GetUpperLimit()), this)),
+        units(new QLineEdit(target.GetUnits(), this)),
+        buttonBox(new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel))
+    {
+        this->setWindowTitle(tr("Target of %1").arg(ctq));
+        MakeLayout();
+
+        for (auto* edit : {lower, nominal, upper})
+        {
+            connect(edit, &QLineEdit::textChanged, this, &TargetDialog::Validate);
+        }
+        connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+        connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    }
+
+    TargetDialog::~TargetDialog() = default;
+
+    void TargetDialog::MakeLayout()
+    {
+        auto* form = new QFormLayout;
+        form->addRow(tr("Lower limit"), lower);
+        form->addRow(tr("Nominal"), nominal);
+        form->addRow(tr("Upper limit"), upper);
+        form->addRow(tr("Units"), units);
+
+        auto* layout = new QVBoxLayout;
+        layout->addLayout(form);
+        layout->addWidget(buttonBox);
+        this->setLayout(layout);
+    }
+
+    void TargetDialog::Validate()
+    {
+        std::optional<double> l, n, u;
+        const auto numbers = toValue(*lower, l) && toValue(*nominal, n) && toValue(*upper, u);
+        const auto ordered = !numbers || !l || !u || *l <= *u;
+        buttonBox->button(QDialogButtonBox::Ok)->setEnabled(numbers && ordered);
+    }
+
+    Target TargetDialog::GetTarget() const
+    {
+        Target target;
+        std::optional<double> value;
+        toValue(*lower, value);
+        target.SetLowerLimit(value);
+        toValue(*nominal, value);
+        target.SetNominal(value);
+        toValue(*upper, value);
+        target.SetUpperLimit(value);
+        target.SetUnits(units->text().trimmed());
+        return target;
+    }
+}
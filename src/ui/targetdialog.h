@@ -0,0 +1,52 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "datamodel/target.h"
+
+#include <QDialog>
+
+class QDialogButtonBox;
+class QLineEdit;
+
+namespace CtqTool
+{
+    // edits the specification limits, nominal value and units of a CTQ's target;
+    // a limit or nominal value left empty is not set
+    class TargetDialog : public QDialog
+    {
+        Q_OBJECT
+
+    public:
+        TargetDialog(const QString& ctq, const Target&, QWidget* parent = nullptr);
+        virtual ~TargetDialog();
+
+        Target GetTarget() const;
+
+    private:
+        void MakeLayout();
+        void Validate();
+
+        QLineEdit* lower = nullptr;
+        QLineEdit* nominal = nullptr;
+        QLineEdit* upper = nullptr;
+        QLineEdit* units = nullptr;
+        QDialogButtonBox* buttonBox = nullptr;
+    };
+}
@@ -0,0 +1,150 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "treelayout.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace CtqTool
+{
+    TreeLayout::TreeLayout()
+    {
+        root.contour.push_back({});
+    }
+
+    TreeLayout::Node& TreeLayout::GetRoot()
+    {
+        return root;
+    }
+
+    TreeLayout::Node& TreeLayout::Insert(Node& parent, int row, QString text, double width)
+    {
+        auto node = std::make_unique<Node>();
+        node->parent = &parent;
+        node->text = std::move(text);
+        node->width = width;
+        auto& inserted = **parent.children.insert(parent.children.begin() + row, std::move(node));
+        Invalidate(parent);
+        return inserted;
+    }
+
+    void TreeLayout::Remove(Node& parent, int row, int count)
+    {
+        parent.children.erase(parent.children.begin() + row, parent.children.begin() + row + count);
+        Invalidate(parent);
+    }
+
+    void TreeLayout::SetText(Node& node, QString text, double width)
+    {
+        node.text = std::move(text);
+        if (node.width != width)
+        {
+            node.width = width;
+            Invalidate(node);
+        }
+    }
+
+    void TreeLayout::Clear()
+    {
+        root.children.clear();
+        Invalidate(root);
+    }
+
+    void TreeLayout::Update(const std::function<void(Node&)>& moved)
+    {
+        Layout(root, moved);
+    }
+
+    const std::vector<TreeLayout::Extent>& TreeLayout::GetContour() const
+    {
+        return root.contour;
+    }
+
+    void TreeLayout::Invalidate(Node& node)
+    {
+        // an invalid node's ancestors are invalid already
+        node.valid = false;
+        for (auto* p = node.parent; p != nullptr && p->valid; p = p->parent)
+        {
+            p->valid = false;
+        }
+    }
+
+    void TreeLayout::Layout(Node& node, const std::function<void(Node&)>& moved)
+    {
+        if (node.valid)
+        {
+            return;
+        }
+
+        // the contour of the children placed so far, relative to the first one
+        std::vector<Extent> levels;
+        std::vector<double> xs;
+        xs.reserve(node.children.size());
+        for (auto& child : node.children)
+        {
+            Layout(*child, moved);
+            const auto& contour = child->contour;
+
+            auto x = 0.0;
+            if (!xs.empty())
+            {
+                x = -std::numeric_limits<double>::infinity();
+                for (size_t d = 0; d < std::min(levels.size(), contour.size()); ++d)
+                {
+                    x = std::max(x, levels[d].right + siblingGap - contour[d].left);
+                }
+            }
+            for (size_t d = 0; d < contour.size(); ++d)
+            {
+                if (d < levels.size())
+                {
+                    levels[d].right = x + contour[d].right;
+                }
+                else
+                {
+                    levels.push_back({x + contour[d].left, x + contour[d].right});
+                }
+            }
+            xs.push_back(x);
+        }
+
+        const auto center = xs.empty() ? 0.0 : (xs.front() + xs.back()) / 2;
+        for (size_t i = 0; i < xs.size(); ++i)
+        {
+            auto& child = *node.children[i];
+            if (!child.placed || child.x != xs[i] - center)
+            {
+                child.x = xs[i] - center;
+                child.placed = true;
+                if (moved)
+                {
+                    moved(child);
+                }
+            }
+        }
+
+        node.contour.assign(1, {-node.width / 2, node.width / 2});
+        for (const auto& level : levels)
+        {
+            node.contour.push_back({level.left - center, level.right - center});
+        }
+        node.valid = true;
+    }
+}
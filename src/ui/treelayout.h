@@ -0,0 +1,88 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace CtqTool
+{
+    // A Reingold-Tilford tidy tree layout that keeps the shape of every
+    // subtree, as the extents of each of its levels relative to its root.
+    // Children are packed left to right against the contour of their left
+    // siblings and their parent is centered above them. A change only
+    // invalidates the changed node and its ancestors, so laying out again
+    // costs the changed subtree plus, for each ancestor, one pass over its
+    // children's contours; O(n * height) for a whole tree, i.e. linear for
+    // the fixed depth of CTQ trees.
+    class TreeLayout
+    {
+    public:
+        static constexpr double levelHeight = 64.0;
+        static constexpr double boxHeight = 24.0;
+        static constexpr double siblingGap = 12.0;
+
+        struct Extent
+        {
+            double left = 0.0;
+            double right = 0.0;
+        };
+
+        struct Node
+        {
+            Node* parent = nullptr;
+            std::vector<std::unique_ptr<Node>> children;
+            double width = 0.0;
+            double x = 0.0;                 // of the center, relative to the parent's
+            QString text;                   // shown in the node's box
+
+        private:
+            friend class TreeLayout;
+            std::vector<Extent> contour;    // per level, relative to the center
+            bool valid = false;
+            bool placed = false;
+        };
+
+        TreeLayout();
+
+        // the invisible root above the needs
+        Node& GetRoot();
+
+        Node& Insert(Node& parent, int row, QString text, double width);
+        void Remove(Node& parent, int row, int count);
+        void SetText(Node&, QString text, double width);
+        void Clear();
+
+        // lays out what changed, calling moved, if given, for every node that
+        // is new or whose position relative to its parent changed
+        void Update(const std::function<void(Node&)>& moved = {});
+
+        // the extents of every level, the root's own first, relative to its center
+        const std::vector<Extent>& GetContour() const;
+
+    private:
+        void Invalidate(Node&);
+        void Layout(Node&, const std::function<void(Node&)>& moved);
+
+        Node root;
+    };
+}
@@ -18,11 +18,317 @@
 
 #include "treeview.h"
 
+#include "datamodel/conformance.h"
+#include "datamodel/ctqmodel.h"
+
+#include <QHash>
+#include <QPainter>
+#include <QPointer>
+#include <QStyledItemDelegate>
+
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    constexpr size_t rootKey = 0;
+
+    // the keys of the parent's children by row, which tell siblings with the same text apart
+    std::vector<size_t> childKeys(const QAbstractItemModel& model, const QModelIndex& parent, size_t parentKey)
+    {
+        const auto rows = model.rowCount(parent);
+        std::vector<size_t> keys;
+        keys.reserve(rows);
+        QHash<QString, size_t> seen;
+        for (auto r = 0; r < rows; ++r)
+        {
+            const auto text = model.index(r, 0, parent).data(Qt::DisplayRole).toString();
+            keys.push_back(qHash(seen[text]++, qHash(text, parentKey)));
+        }
+        return keys;
+    }
+}
+
 namespace CtqTool
 {
+    // Caches the size hints of items by row, which the model identifies by
+    // internal pointer, until the row's data changes or it is removed.
+    class RowHeightDelegate : public QStyledItemDelegate
+    {
+    public:
+        using QStyledItemDelegate::QStyledItemDelegate;
+
+        QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override
+        {
+            if (singleLine)
+            {
+                return QStyledItemDelegate::sizeHint(option, index);
+            }
+
+            auto& sizes = cache[index.internalPointer()];
+            if (static_cast<int>(sizes.size()) <= index.column())
+            {
+                sizes.resize(index.column() + 1);
+            }
+            auto& size = sizes[index.column()];
+            if (!size.isValid())
+            {
+                size = QStyledItemDelegate::sizeHint(option, index);
+            }
+            return size;
+        }
+
+        void Watch(QAbstractItemModel* model)
+        {
+            if (watched)
+            {
+                disconnect(watched, nullptr, this, nullptr);
+            }
+            watched = model;
+            cache.clear();
+            if (!model)
+            {
+                return;
+            }
+
+            connect(model, &QAbstractItemModel::dataChanged, this, [this](const QModelIndex& topLeft, const QModelIndex& bottomRight)
+            {
+                for (auto row = topLeft.row(); row <= bottomRight.row(); ++row)
+                {
+                    cache.erase(topLeft.siblingAtRow(row).internalPointer());
+                }
+            });
+            // the pointers of removed rows may come back for other items
+            connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, [this](const QModelIndex& parent, int first, int last)
+            {
+                Forget(parent, first, last);
+            });
+            connect(model, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { cache.clear(); });
+        }
+
+        void SetSingleLine(bool on)
+        {
+            singleLine = on;
+            cache.clear();
+        }
+
+        bool IsSingleLine() const
+        {
+            return singleLine;
+        }
+
+    protected:
+        void initStyleOption(QStyleOptionViewItem* option, const QModelIndex& index) const override
+        {
+            QStyledItemDelegate::initStyleOption(option, index);
+            if (singleLine)
+            {
+                option->text.replace('\n', ' ');
+            }
+        }
+
+    private:
+        void Forget(const QModelIndex& parent, int first, int last)
+        {
+            if (cache.empty())
+            {
+                return;
+            }
+            for (auto row = first; row <= last; ++row)
+            {
+                const auto index = watched->index(row, 0, parent);
+                cache.erase(index.internalPointer());
+                if (const auto children = watched->rowCount(index); children > 0)
+                {
+                    Forget(index, 0, children - 1);
+                }
+            }
+        }
+
+        mutable std::unordered_map<const void*, std::vector<QSize>> cache;
+        QPointer<QAbstractItemModel> watched;
+        bool singleLine = false;
+    };
+
     TreeView::TreeView(QWidget* parent) :
-        QTreeView(parent)
+        QTreeView(parent),
+        delegate(new RowHeightDelegate(this))
     {
+        setItemDelegate(delegate);
         setUniformRowHeights(false);
     }
+
+    void TreeView::setModel(QAbstractItemModel* model)
+    {
+        delegate->Watch(model);
+        QTreeView::setModel(model);
+    }
+
+    void TreeView::SetRowHeights(RowHeights heights)
+    {
+        const auto uniform = heights == RowHeights::Uniform;
+        delegate->SetSingleLine(uniform);
+        setUniformRowHeights(uniform);
+        doItemsLayout();
+    }
+
+    TreeView::RowHeights TreeView::GetRowHeights() const
+    {
+        return delegate->IsSingleLine() ? RowHeights::Uniform : RowHeights::PerRow;
+    }
+
+    // While a layout is pending, expanding an item only records it, so the
+    // layout is scheduled first and run once at the end. Items are expanded
+    // once their children are fetched, so none is left open and empty.
+    void TreeView::ExpandToDepth(int depth)
+    {
+        if (model() == nullptr)
+        {
+            return;
+        }
+
+        scheduleDelayedItemsLayout();
+        std::vector<QModelIndex> level{rootIndex()};
+        for (auto d = 0; !level.empty(); ++d)
+        {
+            std::vector<QModelIndex> next;
+            for (const auto& parent : level)
+            {
+                if (!FetchAll(parent))
+                {
+                    next.clear();
+                    break;
+                }
+                if (parent != rootIndex())
+                {
+                    expand(parent);
+                }
+                for (auto r = 0; d < depth && r < model()->rowCount(parent); ++r)
+                {
+                    const auto child = model()->index(r, 0, parent);
+                    if (model()->hasChildren(child))
+                    {
+                        next.push_back(child);
+                    }
+                }
+            }
+            level.swap(next);
+        }
+        executeDelayedItemsLayout();
+    }
+
+    void TreeView::ExpandTo(const QModelIndex& index)
+    {
+        if (!index.isValid())
+        {
+            return;
+        }
+
+        scheduleDelayedItemsLayout();
+        for (auto p = index.parent(); p.isValid() && p != rootIndex(); p = p.parent())
+        {
+            expand(p);
+        }
+        executeDelayedItemsLayout();
+        setCurrentIndex(index);
+        scrollTo(index);
+    }
+
+    TreeView::Expansion TreeView::SaveExpansion() const
+    {
+        Expansion keys;
+        if (model() == nullptr)
+        {
+            return keys;
+        }
+
+        // collapsed items are not descended into, so their expanded descendants are not kept
+        std::vector<std::pair<QModelIndex, size_t>> pending{{rootIndex(), rootKey}};
+        while (!pending.empty())
+        {
+            const auto [parent, parentKey] = pending.back();
+            pending.pop_back();
+            const auto children = childKeys(*model(), parent, parentKey);
+            for (auto r = 0; r < static_cast<int>(children.size()); ++r)
+            {
+                const auto child = model()->index(r, 0, parent);
+                if (isExpanded(child))
+                {
+                    keys.insert(children[r]);
+                    pending.emplace_back(child, children[r]);
+                }
+            }
+        }
+        return keys;
+    }
+
+    void TreeView::RestoreExpansion(const Expansion& keys)
+    {
+        if (model() == nullptr || keys.empty())
+        {
+            return;
+        }
+
+        scheduleDelayedItemsLayout();
+        std::vector<std::pair<QModelIndex, size_t>> pending{{rootIndex(), rootKey}};
+        while (!pending.empty())
+        {
+            const auto [parent, parentKey] = pending.back();
+            pending.pop_back();
+            if (!FetchAll(parent))
+            {
+                break;
+            }
+            if (parent != rootIndex())
+            {
+                expand(parent);
+            }
+            const auto children = childKeys(*model(), parent, parentKey);
+            for (auto r = 0; r < static_cast<int>(children.size()); ++r)
+            {
+                if (keys.count(children[r]) > 0)
+                {
+                    pending.emplace_back(model()->index(r, 0, parent), children[r]);
+                }
+            }
+        }
+        executeDelayedItemsLayout();
+    }
+
+    bool TreeView::FetchAll(const QModelIndex& parent)
+    {
+        const auto* ctqModel = qobject_cast<const CtqModel*>(model());
+        while (model()->canFetchMore(parent))
+        {
+            if (ctqModel != nullptr && !ctqModel->IsWithinFetchBudget())
+            {
+                return false;
+            }
+            model()->fetchMore(parent);
+        }
+        return true;
+    }
+
+    void TreeView::drawRow(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+    {
+        // only the cached level is read, so repainting costs the same on any tree size
+        const auto level = index.data(CtqModel::ConformanceRole);
+        if (level.isValid())
+        {
+            static const QColor near(255, 191, 0, 70);
+            static const QColor out(220, 50, 47, 90);
+            switch (static_cast<Conformance::Level>(level.toInt()))
+            {
+            case Conformance::Level::Near:
+                painter->fillRect(option.rect, near);
+                break;
+            case Conformance::Level::Out:
+                painter->fillRect(option.rect, out);
+                break;
+            default:
+                break;
+            }
+        }
+        QTreeView::drawRow(painter, option, index);
+    }
 }
@@ -20,11 +20,54 @@
 
 #include <QTreeView>
 
+#include <unordered_set>
+
 namespace CtqTool
 {
+    class RowHeightDelegate;
+
     class TreeView : public QTreeView
     {
     public:
+        // Uniform lays out every row at the height of the first, showing
+        // notes on one line, so that layout and scrolling do not depend on
+        // the number of rows. PerRow fits rows to multi-line notes; the size
+        // of each item is cached until its row changes.
+        enum class RowHeights
+        {
+            Uniform,
+            PerRow
+        };
+
         TreeView(QWidget *parent = nullptr);
+
+        void setModel(QAbstractItemModel*) override;
+
+        void SetRowHeights(RowHeights);
+        RowHeights GetRowHeights() const;
+
+        // Each of these changes what is expanded in one layout pass, where
+        // QTreeView lays out the tree again for every item expanded. Items of
+        // a lazy model are fetched as far as they are expanded, until its
+        // fetch budget is used up; the items beyond are left collapsed.
+        void ExpandToDepth(int depth);          // the items less than depth levels down, keeping the others
+        void ExpandTo(const QModelIndex&);      // its ancestors, then scrolls to it and makes it current
+
+        // The expanded items by their place on the path from the root: their
+        // text and, among siblings with that text, which one they are. These
+        // stay the same across reloads and edits elsewhere in the tree.
+        using Expansion = std::unordered_set<size_t>;
+        Expansion SaveExpansion() const;
+        void RestoreExpansion(const Expansion&);
+
+    protected:
+        // tints rows by the conformance of their CTQ
+        void drawRow(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+    private:
+        // false if the fetch budget ran out first
+        bool FetchAll(const QModelIndex& parent);
+
+        RowHeightDelegate* delegate = nullptr;
     };
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/changecoalescer.h"
+#include "datamodel/ctqmodel.h"
+
+#include <QtTest>
+
+#include <vector>
+
+using namespace CtqTool;
+
+namespace
+{
+    struct Change
+    {
+        QModelIndex topLeft;
+        QModelIndex bottomRight;
+        QList<int> roles;
+        QString text;   // of topLeft when it was emitted
+    };
+
+    // need A with drivers A1 and A2, need B with driver B1
+    std::unique_ptr<CtqModel> makeModel()
+    {
+        auto model = std::make_unique<CtqModel>();
+        model->Reset(CtqModel::Parse("A\tnote\t0\n"
+                                     "    A1\tnote\t0\n"
+                                     "    A2\tnote\t0\n"
+                                     "B\tnote\t0\n"
+                                     "    B1\tnote\t0\n"));
+        return model;
+    }
+}
+
+class TestChangeCoalescer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init()
+    {
+        model = makeModel();
+        // a long interval, so that only Flush and structural changes emit
+        coalescer = std::make_unique<ChangeCoalescer>(*model, 60000);
+        changes.clear();
+        events.clear();
+        connect(model.get(), &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex& topLeft, const QModelIndex& bottomRight, const QList<int>& roles)
+            {
+                changes.push_back({topLeft, bottomRight, roles, topLeft.data().toString()});
+                events.append('C');
+            });
+        connect(model.get(), &QAbstractItemModel::rowsAboutToBeInserted, this, [this]() { events.append('I'); });
+    }
+
+    void cleanup()
+    {
+        coalescer.reset();
+        model.reset();
+    }
+
+    // one signal per parent, spanning the cells and roles added under it
+    void OnePerParent()
+    {
+        const auto a = model->index(0, 0);
+        const auto b = model->index(1, 0);
+        coalescer->Add(model->index(1, 2, a), model->index(1, 2, a), {Qt::DisplayRole});
+        coalescer->Add(model->index(0, 0, a), model->index(0, 1, a), {CtqModel::ConformanceRole});
+        coalescer->Add(model->index(0, 1, b), model->index(0, 1, b), {Qt::DisplayRole});
+        coalescer->Add(a, a, {Qt::DisplayRole});
+        QVERIFY(changes.empty());
+
+        coalescer->Flush();
+        QCOMPARE(changes.size(), size_t(3));
+        const auto& underA = changes[0];
+        QCOMPARE(underA.topLeft, model->index(0, 0, a));
+        QCOMPARE(underA.bottomRight, model->index(1, 2, a));
+        QCOMPARE(underA.roles.size(), qsizetype(2));
+        QVERIFY(underA.roles.contains(Qt::DisplayRole) && underA.roles.contains(CtqModel::ConformanceRole));
+        QCOMPARE(changes[1].topLeft, model->index(0, 1, b));
+        QCOMPARE(changes[2].topLeft, a);
+
+        coalescer->Flush();
+        QCOMPARE(changes.size(), size_t(3));
+    }
+
+    // no roles stand for all of them, whatever is added with them
+    void AllRoles()
+    {
+        const auto a = model->index(0, 0);
+        coalescer->Add(a, a, {Qt::DisplayRole});
+        coalescer->Add(a, a);
+        coalescer->Add(a, a, {CtqModel::ConformanceRole});
+        coalescer->Flush();
+        QCOMPARE(changes.size(), size_t(1));
+        QVERIFY(changes[0].roles.isEmpty());
+    }
+
+    void Invalid()
+    {
+        coalescer->Add(QModelIndex(), QModelIndex());
+        coalescer->Flush();
+        QVERIFY(changes.empty());
+    }
+
+    // pending changes go out while their indexes are still valid
+    void BeforeStructure()
+    {
+        const auto a = model->index(0, 0);
+        coalescer->Add(model->index(1, 0, a), model->index(1, 0, a));
+        QVERIFY(model->insertRows(0, 1, a));
+        QCOMPARE(events, QByteArray("CI"));
+        QCOMPARE(changes[0].text, QString("A2"));
+    }
+
+    void DroppedOnReset()
+    {
+        coalescer->Add(model->index(0, 0), model->index(0, 0));
+        model->Reset(CtqModel::Parse("C\tnote\t0\n"));
+        coalescer->Flush();
+        QVERIFY(changes.empty());
+    }
+
+    // one batch per interval
+    void Timer()
+    {
+        ChangeCoalescer frame(*model, 1);
+        const auto a = model->index(0, 0);
+        frame.Add(a, a);
+        frame.Add(model->index(1, 0), model->index(1, 0));
+        QVERIFY(changes.empty());
+        QTRY_COMPARE(changes.size(), size_t(1));
+        QCOMPARE(changes[0].bottomRight, model->index(1, 0));
+    }
+
+private:
+    std::unique_ptr<CtqModel> model;
+    std::unique_ptr<ChangeCoalescer> coalescer;
+    std::vector<Change> changes;
+    QByteArray events;
+};
+
+QTEST_GUILESS_MAIN(TestChangeCoalescer)
+#include "tst_changecoalescer.moc"
@@ -0,0 +1,77 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/csvimport.h"
+#include "datamodel/ctq.h"
+#include "datamodel/ctqmodel.h"
+#include "datamodel/item.h"
+
+#include <QTemporaryFile>
+#include <QtTest>
+
+using namespace CtqTool;
+
+class TestCsvImport : public QObject
+{
+    Q_OBJECT
+private slots:
+    // two drivers with a CTQ of the same text, and a CTQ of its own
+    void NamesAndPaths()
+    {
+        CtqModel model;
+        model.Reset(CtqModel::Parse("Need\tnote\t0\n"
+                                    "    A\tnote\t0\n"
+                                    "        Width\tnote\t0\n"
+                                    "        Height\tnote\t0\n"
+                                    "    B\tnote\t0\n"
+                                    "        Width\tnote\t0\n"));
+
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        file.write("ctq,value\n"
+                   "Width,1\n"
+                   "Need/A/Width,2\n"
+                   "Need/B/Width,3\n"
+                   "\"Need/B/Width\",5\n"
+                   "Height,4\n"
+                   "Depth,6\n"
+                   "Height,x\n");
+        QVERIFY(file.flush());
+
+        const auto result = ImportCsv(file.fileName(), {}, model);
+        QVERIFY(result.error.isEmpty());
+        QCOMPARE(result.samples, size_t(4));
+        QCOMPARE(result.ambiguous, size_t(1));
+        QCOMPARE(result.unknown, size_t(1));
+        QCOMPARE(result.malformed, size_t(1));
+
+        const auto& need = *model.GetRootItem().GetChild(0);
+        const auto statistics = [&need](int driver, int row)
+        {
+            return static_cast<const Ctq&>(*need.GetChild(driver)->GetChild(row)->GetData()).GetStatistics();
+        };
+        QCOMPARE(statistics(0, 0).count, size_t(1));
+        QCOMPARE(statistics(0, 0).mean, 2.0);
+        QCOMPARE(statistics(1, 0).count, size_t(2));
+        QCOMPARE(statistics(1, 0).mean, 4.0);
+        QCOMPARE(statistics(0, 1).mean, 4.0);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestCsvImport)
+#include "tst_csvimport.moc"
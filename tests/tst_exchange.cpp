@@ -0,0 +1,157 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/ctq.h"
+#include "datamodel/ctqmodel.h"
+#include "datamodel/item.h"
+#include "datamodel/jsonstream.h"
+#include "datamodel/xmlstream.h"
+
+#include <QBuffer>
+#include <QtTest>
+
+using namespace CtqTool;
+
+namespace
+{
+    // a need, a driver and a CTQ with limits and samples
+    std::unique_ptr<TreeItem> makeTree()
+    {
+        auto root = CtqModel::Parse(QString());
+        auto need = std::make_shared<TreeItem>(MakeItemData(1, "Need", "a \"quoted\" note"), root.get());
+        auto driver = std::make_shared<TreeItem>(MakeItemData(2, "Driver", ""), need.get());
+        auto data = MakeItemData(3, "CTQ", "measured");
+        auto& measurement = static_cast<Ctq&>(*data).GetMeasurement();
+        measurement.SetDescription("caliper");
+        measurement.GetTarget().SetLowerLimit(-0.5);
+        measurement.GetTarget().SetUpperLimit(0.25);
+        measurement.GetTarget().SetUnits("mm");
+        const double values[] = {0.1, -0.2, 1.0 / 3.0};
+        const qint64 timestamps[] = {1000, 2000, 3000};
+        const quint32 lots[] = {1, 1, 2};
+        measurement.Append(values, timestamps, lots, 3);
+        auto ctq = std::make_shared<TreeItem>(data, driver.get());
+        ctq->SetRank(2);
+        driver->Append(ctq);
+        need->Append(driver);
+        root->Append(need);
+        return root;
+    }
+
+    void compare(const TreeItem& expected, const TreeItem& actual)
+    {
+        QCOMPARE(actual.GetData()->GetText(), expected.GetData()->GetText());
+        QCOMPARE(actual.GetData()->GetNote(), expected.GetData()->GetNote());
+        QCOMPARE(actual.GetRank(), expected.GetRank());
+        QCOMPARE(actual.ChildCount(), expected.ChildCount());
+
+        const auto* expectedCtq = dynamic_cast<const Ctq*>(expected.GetData().get());
+        const auto* actualCtq = dynamic_cast<const Ctq*>(actual.GetData().get());
+        QCOMPARE(actualCtq != nullptr, expectedCtq != nullptr);
+        if (expectedCtq != nullptr)
+        {
+            const auto& e = expectedCtq->GetMeasurement();
+            const auto& a = actualCtq->GetMeasurement();
+            QCOMPARE(a.GetDescription(), e.GetDescription());
+            QCOMPARE(a.GetTarget().GetLowerLimit(), e.GetTarget().GetLowerLimit());
+            QCOMPARE(a.GetTarget().GetNominal(), e.GetTarget().GetNominal());
+            QCOMPARE(a.GetTarget().GetUpperLimit(), e.GetTarget().GetUpperLimit());
+            QCOMPARE(a.GetTarget().GetUnits(), e.GetTarget().GetUnits());
+            QCOMPARE(a.GetSamples().Size(), e.GetSamples().Size());
+            for (size_t i = 0; i < e.GetSamples().Size(); ++i)
+            {
+                QCOMPARE(a.GetSamples().At(i).value, e.GetSamples().At(i).value);
+                QCOMPARE(a.GetSamples().At(i).timestamp, e.GetSamples().At(i).timestamp);
+                QCOMPARE(a.GetSamples().At(i).lot, e.GetSamples().At(i).lot);
+            }
+            QCOMPARE(actualCtq->GetStatistics().count, e.GetSamples().Size());
+        }
+        for (auto r = 0; r < expected.ChildCount(); ++r)
+        {
+            compare(*expected.GetChild(r), *actual.GetChild(r));
+        }
+    }
+}
+
+class TestExchange : public QObject
+{
+    Q_OBJECT
+private slots:
+    void Xml()
+    {
+        const auto root = makeTree();
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadWrite);
+        QVERIFY(WriteXml(*root, buffer));
+        buffer.seek(0);
+        QString error;
+        const auto read = ReadXml(buffer, &error);
+        QVERIFY2(read, qPrintable(error));
+        compare(*root, *read);
+    }
+
+    // deeper item elements are an error instead of a stack overflow
+    void XmlNesting()
+    {
+        constexpr auto depth = 100000;
+        QByteArray xml("<ctqtree version=\"1\">");
+        for (auto i = 0; i < depth; ++i)
+        {
+            xml.append("<item>");
+        }
+        for (auto i = 0; i < depth; ++i)
+        {
+            xml.append("</item>");
+        }
+        xml.append("</ctqtree>");
+        QBuffer buffer(&xml);
+        buffer.open(QIODevice::ReadOnly);
+        QString error;
+        QVERIFY(!ReadXml(buffer, &error));
+        QVERIFY2(error.contains("nesting too deep"), qPrintable(error));
+    }
+
+    void Json()
+    {
+        const auto root = makeTree();
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadWrite);
+        QVERIFY(WriteJson(*root, buffer));
+        buffer.seek(0);
+        QString error;
+        const auto read = ReadJson(buffer, &error);
+        QVERIFY2(read, qPrintable(error));
+        compare(*root, *read);
+    }
+
+    void CloneOwnsSamples()
+    {
+        const auto root = makeTree();
+        const auto& original = static_cast<const Ctq&>(*root->GetChild(0)->GetChild(0)->GetChild(0)->GetData());
+        const auto copy = original.Clone();
+        const double value = 5.0;
+        const qint64 timestamp = 4000;
+        const quint32 lot = 3;
+        static_cast<Ctq&>(*copy).GetMeasurement().Append(&value, &timestamp, &lot, 1);
+        QCOMPARE(original.GetMeasurement().GetSamples().Size(), size_t(3));
+        QCOMPARE(static_cast<const Ctq&>(*copy).GetMeasurement().GetSamples().Size(), size_t(4));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestExchange)
+#include "tst_exchange.moc"
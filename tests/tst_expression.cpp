@@ -0,0 +1,140 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/expression.h"
+
+#include <QtTest>
+
+#include <limits>
+#include <vector>
+
+using namespace CtqTool;
+
+namespace
+{
+    double evaluate(const QString& source, const std::vector<QString>& names = {}, const std::vector<double>& inputs = {})
+    {
+        QString error;
+        const auto expression = Expression::Compile(source, names, error);
+        return expression ? expression->Evaluate(inputs.data()) : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    QString errorOf(const QString& source, const std::vector<QString>& names = {})
+    {
+        QString error;
+        const auto expression = Expression::Compile(source, names, error);
+        return expression ? QString() : error;
+    }
+
+    // 2^depth terms, each with a constant of its own, nested only depth deep
+    QString balancedSum(int depth)
+    {
+        return (depth == 0) ? QString("x * 1.5") : "(" + balancedSum(depth - 1) + " + " + balancedSum(depth - 1) + ")";
+    }
+}
+
+class TestExpression : public QObject
+{
+    Q_OBJECT
+private slots:
+    void Precedence()
+    {
+        QCOMPARE(evaluate("1 + 2 * 3 ^ 2"), 19.0);
+        QCOMPARE(evaluate("-2 ^ 2"), -4.0);
+        QCOMPARE(evaluate("2 ^ -1"), 0.5);
+        QCOMPARE(evaluate("2 ^ 3 ^ 2"), 512.0);
+        QCOMPARE(evaluate("(1 - 2) - 3"), -4.0);
+        QCOMPARE(evaluate("8 / 4 / 2"), 1.0);
+        QCOMPARE(evaluate("max(1, 3, 2) + pow(2, 3) + abs(-1)"), 12.0);
+    }
+
+    void Names()
+    {
+        const std::vector<QString> names{"CTQ a", "Gap (mm)"};
+        const std::vector<double> inputs{2.0, 5.0};
+        QCOMPARE(evaluate("ctq_a * gap_mm_", names, inputs), 10.0);
+        QCOMPARE(evaluate("[Gap (mm)] - [CTQ a]", names, inputs), 3.0);
+        QVERIFY(!errorOf("ctq_b", names).isEmpty());
+        QVERIFY(!errorOf("x", {"x", "X"}).isEmpty());
+    }
+
+    // batches of registers give what evaluating one trial at a time gives
+    void Batches()
+    {
+        QString error;
+        const auto expression = Expression::Compile("sqrt(a * a + b * b) - min(a, b) / 2", {"a", "b"}, error);
+        QVERIFY2(expression, qPrintable(error));
+        const auto count = Expression::batchSize * 2 + 3;
+        std::vector<double> a(count);
+        std::vector<double> b(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            a[i] = i * 0.5;
+            b[i] = 3.0 - i;
+        }
+        const double* inputs[] = {a.data(), b.data()};
+        std::vector<double> out(count);
+        expression->Evaluate(inputs, count, out.data());
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double one[] = {a[i], b[i]};
+            QCOMPARE(out[i], expression->Evaluate(one));
+        }
+    }
+
+    void Malformed()
+    {
+        QVERIFY(!errorOf("1 +").isEmpty());
+        QVERIFY(!errorOf("(1").isEmpty());
+        QVERIFY(!errorOf("1 2").isEmpty());
+        QVERIFY(!errorOf("[a").isEmpty());
+        QVERIFY(!errorOf("sqrt(1, 2)").isEmpty());
+        QVERIFY(!errorOf("1..2").isEmpty());
+    }
+
+    // deep sources fail to compile rather than run out of stack
+    void Limits()
+    {
+        QVERIFY(errorOf(QString(1000, '(') + "1" + QString(1000, ')')).contains("nested too deeply"));
+        QVERIFY(errorOf(QString("2^").repeated(1000) + "1").contains("nested too deeply"));
+        QCOMPARE(evaluate(QString(1000000, '-') + "1"), 1.0);
+        QCOMPARE(evaluate(QString("-+").repeated(100001) + "1"), -1.0);
+        // a chain as long as the terms, compiled and freed without recursing through it
+        QCOMPARE(evaluate("x" + QString(" + x").repeated(60000), {"x"}, {0.5}), 30000.5);
+        QCOMPARE(evaluate("1" + QString(" * x").repeated(200000), {"x"}, {1.0}), 1.0);
+    }
+
+    // instructions address constants and inputs with 16 bits
+    void Operands()
+    {
+        std::vector<QString> names;
+        for (auto i = 0; i <= 65535; ++i)
+        {
+            names.push_back(QString("in%1").arg(i));
+        }
+        QVERIFY(errorOf("in0", names).contains("inputs"));
+        names.pop_back();
+        QCOMPARE(evaluate("in65534", names, std::vector<double>(names.size(), 4.0)), 4.0);
+
+        QVERIFY(errorOf(balancedSum(16), {"x"}).contains("constants"));
+        QCOMPARE(evaluate(balancedSum(15), {"x"}, {2.0}), 32768 * 3.0);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestExpression)
+#include "tst_expression.moc"
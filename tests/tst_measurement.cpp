@@ -0,0 +1,110 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/measurement.h"
+
+#include <QtTest>
+
+#include <cmath>
+#include <vector>
+
+using namespace CtqTool;
+
+namespace
+{
+    void append(Measurement& measurement, size_t count)
+    {
+        std::vector<double> values;
+        for (size_t i = 0; i < count; ++i)
+        {
+            values.push_back(std::sin(i * 0.37) * 2.0 + (i % 7) * 0.1);
+        }
+        const std::vector<qint64> timestamps(count, 0);
+        const std::vector<quint32> lots(count, 0);
+        measurement.Append(values.data(), timestamps.data(), lots.data(), count);
+    }
+
+    void limit(Measurement& measurement)
+    {
+        measurement.GetTarget().SetLowerLimit(-1.5);
+        measurement.GetTarget().SetUpperLimit(1.9);
+    }
+}
+
+class TestMeasurement : public QObject
+{
+    Q_OBJECT
+private slots:
+    // a measurement that stops keeping samples agrees with one that keeps them
+    void StopsKeepingSamples()
+    {
+        Measurement kept;
+        Measurement streamed;
+        limit(kept);
+        limit(streamed);
+        streamed.SetSampleLimit(1000);
+        for (auto i = 0; i < 5; ++i)
+        {
+            append(kept, 700);
+            append(streamed, 700);
+        }
+        QVERIFY(kept.KeepsSamples());
+        QVERIFY(!streamed.KeepsSamples());
+        QCOMPARE(streamed.GetSamples().Size(), size_t(0));
+
+        const auto expected = ComputeStatistics(kept, kept.GetTarget());
+        const auto actual = ComputeStatistics(streamed, streamed.GetTarget());
+        QCOMPARE(actual.count, expected.count);
+        QVERIFY(std::abs(actual.mean - expected.mean) < 1e-12);
+        QVERIFY(std::abs(actual.stddev - expected.stddev) < 1e-12);
+        QCOMPARE(actual.min, expected.min);
+        QCOMPARE(actual.max, expected.max);
+        QVERIFY(std::abs(actual.ppm - expected.ppm) < 1e-6);
+
+        const auto& k = kept.UpdateConformance();
+        const auto& s = streamed.UpdateConformance();
+        QCOMPARE(s.in, k.in);
+        QCOMPARE(s.near, k.near);
+        QCOMPARE(s.out, k.out);
+    }
+
+    // after the target changed, the share outside it comes from the sketch
+    void RestatesFromSketch()
+    {
+        Measurement kept;
+        Measurement streamed;
+        streamed.SetSampleLimit(0);
+        append(kept, 20000);
+        append(streamed, 20000);
+        QVERIFY(!streamed.KeepsSamples());
+
+        limit(kept);
+        limit(streamed);
+        const auto expected = ComputeStatistics(kept, kept.GetTarget());
+        const auto actual = ComputeStatistics(streamed, streamed.GetTarget());
+        QCOMPARE(actual.count, expected.count);
+        QVERIFY(std::abs(actual.ppm - expected.ppm) < 0.017e6);
+        const auto& k = kept.UpdateConformance();
+        const auto& s = streamed.UpdateConformance();
+        QVERIFY(std::abs(double(s.out) - double(k.out)) < 0.017 * 20000);
+        QCOMPARE(s.in + s.near + s.out, k.in + k.near + k.out);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMeasurement)
+#include "tst_measurement.moc"
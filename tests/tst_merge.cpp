@@ -0,0 +1,197 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/ctqmerge.h"
+#include "datamodel/ctqmodel.h"
+#include "datamodel/item.h"
+
+#include <QtTest>
+
+using namespace CtqTool;
+
+namespace
+{
+    constexpr auto noteColumn = 1;
+
+    const QString base = "Need\tneed\t0\n"
+                         "    First\tfirst\t0\n"
+                         "    Second\tsecond\t0\n";
+
+    // the tree as text, note and rank, one line per item
+    QStringList describe(const TreeItem& item, const QString& indent = QString())
+    {
+        QStringList lines;
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            const auto& child = *item.GetChild(r);
+            lines.append(QString("%1%2 %3 %4").arg(indent, child.GetData()->GetText(), child.GetData()->GetNote())
+                .arg(child.GetRank()));
+            lines += describe(child, indent + "  ");
+        }
+        return lines;
+    }
+
+    MergeResult merge(const QString& b, const QString& o, const QString& t)
+    {
+        return Merge(*CtqModel::Parse(b), *CtqModel::Parse(o), *CtqModel::Parse(t));
+    }
+}
+
+class TestMerge : public QObject
+{
+    Q_OBJECT
+private slots:
+    // changes to different items and a sibling added by theirs all end up merged
+    void Clean()
+    {
+        const auto ours = "Need\tneed\t0\n"
+                          "    First\tours\t0\n"
+                          "    Second\tsecond\t0\n";
+        const auto theirs = "Need\tneed\t0\n"
+                            "    First\tfirst\t0\n"
+                            "    Second\tsecond\t2\n"
+                            "    Third\tthird\t0\n";
+        const auto result = merge(base, ours, theirs);
+        QVERIFY(result.conflicts.empty());
+        QCOMPARE(describe(*result.root), QStringList({"Need need 0", "  First ours 0", "  Second second 2",
+            "  Third third 0"}));
+    }
+
+    // a sibling only theirs inserted follows its preceding sibling in theirs
+    void InsertionKeepsPlace()
+    {
+        const auto ours = "Need\tneed\t0\n"
+                          "    First\tfirst\t0\n"
+                          "    Second\tours\t0\n";
+        const auto theirs = "Need\tneed\t0\n"
+                            "    First\tfirst\t0\n"
+                            "    Between\tbetween\t0\n"
+                            "    Second\tsecond\t0\n";
+        const auto result = merge(base, ours, theirs);
+        QVERIFY(result.conflicts.empty());
+        QCOMPARE(describe(*result.root), QStringList({"Need need 0", "  First first 0", "  Between between 0",
+            "  Second ours 0"}));
+    }
+
+    // both sides changing the same note differently keeps ours and reports it
+    void EditEdit()
+    {
+        const auto ours = "Need\tneed\t0\n"
+                          "    First\tours\t0\n"
+                          "    Second\tsecond\t0\n";
+        const auto theirs = "Need\tneed\t0\n"
+                            "    First\ttheirs\t1\n"
+                            "    Second\tsecond\t0\n";
+        const auto result = merge(base, ours, theirs);
+        QCOMPARE(describe(*result.root), QStringList({"Need need 0", "  First ours 1", "  Second second 0"}));
+        QCOMPARE(result.conflicts.size(), size_t(1));
+        const auto& conflict = result.conflicts.front();
+        QCOMPARE(conflict.kind, MergeConflict::Kind::Modified);
+        QCOMPARE(conflict.path, QStringList({"Need", "First"}));
+        QCOMPARE(conflict.column, noteColumn);
+        QCOMPARE(conflict.base.toString(), QString("first"));
+        QCOMPARE(conflict.ours.toString(), QString("ours"));
+        QCOMPARE(conflict.theirs.toString(), QString("theirs"));
+    }
+
+    // a deletion loses against a change on the other side
+    void DeleteEdit()
+    {
+        const auto deleted = "Need\tneed\t0\n"
+                             "    First\tfirst\t0\n";
+        const auto edited = "Need\tneed\t0\n"
+                            "    First\tfirst\t0\n"
+                            "    Second\tedited\t0\n";
+
+        auto result = merge(base, deleted, edited);
+        QCOMPARE(describe(*result.root), QStringList({"Need need 0", "  First first 0", "  Second edited 0"}));
+        QCOMPARE(result.conflicts.size(), size_t(1));
+        QCOMPARE(result.conflicts.front().kind, MergeConflict::Kind::DeletedByOurs);
+        QCOMPARE(result.conflicts.front().path, QStringList({"Need", "Second"}));
+
+        result = merge(base, edited, deleted);
+        QCOMPARE(describe(*result.root), QStringList({"Need need 0", "  First first 0", "  Second edited 0"}));
+        QCOMPARE(result.conflicts.size(), size_t(1));
+        QCOMPARE(result.conflicts.front().kind, MergeConflict::Kind::DeletedByTheirs);
+
+        // without a change on the other side, the deletion stands
+        result = merge(base, base, deleted);
+        QVERIFY(result.conflicts.empty());
+        QCOMPARE(describe(*result.root), QStringList({"Need need 0", "  First first 0"}));
+    }
+
+    // siblings with the same text are matched by which of them they are
+    void SameTextSiblings()
+    {
+        const auto twins = "Need\tneed\t0\n"
+                           "    Twin\tone\t0\n"
+                           "    Twin\ttwo\t0\n";
+        const auto ours = "Need\tneed\t0\n"
+                          "    Twin\tone\t1\n"
+                          "    Twin\ttwo\t0\n";
+        const auto theirs = "Need\tneed\t0\n"
+                            "    Twin\tone\t0\n"
+                            "    Twin\tchanged\t0\n";
+        const auto result = merge(twins, ours, theirs);
+        QVERIFY(result.conflicts.empty());
+        QCOMPARE(describe(*result.root), QStringList({"Need need 0", "  Twin one 1", "  Twin changed 0"}));
+    }
+
+    // copied items share the data of the input they come from, registered as
+    // its owners, and data shared within a tree stays shared
+    void SharedData()
+    {
+        const auto linked = "Need\tneed\t0\n"
+                            "    First\tfirst\t0\n"
+                            "        CTQ\tctq\t0\n"
+                            "    Second\tsecond\t0\n"
+                            "        CTQ\tctq\t0\t@2\n";
+        auto baseRoot = CtqModel::Parse(linked);
+        auto oursRoot = CtqModel::Parse(linked);
+        auto theirsRoot = CtqModel::Parse(QString(linked) + "Other\tother\t0\n");
+        const auto data = oursRoot->GetChild(0)->GetChild(0)->GetChild(0)->GetData();
+        QCOMPARE(data->GetOwners().size(), size_t(2));
+
+        auto result = Merge(*baseRoot, *oursRoot, *theirsRoot);
+        QVERIFY(result.conflicts.empty());
+        const auto& need = *result.root->GetChild(0);
+        QCOMPARE(need.GetChild(0)->GetChild(0)->GetData(), data);
+        QCOMPARE(need.GetChild(1)->GetChild(0)->GetData(), data);
+        QCOMPARE(data->GetOwners().size(), size_t(4));
+
+        baseRoot.reset();
+        oursRoot.reset();
+        theirsRoot.reset();
+        QCOMPARE(data->GetOwners().size(), size_t(2));
+        QCOMPARE(describe(*result.root).size(), qsizetype(6));
+    }
+
+    void ConflictText()
+    {
+        MergeConflict conflict;
+        conflict.path = QStringList({"Need", "First"});
+        conflict.column = noteColumn;
+        conflict.base = "a";
+        conflict.ours = "b";
+        conflict.theirs = "c";
+        QCOMPARE(ToString(conflict), QString("Need / First: note changed on both sides (base 'a', ours 'b', theirs 'c')"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMerge)
+#include "tst_merge.moc"
@@ -0,0 +1,112 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/ctqmodel.h"
+#include "datamodel/item.h"
+#include "datamodel/montecarlo.h"
+
+#include <QThreadPool>
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace CtqTool;
+
+namespace
+{
+    // A at 10 and B at 5, both with a tolerance of three sigma on each side,
+    // so the driver's value A + 2B has mean 20 and variance 0.2² + 4 * 0.1²
+    const QString tree = "Need\tnote\t0\n"
+                         "    Driver\tnote\t0\n"
+                         "        A\tnote\t0\tl=9.4\tn=10\tu=10.6\n"
+                         "        B\tnote\t0\tw=2\tl=4.7\tn=5\tu=5.3\n";
+
+    const TreeItem& driverOf(const TreeItem& root)
+    {
+        return *root.GetChild(0)->GetChild(0);
+    }
+
+    SimulationResult simulate(quint64 seed, size_t trials)
+    {
+        auto root = CtqModel::Parse(tree);
+        Simulate(*root, {seed, trials});
+        return driverOf(*root).GetSimulation();
+    }
+}
+
+class TestMonteCarlo : public QObject
+{
+    Q_OBJECT
+private slots:
+    // a weighted sum of normal CTQs is normal with the summed variance
+    void LinearSum()
+    {
+        constexpr size_t trials = 1 << 16;
+        auto root = CtqModel::Parse(tree);
+        Simulate(*root, {7, trials});
+
+        const auto& driver = driverOf(*root).GetSimulation();
+        QCOMPARE(driver.trials, trials);
+        QVERIFY(std::abs(driver.mean - 20.0) < 0.01);
+        QVERIFY(std::abs(driver.stddev / std::sqrt(0.08) - 1.0) < 0.02);
+        QVERIFY(driver.min < driver.mean && driver.mean < driver.max);
+        // either CTQ beyond three sigma
+        QVERIFY(std::abs(driver.outOfSpec - (1.0 - 0.9973 * 0.9973)) < 0.0015);
+        QCOMPARE(root->GetChild(0)->GetSimulation().mean, driver.mean);
+
+        const auto& a = driverOf(*root).GetChild(0)->GetSimulation();
+        QVERIFY(std::abs(a.mean - 10.0) < 0.01);
+        QVERIFY(std::abs(a.stddev / 0.2 - 1.0) < 0.02);
+    }
+
+    // the same seed gives the same results on any number of threads
+    void IndependentOfThreads()
+    {
+        constexpr size_t trials = 10000;
+        auto* pool = QThreadPool::globalInstance();
+        const auto threads = pool->maxThreadCount();
+        pool->setMaxThreadCount(1);
+        const auto serial = simulate(3, trials);
+        pool->setMaxThreadCount(std::max(threads, 4));
+        const auto parallel = simulate(3, trials);
+        pool->setMaxThreadCount(threads);
+
+        QCOMPARE(parallel.trials, serial.trials);
+        QVERIFY(parallel.mean == serial.mean);
+        QVERIFY(parallel.stddev == serial.stddev);
+        QVERIFY(parallel.min == serial.min);
+        QVERIFY(parallel.max == serial.max);
+        QVERIFY(parallel.outOfSpec == serial.outOfSpec);
+
+        QVERIFY(simulate(4, trials).mean != serial.mean);
+    }
+
+    // once cancelled, a simulation stores nothing
+    void Cancel()
+    {
+        auto root = CtqModel::Parse(tree);
+        SimulationProgress progress;
+        progress.cancelled = true;
+        QVERIFY(!PrepareSimulation(*root, {1, 1 << 16})(progress));
+        QCOMPARE(driverOf(*root).GetSimulation().trials, size_t(0));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMonteCarlo)
+#include "tst_montecarlo.moc"
@@ -0,0 +1,212 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/ctq.h"
+#include "datamodel/ctqmodel.h"
+#include "datamodel/item.h"
+#include "datamodel/journal.h"
+#include "datamodel/sqlstore.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace CtqTool;
+
+namespace
+{
+    // a need with drivers First and Second, each with a CTQ
+    std::unique_ptr<TreeItem> makeTree()
+    {
+        return CtqModel::Parse("Need\tnote\t0\n"
+                               "    First\tnote\t0\n"
+                               "        Width\tmeasured\t0\tl=1\tn=1.5\tu=2\tm=mm\n"
+                               "    Second\tnote\t0\n"
+                               "        Depth\tmeasured\t0\tu=4\n");
+    }
+
+    const Target& targetOf(const TreeItem& item)
+    {
+        return dynamic_cast<const Ctq&>(*item.GetData()).GetMeasurement().GetTarget();
+    }
+
+    // the CTQ under a driver, as the lazy model fetches it
+    ItemLine fetchCtq(const SqlStore& store, int driver)
+    {
+        const auto need = store.GetChildren(store.GetRoot(), 0, 1).at(0);
+        const auto parent = store.GetChildren(need.id, driver, 1).at(0);
+        return store.GetChildren(parent.id, 0, 1).at(0).item;
+    }
+}
+
+class TestSqlStore : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init()
+    {
+        QVERIFY(dir.isValid());
+        filename = dir.filePath(QString("%1.ctqdb").arg(QTest::currentTestFunction()));
+    }
+
+    void Targets()
+    {
+        auto store = SqlStore::Open(filename);
+        QVERIFY(store);
+        QVERIFY(store->Write(*makeTree()));
+
+        const auto width = fetchCtq(*store, 0);
+        QCOMPARE(width.lower, std::optional<double>(1.0));
+        QCOMPARE(width.nominal, std::optional<double>(1.5));
+        QCOMPARE(width.upper, std::optional<double>(2.0));
+        QCOMPARE(width.units, QString("mm"));
+        const auto depth = fetchCtq(*store, 1);
+        QVERIFY(!depth.lower.has_value());
+        QCOMPARE(depth.upper, std::optional<double>(4.0));
+
+        const auto tree = store->Read();
+        QVERIFY(tree);
+        const auto& target = targetOf(*tree->GetChild(0)->GetChild(0)->GetChild(0));
+        QCOMPARE(target.GetLowerLimit(), std::optional<double>(1.0));
+        QCOMPARE(target.GetNominal(), std::optional<double>(1.5));
+        QCOMPARE(target.GetUpperLimit(), std::optional<double>(2.0));
+        QCOMPARE(target.GetUnits(), QString("mm"));
+    }
+
+    // edited targets are saved, and linked items take over the target with the text
+    void ApplyTargets()
+    {
+        auto store = SqlStore::Open(filename);
+        QVERIFY(store);
+        QVERIFY(store->Write(*makeTree()));
+
+        const std::vector<JournalRecord> records = {
+            {JournalRecord::Operation::SetTarget, {0, 1, 0}, 0, 0, "\tl=3\tu=5\tm=mm", {}},
+            {JournalRecord::Operation::Link, {0, 0, 0}, 0, 0, {}, {0, 1, 0}}
+        };
+        QVERIFY(store->Apply(records));
+
+        for (const auto driver : {0, 1})
+        {
+            const auto ctq = fetchCtq(*store, driver);
+            QCOMPARE(ctq.text, QString("Depth"));
+            QCOMPARE(ctq.lower, std::optional<double>(3.0));
+            QVERIFY(!ctq.nominal.has_value());
+            QCOMPARE(ctq.upper, std::optional<double>(5.0));
+            QCOMPARE(ctq.units, QString("mm"));
+        }
+    }
+
+    void Queries()
+    {
+        auto store = SqlStore::Open(filename);
+        QVERIFY(store);
+        QVERIFY(store->Write(*CtqModel::Parse("Need\tnote\t0\n"
+                                              "    First\tnote\t0\n"
+                                              "        Width*\tmeasured\t0\n"
+                                              "        Weight\tmeasured\t0\n"
+                                              "    Second\tnote\t0\n"
+                                              "        Depth\tmeasured\t0\n"
+                                              "Other\tnote\t0\n")));
+        const auto texts = [](const std::vector<NodeStore::Node>& nodes)
+        {
+            QStringList texts;
+            for (const auto& node : nodes)
+            {
+                texts.append(node.item.text);
+            }
+            return texts;
+        };
+
+        const auto need = store->GetChildren(store->GetRoot(), 0, 1).at(0);
+        QCOMPARE(need.childCount, 2);
+        QCOMPARE(texts(store->GetSubtree(need.id)), QStringList({"Need", "First", "Second", "Width*", "Weight", "Depth"}));
+        QCOMPARE(texts(store->GetLevel(1, 0, 10)), QStringList({"Need", "Other"}));
+        QCOMPARE(texts(store->GetLevel(3, 1, 10)), QStringList({"Weight", "Depth"}));
+        QCOMPARE(texts(store->Search("W", 10)), QStringList({"Weight", "Width*"}));
+        QCOMPARE(texts(store->Search("W", 1)), QStringList({"Weight"}));
+        // pattern characters are matched as they are
+        QCOMPARE(texts(store->Search("Width*", 10)), QStringList({"Width*"}));
+        QCOMPARE(texts(store->Search("*", 10)), QStringList());
+        QCOMPARE(texts(store->Search("w", 10)), QStringList());
+
+        const auto depth = store->Search("Depth", 1).at(0);
+        const auto ancestry = store->GetAncestry(depth.id);
+        QCOMPARE(ancestry.size(), size_t(4));
+        QCOMPARE(ancestry.front(), store->GetRoot());
+        QCOMPARE(ancestry[1], need.id);
+        QCOMPARE(ancestry.back(), depth.id);
+        QVERIFY(store->GetAncestry(12345).empty());
+    }
+
+    // a lazy model finds stored items by id, though edits moved their rows
+    void FetchStored()
+    {
+        std::shared_ptr<SqlStore> store = SqlStore::Open(filename);
+        QVERIFY(store);
+        QVERIFY(store->Write(*makeTree()));
+        CtqModel model;
+        model.Reset(std::shared_ptr<NodeStore>(store));
+
+        const auto depth = store->Search("Depth", 1).at(0);
+        auto index = model.FetchStored(store->GetAncestry(depth.id));
+        QVERIFY(index.isValid());
+        QCOMPARE(index.data().toString(), QString("Depth"));
+        QCOMPARE(index.parent().row(), 1);
+
+        QVERIFY(model.insertRows(0, 1, model.index(0, 0)));
+        index = model.FetchStored(store->GetAncestry(depth.id));
+        QCOMPARE(index.data().toString(), QString("Depth"));
+        QCOMPARE(index.parent().row(), 2);
+
+        QVERIFY(model.removeRows(2, 1, model.index(0, 0)));
+        QVERIFY(!model.FetchStored(store->GetAncestry(depth.id)).isValid());
+        QVERIFY(!model.FetchStored({}).isValid());
+    }
+
+    // a database from before targets were stored gets their columns
+    void EarlierSchema()
+    {
+        {
+            auto db = QSqlDatabase::addDatabase("QSQLITE", "earlier");
+            db.setDatabaseName(filename);
+            QVERIFY(db.open());
+            QSqlQuery query(db);
+            QVERIFY(query.exec("CREATE TABLE node (id INTEGER PRIMARY KEY, parent INTEGER, row INTEGER NOT NULL, "
+                "depth INTEGER NOT NULL, text TEXT NOT NULL, note TEXT NOT NULL, rank INTEGER NOT NULL DEFAULT 0, "
+                "weight REAL NOT NULL DEFAULT 1, transfer TEXT NOT NULL DEFAULT '', children INTEGER NOT NULL DEFAULT 0)"));
+            QVERIFY(query.exec("INSERT INTO node (id, parent, row, depth, text, note) VALUES (1, NULL, 0, 0, 'Title', 'Note')"));
+            db.close();
+        }
+        QSqlDatabase::removeDatabase("earlier");
+
+        auto store = SqlStore::Open(filename);
+        QVERIFY(store);
+        QCOMPARE(store->GetRoot(), NodeStore::Id(1));
+        QVERIFY(store->Write(*makeTree()));
+        QCOMPARE(fetchCtq(*store, 0).units, QString("mm"));
+    }
+
+private:
+    QTemporaryDir dir;
+    QString filename;
+};
+
+QTEST_GUILESS_MAIN(TestSqlStore)
+#include "tst_sqlstore.moc"
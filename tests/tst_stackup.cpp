@@ -0,0 +1,134 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/ctqmodel.h"
+#include "datamodel/item.h"
+#include "datamodel/stackup.h"
+
+#include <QtTest>
+
+#include <cmath>
+
+using namespace CtqTool;
+
+namespace
+{
+    // children first, as the model does
+    void computeStackUps(TreeItem& item)
+    {
+        for (auto r = 0; r < item.ChildCount(); ++r)
+        {
+            computeStackUps(*item.GetChild(r));
+        }
+        item.SetStackUp(ComputeStackUp(item));
+    }
+
+    std::unique_ptr<TreeItem> stackUps(const QString& tree)
+    {
+        auto root = CtqModel::Parse(tree);
+        for (auto r = 0; r < root->ChildCount(); ++r)
+        {
+            computeStackUps(*root->GetChild(r));
+        }
+        return root;
+    }
+
+    const StackUp& driverOf(const TreeItem& root)
+    {
+        return root.GetChild(0)->GetChild(0)->GetStackUp();
+    }
+}
+
+class TestStackUp : public QObject
+{
+    Q_OBJECT
+private slots:
+    // A at 10 ± 0.6 plus twice B at 5 ± 0.3
+    void LinearSum()
+    {
+        const auto root = stackUps("Need\tnote\t0\n"
+                                   "    Driver\tnote\t0\n"
+                                   "        A\tnote\t0\tl=9.4\tn=10\tu=10.6\n"
+                                   "        B\tnote\t0\tw=2\tl=4.7\tn=5\tu=5.3\n");
+        const auto& driver = driverOf(*root);
+        QVERIFY(driver.nominal.has_value());
+        QCOMPARE(*driver.nominal, 20.0);
+        QCOMPARE(driver.worstCase, 1.2);
+        QCOMPARE(driver.rss, std::sqrt(0.6 * 0.6 + 0.6 * 0.6));
+        // normal CTQs sum to a normal value, of which the RSS is three sigma
+        QCOMPARE(driver.statistical, driver.rss);
+        QVERIFY(!driver.nonlinear);
+        QCOMPARE(root->GetChild(0)->GetStackUp(), driver);
+    }
+
+    // a CTQ shown under two drivers adds up with itself rather than in quadrature
+    void Linked()
+    {
+        const auto tree = QString("Need\tnote\t0\n"
+                                  "    First\tnote\t0\n"
+                                  "        C\tnote\t0\tl=9\tn=10\tu=11\n"
+                                  "    Second\tnote\t0%1\n"
+                                  "        C\tnote\t0\t@2\n");
+
+        auto root = stackUps(tree.arg(QString()));
+        auto need = root->GetChild(0)->GetStackUp();
+        QCOMPARE(*need.nominal, 20.0);
+        QCOMPARE(need.worstCase, 2.0);
+        QCOMPARE(need.rss, 2.0);
+
+        // and so cancels out where it is subtracted
+        root = stackUps(tree.arg("\tw=-1"));
+        need = root->GetChild(0)->GetStackUp();
+        QCOMPARE(*need.nominal, 0.0);
+        QCOMPARE(need.worstCase, 0.0);
+        QCOMPARE(need.rss, 0.0);
+    }
+
+    // through the sensitivities of a product at the nominal values, 5 and 10
+    void Transfer()
+    {
+        const auto tree = "Need\tnote\t0\n"
+                          "    Driver\tnote\t0\tt=a * b\n"
+                          "        A\tnote\t0\tl=9.4\tn=10\tu=10.6\n"
+                          "        B\tnote\t0\tl=4.7\tn=5\tu=5.3\n";
+        const auto root = stackUps(tree);
+        const auto& driver = driverOf(*root);
+        QVERIFY(driver.nonlinear);
+        QCOMPARE(*driver.nominal, 50.0);
+        QVERIFY(std::abs(driver.worstCase - 6.0) < 1e-6);
+        QVERIFY(std::abs(driver.rss - std::sqrt(18.0)) < 1e-6);
+
+        // sampled: three sigma of the product, close to the RSS for tolerances this small
+        const auto threeSigma = 3 * std::sqrt(1.0 + 1.0 + 0.02 * 0.02);
+        QVERIFY2(std::abs(driver.statistical / threeSigma - 1.0) < 0.1, qPrintable(QString::number(driver.statistical)));
+        // with a fixed seed
+        QCOMPARE(driverOf(*stackUps(tree)).statistical, driver.statistical);
+    }
+
+    void WithoutTargets()
+    {
+        const auto root = stackUps("Need\tnote\t0\n"
+                                   "    Driver\tnote\t0\n"
+                                   "        A\tnote\t0\n");
+        QVERIFY(!driverOf(*root).nominal.has_value());
+        QVERIFY(!root->GetChild(0)->GetStackUp().nominal.has_value());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestStackUp)
+#include "tst_stackup.moc"
@@ -0,0 +1,82 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/samplestore.h"
+#include "datamodel/statistics.h"
+#include "datamodel/target.h"
+
+#include <QtTest>
+
+#include <cmath>
+
+using namespace CtqTool;
+
+class TestStatistics : public QObject
+{
+    Q_OBJECT
+private slots:
+    void Moments_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::newRow("empty") << 0;
+        QTest::newRow("one") << 1;
+        QTest::newRow("under a lane") << 3;
+        QTest::newRow("lanes and a tail") << 7;
+        QTest::newRow("chunks") << int(SampleStore::chunkCapacity * 2 + 5);
+    }
+
+    // against two passes in long double, around a large offset that a
+    // sum of squares would lose the variance to
+    void Moments()
+    {
+        QFETCH(int, count);
+        SampleStore samples;
+        long double sum = 0.0;
+        for (auto i = 0; i < count; ++i)
+        {
+            const auto v = 1e9 + (i % 17) * 0.25 - (i % 5);
+            samples.Append(v, i, 0);
+            sum += v;
+        }
+        Target target;
+        target.SetUpperLimit(1e9 + 3.0);
+        const auto s = ComputeStatistics(samples, target);
+        QCOMPARE(s.count, size_t(count));
+        if (count == 0)
+        {
+            return;
+        }
+
+        const auto mean = sum / count;
+        long double m2 = 0.0;
+        size_t outside = 0;
+        for (size_t i = 0; i < samples.Size(); ++i)
+        {
+            const auto v = samples.At(i).value;
+            m2 += (v - mean) * (v - mean);
+            outside += v > 1e9 + 3.0;
+        }
+        const auto stddev = count > 1 ? std::sqrt(static_cast<double>(m2 / (count - 1))) : 0.0;
+        QVERIFY(std::abs(s.mean - static_cast<double>(mean)) < 1e-12 * std::abs(s.mean));
+        QVERIFY(std::abs(s.stddev - stddev) < 1e-8 * std::max(1.0, stddev));
+        QCOMPARE(s.ppm, 1e6 * outside / count);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestStatistics)
+#include "tst_statistics.moc"
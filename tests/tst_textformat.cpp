@@ -0,0 +1,216 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "datamodel/ctq.h"
+#include "datamodel/ctqmodel.h"
+#include "datamodel/document.h"
+#include "datamodel/documentstore.h"
+#include "datamodel/item.h"
+#include "datamodel/journal.h"
+#include "datamodel/textformat.h"
+
+#include <QBuffer>
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace CtqTool;
+
+namespace
+{
+    std::shared_ptr<TreeItem> append(TreeItem& parent, const QString& text, const QString& note)
+    {
+        auto item = std::make_shared<TreeItem>(MakeItemData(parent.Depth() + 1, text, note), &parent);
+        parent.Append(item);
+        return item;
+    }
+
+    QByteArray write(const TreeItem& root)
+    {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        WriteTree(root, buffer);
+        return buffer.data();
+    }
+
+    void compare(const TreeItem& expected, const TreeItem& actual)
+    {
+        QCOMPARE(actual.GetData()->GetText(), expected.GetData()->GetText());
+        QCOMPARE(actual.GetData()->GetNote(), expected.GetData()->GetNote());
+        QCOMPARE(actual.GetRank(), expected.GetRank());
+        QCOMPARE(actual.GetWeight(), expected.GetWeight());
+        QCOMPARE(actual.GetTransfer(), expected.GetTransfer());
+        if (const auto* ctq = dynamic_cast<const Ctq*>(expected.GetData().get()); ctq != nullptr)
+        {
+            const auto& e = ctq->GetMeasurement().GetTarget();
+            const auto& a = static_cast<const Ctq&>(*actual.GetData()).GetMeasurement().GetTarget();
+            QCOMPARE(a.GetLowerLimit(), e.GetLowerLimit());
+            QCOMPARE(a.GetNominal(), e.GetNominal());
+            QCOMPARE(a.GetUpperLimit(), e.GetUpperLimit());
+            QCOMPARE(a.GetUnits(), e.GetUnits());
+        }
+        QCOMPARE(actual.ChildCount(), expected.ChildCount());
+        for (auto r = 0; r < expected.ChildCount(); ++r)
+        {
+            compare(*expected.GetChild(r), *actual.GetChild(r));
+        }
+    }
+}
+
+class TestTextFormat : public QObject
+{
+    Q_OBJECT
+private slots:
+    void RoundTrip_data()
+    {
+        QTest::addColumn<QString>("text");
+        QTest::addColumn<QString>("note");
+
+        QTest::newRow("plain") << "Need" << "a note";
+        QTest::newRow("empty text") << "" << "a note";
+        QTest::newRow("empty note") << "Need" << "";
+        QTest::newRow("both empty") << "" << "";
+        QTest::newRow("leading space") << "  indented" << " note";
+        QTest::newRow("trailing space") << "text " << "note\t ";
+        QTest::newRow("only spaces") << "   " << " ";
+        QTest::newRow("other whitespace") << QString(QChar(0x00a0)) + "x\v" << QString("\fnote") + QChar(0x2003);
+        QTest::newRow("escapes") << "%percent" << "back\\slash\nline\r\\e\\s\\u0020";
+    }
+
+    void RoundTrip()
+    {
+        QFETCH(QString, text);
+        QFETCH(QString, note);
+
+        auto root = CtqModel::Parse(QString());
+        auto need = append(*root, text, note);
+        need->SetRank(3);
+        auto driver = append(*need, note, text);
+        driver->SetWeight(0.25);
+        driver->SetTransfer(" a + b ");
+        auto ctq = append(*driver, text, "");
+        auto& target = static_cast<Ctq&>(*ctq->GetData()).GetMeasurement().GetTarget();
+        target.SetLowerLimit(-0.1);
+        target.SetUpperLimit(1.0 / 3.0);
+        target.SetUnits(text);
+        append(*driver, "unlimited", note);
+        append(*root, "next", text);
+
+        const auto written = write(*root);
+        const auto read = CtqModel::Parse(QString::fromUtf8(written));
+        compare(*root, *read);
+        QCOMPARE(write(*read), written);
+    }
+
+    void LegacyLines()
+    {
+        // written by hand: doubled tabs and surrounding whitespace are not columns
+        const auto root = CtqModel::Parse("Need\t\tnote  \n    Driver\t \tother\t\n");
+        QCOMPARE(root->ChildCount(), 1);
+        const auto& need = *root->GetChild(0);
+        QCOMPARE(need.GetData()->GetText(), QString("Need"));
+        QCOMPARE(need.GetData()->GetNote(), QString("note"));
+        QCOMPARE(need.ChildCount(), 1);
+        QCOMPARE(need.GetChild(0)->GetData()->GetText(), QString("Driver"));
+        QCOMPARE(need.GetChild(0)->GetData()->GetNote(), QString(" "));
+    }
+
+    void TargetRecord()
+    {
+        auto root = CtqModel::Parse("Need\tnote\t0\n    Driver\tnote\t0\n        CTQ\tnote\t0\tu=2\n");
+        auto& target = static_cast<Ctq&>(*root->GetChild(0)->GetChild(0)->GetChild(0)->GetData()).GetMeasurement().GetTarget();
+        QCOMPARE(target.GetUpperLimit(), std::optional<double>(2.0));
+
+        Target edited;
+        edited.SetLowerLimit(1.5);
+        edited.SetNominal(2.5);
+        edited.SetUnits("\tmm ");
+        QByteArray columns;
+        AppendTarget(columns, edited);
+
+        QByteArray line;
+        AppendTo(line, {JournalRecord::Operation::SetTarget, {0, 0, 0}, 0, 0, QString::fromUtf8(columns), {}});
+        JournalRecord record;
+        QVERIFY(Parse(line.chopped(1), record));
+        QVERIFY(Apply(record, *root));
+        QCOMPARE(target.GetLowerLimit(), edited.GetLowerLimit());
+        QCOMPARE(target.GetNominal(), edited.GetNominal());
+        QCOMPARE(target.GetUpperLimit(), std::optional<double>());
+        QCOMPARE(target.GetUnits(), edited.GetUnits());
+
+        // not a CTQ
+        record.path = {0};
+        QVERIFY(!Apply(record, *root));
+    }
+
+    // an item sharing an earlier one's data is fetched with its target
+    void LazySharedItem()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const auto filename = dir.filePath("shared.ctq");
+        QFile file(filename);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("Need\tnote\t0\n"
+                   "    First\tnote\t0\n"
+                   "        CTQ\tmeasured\t0\tl=1\tu=2\n"
+                   "    Second\tnote\t0\n"
+                   "        CTQ\tmeasured\t3\t@2\n");
+        file.close();
+
+        for (auto pass = 0; pass < 2; ++pass) // with the index built, then read back
+        {
+            const auto store = DocumentStore::Open(filename);
+            QVERIFY(store);
+            const auto need = store->GetChildren(store->GetRoot(), 0, 1).at(0);
+            const auto second = store->GetChildren(need.id, 1, 1).at(0);
+            const auto ctq = store->GetChildren(second.id, 0, 1).at(0).item;
+            QCOMPARE(ctq.text, QString("CTQ"));
+            QCOMPARE(ctq.note, QString("measured"));
+            QCOMPARE(ctq.rank, static_cast<unsigned short>(3));
+            QCOMPARE(ctq.lower, std::optional<double>(1.0));
+            QCOMPARE(ctq.upper, std::optional<double>(2.0));
+        }
+    }
+
+    void ReadStopsAtFailingBlock()
+    {
+        auto root = CtqModel::Parse(QString());
+        append(*root, "Need", "note");
+        auto bytes = write(*root);
+
+        const auto appendBlock = [&bytes](const QByteArray& records, int count)
+        {
+            bytes += "%begin\n" + records + "%commit\t" + QByteArray::number(count) + "\t" +
+                QByteArray::number(qChecksum(QByteArrayView(records))) + "\n";
+        };
+
+        // renames the need, then renames it again and edits an item that does not exist
+        appendBlock("S\t0\t0\tFirst\n", 1);
+        const auto firstCommit = bytes.size();
+        appendBlock("S\t0\t0\tSecond\nS\t5\t0\tMissing\n", 2);
+
+        const auto contents = Document::Read(bytes);
+        QVERIFY(contents.root);
+        QCOMPARE(contents.root->GetChild(0)->GetData()->GetText(), QString("First"));
+        QCOMPARE(contents.committedSize, qint64(firstCommit));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestTextFormat)
+#include "tst_textformat.moc"
@@ -0,0 +1,195 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/ctqmodel.h"
+#include "ui/treeview.h"
+
+#include "datamodel/nodestore.h"
+
+#include <QtTest>
+
+using namespace CtqTool;
+
+namespace
+{
+    constexpr auto noteColumn = 1;
+    const QString threeLines = "one\ntwo\nthree";
+
+    // needs with drivers without CTQs; need n has id n + 1
+    class NeedStore : public NodeStore
+    {
+    public:
+        NeedStore(int needs, int drivers) :
+            needs(needs),
+            drivers(drivers)
+        {
+        }
+
+        Id GetRoot() const override
+        {
+            return 0;
+        }
+
+        int ChildCount(Id id) const override
+        {
+            return id == 0 ? needs : (id <= static_cast<Id>(needs) ? drivers : 0);
+        }
+
+        std::vector<Node> GetChildren(Id parent, int first, int count) const override
+        {
+            std::vector<Node> nodes;
+            for (auto r = first; r < std::min(first + count, ChildCount(parent)); ++r)
+            {
+                Node node;
+                if (parent == 0)
+                {
+                    node.id = r + 1;
+                    node.item.text = QString("Need %1").arg(r);
+                    node.childCount = drivers;
+                }
+                else
+                {
+                    node.id = (parent * 1000) + r;
+                    node.item.text = QString("Driver %1").arg(r);
+                }
+                nodes.push_back(node);
+            }
+            return nodes;
+        }
+
+    private:
+        int needs;
+        int drivers;
+    };
+}
+
+class TestTreeView : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init()
+    {
+        model = std::make_unique<CtqModel>();
+        model->Reset(CtqModel::Parse("A\tnote\t0\n"
+                                     "B\tnote\t0\n"
+                                     "C\tnote\t0\n"));
+        view = std::make_unique<TreeView>();
+        view->setModel(model.get());
+        view->resize(640, 480);
+        view->show();
+        QVERIFY(QTest::qWaitForWindowExposed(view.get()));
+    }
+
+    void cleanup()
+    {
+        view.reset();
+        model.reset();
+    }
+
+    // per row, a row is as high as its note; uniform, every row as the first
+    void RowHeights()
+    {
+        QVERIFY(model->setData(model->index(1, noteColumn), threeLines));
+        QTRY_VERIFY(height(1) > height(0));
+        QCOMPARE(height(2), height(0));
+
+        view->SetRowHeights(TreeView::RowHeights::Uniform);
+        QCOMPARE(view->GetRowHeights(), TreeView::RowHeights::Uniform);
+        QCOMPARE(height(1), height(0));
+        QCOMPARE(height(2), height(0));
+
+        view->SetRowHeights(TreeView::RowHeights::PerRow);
+        QVERIFY(height(1) > height(0));
+    }
+
+    // a cached height goes once its row changes
+    void CacheFollowsEdits()
+    {
+        const auto single = height(0);
+        QVERIFY(model->setData(model->index(0, noteColumn), threeLines));
+        QTRY_VERIFY(height(0) > single);
+        QVERIFY(model->setData(model->index(0, noteColumn), "one"));
+        QTRY_COMPARE(height(0), single);
+    }
+
+    // and once the row is removed, for an item that comes in its place
+    void CacheForgetsRemovedRows()
+    {
+        const auto single = height(0);
+        QVERIFY(model->setData(model->index(0, noteColumn), threeLines));
+        QTRY_VERIFY(height(0) > single);
+        QVERIFY(model->removeRows(0, 1, QModelIndex()));
+        QVERIFY(model->insertRows(0, 1, QModelIndex()));
+        QCOMPARE(height(0), single);
+    }
+
+    // of siblings with the same text, only the one that was expanded is again
+    void ExpansionTellsSameTextsApart()
+    {
+        const auto text = "Need\tnote\t0\n"
+                          "    Same\tnote\t0\n"
+                          "        CTQ\tnote\t0\n"
+                          "    Same\tnote\t0\n"
+                          "        CTQ\tnote\t0\n";
+        model->Reset(CtqModel::Parse(text));
+        const auto need = model->index(0, 0);
+        view->expand(need);
+        view->expand(model->index(1, 0, need));
+        const auto expansion = view->SaveExpansion();
+        QCOMPARE(expansion.size(), size_t(2));
+
+        model->Reset(CtqModel::Parse(text));
+        view->RestoreExpansion(expansion);
+        const auto reloaded = model->index(0, 0);
+        QVERIFY(view->isExpanded(reloaded));
+        QVERIFY(!view->isExpanded(model->index(0, 0, reloaded)));
+        QVERIFY(view->isExpanded(model->index(1, 0, reloaded)));
+    }
+
+    // expanding all of a lazy tree stops at the fetch budget, leaving the rest collapsed
+    void ExpandingKeepsToFetchBudget()
+    {
+        constexpr auto needs = 20;
+        constexpr auto drivers = 5;
+        model->SetFetchBudget(needs + 2 * drivers);
+        model->Reset(std::make_shared<NeedStore>(needs, drivers));
+        view->ExpandToDepth(std::numeric_limits<int>::max());
+
+        QCOMPARE(model->rowCount(), needs);
+        QVERIFY(!model->IsWithinFetchBudget());
+        QVERIFY(view->isExpanded(model->index(0, 0)));
+        QVERIFY(view->isExpanded(model->index(1, 0)));
+        for (auto r = 2; r < needs; ++r)
+        {
+            QVERIFY(!view->isExpanded(model->index(r, 0)));
+            QCOMPARE(model->rowCount(model->index(r, 0)), 0);
+        }
+    }
+
+private:
+    int height(int row) const
+    {
+        return view->visualRect(model->index(row, 0)).height();
+    }
+
+    std::unique_ptr<CtqModel> model;
+    std::unique_ptr<TreeView> view;
+};
+
+QTEST_MAIN(TestTreeView)
+#include "tst_treeview.moc"
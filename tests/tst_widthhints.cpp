@@ -0,0 +1,91 @@
+/*
+ * this file is part of CTQ tool - a tool to explore critical to quality trees
+ * Copyright (C) 2021 Sjoerd Crijns
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datamodel/ctqmodel.h"
+
+#include <QtTest>
+
+using namespace CtqTool;
+
+class TestWidthHints : public QObject
+{
+    Q_OBJECT
+private slots:
+    // each level keeps its own texts
+    void PerLevel()
+    {
+        CtqModel model;
+        model.Reset(CtqModel::Parse("N\tnote\t0\n"
+                                    "    A driver with a long text\tnote\t0\n"
+                                    "        Width\ta note of some length\t0\n"));
+        QCOMPARE(model.GetWidthHints(0, 1), std::vector<QString>{"N"});
+        QCOMPARE(model.GetWidthHints(0, 2), std::vector<QString>{"A driver with a long text"});
+        QCOMPARE(model.GetWidthHints(0, 3), std::vector<QString>{"Width"});
+        QCOMPARE(model.GetWidthHints(1, 3), std::vector<QString>{"a note of some length"});
+        QVERIFY(model.GetWidthHints(0, 4).empty());
+        QVERIFY(model.GetWidthHints(model.columnCount() - 1, 1).empty());
+    }
+
+    // the longest few by characters, longest first, each once
+    void Candidates()
+    {
+        QString source;
+        for (auto i = 1; i <= 20; ++i)
+        {
+            source += QString(i, QChar('a' + i % 3)) + "\tnote\t0\n";
+        }
+        source += QString(20, QChar('a' + 20 % 3)) + "\tnote\t0\n";
+        CtqModel model;
+        model.Reset(CtqModel::Parse(source));
+
+        const auto& hints = model.GetWidthHints(0, 1);
+        QCOMPARE(hints.size(), CtqModel::widthCandidates);
+        for (size_t i = 0; i < hints.size(); ++i)
+        {
+            QCOMPARE(hints[i].size(), qsizetype(20 - i));
+        }
+    }
+
+    // edits and inserted rows extend the hint of their level only
+    void Edits()
+    {
+        CtqModel model;
+        model.Reset(CtqModel::Parse("Need\tnote\t0\n"
+                                    "    Driver\tnote\t0\n"));
+        std::vector<int> changed;
+        connect(&model, &CtqModel::WidthHintChanged, this, [&changed](int column) { changed.push_back(column); });
+
+        const auto need = model.index(0, 0);
+        const auto driver = model.index(0, 0, need);
+        QVERIFY(model.setData(driver, "A longer driver"));
+        QCOMPARE(changed, std::vector<int>{0});
+        QCOMPARE(model.GetWidthHints(0, 2).front(), QString("A longer driver"));
+        QCOMPARE(model.GetWidthHints(0, 1), std::vector<QString>{"Need"});
+
+        changed.clear();
+        QVERIFY(model.setData(driver, "Driver"));
+        QVERIFY(changed.empty());
+
+        QVERIFY(model.insertRows(0, 1, driver));
+        QVERIFY(!changed.empty());
+        QCOMPARE(model.GetWidthHints(0, 3), std::vector<QString>{"[not set]"});
+    }
+};
+
+QTEST_GUILESS_MAIN(TestWidthHints)
+#include "tst_widthhints.moc"